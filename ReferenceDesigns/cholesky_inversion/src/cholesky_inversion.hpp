@@ -5,12 +5,15 @@
 #include <sycl/ext/intel/ac_types/ac_complex.hpp>
 #include <sycl/ext/intel/ac_types/ac_int.hpp>
 #include <sycl/ext/intel/fpga_extensions.hpp>
+#include <stdexcept>
+#include <string>
 #include <type_traits>
 #include <vector>
 
 #include "memory_transfers.hpp"
 
 // Included from include/
+#include "matrix_size.hpp"
 #include "streaming_cholesky.hpp"
 #include "streaming_cholesky_inversion.hpp"
 #include "tuple.hpp"
@@ -24,6 +27,16 @@ class CholeskyLocalMemToDDR;
 class APipe;
 class LPipe;
 class IPipe;
+class CholeskyMixedDDRToLocalMem;
+class InversionMixedSizes;
+class DecompositionMixedKernel;
+class InversionMixedKernel;
+class CholeskyMixedLocalMemToDDR;
+class AMixedPipe;
+class LMixedPipe;
+class IMixedPipe;
+class DecompositionSizeMixedPipe;
+class InversionSizeMixedPipe;
 
 /*
   Implementation of the Cholesky-based inversion using streaming kernels
@@ -135,4 +148,171 @@ void CholeskyInversionImpl(
   free(i_device, q);
 }
 
+/*
+  Implementation of the Cholesky-based inversion of a batch of matrices of
+  different sizes, up to dimension x dimension, using streaming kernels.
+  The size of each matrix is read by the kernel that loads the matrices from
+  DDR, which streams it to the decomposition kernel ahead of the matrix, and
+  by a separate kernel that streams it to the inversion kernel. The A matrices
+  are stored one after the other, each with its own size, as are the I
+  matrices.
+*/
+template <unsigned dimension,  // Maximum number of columns/rows of the
+                               // matrices
+          unsigned raw_latency_decomposition,  // RAW latency for triangular
+                                               // loop optimization
+          unsigned raw_latency_inversion,  // RAW latency for triangular loop
+                                           // optimization
+          bool is_complex,  // Selects between ac_complex<T> and T datatype
+          typename T,       // The datatype for the computation
+          typename TT = std::conditional_t<is_complex, ac_complex<T>, T>
+          // TT will be ac_complex<T> or T depending on is_complex
+          >
+void CholeskyInversionMixedImpl(
+    std::vector<TT> &a_matrix,  // Input matrices A to invert
+    std::vector<TT> &i_matrix,  // Output matrices I (inverse of A)
+    std::vector<fpga_linalg::MatrixSize> &sizes,  // Size of each matrix
+    sycl::queue &q,             // Device queue
+    int repetitions             // Number of repetitions, for performance
+                                // evaluation
+) {
+  constexpr int kNumElementsPerDDRBurst = is_complex ? 4 : 8;
+
+  using PipeType = fpga_tools::NTuple<TT, kNumElementsPerDDRBurst>;
+
+  // Pipes to communicate the A and L matrices between kernels, and the size
+  // of the matrices to the decomposition and inversion kernels
+  using AMatrixPipe = sycl::ext::intel::pipe<AMixedPipe, PipeType, 3>;
+  using LMatrixPipe =
+      sycl::ext::intel::pipe<LMixedPipe, TT, kNumElementsPerDDRBurst * 4>;
+  using IMatrixPipe =
+      sycl::ext::intel::pipe<IMixedPipe, TT, kNumElementsPerDDRBurst * 4>;
+  using DecompositionSizePipe =
+      sycl::ext::intel::pipe<DecompositionSizeMixedPipe,
+                             fpga_linalg::MatrixSize, 4>;
+  using InversionSizePipe =
+      sycl::ext::intel::pipe<InversionSizeMixedPipe, fpga_linalg::MatrixSize,
+                             4>;
+
+  int matrix_count = sizes.size();
+
+  // Total number of elements of the A matrices and of the I matrices
+  int a_elements = 0;
+  int i_elements = 0;
+  for (int m = 0; m < matrix_count; m++) {
+    auto size = sizes[m];
+    if (!fpga_linalg::MatrixSizeSupported(size, dimension, dimension, true)) {
+      throw std::invalid_argument(
+          "matrix " + std::to_string(m) + " is " + std::to_string(size.rows) +
+          "x" + std::to_string(size.columns) + ", but the Cholesky kernels " +
+          "only support square matrices of at least 4x4 and of up to " +
+          std::to_string(dimension) + "x" + std::to_string(dimension));
+    }
+    a_elements += size.rows * size.columns;
+    i_elements += size.columns * (size.columns + 1) / 2;
+  }
+
+  // Allocate FPGA DDR memory.
+#if defined (IS_BSP)
+  TT *a_device = sycl::malloc_device<TT>(a_elements, q);
+  TT *i_device = sycl::malloc_device<TT>(i_elements, q);
+  fpga_linalg::MatrixSize *sizes_device =
+      sycl::malloc_device<fpga_linalg::MatrixSize>(matrix_count, q);
+#else
+  // malloc_device are not supported when targetting an FPGA part/family
+  TT *a_device = sycl::malloc_shared<TT>(a_elements, q);
+  TT *i_device = sycl::malloc_shared<TT>(i_elements, q);
+  fpga_linalg::MatrixSize *sizes_device =
+      sycl::malloc_shared<fpga_linalg::MatrixSize>(matrix_count, q);
+#endif
+
+  if ((a_device == nullptr) || (i_device == nullptr) ||
+      (sizes_device == nullptr)) {
+    std::cerr << "Error when allocating FPGA DDR" << std::endl;
+    std::cerr << "The FPGA DDR may be full" << std::endl;
+    std::cerr << "Try reducing the matrix sizes/count" << std::endl;
+    return;
+  }
+
+  // Copy the matrices to decompose and their sizes to the FPGA DDR
+  q.memcpy(a_device, a_matrix.data(), a_elements * sizeof(TT)).wait();
+  q.memcpy(sizes_device, sizes.data(),
+           matrix_count * sizeof(fpga_linalg::MatrixSize))
+      .wait();
+
+  // Launch a kernel that will repeatedly read the matrices from the FPGA DDR
+  // and write their sizes to the DecompositionSizePipe pipe and their content
+  // to the AMatrixPipe pipe.
+  auto ddr_read_event = q.single_task<CholeskyMixedDDRToLocalMem>([=] {
+    MatrixReadFromDDRToPipeWithSize<TT, dimension, dimension,
+                                    kNumElementsPerDDRBurst, AMatrixPipe,
+                                    DecompositionSizePipe>(
+        a_device, sizes_device, matrix_count, repetitions);
+  });
+
+  // Stream the size of each matrix to the inversion kernel
+  q.single_task<InversionMixedSizes>([=] {
+#if defined (IS_BSP)
+    sycl::ext::intel::device_ptr<fpga_linalg::MatrixSize>
+        sizes_ptr_located(sizes_device);
+#else
+    fpga_linalg::MatrixSize *sizes_ptr_located(sizes_device);
+#endif
+    for (int repetition = 0; repetition < repetitions; repetition++) {
+      for (int matrix_index = 0; matrix_index < matrix_count; matrix_index++) {
+        InversionSizePipe::write(sizes_ptr_located[matrix_index]);
+      }
+    }
+  });
+
+  // Read the size of each matrix from the DecompositionSizePipe pipe and the
+  // A matrix from the AMatrixPipe pipe, and compute the Cholesky
+  // decomposition. Write the L output matrix to the LMatrixPipe pipe.
+  q.single_task<DecompositionMixedKernel>(
+      fpga_linalg::StreamingCholesky<
+          T, is_complex, dimension, raw_latency_decomposition,
+          kNumElementsPerDDRBurst, AMatrixPipe, LMatrixPipe,
+          DecompositionSizePipe>());
+
+  // Read the size of each matrix from the InversionSizePipe pipe and the L
+  // matrix from the LMatrixPipe pipe, and compute the Cholesky-based
+  // inversion. Write the I output matrix to the IMatrixPipe pipe.
+  q.single_task<InversionMixedKernel>(
+      fpga_linalg::StreamingCholeskyInversion<
+          T, is_complex, dimension, raw_latency_inversion,
+          kNumElementsPerDDRBurst, LMatrixPipe, IMatrixPipe,
+          InversionSizePipe>());
+
+  // Read the I matrix from the IMatrixPipe pipe and copy it to the FPGA DDR
+  auto ddr_write_event = q.single_task<CholeskyMixedLocalMemToDDR>([=] {
+    VectorReadFromPipeToDDRWithSize<TT, kNumElementsPerDDRBurst, IMatrixPipe>(
+        i_device, sizes_device, matrix_count, repetitions);
+  });
+
+  ddr_write_event.wait();
+
+  // Compute the total time the execution lasted
+  auto start_time = ddr_read_event.template get_profiling_info<
+      sycl::info::event_profiling::command_start>();
+  auto end_time = ddr_write_event.template get_profiling_info<
+      sycl::info::event_profiling::command_end>();
+  double diff = (end_time - start_time) / 1.0e9;
+
+  // Make sure we throw any asynchronous errors if they have occurred during
+  // the computation
+  q.throw_asynchronous();
+
+  std::cout << "   Total duration:   " << diff << " s" << std::endl;
+  std::cout << "Throughput: " << ((repetitions * matrix_count) / diff) * 1e-3
+            << "k matrices/s" << std::endl;
+
+  // Copy the I matrices result from the FPGA DDR to the host memory
+  q.memcpy(i_matrix.data(), i_device, i_elements * sizeof(TT)).wait();
+
+  // Clean allocated FPGA memory
+  free(a_device, q);
+  free(i_device, q);
+  free(sizes_device, q);
+}
+
 #endif /* __CHOLESKY_INVERSION_HPP__ */
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cmath>
 
 #include <sycl/sycl.hpp>
@@ -12,13 +13,17 @@
 // Use "#define DEBUG" to print debugging information such as matrices content
 
 /*
-  COMPLEX, MATRIX_DIMENSION, FIXED_ITERATIONS_DECOMPOSITION and
-  FIXED_ITERATIONS_INVERSION are defined by the build system. Depending on the
-  value of COMPLEX, computes the real or complex Cholesky-based inversion. The
-  Cholesky decompostion provides the L matrix from A such that: A = LL*
+  COMPLEX, MATRIX_DIMENSION, FIXED_ITERATIONS_DECOMPOSITION,
+  FIXED_ITERATIONS_INVERSION and MIXED_SIZES are defined by the build system.
+  Depending on the value of COMPLEX, computes the real or complex
+  Cholesky-based inversion. The Cholesky decompostion provides the L matrix
+  from A such that: A = LL*
   Therefore we can compute inv(A) = inv(LL*)
                                   = inv(L*) x inv(L)
                                   = inv(L)* x inv(L)
+  If MIXED_SIZES is set, the kernels invert matrices of any size up to
+  MATRIX_DIMENSION x MATRIX_DIMENSION, and CholeskyInversion streams the size
+  of each matrix along with it.
 
   Function arguments:
   - a_matrix:    The input matrix.
@@ -28,6 +33,30 @@
   - repetitions: The number of repetitions of the computation to execute.
                  (for performance evaluation)
 */
+#if MIXED_SIZES
+// Cholesky-based inversion of matrices of mixed sizes
+template <typename T, bool is_complex>
+void CholeskyInversionMixed(std::vector<T> &a_matrix,
+                            std::vector<T> &i_matrix,
+                            std::vector<fpga_linalg::MatrixSize> &sizes,
+                            sycl::queue &q, int repetitions) {
+  CholeskyInversionMixedImpl<MATRIX_DIMENSION, FIXED_ITERATIONS_DECOMPOSITION,
+                             FIXED_ITERATIONS_INVERSION, is_complex, float>(
+      a_matrix, i_matrix, sizes, q, repetitions);
+}
+
+// Cholesky-based inversion of matrices of the maximum size, on the same
+// kernels
+template <typename T, bool is_complex>
+void CholeskyInversion(std::vector<T> &a_matrix, std::vector<T> &i_matrix,
+                       sycl::queue &q, int matrix_count, int repetitions) {
+  std::vector<fpga_linalg::MatrixSize> sizes(
+      matrix_count,
+      fpga_linalg::MatrixSize{MATRIX_DIMENSION, MATRIX_DIMENSION});
+  CholeskyInversionMixed<T, is_complex>(a_matrix, i_matrix, sizes, q,
+                                        repetitions);
+}
+#else
 template <typename T, bool is_complex>
 void CholeskyInversion(std::vector<T> &a_matrix, std::vector<T> &i_matrix,
                        sycl::queue &q, int matrix_count, int repetitions) {
@@ -35,6 +64,7 @@ void CholeskyInversion(std::vector<T> &a_matrix, std::vector<T> &i_matrix,
                         FIXED_ITERATIONS_INVERSION, is_complex, float>(
       a_matrix, i_matrix, q, matrix_count, repetitions);
 }
+#endif
 
 /*
   Returns true if both the real and complex parts of the given ac_complex
@@ -58,26 +88,11 @@ float RandomValueInInterval(float min, float max) {
 }
 
 /*
-  Generate the input matrices for the cholesky inversion
+  Generate a random (Hermitian and positive-definite) matrix of size
+  columns x columns in a_matrix
 */
-template <int matrices_to_invert, int matrix_size, int columns, typename T>
-void GenerateInputData(std::vector<T> &a_matrix) {
-  constexpr bool kComplex = COMPLEX != 0;
-
-  std::cout << "Generating " << matrices_to_invert << " random ";
-  if constexpr (kComplex) {
-    std::cout << "complex ";
-  } else {
-    std::cout << "real ";
-  }
-  std::cout << "matri" << (matrices_to_invert > 1 ? "ces" : "x") << " of size "
-            << columns << "x" << columns << " " << std::endl;
-            
-  constexpr size_t kRandomSeed = 1138;
-
-  // Generate the random (Hermitian and positive-definite) input matrices
-  srand(kRandomSeed);
-
+template <typename T>
+void GenerateHermitianMatrix(int columns, T *a_matrix) {
   // Max condition number
   constexpr float kEpsilon = 0.5;
 
@@ -99,66 +114,89 @@ void GenerateInputData(std::vector<T> &a_matrix) {
     Once this matrix is generated, we need to alter it a little to make
     it Hermitian
   */
-  for (int mat_idx = 0; mat_idx < matrices_to_invert; mat_idx++) {
-    int current_matrix = mat_idx * matrix_size;
 
-    // Generate a random matrix R with diagonal elements set to 0
-    // and measure the weights of the off diagonal entries
-    std::vector<T> r, weights, a_matrix_non_hermitian;
-    r.resize(columns * columns);
-    a_matrix_non_hermitian.resize(columns * columns);
-    weights.resize(columns);
-    for (int row = 0; row < columns; row++) {
-      weights[row] = {0};
-      for (int col = 0; col < columns; col++) {
-        if (col != row) {
-          int index = (row * columns) + col;
-          float random1 = RandomValueInInterval(kRandomMin, kRandomMax);
-          T elem;
+  // Generate a random matrix R with diagonal elements set to 0
+  // and measure the weights of the off diagonal entries
+  std::vector<T> r, weights, a_matrix_non_hermitian;
+  r.resize(columns * columns);
+  a_matrix_non_hermitian.resize(columns * columns);
+  weights.resize(columns);
+  for (int row = 0; row < columns; row++) {
+    weights[row] = {0};
+    for (int col = 0; col < columns; col++) {
+      if (col != row) {
+        int index = (row * columns) + col;
+        float random1 = RandomValueInInterval(kRandomMin, kRandomMax);
+        T elem;
 #if COMPLEX == 1
-          float random1I = RandomValueInInterval(kRandomMin, kRandomMax);
-          elem = {random1, random1I};
-          r[index] = elem;
+        float random1I = RandomValueInInterval(kRandomMin, kRandomMax);
+        elem = {random1, random1I};
+        r[index] = elem;
 #else
-          elem = random1;
-          r[index] = elem;
+        elem = random1;
+        r[index] = elem;
 #endif
-          weights[row] += elem;
-        }
+        weights[row] += elem;
       }
-
-      // Construct the new diagonal element
-      weights[row] /= kEpsilon;
-      r[(row * columns) + row] = weights[row];
     }
 
-    // Perform the diagonal scaling by solving:
-    // diag(diag(A))*output = A
-    for (int row = 0; row < columns; row++) {
-      for (int col = 0; col < columns; col++) {
-        int index = row * columns + col;
-        a_matrix_non_hermitian[index] = r[index] / r[(row * columns) + row];
-      }
+    // Construct the new diagonal element
+    weights[row] /= kEpsilon;
+    r[(row * columns) + row] = weights[row];
+  }
+
+  // Perform the diagonal scaling by solving:
+  // diag(diag(A))*output = A
+  for (int row = 0; row < columns; row++) {
+    for (int col = 0; col < columns; col++) {
+      int index = row * columns + col;
+      a_matrix_non_hermitian[index] = r[index] / r[(row * columns) + row];
     }
+  }
 
-    // Make the matrix Hermitian
-    for (int row = 0; row < columns; row++) {
-      for (int col = 0; col < columns; col++) {
-        int index = row * columns + col;
+  // Make the matrix Hermitian
+  for (int row = 0; row < columns; row++) {
+    for (int col = 0; col < columns; col++) {
+      int index = row * columns + col;
 
-        a_matrix[current_matrix + index] =
-            (a_matrix_non_hermitian[index] +
-             a_matrix_non_hermitian[(col * columns) + row]) /
-            2;
+      a_matrix[index] = (a_matrix_non_hermitian[index] +
+                         a_matrix_non_hermitian[(col * columns) + row]) /
+                        2;
 
 #if COMPLEX == 1
-        if (row > col) {
-          a_matrix[current_matrix + index] =
-              a_matrix[current_matrix + index].conj();
-        }
-#endif
+      if (row > col) {
+        a_matrix[index] = a_matrix[index].conj();
       }
+#endif
     }
+  }
+}
+
+/*
+  Generate the input matrices for the cholesky inversion
+*/
+template <int matrices_to_invert, int matrix_size, int columns, typename T>
+void GenerateInputData(std::vector<T> &a_matrix) {
+  constexpr bool kComplex = COMPLEX != 0;
+
+  std::cout << "Generating " << matrices_to_invert << " random ";
+  if constexpr (kComplex) {
+    std::cout << "complex ";
+  } else {
+    std::cout << "real ";
+  }
+  std::cout << "matri" << (matrices_to_invert > 1 ? "ces" : "x") << " of size "
+            << columns << "x" << columns << " " << std::endl;
+            
+  constexpr size_t kRandomSeed = 1138;
+
+  // Generate the random (Hermitian and positive-definite) input matrices
+  srand(kRandomSeed);
+
+  for (int mat_idx = 0; mat_idx < matrices_to_invert; mat_idx++) {
+    int current_matrix = mat_idx * matrix_size;
+
+    GenerateHermitianMatrix(columns, a_matrix.data() + current_matrix);
 
 #ifdef DEBUG
     std::cout << "A MATRIX " << mat_idx << std::endl;
@@ -326,6 +364,118 @@ int CheckResults(std::vector<T> &a_matrix, std::vector<T> &i_matrix) {
   return 0;
 }
 
+#if MIXED_SIZES
+/*
+  returns the magnitude of the given value
+*/
+float Magnitude(ac_complex<float> val) {
+  return std::sqrt(val.r() * val.r() + val.i() * val.i());
+}
+float Magnitude(float val) { return std::abs(val); }
+
+/*
+  returns the conjugate of the given value
+*/
+ac_complex<float> Conjugate(ac_complex<float> val) { return val.conj(); }
+float Conjugate(float val) { return val; }
+
+/*
+  Inverts a batch of random matrices of mixed sizes, up to
+  MATRIX_DIMENSION x MATRIX_DIMENSION, in a single run of the kernels, and
+  checks that I x A = Id and A x I = Id.
+  Returns true if all the inversions are correct.
+*/
+template <typename T>
+bool TestMixedSizes(sycl::queue &q) {
+  constexpr bool kComplex = COMPLEX != 0;
+  constexpr int kDimension = MATRIX_DIMENSION;
+  constexpr float kErrorThreshold = 1e-4;
+
+  // Matrices from the maximum size down to 4x4
+  const int kShapes[] = {kDimension,     kDimension / 2, 4,
+                         kDimension - 1, kDimension / 4, kDimension,
+                         kDimension / 2 + 1};
+  std::vector<fpga_linalg::MatrixSize> sizes;
+  for (int size : kShapes) {
+    short matrix_size = std::max(size, 4);
+    sizes.push_back({matrix_size, matrix_size});
+  }
+
+  int a_elements = 0;
+  int i_elements = 0;
+  for (auto size : sizes) {
+    a_elements += size.rows * size.columns;
+    i_elements += size.columns * (size.columns + 1) / 2;
+  }
+
+  std::vector<T> a_matrix(a_elements);
+  std::vector<T> i_matrix(i_elements);
+  int a_offset = 0;
+  for (auto size : sizes) {
+    GenerateHermitianMatrix(size.rows, a_matrix.data() + a_offset);
+    a_offset += size.rows * size.columns;
+  }
+
+  std::cout << std::endl
+            << "Computing the Cholesky-based inversion of a batch of "
+            << sizes.size() << " matrices of mixed sizes:";
+  for (auto size : sizes) {
+    std::cout << " " << size.rows << "x" << size.columns;
+  }
+  std::cout << std::endl;
+
+  CholeskyInversionMixed<T, kComplex>(a_matrix, i_matrix, sizes, q, 1);
+
+  std::cout << "Verifying results..." << std::endl;
+  a_offset = 0;
+  int i_offset = 0;
+  for (auto size : sizes) {
+    int n = size.rows;
+
+    // Read the lower-left elements of the I matrix, column by column
+    std::vector<T> i_matrix_op(n * n);
+    int i_idx = i_offset;
+    for (int j = 0; j < n; j++) {
+      for (int i = j; i < n; i++) {
+        i_matrix_op[i * n + j] = i_matrix[i_idx++];
+        i_matrix_op[j * n + i] = Conjugate(i_matrix_op[i * n + j]);
+      }
+    }
+    auto inv = [&](int i, int j) { return i_matrix_op[i * n + j]; };
+    auto a = [&](int i, int j) { return a_matrix[a_offset + i * n + j]; };
+
+    float error = 0;
+    for (int i = 0; i < n; i++) {
+      for (int j = 0; j < n; j++) {
+        T i_times_a_ij{0};
+        T a_times_i_ij{0};
+        for (int k = 0; k < n; k++) {
+          i_times_a_ij += inv(i, k) * Conjugate(a(k, j));
+          a_times_i_ij += a(i, k) * Conjugate(inv(k, j));
+        }
+        T id_ij = i == j ? T{1} : T{0};
+        error = std::max({error, Magnitude(i_times_a_ij - id_ij),
+                          Magnitude(a_times_i_ij - id_ij)});
+        if (!IsFinite(i_times_a_ij) || !IsFinite(a_times_i_ij)) {
+          error = INFINITY;
+        }
+      }
+    }
+
+    if (!(error < kErrorThreshold)) {
+      std::cerr << "Error in the inversion of the " << n << "x" << n
+                << " matrix: max |I*A - Id|, |A*I - Id| = " << error
+                << std::endl;
+      return false;
+    }
+
+    a_offset += n * n;
+    i_offset += n * (n + 1) / 2;
+  }
+  return true;
+}
+#endif
+
 int main(int argc, char *argv[]) {
   constexpr size_t kRows = MATRIX_DIMENSION;
   constexpr size_t kColumns = MATRIX_DIMENSION;
@@ -399,6 +549,13 @@ int main(int argc, char *argv[]) {
     CholeskyInversion<T, kComplex>(a_matrix, i_matrix, q, kMatricesToInvert,
                                    repetitions);
 
+#if MIXED_SIZES
+    if (!TestMixedSizes<T>(q)) {
+      std::cout << std::endl << "FAILED" << std::endl;
+      return 1;
+    }
+#endif
+
     // Check the returned matrices for correctness
     return CheckResults<kMatricesToInvert, kAMatrixSize, kIMatrixSize, kRows,
                         kColumns>(a_matrix, i_matrix);
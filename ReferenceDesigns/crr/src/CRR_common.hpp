@@ -46,6 +46,10 @@ constexpr double kEpsilon  = 0.0001;
 // nsteps by 2 to ensure all the required derivative prices are calculated.
 constexpr size_t kOpt0 = 2;
 
+// Default number of options in each batch streamed through the kernel. The
+// host prepares one batch while the kernel prices the other.
+constexpr int kDefaultBatchSize = 4;
+
 
 // Solver configuration settings that are dependent on selected
 // board. Most notable settings are:
@@ -130,11 +134,6 @@ typedef struct {
   double pad;
 } ArrayEle;
 
-typedef struct {
-  ArrayEle array_eles[kMaxNSteps3][3]; /* Second dimension size set to 3 to have a
-                                          separate ArrayEle for each option price */
-} CRRArrayEles;
-
 typedef struct {
   ArrayEle array_eles[kMaxNSteps3];
 } CRRPerStepMeta;
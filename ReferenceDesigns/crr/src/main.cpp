@@ -92,6 +92,9 @@
 
 #include <sycl/sycl.hpp>
 #include <sycl/ext/intel/fpga_extensions.hpp>
+#include <algorithm>
+#include <cctype>
+#include <chrono>
 #include <cmath>
 #include <cstddef>
 #include <cstdlib>
@@ -101,6 +104,8 @@
 #include <regex>
 #include <sstream>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include "CRR_common.hpp"
 
@@ -120,260 +125,276 @@ using namespace sycl;
 #endif
 
 class CRRSolver;
-double CrrSolver(const int n_items, vector<CRRMeta> &in_params,
-                  vector<CRRResParams> &res_params,
-                  vector<CRRPerStepMeta> &in_params2, queue &q) {
-  auto start = std::chrono::steady_clock::now();
+// Launches the kernel on one batch of 'n_crr' CRR problems, which must be a
+// multiple of OUTER_UNROLL. The metadata is read from, and the results are
+// written to, USM host allocations. 'steps' is the largest number of time
+// steps of the CRRs of the batch.
+event CrrSolver(queue &q, CRRMeta *in_params_ptr,
+                CRRPerStepMeta *in_params2_ptr, CRRResParams *res_params_ptr,
+                const int n_crr, const int steps) {
+  return q.submit([&](handler &h) {
+    h.single_task<CRRSolver>([=]() [[intel::kernel_args_restrict]] {
+      // The batches of CRR problems stream through host memory
+      sycl::ext::intel::host_ptr<CRRMeta> accessor_v(in_params_ptr);
+      sycl::ext::intel::host_ptr<CRRPerStepMeta> accessor_v2(in_params2_ptr);
+      sycl::ext::intel::host_ptr<CRRResParams> accessor_r(res_params_ptr);
+
+      // Kernel requires n_crr to be a multiple of OUTER_UNROLL.
+      // This is taken care of by the host.
+      const int n_crr_div = n_crr / OUTER_UNROLL;
+
+      // Outerloop counter. Use while-loop for better timing-closure
+      // characteristics because it tells the compiler the loop body will
+      // never be skipped.
+      int oc = 0;
+      do {
+        // Metadata of CRR problems
+        [[intel::fpga_register]] double u[OUTER_UNROLL];
+        [[intel::fpga_register]] double c1[OUTER_UNROLL];
+        [[intel::fpga_register]] double c2[OUTER_UNROLL];
+        [[intel::fpga_register]] double param_1[OUTER_UNROLL];
+        [[intel::fpga_register]] double param_2[OUTER_UNROLL];
+        [[intel::fpga_register]] short n_steps[OUTER_UNROLL];
+
+        // Current values in binomial tree.  We only need to keep track of
+        // one level worth of data, not the entire tree.
+        [[intel::fpga_memory, intel::singlepump,
+          intel::bankwidth(sizeof(double)),
+          intel::numbanks(INNER_UNROLL * OUTER_UNROLL_POW2),
+          intel::private_copies(
+              8)]] double optval[kMaxNSteps3][OUTER_UNROLL_POW2];
+
+        // Initial values in binomial tree, which correspond to the last
+        // level of the binomial tree.
+        [[intel::fpga_memory, intel::singlepump,
+          intel::bankwidth(sizeof(double)),
+          intel::numbanks(INNER_UNROLL * OUTER_UNROLL_POW2),
+          intel::private_copies(
+              8)]] double init_optval[kMaxNSteps3][OUTER_UNROLL_POW2];
+
+        // u2_array pre-calculates the power function of u2.
+        [[intel::fpga_memory, intel::singlepump,
+          intel::bankwidth(sizeof(double)),
+          intel::numbanks(INNER_UNROLL * OUTER_UNROLL_POW2),
+          intel::private_copies(
+              8)]] double u2_array[kMaxNSteps3][OUTER_UNROLL_POW2];
+
+        // p1powu_array precalculates p1 multipy the power of u.
+        [[intel::fpga_memory, intel::singlepump,
+          intel::bankwidth(sizeof(double)),
+          intel::numbanks(INNER_UNROLL * OUTER_UNROLL_POW2),
+          intel::private_copies(
+              8)]] double p1powu_array[kMaxNSteps3][OUTER_UNROLL_POW2];
+
+        // n0_optval stores the binomial tree value corresponding to node 0
+        // of a level. This is the same as what's stored in
+        // optval/init_optval, but replicating this data allows us to have
+        // only one read port for optval and init_optval, thereby removing
+        // the need of double-pumping or replication. n0_optval_2 is a copy
+        // of n0_optval that stores the node 0 value for a specific layer of
+        // the tree. pgreek is the array saving values for post-calculating
+        // Greeks.
+        [[intel::fpga_register]] double n0_optval[OUTER_UNROLL];
+        [[intel::fpga_register]] double n0_optval_2[OUTER_UNROLL];
+        [[intel::fpga_register]] double pgreek[4][OUTER_UNROLL];
+
+        // L1 + L2:
+        // Populate init_optval -- calculate the last level of the binomial
+        // tree.
+        for (short ic = 0; ic < OUTER_UNROLL; ++ic) {
+          // Transfer data from DRAM to local memory or registers
+          const int c = oc * OUTER_UNROLL + ic;
+          const CRRMeta param = accessor_v[c];
+
+          u[ic] = param.u;
+          c1[ic] = param.c1;
+          c2[ic] = param.c2;
+          param_1[ic] = param.param_1;
+          param_2[ic] = param.param_2;
+          n_steps[ic] = param.n_steps;
+
+          for (short t = steps; t >= 0; --t) {
+            const ArrayEle param_array = accessor_v2[c].array_eles[t];
+
+            const double init_val = param_array.init_optval;
+
+            init_optval[t][ic] = init_val;
+
+            // n0_optval intends to store the node value at t == 0.
+            // Instead of qualifying this statement by an "if (t == 0)",
+            // which couples the loop counter to the timing path of the
+            // assignment, we reverse the loop direction so the last value
+            // stored corresponds to t == 0.
+            n0_optval[ic] = init_val;
+
+            // Transfer data from DRAM to local memory or registers
+            u2_array[t][ic] = param_array.u2;
+            p1powu_array[t][ic] = param_array.p1powu;
+          }
+        }
 
-  int steps = std::max_element(in_params.begin(), in_params.end(),
-                               [](const CRRMeta &a, const CRRMeta &b) {
-                                 return a.n_steps < b.n_steps;
-                               })->n_steps;
-
-  const int n_crr =
-      (((n_items + (OUTER_UNROLL - 1)) / OUTER_UNROLL) * OUTER_UNROLL) * 3;
-
-  {
-    buffer<CRRMeta, 1> i_params(in_params.size());
-    buffer<CRRPerStepMeta, 1> a_params(in_params2.size());
-    buffer<CRRResParams, 1> r_params(res_params.size());
-    r_params.set_final_data(res_params.data());
-
-    event e;
-    {
-      // copy the input buffers
-      q.submit([&](handler& h) {
-        auto accessor_v =
-          i_params.template get_access<access::mode::discard_write>(h);
-        h.copy(in_params.data(), accessor_v);
-      });
-
-      q.submit([&](handler& h) {
-        auto accessor_v2 =
-          a_params.template get_access<access::mode::discard_write>(h);
-        h.copy(in_params2.data(), accessor_v2);
-      });
-
-      // start the main kernel
-      e = q.submit([&](handler &h) {
-        auto accessor_v =
-            i_params.template get_access<access::mode::read_write>(h);
-
-        auto accessor_v2 =
-            a_params.template get_access<access::mode::read_write>(h);
-
-        auto accessor_r =
-            r_params.template get_access<access::mode::discard_write>(h);
-
-        h.single_task<CRRSolver>([=]() [[intel::kernel_args_restrict]] {
-          // Kernel requires n_crr to be a multiple of OUTER_UNROLL.
-          // This is taken care of by the host.
-          const int n_crr_div = n_crr / OUTER_UNROLL;
-
-          // Outerloop counter. Use while-loop for better timing-closure
-          // characteristics because it tells the compiler the loop body will
-          // never be skipped.
-          int oc = 0;
-          do {
-            // Metadata of CRR problems
-            [[intel::fpga_register]] double u[OUTER_UNROLL];
-            [[intel::fpga_register]] double c1[OUTER_UNROLL];
-            [[intel::fpga_register]] double c2[OUTER_UNROLL];
-            [[intel::fpga_register]] double param_1[OUTER_UNROLL];
-            [[intel::fpga_register]] double param_2[OUTER_UNROLL];
-            [[intel::fpga_register]] short n_steps[OUTER_UNROLL];
-
-            // Current values in binomial tree.  We only need to keep track of
-            // one level worth of data, not the entire tree.
-            [[intel::fpga_memory, intel::singlepump,
-              intel::bankwidth(sizeof(double)),
-              intel::numbanks(INNER_UNROLL * OUTER_UNROLL_POW2),
-              intel::private_copies(
-                  8)]] double optval[kMaxNSteps3][OUTER_UNROLL_POW2];
-
-            // Initial values in binomial tree, which correspond to the last
-            // level of the binomial tree.
-            [[intel::fpga_memory, intel::singlepump,
-              intel::bankwidth(sizeof(double)),
-              intel::numbanks(INNER_UNROLL * OUTER_UNROLL_POW2),
-              intel::private_copies(
-                  8)]] double init_optval[kMaxNSteps3][OUTER_UNROLL_POW2];
-
-            // u2_array pre-calculates the power function of u2.
-            [[intel::fpga_memory, intel::singlepump,
-              intel::bankwidth(sizeof(double)),
-              intel::numbanks(INNER_UNROLL * OUTER_UNROLL_POW2),
-              intel::private_copies(
-                  8)]] double u2_array[kMaxNSteps3][OUTER_UNROLL_POW2];
-
-            // p1powu_array precalculates p1 multipy the power of u.
-            [[intel::fpga_memory, intel::singlepump,
-              intel::bankwidth(sizeof(double)),
-              intel::numbanks(INNER_UNROLL * OUTER_UNROLL_POW2),
-              intel::private_copies(
-                  8)]] double p1powu_array[kMaxNSteps3][OUTER_UNROLL_POW2];
-
-            // n0_optval stores the binomial tree value corresponding to node 0
-            // of a level. This is the same as what's stored in
-            // optval/init_optval, but replicating this data allows us to have
-            // only one read port for optval and init_optval, thereby removing
-            // the need of double-pumping or replication. n0_optval_2 is a copy
-            // of n0_optval that stores the node 0 value for a specific layer of
-            // the tree. pgreek is the array saving values for post-calculating
-            // Greeks.
-            [[intel::fpga_register]] double n0_optval[OUTER_UNROLL];
-            [[intel::fpga_register]] double n0_optval_2[OUTER_UNROLL];
-            [[intel::fpga_register]] double pgreek[4][OUTER_UNROLL];
-
-            // L1 + L2:
-            // Populate init_optval -- calculate the last level of the binomial
-            // tree.
-            for (short ic = 0; ic < OUTER_UNROLL; ++ic) {
-              // Transfer data from DRAM to local memory or registers
-              const int c = oc * OUTER_UNROLL + ic;
-              const CRRMeta param = accessor_v[c];
-
-              u[ic] = param.u;
-              c1[ic] = param.c1;
-              c2[ic] = param.c2;
-              param_1[ic] = param.param_1;
-              param_2[ic] = param.param_2;
-              n_steps[ic] = param.n_steps;
-
-              for (short t = steps; t >= 0; --t) {
-                const ArrayEle param_array = accessor_v2[c].array_eles[t];
-
-                const double init_val = param_array.init_optval;
-
-                init_optval[t][ic] = init_val;
-
-                // n0_optval intends to store the node value at t == 0.
-                // Instead of qualifying this statement by an "if (t == 0)",
-                // which couples the loop counter to the timing path of the
-                // assignment, we reverse the loop direction so the last value
-                // stored corresponds to t == 0.
-                n0_optval[ic] = init_val;
-
-                // Transfer data from DRAM to local memory or registers
-                u2_array[t][ic] = param_array.u2;
-                p1powu_array[t][ic] = param_array.p1powu;
-              }
-            }
+        // L3:
+        // Update optval[] -- calculate each level of the binomial tree.
+        // reg[] helps to achieve updating INNER_UNROLL elements in optval[]
+        // simultaneously.
+        [[intel::disable_loop_pipelining]] // NO-FORMAT: Attribute
+        for (short t = 0; t <= steps - 1; ++t) {
+          [[intel::fpga_register]] double reg[INNER_UNROLL + 1][OUTER_UNROLL];
+
+          double val_1, val_2;
 
-            // L3:
-            // Update optval[] -- calculate each level of the binomial tree.
-            // reg[] helps to achieve updating INNER_UNROLL elements in optval[]
-            // simultaneously.
-            [[intel::disable_loop_pipelining]] // NO-FORMAT: Attribute
-            for (short t = 0; t <= steps - 1; ++t) {
-              [[intel::fpga_register]] double reg[INNER_UNROLL + 1][OUTER_UNROLL];
+          #pragma unroll
+          for (short ic = 0; ic < OUTER_UNROLL; ++ic) {
+            reg[0][ic] = n0_optval[ic];
+          }
 
-              double val_1, val_2;
+          // L4:
+          // Calculate all the elements in optval[] -- all the tree nodes
+          // for one level of the tree
+          [[intel::initiation_interval(1)]] // NO-FORMAT: Attribute
+          for (int n = 0; n <= steps - 1 - t; n += INNER_UNROLL) {
+
+            #pragma unroll
+            for (short ic = 0; ic < OUTER_UNROLL; ++ic) {
 
               #pragma unroll
-              for (short ic = 0; ic < OUTER_UNROLL; ++ic) {
-                reg[0][ic] = n0_optval[ic];
+              for (short ri = 1; ri <= INNER_UNROLL; ++ri) {
+                reg[ri][ic] =
+                    (t == 0) ? init_optval[n + ri][ic] : optval[n + ri][ic];
               }
 
-              // L4:
-              // Calculate all the elements in optval[] -- all the tree nodes
-              // for one level of the tree
-              [[intel::initiation_interval(1)]] // NO-FORMAT: Attribute
-              for (int n = 0; n <= steps - 1 - t; n += INNER_UNROLL) {
-
-                #pragma unroll
-                for (short ic = 0; ic < OUTER_UNROLL; ++ic) {
-
-                  #pragma unroll
-                  for (short ri = 1; ri <= INNER_UNROLL; ++ri) {
-                    reg[ri][ic] =
-                        (t == 0) ? init_optval[n + ri][ic] : optval[n + ri][ic];
-                  }
-
-                  #pragma unroll
-                  for (short ri = 0; ri < INNER_UNROLL; ++ri) {
-                    const double val = sycl::fmax(
-                        c1[ic] * reg[ri][ic] + c2[ic] * reg[ri + 1][ic],
-                        p1powu_array[t][ic] * u2_array[n + ri][ic] -
-                            param_2[ic]);
-
-                    optval[n + ri][ic] = val;
-                    if (n + ri == 0) {
-                      n0_optval[ic] = val;
-                    }
-                    if (n + ri == 1) {
-                      val_1 = val;
-                    }
-                    if (n + ri == 2) {
-                      val_2 = val;
-                    }
-                  }
-
-                  reg[0][ic] = reg[INNER_UNROLL][ic];
-
-                  if (t == steps - 5) {
-                    pgreek[3][ic] = val_2;
-                  }
-                  if (t == steps - 3) {
-                    pgreek[0][ic] = n0_optval[ic];
-                    pgreek[1][ic] = val_1;
-                    pgreek[2][ic] = val_2;
-                    n0_optval_2[ic] = n0_optval[ic];
-                  }
+              #pragma unroll
+              for (short ri = 0; ri < INNER_UNROLL; ++ri) {
+                const double val = sycl::fmax(
+                    c1[ic] * reg[ri][ic] + c2[ic] * reg[ri + 1][ic],
+                    p1powu_array[t][ic] * u2_array[n + ri][ic] -
+                        param_2[ic]);
+
+                optval[n + ri][ic] = val;
+                if (n + ri == 0) {
+                  n0_optval[ic] = val;
+                }
+                if (n + ri == 1) {
+                  val_1 = val;
+                }
+                if (n + ri == 2) {
+                  val_2 = val;
                 }
               }
-            }
 
-            // L5: transfer crr_res_params to DRAM
-            #pragma unroll
-            for (short ic = 0; ic < OUTER_UNROLL; ++ic) {
-              const int c = oc * OUTER_UNROLL + ic;
-              if (n_steps[ic] < steps) {
-                accessor_r[c].optval0 = n0_optval_2[ic];
-              } else {
-                accessor_r[c].optval0 = n0_optval[ic];
+              reg[0][ic] = reg[INNER_UNROLL][ic];
+
+              if (t == steps - 5) {
+                pgreek[3][ic] = val_2;
+              }
+              if (t == steps - 3) {
+                pgreek[0][ic] = n0_optval[ic];
+                pgreek[1][ic] = val_1;
+                pgreek[2][ic] = val_2;
+                n0_optval_2[ic] = n0_optval[ic];
               }
-              accessor_r[c].pgreek[0] = pgreek[0][ic];
-              accessor_r[c].pgreek[1] = pgreek[1][ic];
-              accessor_r[c].pgreek[2] = pgreek[2][ic];
-              accessor_r[c].pgreek[3] = pgreek[3][ic];
             }
-            // Increment counters
-            oc += 1;
-          } while (oc < n_crr_div);
-        });
-      });
-    }
-  }
+          }
+        }
 
-  auto end = std::chrono::steady_clock::now();
-  double diff = std::chrono::duration_cast<std::chrono::duration<double>>(end - start).count();
-  return diff;
+        // L5: transfer crr_res_params to DRAM
+        #pragma unroll
+        for (short ic = 0; ic < OUTER_UNROLL; ++ic) {
+          const int c = oc * OUTER_UNROLL + ic;
+          if (n_steps[ic] < steps) {
+            accessor_r[c].optval0 = n0_optval_2[ic];
+          } else {
+            accessor_r[c].optval0 = n0_optval[ic];
+          }
+          accessor_r[c].pgreek[0] = pgreek[0][ic];
+          accessor_r[c].pgreek[1] = pgreek[1][ic];
+          accessor_r[c].pgreek[2] = pgreek[2][ic];
+          accessor_r[c].pgreek[3] = pgreek[3][ic];
+        }
+        // Increment counters
+        oc += 1;
+      } while (oc < n_crr_div);
+    });
+  });
 }
 
-void ReadInputFromFile(ifstream &input_file, vector<InputData> &inp) {
-  string line_of_args;
-  while (getline(input_file, line_of_args)) {
+// Reads the options of the input file. The whole file is read into memory at
+// once and the fields are parsed in place, instead of copying every line into
+// a string stream, which is what limits the ingestion rate of large files.
+bool ReadInputFromFile(ifstream &input_file, vector<InputData> &inp) {
+  constexpr int kFieldsPerLine = 8;
+
+  input_file.seekg(0, ios::end);
+  const size_t size = input_file.tellg();
+  input_file.seekg(0, ios::beg);
+
+  // the string adds a null terminator after the contents of the file, which
+  // stops strtod on the last field
+  string contents(size, '\0');
+  input_file.read(&contents[0], size);
+  if (static_cast<size_t>(input_file.gcount()) != size) {
+    std::cerr << "Failed to read the input file\n";
+    return false;
+  }
+
+  const char *ptr = contents.c_str();
+  const char *end = ptr + size;
+  int line = 1;
+  while (ptr < end) {
+    // skip blank lines
+    if (isspace(*ptr)) {
+      line += (*ptr == '\n');
+      ++ptr;
+      continue;
+    }
+
+    double fields[kFieldsPerLine];
+    for (int f = 0; f < kFieldsPerLine; ++f) {
+      // strtod skips leading whitespace, which would run into the next line
+      // if this field is missing
+      char *next = nullptr;
+      if (*ptr != '\n' && *ptr != '\r') {
+        fields[f] = strtod(ptr, &next);
+      }
+      const bool last = (f == kFieldsPerLine - 1);
+      if (next == nullptr || next == ptr || (!last && *next != ',')) {
+        std::cerr << "Malformed input on line " << line << ": expected "
+                  << kFieldsPerLine << " comma-separated values\n";
+        return false;
+      }
+      ptr = last ? next : next + 1;
+    }
+
+    // only whitespace may follow the last field of the line
+    while (ptr < end && *ptr != '\n' && isspace(*ptr)) {
+      ++ptr;
+    }
+    if (ptr < end && *ptr != '\n') {
+      std::cerr << "Malformed input on line " << line << ": expected "
+                << kFieldsPerLine << " comma-separated values\n";
+      return false;
+    }
+
     InputData temp;
-    istringstream line_of_args_ss(line_of_args);
-    line_of_args_ss >> temp.n_steps;
-    line_of_args_ss.ignore(1, ',');
-    line_of_args_ss >> temp.cp;
-    line_of_args_ss.ignore(1, ',');
-    line_of_args_ss >> temp.spot;
-    line_of_args_ss.ignore(1, ',');
-    line_of_args_ss >> temp.fwd;
-    line_of_args_ss.ignore(1, ',');
-    line_of_args_ss >> temp.strike;
-    line_of_args_ss.ignore(1, ',');
-    line_of_args_ss >> temp.vol;
-    line_of_args_ss.ignore(1, ',');
-    line_of_args_ss >> temp.df;
-    line_of_args_ss.ignore(1, ',');
-    line_of_args_ss >> temp.t;
+    temp.n_steps = fields[0];
+    temp.cp = static_cast<int>(fields[1]);
+    temp.spot = fields[2];
+    temp.fwd = fields[3];
+    temp.strike = fields[4];
+    temp.vol = fields[5];
+    temp.df = fields[6];
+    temp.t = fields[7];
+
+    if (temp.n_steps < 1 || temp.n_steps > kMaxNSteps) {
+      std::cerr << "Invalid n_steps on line " << line
+                << ": the maximum is " << kMaxNSteps << "\n";
+      return false;
+    }
 
     inp.push_back(temp);
   }
+
+  return true;
 }
 
 static string ToStringWithPrecision(const double value, const int p = 6) {
@@ -468,72 +489,50 @@ CRRInParams PrepareData(const InputData &inp) {
   return in_params;
 }
 
-CRRArrayEles PrepareArrData(const CRRInParams &in) {
-  CRRArrayEles arr;
-
-  // Write in reverse t-direction to match kernel access pattern
-  for (int i = 0; i <= in.n_steps + kOpt0; ++i) {
-    for (int inner_func_index = 0; inner_func_index < 3; ++inner_func_index) {
-      arr.array_eles[i][inner_func_index].u2 = sycl::pow(in.u2[inner_func_index], (double) i);
-      arr.array_eles[i][inner_func_index].p1powu =
-          in.param_1[inner_func_index] * sycl::pow(in.u[inner_func_index], (double) (i + 1));
-      arr.array_eles[i][inner_func_index].init_optval =
-          sycl::fmax(in.param_1[inner_func_index] * sycl::pow(in.u2[inner_func_index], (double) i) -
-                   in.param_2, 0.0);
-    }
-  }
-
-  return arr;
-}
-
 // Metadata, used in the Kernel, is generated from the input data
 // Each CRR problem is split into 3 sub-problems to calculate
-// each required option price separately
-void PrepareKernelData(vector<CRRInParams> &in_params,
-                       vector<CRRArrayEles> &array_params,
-                       vector<CRRMeta> &in_buff_params,
-                       vector<CRRPerStepMeta> &in_buff2_params,
-                       const int n_crrs) {
-
-  constexpr short offset = 0;
-
-  for (int wi_idx = offset, dst = offset * 3; wi_idx < n_crrs; ++wi_idx) {
-    CRRInParams &src_crr_params = in_params[wi_idx];
-
-    CRRArrayEles &src_crr_eles = array_params[wi_idx];
-
-    for (int inner_func_index = 0; inner_func_index < 3;
-         ++inner_func_index, ++dst) {
-      CRRMeta &dst_crr_meta = in_buff_params[dst];
-      CRRPerStepMeta &dst_crr_per_step_meta = in_buff2_params[dst];
-
-      dst_crr_meta.u = src_crr_params.u[inner_func_index];
-      dst_crr_meta.c1 = src_crr_params.c1[inner_func_index];
-      dst_crr_meta.c2 = src_crr_params.c2[inner_func_index];
-
-      dst_crr_meta.param_1 = src_crr_params.param_1[inner_func_index];
-      dst_crr_meta.param_2 = src_crr_params.param_2;
+// each required option price separately. The per-step arrays of the three
+// sub-problems are written straight to the kernel's input buffers, and are
+// padded with zeros up to 'steps', the number of time steps of the batch.
+void PrepareKernelData(const CRRInParams &in_params, CRRMeta *in_buff_params,
+                       CRRPerStepMeta *in_buff2_params, const int steps) {
+  const int last_step = in_params.n_steps + kOpt0;
+
+  for (int inner_func_index = 0; inner_func_index < 3; ++inner_func_index) {
+    CRRMeta &dst_crr_meta = in_buff_params[inner_func_index];
+    CRRPerStepMeta &dst_crr_per_step_meta = in_buff2_params[inner_func_index];
+
+    dst_crr_meta.u = in_params.u[inner_func_index];
+    dst_crr_meta.c1 = in_params.c1[inner_func_index];
+    dst_crr_meta.c2 = in_params.c2[inner_func_index];
+
+    dst_crr_meta.param_1 = in_params.param_1[inner_func_index];
+    dst_crr_meta.param_2 = in_params.param_2;
+
+    if (inner_func_index == 0) {
+      dst_crr_meta.n_steps = in_params.n_steps + kOpt0;
+    } else {
+      dst_crr_meta.n_steps = in_params.n_steps;
+    }
 
-      if (inner_func_index == 0) {
-        dst_crr_meta.n_steps = src_crr_params.n_steps + kOpt0;
-      } else {
-        dst_crr_meta.n_steps = src_crr_params.n_steps;
-      }
-      for (int i = 0; i <= kMaxNSteps2; ++i) {
-        dst_crr_per_step_meta.array_eles[i].u2 =
-            src_crr_eles.array_eles[i][inner_func_index].u2;
-        dst_crr_per_step_meta.array_eles[i].p1powu =
-            src_crr_eles.array_eles[i][inner_func_index].p1powu;
-        dst_crr_per_step_meta.array_eles[i].init_optval =
-            src_crr_eles.array_eles[i][inner_func_index].init_optval;
-      }
+    for (int i = 0; i <= last_step; ++i) {
+      ArrayEle &ele = dst_crr_per_step_meta.array_eles[i];
+      ele.u2 = sycl::pow(in_params.u2[inner_func_index], (double) i);
+      ele.p1powu = in_params.param_1[inner_func_index] *
+                   sycl::pow(in_params.u[inner_func_index], (double) (i + 1));
+      ele.init_optval =
+          sycl::fmax(in_params.param_1[inner_func_index] * ele.u2 -
+                         in_params.param_2, 0.0);
+    }
+    for (int i = last_step + 1; i <= steps; ++i) {
+      dst_crr_per_step_meta.array_eles[i] = ArrayEle{};
     }
   }
 }
 
 // Takes in the result from the kernel and stores the 3 option prices
 // belonging to the same CRR problem in one InterRes element
-void ProcessKernelResult(const vector<CRRResParams> &res_params,
+void ProcessKernelResult(const CRRResParams *res_params,
                          vector<InterRes> &postp_buff, const int n_crrs) {
   constexpr int offset = 0;
 
@@ -718,17 +717,178 @@ void TestCorrectness(int k, int n_crrs, bool &pass, const InputData &inp,
   }
 }
 
-// Print out the achieved CRR throughput
-void TestThroughput(const double &time, const int &n_crrs) {
+// The number of CRR problems the kernel processes for a batch of 'n_items'
+// options: three per option, padded to a multiple of OUTER_UNROLL
+int KernelCRRCount(const int n_items) {
+  return (((n_items + (OUTER_UNROLL - 1)) / OUTER_UNROLL) * OUTER_UNROLL) * 3;
+}
+
+// One batch of options in flight in the pricing service. The kernel reads the
+// metadata of the batch from, and writes its results to, USM host
+// allocations, so the host can prepare the next batch in place while the
+// kernel works on this one.
+struct CRRBatch {
+  CRRMeta *in_params = nullptr;
+  CRRPerStepMeta *in_params2 = nullptr;
+  CRRResParams *res_params = nullptr;
+  vector<CRRInParams> crr_params;  // the CPU parameters of each option
+  int first = 0;                   // index of the first option in the stream
+  int n_items = 0;                 // number of options in the batch
+  int steps = 0;                   // time steps the kernel walks for the batch
+  event e;
+  std::chrono::steady_clock::time_point start;
+};
+
+// Allocates the host memory of a batch of up to 'batch_size' options
+bool AllocateBatch(queue &q, CRRBatch &batch, const int batch_size) {
+  const int n_crr = KernelCRRCount(batch_size);
+  batch.in_params = malloc_host<CRRMeta>(n_crr, q);
+  batch.in_params2 = malloc_host<CRRPerStepMeta>(n_crr, q);
+  batch.res_params = malloc_host<CRRResParams>(n_crr, q);
+  batch.crr_params.resize(batch_size);
+  return batch.in_params != nullptr && batch.in_params2 != nullptr &&
+         batch.res_params != nullptr;
+}
+
+void FreeBatch(queue &q, CRRBatch &batch) {
+  sycl::free(batch.in_params, q);
+  sycl::free(batch.in_params2, q);
+  sycl::free(batch.res_params, q);
+}
+
+// Prepares the kernel inputs of the 'n_items' options of the stream starting
+// at option 'first', using 'threads' host threads. The stream replays the
+// input options 'inp' in order.
+void PrepareBatch(CRRBatch &batch, const vector<InputData> &inp,
+                  const int first, const int n_items, const int threads) {
+  batch.first = first;
+  batch.n_items = n_items;
+
+  // the kernel walks the tree of the option with the most time steps
+  batch.steps = 0;
+  for (int j = 0; j < n_items; ++j) {
+    const InputData &option = inp[(first + j) % inp.size()];
+    batch.steps = std::max(batch.steps, int(option.n_steps) + int(kOpt0));
+  }
+
+  auto prepare_options = [&](const int thread_idx) {
+    for (int j = thread_idx; j < n_items; j += threads) {
+      const InputData &option = inp[(first + j) % inp.size()];
+      batch.crr_params[j] = PrepareData(option);
+      PrepareKernelData(batch.crr_params[j], &batch.in_params[j * 3],
+                        &batch.in_params2[j * 3], batch.steps);
+    }
+  };
+
+  vector<std::thread> workers;
+  for (int t = 1; t < std::min(threads, n_items); ++t) {
+    workers.emplace_back(prepare_options, t);
+  }
+  prepare_options(0);
+  for (auto &w : workers) {
+    w.join();
+  }
+
+  // zero the CRR problems that pad the batch to a multiple of OUTER_UNROLL
+  for (int c = n_items * 3; c < KernelCRRCount(n_items); ++c) {
+    batch.in_params[c] = CRRMeta{};
+    for (int i = 0; i <= batch.steps; ++i) {
+      batch.in_params2[c].array_eles[i] = ArrayEle{};
+    }
+  }
+}
+
+// Statistics of a run of the pricing service
+struct ServiceStats {
+  int n_options = 0;
+  int n_batches = 0;
+  double time = 0;         // seconds, from the first input to the last result
+  double min_latency = 0;  // per batch, in seconds
+  double max_latency = 0;
+  double total_latency = 0;
+};
+
+// Prices a stream of 'n_stream' options, which replays the input options
+// 'inp', in batches of 'batch_size' options. The two batches alternate
+// between preparation on the host and pricing on the FPGA: the host prepares
+// the next batch while the kernel prices the current one, and post-processes
+// a batch while the kernel prices the next one. The results of each input
+// option are written to 'result', and its CPU parameters to 'in_params'.
+ServiceStats RunPricingService(queue &q, CRRBatch (&batches)[2],
+                               const vector<InputData> &inp,
+                               const int n_stream, const int batch_size,
+                               const int threads,
+                               vector<CRRInParams> &in_params,
+                               vector<OutputRes> &result) {
+  ServiceStats stats;
+  stats.n_options = n_stream;
+  stats.n_batches = (n_stream + batch_size - 1) / batch_size;
+
+  auto prepare_and_launch = [&](const int b) {
+    CRRBatch &batch = batches[b % 2];
+    batch.start = std::chrono::steady_clock::now();
+    const int first = b * batch_size;
+    PrepareBatch(batch, inp, first, std::min(batch_size, n_stream - first),
+                 threads);
+    batch.e = CrrSolver(q, batch.in_params, batch.in_params2,
+                        batch.res_params, KernelCRRCount(batch.n_items),
+                        batch.steps);
+  };
+
+  vector<InterRes> process_res(batch_size);
+  auto start = std::chrono::steady_clock::now();
+  prepare_and_launch(0);
+  for (int b = 0; b < stats.n_batches; ++b) {
+    // the other batch was post-processed in the previous iteration, so it is
+    // free to hold the next batch while the kernel works on this one
+    if (b + 1 < stats.n_batches) {
+      prepare_and_launch(b + 1);
+    }
+
+    CRRBatch &batch = batches[b % 2];
+    batch.e.wait();
+
+    // Post-processing step
+    // process_res used to compute final results
+    ProcessKernelResult(batch.res_params, process_res, batch.n_items);
+    for (int j = 0; j < batch.n_items; ++j) {
+      const int i = (batch.first + j) % inp.size();
+      in_params[i] = batch.crr_params[j];
+      result[i] = ComputeOutput(inp[i], in_params[i], process_res[j]);
+    }
+
+    auto end = std::chrono::steady_clock::now();
+    const double latency =
+        std::chrono::duration<double>(end - batch.start).count();
+    stats.min_latency = (b == 0) ? latency : std::min(stats.min_latency, latency);
+    stats.max_latency = std::max(stats.max_latency, latency);
+    stats.total_latency += latency;
+    stats.time = std::chrono::duration<double>(end - start).count();
+  }
+
+  return stats;
+}
+
+// Print out the achieved CRR throughput and the latency of the batches
+void TestThroughput(const ServiceStats &stats, const int batch_size) {
   std::cout << "\n============= Throughput Test =============\n";
 
+  std::cout << "   Options priced:   " << stats.n_options << " in "
+            << stats.n_batches << " batches of up to " << batch_size << "\n";
   std::cout << "   Avg throughput:   " << std::fixed << std::setprecision(1)
-            << (n_crrs / time) << " assets/s\n";
+            << (stats.n_options / stats.time) << " assets/s\n";
+  std::cout << "   Batch latency:    " << std::fixed << std::setprecision(3)
+            << "avg " << (stats.total_latency / stats.n_batches * 1e3)
+            << " ms, min " << (stats.min_latency * 1e3) << " ms, max "
+            << (stats.max_latency * 1e3) << " ms\n";
 }
 
 int main(int argc, char *argv[]) {
   string infilename = "";
   string outfilename = "";
+  int batch_size = kDefaultBatchSize;
+  int repeat = 1;
+  int threads = std::max(1u, std::thread::hardware_concurrency());
 
 #if FPGA_SIMULATOR
   const string default_ifile = "src/data/small_ordered_inputs.csv";
@@ -738,17 +898,32 @@ int main(int argc, char *argv[]) {
   const string default_ofile = "src/data/ordered_outputs.csv";
 
   char str_buffer[kMaxStringLen] = {0};
+  char num_buffer[kMaxStringLen] = {0};
   for (int i = 1; i < argc; i++) {
     if (argv[i][0] == '-') {
       string sarg(argv[i]);
 
       FindGetArgString(sarg, "-o=", str_buffer, kMaxStringLen);
       FindGetArgString(sarg, "--output-file=", str_buffer, kMaxStringLen);
+      if (FindGetArgString(sarg, "--batch-size=", num_buffer, kMaxStringLen)) {
+        batch_size = atoi(num_buffer);
+      }
+      if (FindGetArgString(sarg, "--repeat=", num_buffer, kMaxStringLen)) {
+        repeat = atoi(num_buffer);
+      }
+      if (FindGetArgString(sarg, "--threads=", num_buffer, kMaxStringLen)) {
+        threads = atoi(num_buffer);
+      }
     } else {
       infilename = string(argv[i]);
     }
   }
 
+  if (batch_size < 1 || repeat < 1 || threads < 1) {
+    std::cerr << "--batch-size, --repeat and --threads must be positive\n";
+    return 1;
+  }
+
   try {
 
 #if FPGA_SIMULATOR
@@ -767,6 +942,13 @@ int main(int argc, char *argv[]) {
               << device.get_info<info::device::name>().c_str()
               << std::endl;
 
+    // The batches of options stream through USM host allocations
+    if (!device.has(aspect::usm_host_allocations)) {
+      std::cerr << "USM host allocations must be supported to run this "
+                   "sample\n";
+      return 1;
+    }
+
     vector<InputData> inp;
 
     // Get input file name, if users don't have their test input file, this
@@ -774,7 +956,7 @@ int main(int argc, char *argv[]) {
     if (infilename == "") {
       infilename = default_ifile;
     }
-    ifstream inputFile(infilename);
+    ifstream inputFile(infilename, ios::binary);
 
     if (!inputFile.is_open()) {
       std::cerr << "Input file doesn't exist \n";
@@ -805,7 +987,9 @@ int main(int argc, char *argv[]) {
     }
 
     // Read inputs data from input file
-    ReadInputFromFile(inputFile, inp);
+    if (!ReadInputFromFile(inputFile, inp)) {
+      return 1;
+    }
 
 // Get the number of data from the input file
 // Emulator mode only goes through one input (or through OUTER_UNROLL inputs) to
@@ -827,44 +1011,37 @@ int main(int argc, char *argv[]) {
     }
 
     const int n_crrs = temp_crrs;
+    inp.resize(n_crrs);
 
-    vector<CRRInParams> in_params(n_crrs);
-    vector<CRRArrayEles> array_params(n_crrs);
+    // The stream of options replays the inputs 'repeat' times
+    const int n_stream = n_crrs * repeat;
+    batch_size = std::min(batch_size, n_stream);
 
-    for (int j = 0; j < n_crrs; ++j) {
-      in_params[j] = PrepareData(inp[j]);
-      array_params[j] = PrepareArrData(in_params[j]);
+    // Allocate the two batches that alternate between the host and the FPGA
+    CRRBatch batches[2];
+    for (auto &batch : batches) {
+      if (!AllocateBatch(q, batch, batch_size)) {
+        std::cerr << "Failed to allocate USM host memory for the batches\n";
+        return 1;
+      }
     }
 
-    // following vectors are arguments for CrrSolver
-    vector<CRRMeta> in_buff_params(n_crrs * 3);
-    vector<CRRPerStepMeta> in_buff2_params(n_crrs * 3);
-
-    // Prepare metadata as input to kernel
-    PrepareKernelData(in_params, array_params, in_buff_params, in_buff2_params,
-                      n_crrs);
+    vector<CRRInParams> in_params(n_crrs);
+    vector<OutputRes> result(n_crrs);
 
 #ifdef FPGA_HARDWARE
     // warmup run - use this run to warmup accelerator
-    vector<CRRResParams> res_params_dummy(n_crrs * 3);
-    CrrSolver(n_crrs, in_buff_params, res_params_dummy, in_buff2_params,
-               q);
+    RunPricingService(q, batches, inp, n_crrs, batch_size, threads, in_params,
+                      result);
 #endif
 
     // Timed run - profile performance
-    vector<CRRResParams> res_params(n_crrs * 3);
-    double time = CrrSolver(n_crrs, in_buff_params, res_params,
-                             in_buff2_params, q);
+    ServiceStats stats = RunPricingService(q, batches, inp, n_stream,
+                                           batch_size, threads, in_params,
+                                           result);
     bool pass = true;
 
-    // Post-processing step
-    // process_res used to compute final results
-    vector<InterRes> process_res(n_crrs);
-    ProcessKernelResult(res_params, process_res, n_crrs);
-
-    vector<OutputRes> result(n_crrs);
     for (int i = 0; i < n_crrs; ++i) {
-      result[i] = ComputeOutput(inp[i], in_params[i], process_res[i]);
       TestCorrectness(i, n_crrs, pass, inp[i], in_params[i], result[i]);
     }
 
@@ -873,7 +1050,11 @@ int main(int argc, char *argv[]) {
 
     WriteOutputToFile(outputFile, result);
 
-    TestThroughput(time, n_crrs);
+    TestThroughput(stats, batch_size);
+
+    for (auto &batch : batches) {
+      FreeBatch(q, batch);
+    }
 
   } catch (sycl::exception const &e) {
     std::cerr << "Caught a synchronous SYCL exception: " << e.what() << "\n";
@@ -21,6 +21,8 @@
 #include <fstream>
 #include <functional>
 #include <iostream>
+#include <map>
+#include <mutex>
 #include <numeric>
 #include <set>
 #include <sstream>
@@ -31,33 +33,97 @@
 #include "db_utils/Date.hpp"
 #include "db_utils/LikeRegex.hpp"
 #include "dbdata.hpp"
+#include "operator_checks.hpp"
+#include "query_scheduler.hpp"
 
 #include "exception_handler.hpp"
 
 using namespace sycl;
 
-// include files depending on the query selected
-#if (QUERY == 1)
+// include files depending on the queries selected. CMake defines
+// QUERY<N>_ENABLED for each query compiled into the program, and QUERY as the
+// default query to run.
+struct QueryPlan;
+#if defined(QUERY1_ENABLED)
 #include "query1/query1_kernel.hpp"
+bool PlanQuery1(Database& dbinfo, std::string& args, bool test,
+                QueryPlan& plan);
 bool DoQuery1(queue& q, Database& dbinfo, std::string& db_root_dir,
-              std::string& args, bool test, bool print, double& kernel_latency,
-              double& total_latency);
-#elif (QUERY == 9)
+              const QueryPlan& plan, bool test, bool print,
+              double& kernel_latency, double& total_latency);
+#endif
+#if defined(QUERY9_ENABLED)
 #include "query9/query9_kernel.hpp"
+bool PlanQuery9(Database& dbinfo, std::string& args, bool test,
+                QueryPlan& plan);
 bool DoQuery9(queue& q, Database& dbinfo, std::string& db_root_dir,
-              std::string& args, bool test, bool print, double& kernel_latency,
-              double& total_latency);
-#elif (QUERY == 11)
+              const QueryPlan& plan, bool test, bool print,
+              double& kernel_latency, double& total_latency);
+#endif
+#if defined(QUERY11_ENABLED)
 #include "query11/query11_kernel.hpp"
+bool PlanQuery11(Database& dbinfo, std::string& args, bool test,
+                 QueryPlan& plan);
 bool DoQuery11(queue& q, Database& dbinfo, std::string& db_root_dir,
-               std::string& args, bool test, bool print, double& kernel_latency,
-               double& total_latency);
-#elif (QUERY == 12)
+               const QueryPlan& plan, bool test, bool print,
+               double& kernel_latency, double& total_latency);
+#endif
+#if defined(QUERY12_ENABLED)
 #include "query12/query12_kernel.hpp"
+bool PlanQuery12(Database& dbinfo, std::string& args, bool test,
+                 QueryPlan& plan);
 bool DoQuery12(queue& q, Database& dbinfo, std::string& db_root_dir,
-               std::string& args, bool test, bool print, double& kernel_latency,
-               double& total_latency);
+               const QueryPlan& plan, bool test, bool print,
+               double& kernel_latency, double& total_latency);
+#endif
+
+// the queries compiled into this program
+const std::vector<unsigned int> kEnabledQueries = {
+#if defined(QUERY1_ENABLED)
+    1,
+#endif
+#if defined(QUERY9_ENABLED)
+    9,
+#endif
+#if defined(QUERY11_ENABLED)
+    11,
+#endif
+#if defined(QUERY12_ENABLED)
+    12,
+#endif
+};
+
+// The DoQuery functions may run concurrently when several queries are
+// scheduled (--queries). They hold this lock for everything but the query
+// itself, so that their parsing, printing and validation do not interleave.
+std::mutex io_mutex;
+
+//
+// A query with its arguments parsed, checked and compiled into the arguments
+// of its kernels (the predicate programs and LIKE patterns of Query<N>Plan).
+// A plan is prepared once, and then run by every run of the query and by
+// every entry of a queue of queries with the same arguments.
+//
+struct QueryPlan {
+  unsigned int query = 0;
+
+  // the query and its arguments, printed when the query runs
+  std::string description;
+
+#if defined(QUERY1_ENABLED)
+  unsigned int q1_low_date = 0;
+#endif
+#if defined(QUERY9_ENABLED)
+  Query9Plan q9;
+#endif
+#if defined(QUERY11_ENABLED)
+  Query11Plan q11;
 #endif
+#if defined(QUERY12_ENABLED)
+  Query12Plan q12;
+  std::string q12_shipmode1, q12_shipmode2;
+#endif
+};
 
 //
 // print help for the program
@@ -73,8 +139,19 @@ void Help() {
   std::cout << "\t--test    enables testing of the query."
                " This overrides the arguments to the query (--args) "
                "and uses default input from TPCH documents\n";
+  std::cout << "\t--check-operators    check the database operators on the"
+               " host, without a database, and exit\n";
   std::cout << "\t--print   print the query results to stdout\n";
   std::cout << "\t--runs    how many iterations of the query to run\n";
+  std::cout << "\t--queries=<comma separated list of queries>"
+               "   run a queue of queries with the default (test) arguments."
+               " The queries must all be compiled into the program\n";
+  std::cout << "\t--snapshot    write binary snapshots of the LINEITEM and"
+               " ORDERS tables next to the '.tbl' files, which are loaded"
+               " instead of parsing the tables on later runs\n";
+  std::cout << "\t--partition-rows=<rows>    the maximum number of LINEITEM"
+               " rows to stream through the kernels at once. By default, the"
+               " partitions are sized to fit in the device memory\n";
   std::cout << "\t--help    print this help message\n";
   std::cout << "\n";
 
@@ -87,16 +164,19 @@ void Help() {
   std::cout << "\n";
 
   std::cout << "./db --dbroot=/path/to/database/files "
-            << "[--test] [--args=<COLOUR>]\n";
+            << "[--test] [--args=<%COLOUR%|%COLOUR|COLOUR%|COLOUR>]\n";
   std::cout << "\t ./db --dbroot=/path/to/database/files --test\n";
-  std::cout << "\t ./db --dbroot=/path/to/database/files --args=GREEN\n";
+  std::cout << "\t ./db --dbroot=/path/to/database/files --args=%GREEN%\n";
+  std::cout << "\t ./db --dbroot=/path/to/database/files --args=%GREEN\n";
   std::cout << "\n";
 
   std::cout << "./db --dbroot=/path/to/database/files "
-            << "[--test] [--args=<NATION>]\n";
+            << "[--test] [--args=<NATION[|NATION...]>]\n";
   std::cout << "\t ./db --dbroot=/path/to/database/files --test\n";
   std::cout << "\t ./db --dbroot=/path/to/database/files "
             << "--args=GERMANY\n";
+  std::cout << "\t ./db --dbroot=/path/to/database/files "
+            << "--args=\"GERMANY|FRANCE\"\n";
   std::cout << "\n";
 
   std::cout << "./db --dbroot=/path/to/database/files [--test] "
@@ -105,6 +185,12 @@ void Help() {
   std::cout << "\t ./db --dbroot=/path/to/database/files "
             << "--args=MAIL,SHIP,1994-01-10\n";
   std::cout << "\n";
+
+  std::cout << "./db --dbroot=/path/to/database/files [--test] "
+            << "[--queries=<QUERY1,QUERY2,...>]\n";
+  std::cout << "\t ./db --dbroot=/path/to/database/files --test "
+            << "--queries=1,12,9,1,11\n";
+  std::cout << "\n";
 }
 
 //
@@ -114,6 +200,78 @@ bool StrStartsWith(std::string& str, std::string prefix) {
   return str.find(prefix) == 0;
 }
 
+//
+// determine if a query is compiled into the program
+//
+bool QueryEnabled(unsigned int query) {
+  return std::find(kEnabledQueries.begin(), kEnabledQueries.end(), query) !=
+         kEnabledQueries.end();
+}
+
+//
+// prepare the plan of one of the queries compiled into the program
+//
+bool PlanQuery(Database& dbinfo, unsigned int query, std::string& args,
+               bool test, QueryPlan& plan) {
+  plan.query = query;
+#if defined(QUERY1_ENABLED)
+  if (query == 1) {
+    return PlanQuery1(dbinfo, args, test, plan);
+  }
+#endif
+#if defined(QUERY9_ENABLED)
+  if (query == 9) {
+    return PlanQuery9(dbinfo, args, test, plan);
+  }
+#endif
+#if defined(QUERY11_ENABLED)
+  if (query == 11) {
+    return PlanQuery11(dbinfo, args, test, plan);
+  }
+#endif
+#if defined(QUERY12_ENABLED)
+  if (query == 12) {
+    return PlanQuery12(dbinfo, args, test, plan);
+  }
+#endif
+  std::cerr << "ERROR: unsupported query (" << query << ")\n";
+  return false;
+}
+
+//
+// run the plan of one of the queries compiled into the program
+//
+bool RunQuery(queue& q, Database& dbinfo, const QueryPlan& plan,
+              std::string& db_root_dir, bool test, bool print,
+              double& kernel_latency, double& total_latency) {
+#if defined(QUERY1_ENABLED)
+  if (plan.query == 1) {
+    return DoQuery1(q, dbinfo, db_root_dir, plan, test, print,
+                    kernel_latency, total_latency);
+  }
+#endif
+#if defined(QUERY9_ENABLED)
+  if (plan.query == 9) {
+    return DoQuery9(q, dbinfo, db_root_dir, plan, test, print,
+                    kernel_latency, total_latency);
+  }
+#endif
+#if defined(QUERY11_ENABLED)
+  if (plan.query == 11) {
+    return DoQuery11(q, dbinfo, db_root_dir, plan, test, print,
+                     kernel_latency, total_latency);
+  }
+#endif
+#if defined(QUERY12_ENABLED)
+  if (plan.query == 12) {
+    return DoQuery12(q, dbinfo, db_root_dir, plan, test, print,
+                     kernel_latency, total_latency);
+  }
+#endif
+  std::cerr << "ERROR: unsupported query (" << plan.query << ")\n";
+  return false;
+}
+
 //
 // main
 //
@@ -123,7 +281,9 @@ int main(int argc, char* argv[]) {
   std::string db_root_dir = ".";
   std::string args = "";
   unsigned int query = QUERY;
+  std::vector<unsigned int> query_queue;
   bool test_query = false;
+  bool check_operators = false;
 #if defined(FPGA_EMULATOR)
   unsigned int runs = 1;
 #elif defined(FPGA_SIMULATOR)
@@ -132,6 +292,7 @@ int main(int argc, char* argv[]) {
   unsigned int runs = 5;
 #endif
   bool print_result = false;
+  bool write_snapshots = false;
   bool need_help = false;
 
   // parse the command line arguments
@@ -147,12 +308,24 @@ int main(int argc, char* argv[]) {
         db_root_dir = str_after_equals;
       } else if (StrStartsWith(arg, "--query=")) {
         query = atoi(str_after_equals.c_str());
+      } else if (StrStartsWith(arg, "--queries=")) {
+        std::stringstream ss(str_after_equals);
+        std::string tmp;
+        while (std::getline(ss, tmp, ',')) {
+          query_queue.push_back(atoi(tmp.c_str()));
+        }
       } else if (StrStartsWith(arg, "--args=")) {
         args = str_after_equals;
       } else if (StrStartsWith(arg, "--test")) {
         test_query = true;
+      } else if (StrStartsWith(arg, "--check-operators")) {
+        check_operators = true;
       } else if (StrStartsWith(arg, "--print")) {
         print_result = true;
+      } else if (StrStartsWith(arg, "--snapshot")) {
+        write_snapshots = true;
+      } else if (StrStartsWith(arg, "--partition-rows=")) {
+        dbinfo.partition_rows = atoll(str_after_equals.c_str());
       } else if (StrStartsWith(arg, "--runs")) {
 #ifndef FPGA_EMULATOR
         // for hardware, ensure at least two iterations to ensure we can run
@@ -175,19 +348,39 @@ int main(int argc, char* argv[]) {
     return 0;
   }
 
-  // make sure the query is supported
-  if (!(query == 1 || query == 9 || query == 11 || query == 12)) {
-    std::cerr << "ERROR: unsupported query (" << query << "). "
-              << "Only queries 1, 9, 11 and 12 are supported\n";
-    return 1;
+  // check the operators on the host, without the database
+  if (check_operators) {
+    bool success = CheckGroupBy();
+    success &= CheckLikePatterns();
+    std::cout << (success ? "PASSED\n" : "FAILED\n");
+    return success ? 0 : 1;
   }
 
-  if (query != QUERY) {
-    std::cerr << "ERROR: project not currently configured for query " << query
-              << "\n";
-    std::cerr << "\trerun CMake using the command: 'cmake .. -DQUERY=" << query
-              << "'\n";
-    return 1;
+  // a single query is a queue of one
+  bool scheduled = !query_queue.empty();
+  if (!scheduled) {
+    query_queue.push_back(query);
+  } else if (!args.empty()) {
+    std::cout << "Running a queue of queries, therefore ignoring the '--args' "
+              << "flag\n";
+    args = "";
+  }
+
+  for (auto qq : query_queue) {
+    // make sure the query is supported
+    if (!(qq == 1 || qq == 9 || qq == 11 || qq == 12)) {
+      std::cerr << "ERROR: unsupported query (" << qq << "). "
+                << "Only queries 1, 9, 11 and 12 are supported\n";
+      return 1;
+    }
+
+    if (!QueryEnabled(qq)) {
+      std::cerr << "ERROR: project not currently configured for query " << qq
+                << "\n";
+      std::cerr << "\trerun CMake using the command: 'cmake .. -DQUERY=" << qq
+                << "' or 'cmake .. -DQUERY=all'\n";
+      return 1;
+    }
   }
 
   try {
@@ -212,59 +405,76 @@ int main(int argc, char* argv[]) {
               << std::endl;
 
     // parse the database files located in the 'db_root_dir' directory
-    bool success = dbinfo.Parse(db_root_dir);
+    bool success = dbinfo.Parse(db_root_dir, write_snapshots);
     if (!success) {
       std::cerr << "ERROR: couldn't read the DB files\n";
       return 1;
     }
 
-    std::cout << "Database SF = " << kSF << "\n";
-
-    // make sure the parsed database files match the set scale factor
+    // derive the scale factor of the database and make sure the sizes of the
+    // parsed tables match it
     if (!dbinfo.ValidateSF()) {
       std::cerr << "ERROR: could not validate the "
                 << "scale factor of the parsed database files\n";
       return 1;
     }
 
+    std::cout << "Database SF = " << dbinfo.sf << "\n";
+
     // track timing information for each run
     std::vector<double> total_latency(runs);
     std::vector<double> kernel_latency(runs);
 
-    // run 'runs' iterations of the query
-    for (unsigned int run = 0; run < runs && success; run++) {
-      // run the selected query
-      if (query == 1) {
-#if (QUERY == 1)
-        success = DoQuery1(q, dbinfo, db_root_dir, args,
-                           test_query, print_result,
-                           kernel_latency[run], total_latency[run]);
-#endif
-      } else if (query == 9) {
-        // query9
-#if (QUERY == 9)
-        success = DoQuery9(q, dbinfo, db_root_dir, args,
-                           test_query, print_result,
-                           kernel_latency[run], total_latency[run]);
-#endif
-      } else if (query == 11) {
-        // query11
-#if (QUERY == 11)
-        success = DoQuery11(q, dbinfo, db_root_dir, args,
-                            test_query, print_result,
-                            kernel_latency[run], total_latency[run]);
-#endif
-      } else if (query == 12) {
-        // query12
-#if (QUERY == 12)
-        success = DoQuery12(q, dbinfo, db_root_dir, args,
-                            test_query, print_result,
-                            kernel_latency[run], total_latency[run]);
-#endif
-      } else {
-        std::cerr << "ERROR: unsupported query (" << query << ")\n";
-        return 1;
+    if (!scheduled) {
+      // prepare the query once for all of its runs
+      QueryPlan plan;
+      success = PlanQuery(dbinfo, query, args, test_query, plan);
+
+      // run 'runs' iterations of the query
+      for (unsigned int run = 0; run < runs && success; run++) {
+        success = RunQuery(q, dbinfo, plan, db_root_dir, test_query,
+                           print_result, kernel_latency[run],
+                           total_latency[run]);
       }
+    } else {
+      // prepare each query and set of arguments in the queue once, the
+      // queries share the plans while they run
+      std::map<std::pair<unsigned int, std::string>, QueryPlan> plans;
+      for (auto qq : query_queue) {
+        auto key = std::make_pair(qq, std::string());
+        if (success && plans.find(key) == plans.end()) {
+          success = PlanQuery(dbinfo, qq, key.second, test_query,
+                              plans[key]);
+        }
+      }
+
+      // run 'runs' iterations of the queue of queries
+      QueryScheduler scheduler([&](unsigned int qq, std::string& qq_args,
+                                   double& qq_kernel_latency,
+                                   double& qq_total_latency) {
+        const QueryPlan& plan = plans.at(std::make_pair(qq, qq_args));
+        return RunQuery(q, dbinfo, plan, db_root_dir, test_query,
+                        print_result, qq_kernel_latency, qq_total_latency);
+      });
+      for (auto qq : query_queue) {
+        scheduler.Push(qq);
+      }
+
+      // the queries that run at the same time share the device memory
+      dbinfo.concurrent_queries = scheduler.Concurrency();
+
+      for (unsigned int run = 0; run < runs && success; run++) {
+        success = scheduler.Run();
+        total_latency[run] = scheduler.Makespan();
+      }
+
+      // don't analyze the runtime in emulation
+#if !defined(FPGA_EMULATOR) && !defined(FPGA_SIMULATOR)
+      if (success) {
+        // the latency of each query in the last iteration
+        scheduler.PrintReport();
+      }
+#endif
     }
 
     if (success) {
@@ -276,15 +486,23 @@ int main(int argc, char* argv[]) {
           std::accumulate(total_latency.begin() + 1, total_latency.end(), 0.0) /
           (double)(runs - 1);
 
-      double kernel_latency_avg =
-        std::accumulate(kernel_latency.begin() + 1, kernel_latency.end(), 0.0) /
-        (double)(runs - 1);
+      if (!scheduled) {
+        double kernel_latency_avg =
+          std::accumulate(kernel_latency.begin() + 1, kernel_latency.end(),
+                          0.0) / (double)(runs - 1);
 
-      // print the performance results
-      std::cout << "Processing time: " << total_latency_avg << " ms\n";
-      std::cout << "Kernel time: " << kernel_latency_avg << " ms\n";
-      std::cout << "Throughput: " << ((1 / kernel_latency_avg) * 1e3)
-                << " queries/s\n";
+        // print the performance results
+        std::cout << "Processing time: " << total_latency_avg << " ms\n";
+        std::cout << "Kernel time: " << kernel_latency_avg << " ms\n";
+        std::cout << "Throughput: " << ((1 / kernel_latency_avg) * 1e3)
+                  << " queries/s\n";
+      } else {
+        // the average time to run the whole queue
+        std::cout << "Average queue time: " << total_latency_avg << " ms\n";
+        std::cout << "Average throughput: "
+                  << ((query_queue.size() / total_latency_avg) * 1e3)
+                  << " queries/s\n";
+      }
 #endif
 
       std::cout << "PASSED\n";
@@ -311,10 +529,9 @@ int main(int argc, char* argv[]) {
   return 0;
 }
 
-#if (QUERY == 1)
-bool DoQuery1(queue& q, Database& dbinfo, std::string& db_root_dir,
-              std::string& args, bool test, bool print, double& kernel_latency,
-              double& total_latency) {
+#if defined(QUERY1_ENABLED)
+bool PlanQuery1(Database& dbinfo, std::string& args, bool test,
+                QueryPlan& plan) {
   // NOTE: this is fixed based on the TPCH docs
   Date date = Date("1998-12-01");
   unsigned int DELTA = 90;
@@ -339,10 +556,22 @@ bool DoQuery1(queue& q, Database& dbinfo, std::string& db_root_dir,
 
   // compute query interval
   Date low_date = date.PreviousDate(DELTA);
-  unsigned int low_date_compact = low_date.ToCompact();
+  plan.q1_low_date = low_date.ToCompact();
+
+  plan.description = "Q1 within " + std::to_string(DELTA) + " days of " +
+                     std::to_string(date.year) + "-" +
+                     std::to_string(date.month) + "-" +
+                     std::to_string(date.day);
+
+  return true;
+}
+
+bool DoQuery1(queue& q, Database& dbinfo, std::string& db_root_dir,
+              const QueryPlan& plan, bool test, bool print,
+              double& kernel_latency, double& total_latency) {
+  std::unique_lock<std::mutex> lock(io_mutex);
 
-  std::cout << "Running Q1 within " << DELTA << " days of " << date.year << "-"
-            << date.month << "-" << date.day << std::endl;
+  std::cout << "Running " << plan.description << std::endl;
 
   // the query output data
   std::array<DBDecimal, kQuery1OutSize> sum_qty = {0}, sum_base_price = {0},
@@ -350,11 +579,13 @@ bool DoQuery1(queue& q, Database& dbinfo, std::string& db_root_dir,
                                        avg_qty = {0}, avg_price = {0},
                                        avg_discount = {0}, count = {0};
 
-  // perform the query
+  // perform the query, without holding the lock
+  lock.unlock();
   bool success =
-      SubmitQuery1(q, dbinfo, low_date_compact, sum_qty, sum_base_price,
+      SubmitQuery1(q, dbinfo, plan.q1_low_date, sum_qty, sum_base_price,
                    sum_disc_price, sum_charge, avg_qty, avg_price, avg_discount,
                    count, kernel_latency, total_latency);
+  lock.lock();
 
   if (success) {
     // validate the results of the query, if requested
@@ -375,12 +606,11 @@ bool DoQuery1(queue& q, Database& dbinfo, std::string& db_root_dir,
 }
 #endif
 
-#if (QUERY == 9)
-bool DoQuery9(queue& q, Database& dbinfo, std::string& db_root_dir,
-              std::string& args, bool test, bool print, double& kernel_latency,
-              double& total_latency) {
+#if defined(QUERY9_ENABLED)
+bool PlanQuery9(Database& dbinfo, std::string& args, bool test,
+                QueryPlan& plan) {
   // the default colour regex based on the TPCH documents
-  std::string colour = "GREEN";
+  std::string colour = "%GREEN%";
 
   // parse the query arguments
   if (!test && !args.empty()) {
@@ -395,14 +625,26 @@ bool DoQuery9(queue& q, Database& dbinfo, std::string& db_root_dir,
   // convert the colour regex to uppercase characters (convention)
   transform(colour.begin(), colour.end(), colour.begin(), ::toupper);
 
-  std::cout << "Running Q9 with colour regex: " << colour << std::endl;
+  plan.description = "Q9 with colour regex: " + colour;
+
+  return PrepareQuery9(colour, plan.q9);
+}
+
+bool DoQuery9(queue& q, Database& dbinfo, std::string& db_root_dir,
+              const QueryPlan& plan, bool test, bool print,
+              double& kernel_latency, double& total_latency) {
+  std::unique_lock<std::mutex> lock(io_mutex);
+
+  std::cout << "Running " << plan.description << std::endl;
 
   // the output of the query
   std::array<DBDecimal, 25 * 2020> sum_profit;
 
-  // perform the query
-  bool success = SubmitQuery9(q, dbinfo, colour, sum_profit, kernel_latency,
+  // perform the query, without holding the lock
+  lock.unlock();
+  bool success = SubmitQuery9(q, dbinfo, plan.q9, sum_profit, kernel_latency,
                               total_latency);
+  lock.lock();
 
   if (success) {
     // validate the results of the query, if requested
@@ -420,37 +662,58 @@ bool DoQuery9(queue& q, Database& dbinfo, std::string& db_root_dir,
 }
 #endif
 
-#if (QUERY == 11)
-bool DoQuery11(queue& q, Database& dbinfo, std::string& db_root_dir,
-               std::string& args, bool test, bool print, double& kernel_latency,
-               double& total_latency) {
+#if defined(QUERY11_ENABLED)
+bool PlanQuery11(Database& dbinfo, std::string& args, bool test,
+                 QueryPlan& plan) {
   // the default nation, based on the TPCH documents
-  std::string nation = "GERMANY";
+  std::string nation_list = "GERMANY";
 
   // parse the query arguments
   if (!test && !args.empty()) {
     std::stringstream ss(args);
-    std::getline(ss, nation, ',');
+    std::getline(ss, nation_list, ',');
   } else {
     if (!args.empty()) {
       std::cout << "Testing query 11, therefore ignoring the '--args' flag\n";
     }
   }
 
-  // convert the nation name to uppercase characters (convention)
-  transform(nation.begin(), nation.end(), nation.begin(), ::toupper);
+  // convert the nation names to uppercase characters (convention)
+  transform(nation_list.begin(), nation_list.end(), nation_list.begin(),
+            ::toupper);
+
+  // the suppliers of several nations can be valued together (NATION|NATION)
+  std::vector<std::string> nations;
+  std::stringstream ss(nation_list);
+  std::string nation;
+  plan.description = "Q11 for nation";
+  while (std::getline(ss, nation, '|')) {
+    auto it = dbinfo.n.name_key_map.find(nation);
+    plan.description += (nations.empty() ? " " : ", ") + nation + " (key=" +
+        ((it != dbinfo.n.name_key_map.end()) ? std::to_string(it->second)
+                                             : std::string("?")) + ")";
+    nations.push_back(nation);
+  }
+
+  return PrepareQuery11(dbinfo, nations, plan.q11);
+}
+
+bool DoQuery11(queue& q, Database& dbinfo, std::string& db_root_dir,
+               const QueryPlan& plan, bool test, bool print,
+               double& kernel_latency, double& total_latency) {
+  std::unique_lock<std::mutex> lock(io_mutex);
 
-  std::cout << "Running Q11 for nation " << nation.c_str()
-            << " (key=" << (int)(dbinfo.n.name_key_map[nation]) << ")"
-            << std::endl;
+  std::cout << "Running " << plan.description << std::endl;
 
   // the query output
-  std::vector<DBIdentifier> partkeys(kPartTableSize);
-  std::vector<DBDecimal> partkey_values(kPartTableSize);
+  std::vector<DBIdentifier> partkeys(kMaxPartTableSize);
+  std::vector<DBDecimal> partkey_values(kMaxPartTableSize);
 
-  // perform the query
-  bool success = SubmitQuery11(q, dbinfo, nation, partkeys, partkey_values,
+  // perform the query, without holding the lock
+  lock.unlock();
+  bool success = SubmitQuery11(q, dbinfo, plan.q11, partkeys, partkey_values,
                                kernel_latency, total_latency);
+  lock.lock();
 
   if (success) {
     // validate the results of the query, if requested
@@ -468,10 +731,9 @@ bool DoQuery11(queue& q, Database& dbinfo, std::string& db_root_dir,
 }
 #endif
 
-#if (QUERY == 12)
-bool DoQuery12(queue& q, Database& dbinfo, std::string& db_root_dir,
-               std::string& args, bool test, bool print, double& kernel_latency,
-               double& total_latency) {
+#if defined(QUERY12_ENABLED)
+bool PlanQuery12(Database& dbinfo, std::string& args, bool test,
+                 QueryPlan& plan) {
   // the default query date and shipmodes, based on the TPCH documents
   Date date = Date("1994-01-01");
   std::string shipmode1 = "MAIL", shipmode2 = "SHIP";
@@ -508,18 +770,32 @@ bool DoQuery12(queue& q, Database& dbinfo, std::string& db_root_dir,
   Date low_date = date;
   Date high_date = Date(low_date.year + 1, low_date.month, low_date.day);
 
-  std::cout << "Running Q12 between years " << low_date.year << " and "
-            << high_date.year << " for SHIPMODES " << shipmode1 << " and "
-            << shipmode2 << std::endl;;
+  plan.description = "Q12 between years " + std::to_string(low_date.year) +
+                     " and " + std::to_string(high_date.year) +
+                     " for SHIPMODES " + shipmode1 + " and " + shipmode2;
+  plan.q12_shipmode1 = shipmode1;
+  plan.q12_shipmode2 = shipmode2;
+
+  return PrepareQuery12(low_date.ToCompact(), high_date.ToCompact(),
+                        ShipmodeStrToInt(shipmode1),
+                        ShipmodeStrToInt(shipmode2), plan.q12);
+}
+
+bool DoQuery12(queue& q, Database& dbinfo, std::string& db_root_dir,
+               const QueryPlan& plan, bool test, bool print,
+               double& kernel_latency, double& total_latency) {
+  std::unique_lock<std::mutex> lock(io_mutex);
+
+  std::cout << "Running " << plan.description << std::endl;
 
   // the output of the query
   std::array<DBDecimal, 2> high_line_count, low_line_count;
 
-  // perform the query
-  bool success = SubmitQuery12(
-      q, dbinfo, low_date.ToCompact(), high_date.ToCompact(),
-      ShipmodeStrToInt(shipmode1), ShipmodeStrToInt(shipmode2), high_line_count,
-      low_line_count, kernel_latency, total_latency);
+  // perform the query, without holding the lock
+  lock.unlock();
+  bool success = SubmitQuery12(q, dbinfo, plan.q12, high_line_count,
+                               low_line_count, kernel_latency, total_latency);
+  lock.lock();
 
   if (success) {
     // validate the results of the query, if requested
@@ -530,7 +806,8 @@ bool DoQuery12(queue& q, Database& dbinfo, std::string& db_root_dir,
 
     // print the results of the query, if requested
     if (print) {
-      dbinfo.PrintQ12(shipmode1, shipmode2, high_line_count, low_line_count);
+      dbinfo.PrintQ12(plan.q12_shipmode1, plan.q12_shipmode2,
+                      high_line_count, low_line_count);
     }
   }
 
@@ -0,0 +1,185 @@
+#ifndef __GROUPBY_HPP__
+#define __GROUPBY_HPP__
+#pragma once
+
+#include <stddef.h>
+#include <array>
+#include <limits>
+#include <type_traits>
+
+#include "Misc.hpp"
+
+#include "onchip_memory_with_cache.hpp" // From the include directory
+
+//
+// The aggregate functions of a GroupBy
+//
+enum class AggregateOp : unsigned char {
+  kSum,
+  kCount,
+  kMin,
+  kMax,
+  kAvg   // accumulated as a sum, see GroupBy::Average
+};
+
+//
+// Mix the hash of one more column of a composite key into 'seed'. A key type
+// of a GroupBy can build its Hash() from its columns with this function.
+//
+inline unsigned int HashCombine(unsigned int seed, unsigned int value) {
+  return (seed ^ (value + 0x9E3779B9u + (seed << 6) + (seed >> 2))) *
+         2654435769u;
+}
+
+//
+// A group of a GroupBy: its key, the number of rows in it, and its aggregates
+//
+template <typename KeyType, typename ValueType, int num_aggregates>
+struct GroupByEntry {
+  bool valid = false;
+  KeyType key;
+  ValueType count = 0;
+  ValueType values[num_aggregates];
+};
+
+//
+// A streaming GROUP BY operator. The groups are kept in a direct-mapped hash
+// table of 'num_buckets' buckets in on-chip memory, which is an
+// OnchipMemoryWithCache, so that back-to-back rows of the same group are
+// forwarded from the cache and a row is aggregated every cycle (II=1).
+//
+// A row whose bucket holds a group with another key evicts that group, which
+// the kernel writes to a spill buffer in device memory (GroupBySpill). At the
+// end of the stream, the kernel also writes the groups left in the table to
+// the spill buffer (Flush), and the host merges the groups with the same key
+// (Merge). If the key space of a query is small, a dense KeyType::Hash() with
+// at most 'num_buckets' values avoids evictions altogether.
+//
+// KeyType must have an 'unsigned int Hash() const' function and an
+// operator==. The 'ops' are the aggregate function of each value of a row.
+//
+template <typename KeyType, typename ValueType, int num_buckets,
+          int cache_depth, AggregateOp... ops>
+class GroupBy {
+  // static asserts
+  static_assert(std::is_arithmetic<ValueType>::value,
+    "ValueType must be arithmetic to support aggregation");
+  static_assert(num_buckets > 0 && Pow2(Log2(num_buckets)) == num_buckets,
+    "The number of buckets must be a power of 2");
+  static_assert(sizeof...(ops) > 0,
+    "The GroupBy must have at least one aggregate");
+  static_assert(
+      std::is_same<unsigned int, decltype(KeyType().Hash())>::value,
+      "KeyType must have 'Hash()' function that returns an 'unsigned int'");
+
+ public:
+  static constexpr int kNumAggregates = sizeof...(ops);
+  static constexpr AggregateOp kOps[kNumAggregates] = {ops...};
+
+  using Entry = GroupByEntry<KeyType, ValueType, kNumAggregates>;
+  using Values = std::array<ValueType, kNumAggregates>;
+
+  // empty the table
+  void Init() { table_.init(Entry()); }
+
+  // aggregate the 'values' of a row into the group of 'key'. Returns true if
+  // this evicted another group from the table, which is returned in 'evicted'
+  bool Aggregate(const KeyType& key, const Values& values, Entry& evicted) {
+    const unsigned int bucket = key.Hash() & (num_buckets - 1);
+    Entry entry = table_.read(bucket);
+
+    const bool evict = entry.valid && !(entry.key == key);
+    evicted = entry;
+
+    // start a new group
+    if (!entry.valid || evict) {
+      entry.valid = true;
+      entry.key = key;
+      entry.count = 0;
+      #pragma unroll
+      for (int i = 0; i < kNumAggregates; i++) {
+        entry.values[i] = Identity(kOps[i]);
+      }
+    }
+
+    entry.count += 1;
+    #pragma unroll
+    for (int i = 0; i < kNumAggregates; i++) {
+      entry.values[i] = Apply(kOps[i], entry.values[i], values[i]);
+    }
+    table_.write(bucket, entry);
+
+    return evict;
+  }
+
+  // write the groups left in the table to the spill buffer
+  template <typename Spill>
+  void Flush(Spill spill, size_t capacity, size_t& count) {
+    [[intel::initiation_interval(1)]]
+    for (int b = 0; b < num_buckets; b++) {
+      Entry entry = table_.read(b);
+      if (entry.valid) {
+        if (count < capacity) {
+          spill[count] = entry;
+        }
+        count++;
+      }
+    }
+  }
+
+  // merge the group 'from' into the group 'into' with the same key (host)
+  static void Merge(Entry& into, const Entry& from) {
+    if (!into.valid) {
+      into = from;
+      return;
+    }
+    into.count += from.count;
+    for (int i = 0; i < kNumAggregates; i++) {
+      into.values[i] = Combine(kOps[i], into.values[i], from.values[i]);
+    }
+  }
+
+  // the average of the aggregate 'i' of a merged group, for kAvg
+  static double Average(const Entry& entry, int i) {
+    return (entry.count == 0) ? 0.0 : (double)entry.values[i] / entry.count;
+  }
+
+ private:
+  static ValueType Identity(AggregateOp op) {
+    return (op == AggregateOp::kMin) ? std::numeric_limits<ValueType>::max()
+           : (op == AggregateOp::kMax)
+               ? std::numeric_limits<ValueType>::lowest()
+               : ValueType(0);
+  }
+
+  // aggregate the value of a row
+  static ValueType Apply(AggregateOp op, ValueType acc, ValueType value) {
+    return (op == AggregateOp::kCount) ? acc + ValueType(1)
+                                       : Combine(op, acc, value);
+  }
+
+  // combine two partial aggregates
+  static ValueType Combine(AggregateOp op, ValueType a, ValueType b) {
+    return (op == AggregateOp::kMin)   ? ((b < a) ? b : a)
+           : (op == AggregateOp::kMax) ? ((b > a) ? b : a)
+                                       : a + b;
+  }
+
+  fpga_tools::OnchipMemoryWithCache<Entry, num_buckets, cache_depth> table_;
+};
+
+//
+// Write a group evicted from a GroupBy to the spill buffer. The groups past
+// 'capacity' are counted but dropped, so the host can detect that the spill
+// buffer was too small.
+//
+template <typename Spill, typename Entry>
+void GroupBySpill(Spill spill, size_t capacity, size_t& count,
+                  const Entry& entry) {
+  if (count < capacity) {
+    spill[count] = entry;
+  }
+  count++;
+}
+
+#endif /* __GROUPBY_HPP__ */
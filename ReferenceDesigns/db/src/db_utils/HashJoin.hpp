@@ -0,0 +1,337 @@
+#ifndef __HASHJOIN_HPP__
+#define __HASHJOIN_HPP__
+#pragma once
+
+#include <stddef.h>
+#include <type_traits>
+#include <vector>
+
+#include "Misc.hpp"
+#include "StreamingData.hpp"
+#include "Tuple.hpp"
+#include "Unroller.hpp"
+
+#include "onchip_memory_with_cache.hpp" // From the include directory
+
+//
+// A bucket of the HashTable, holding up to 'bucket_size' {key, value} pairs
+//
+template <typename MapType, int bucket_size>
+struct HashBucket {
+  HashBucket() : count(0), overflow(false) {}
+
+  unsigned int keys[bucket_size];
+  MapType values[bucket_size];
+
+  // the number of pairs in the bucket
+  unsigned char count;
+
+  // whether a key that hashes to this bucket did not fit in it
+  bool overflow;
+};
+
+//
+// A hash table in on-chip memory with 'num_buckets' buckets of 'bucket_size'
+// {key, value} pairs each. Unlike the map of MapJoin, its size does not
+// depend on the range of the keys. A key is hashed to a single bucket, and
+// all of the pairs of a bucket are compared in parallel. The buckets are kept
+// in an OnchipMemoryWithCache, so that back-to-back inserts into the same
+// bucket are forwarded from the cache and the inserts run at II=1.
+//
+template <typename MapType, int num_buckets, int bucket_size,
+          int cache_depth = 4>
+class HashTable {
+  // static asserts
+  static_assert(num_buckets > 0 && Pow2(Log2(num_buckets)) == num_buckets,
+    "The number of buckets must be a power of 2");
+  static_assert(bucket_size > 0 && bucket_size < 256,
+    "The bucket size must be in the range [1,255]");
+
+  static constexpr int kBucketBits = Log2(num_buckets);
+
+ public:
+  using ValueType = MapType;
+  using Bucket = HashBucket<MapType, bucket_size>;
+
+  // the maximum number of pairs in the table
+  static constexpr int kNumBuckets = num_buckets;
+  static constexpr int kBucketSize = bucket_size;
+  static constexpr int kCapacity = num_buckets * bucket_size;
+
+  // the bucket of a key (multiplicative hashing)
+  static unsigned int Hash(unsigned int key) {
+    if constexpr (kBucketBits == 0) {
+      return 0;
+    } else {
+      return (key * 2654435769u) >> (32 - kBucketBits);
+    }
+  }
+
+  // empty all buckets
+  void Clear() { buckets_.init(Bucket()); }
+
+  // insert a {key, value} pair, returns false if the bucket of the key is
+  // full (in which case the bucket is marked as overflowed)
+  bool Insert(unsigned int key, const MapType& value) {
+    const unsigned int b = Hash(key);
+    Bucket bucket = buckets_.read(b);
+    const bool fits = bucket.count < bucket_size;
+
+    #pragma unroll
+    for (int i = 0; i < bucket_size; i++) {
+      if (fits && i == bucket.count) {
+        bucket.keys[i] = key;
+        bucket.values[i] = value;
+      }
+    }
+
+    if (fits) {
+      bucket.count++;
+    } else {
+      bucket.overflow = true;
+    }
+    buckets_.write(b, bucket);
+
+    return fits;
+  }
+
+  // find the value of a key, returns false if the key is not in the table.
+  // 'overflow' is set if the key may be one that did not fit in the table
+  bool Find(unsigned int key, MapType& value, bool& overflow) {
+    const Bucket bucket = buckets_.read(Hash(key));
+    bool found = false;
+
+    #pragma unroll
+    for (int i = 0; i < bucket_size; i++) {
+      if (i < bucket.count && bucket.keys[i] == key) {
+        value = bucket.values[i];
+        found = true;
+      }
+    }
+
+    overflow = bucket.overflow;
+    return found;
+  }
+
+ private:
+  fpga_tools::OnchipMemoryWithCache<Bucket, num_buckets, cache_depth>
+      buckets_;
+};
+
+//
+// Insert a row of table 1 (the build table) into the hash table of a HashJoin.
+// A row whose bucket is full is written to the build spill arrays, which must
+// have room for every spilled row (see HashJoinSpillCounter), and 'spilled' is
+// incremented.
+//
+template <typename TableType, typename MapType, typename SpillKeys,
+          typename SpillValues>
+void HashJoinBuild(TableType& table, unsigned int key, const MapType& value,
+                   SpillKeys spill_keys, SpillValues spill_values,
+                   size_t& spilled) {
+  if (!table.Insert(key, value)) {
+    spill_keys[spilled] = key;
+    spill_values[spilled] = value;
+    spilled++;
+  }
+}
+
+//
+// HashJoin implementation
+//
+// Joins the rows of table 2, streamed through T2Pipe, with the rows of table 1
+// that were inserted into 'table' (see HashJoinBuild). Like MapJoin, the keys
+// of table 1 must be unique, and each output window holds the joined rows of
+// one input window.
+//
+// The join is done in two passes, as in a grace hash join:
+//  1) The rows of table 2 are streamed through the join. A row whose key is
+//     in the table is joined, and a row whose bucket overflowed while the
+//     table was built is written to 'probe_spill' (a window at a time) to be
+//     joined in the second pass. 'probe_spill' must have room for every
+//     spilled window (see HashJoinSpillCounter).
+//  2) The 'build_spilled' rows of table 1 that did not fit in the table are
+//     loaded into the table, as many as fit at a time. For each of these
+//     chunks, the spilled rows of table 2 are read back from device memory
+//     and joined with the table.
+// The rows joined in the second pass are written to JoinPipe after those of
+// the first pass, so the output is only in the order of table 2 if nothing
+// spilled. Size the table for table 1 when the order matters.
+//
+template <typename T2Pipe, typename T2Data, int t2_win_size, typename JoinPipe,
+          typename JoinType, typename TableType, typename SpillKeys,
+          typename SpillValues, typename ProbeSpill>
+void HashJoin(TableType& table, SpillKeys build_spill_keys,
+              SpillValues build_spill_values, size_t build_spilled,
+              ProbeSpill probe_spill) {
+  //////////////////////////////////////////////////////////////////////////////
+  // static asserts
+  static_assert(t2_win_size > 0,
+    "Table 2 window size must be positive and non-zero");
+  static_assert(
+      std::is_same<unsigned int, decltype(T2Data().PrimaryKey())>::value,
+      "T2Data must have 'PrimaryKey()' function that returns an 'unsigned "
+      "int'");
+  static_assert(std::is_same<bool, decltype(T2Data().valid)>::value,
+    "T2Data must have a 'valid' boolean member");
+  static_assert(std::is_same<bool, decltype(JoinType().valid)>::value,
+    "JoinType must have a 'valid' boolean member");
+  //////////////////////////////////////////////////////////////////////////////
+
+  using MapType = typename TableType::ValueType;
+  using T2Window = StreamingData<T2Data, t2_win_size>;
+  using JoinWindow = StreamingData<JoinType, t2_win_size>;
+
+  ///////////////////////////////////////////////
+  //// Pass 1
+  // join the rows of table 2 with the table, and spill the rows that may
+  // match a row of table 1 that did not fit in the table
+  size_t probe_spilled = 0;
+  bool done = false;
+
+  [[intel::initiation_interval(1)]]
+  while (!done) {
+    // read from the input pipe
+    bool valid_pipe_read;
+    T2Window in_data = T2Pipe::read(valid_pipe_read);
+
+    // check if the producer is done
+    done = in_data.done && valid_pipe_read;
+
+    if (!done && valid_pipe_read) {
+      // join the input data windows into output data
+      JoinWindow join_data(false, true);
+      T2Window spill_data(false, true);
+      bool spill_window = false;
+
+      UnrolledLoop<0, t2_win_size>([&](auto j) {
+        const T2Data& t2_row = in_data.data.template get<j>();
+
+        MapType value;
+        bool overflow;
+        const bool found = table.Find(t2_row.PrimaryKey(), value, overflow);
+
+        // NOTE: order below important if Join() overrides valid
+        join_data.data.template get<j>().valid = t2_row.valid && found;
+        if (t2_row.valid && found) {
+          join_data.data.template get<j>().Join(value, t2_row);
+        }
+
+        // keep the rows that have to be joined in the second pass
+        spill_data.data.template get<j>() = t2_row;
+        spill_data.data.template get<j>().valid =
+            t2_row.valid && !found && overflow;
+        spill_window |= t2_row.valid && !found && overflow;
+      });
+
+      if (spill_window) {
+        probe_spill[probe_spilled++] = spill_data;
+      }
+
+      // write out joined data
+      JoinPipe::write(join_data);
+    }
+  }
+  ///////////////////////////////////////////////
+
+  ///////////////////////////////////////////////
+  //// Pass 2
+  // join the spilled rows of table 2 with the spilled rows of table 1, in
+  // chunks of table 1 rows that fit in the table
+  size_t build_next = 0;
+
+  while (build_next < build_spilled && probe_spilled > 0) {
+    // load the next chunk of table 1 rows, until a bucket is full. An empty
+    // table always fits at least one row, so every chunk makes progress
+    table.Clear();
+    bool full = false;
+
+    [[intel::initiation_interval(1)]]
+    while (build_next < build_spilled && !full) {
+      if (table.Insert(build_spill_keys[build_next],
+                       build_spill_values[build_next])) {
+        build_next++;
+      } else {
+        full = true;
+      }
+    }
+
+    // join the spilled rows of table 2 with the chunk
+    [[intel::initiation_interval(1)]]
+    for (size_t i = 0; i < probe_spilled; i++) {
+      T2Window in_data = probe_spill[i];
+      JoinWindow join_data(false, true);
+
+      UnrolledLoop<0, t2_win_size>([&](auto j) {
+        const T2Data& t2_row = in_data.data.template get<j>();
+
+        MapType value;
+        bool overflow;
+        const bool found = table.Find(t2_row.PrimaryKey(), value, overflow);
+
+        join_data.data.template get<j>().valid = t2_row.valid && found;
+        if (t2_row.valid && found) {
+          join_data.data.template get<j>().Join(value, t2_row);
+        }
+      });
+
+      JoinPipe::write(join_data);
+    }
+  }
+  ///////////////////////////////////////////////
+}
+
+//
+// Replays HashJoinBuild on the host to count the rows a HashJoin spills, so
+// that its spill buffers are sized for the actual tables rather than for
+// every row of both tables. Call Build with the keys of table 1, in the order
+// they are inserted, then Spills with the keys of table 2.
+//
+template <typename TableType>
+class HashJoinSpillCounter {
+  static constexpr int kNumBuckets = TableType::kNumBuckets;
+  static constexpr int kBucketSize = TableType::kBucketSize;
+
+ public:
+  HashJoinSpillCounter()
+      : keys_(kNumBuckets * kBucketSize),
+        counts_(kNumBuckets, 0),
+        overflow_(kNumBuckets, false) {}
+
+  // insert the key of a row of table 1, as HashJoinBuild does
+  void Build(unsigned int key) {
+    const unsigned int b = TableType::Hash(key);
+    if (counts_[b] < kBucketSize) {
+      keys_[b * kBucketSize + counts_[b]++] = key;
+    } else {
+      overflow_[b] = true;
+      build_spilled_++;
+    }
+  }
+
+  // the number of rows of table 1 that did not fit in the table
+  size_t BuildSpilled() const { return build_spilled_; }
+
+  // whether the first pass of HashJoin spills a (valid) row of table 2 with
+  // this key, i.e. whether its bucket overflowed and does not hold the key
+  bool Spills(unsigned int key) const {
+    const unsigned int b = TableType::Hash(key);
+    if (!overflow_[b]) {
+      return false;
+    }
+    for (int i = 0; i < counts_[b]; i++) {
+      if (keys_[b * kBucketSize + i] == key) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+ private:
+  std::vector<unsigned int> keys_;
+  std::vector<int> counts_;
+  std::vector<bool> overflow_;
+  size_t build_spilled_ = 0;
+};
+
+#endif /* __HASHJOIN_HPP__ */
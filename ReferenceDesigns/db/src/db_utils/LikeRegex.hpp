@@ -3,10 +3,66 @@
 #pragma once
 
 #include <array>
+#include <string>
 #include <type_traits>
 
 //
-// Regex LIKE engine that can match: *WORD*, *WORD and WORD*
+// The forms of LIKE pattern the LikeRegex engine matches
+//
+enum class LikeMode : unsigned char {
+  kContains,    // %WORD%
+  kStartsWith,  // WORD%
+  kEndsWith,    // %WORD
+  kExact,       // WORD
+  kAll          // %, which matches every string
+};
+
+//
+// A LIKE pattern that the host prepares and a kernel takes as an argument,
+// so that both the word and the form of the pattern can change without
+// rebuilding the kernel. The word is padded with '\0', and has at most
+// max_word_length - 1 characters.
+//
+template <unsigned int max_word_length>
+struct LikePattern {
+  // parse a pattern of the form %WORD%, WORD%, %WORD or WORD, or a pattern of
+  // only wildcards (% or %%), which matches every string. Returns false if the
+  // pattern is empty, or if the word is too long or has wildcards in it.
+  bool Parse(const std::string& pattern) {
+    std::string w = pattern;
+    bool leading = !w.empty() && w.front() == '%';
+    if (leading) w.erase(0, 1);
+    bool trailing = !w.empty() && w.back() == '%';
+    if (trailing) w.pop_back();
+
+    if (w.size() >= max_word_length || w.find('%') != std::string::npos) {
+      return false;
+    }
+
+    if (w.empty()) {
+      if (!leading) return false;
+      mode = LikeMode::kAll;
+    } else if (leading && trailing) {
+      mode = LikeMode::kContains;
+    } else if (!leading && !trailing) {
+      mode = LikeMode::kExact;
+    } else {
+      mode = leading ? LikeMode::kEndsWith : LikeMode::kStartsWith;
+    }
+
+    for (unsigned int i = 0; i < max_word_length; i++) {
+      word[i] = (i < w.size()) ? w[i] : '\0';
+    }
+
+    return true;
+  }
+
+  char word[max_word_length] = {};
+  LikeMode mode = LikeMode::kContains;
+};
+
+//
+// Regex LIKE engine that can match: *WORD*, *WORD, WORD* and WORD
 // where the string has max_str_length words or length at most max_word_length.
 // If words are shorter than max_word_length, they are padded with '\0'.
 //
@@ -31,6 +87,8 @@ class LikeRegex {
     // determine if there is a match
     match_start_idx = max_str_length;
     match_end = max_str_length;
+    match_at_start = false;
+    match_at_end = false;
 
     #pragma unroll
     for (unsigned int i = 0; i < max_str_length; i++) {
@@ -50,6 +108,8 @@ class LikeRegex {
           ((i + word_true_len) <= str_true_len)) {
         match_start_idx = i;
         match_end = i + word_true_len;
+        match_at_start |= (i == 0);
+        match_at_end |= (match_end == str_true_len);
       }
     }
   }
@@ -89,18 +149,33 @@ class LikeRegex {
 
   // does the string start with the word (i.e. matches WORD%)
   bool AtStart() {
-    return match_start_idx == 0;
+    return match_at_start;
   }
 
   // does the string end with the word (i.e. matches %WORD)
   bool AtEnd() {
-    return match_end == str_true_len;
+    return match_at_end;
+  }
+
+  // is the string the word (i.e. matches WORD)
+  bool Exact() {
+    return match_at_start && (word_true_len == str_true_len);
+  }
+
+  // does the string match the pattern of the given form
+  bool Matches(LikeMode mode) {
+    return (mode == LikeMode::kStartsWith) ? AtStart()
+           : (mode == LikeMode::kEndsWith) ? AtEnd()
+           : (mode == LikeMode::kExact)    ? Exact()
+           : (mode == LikeMode::kAll)      ? true
+                                           : Contains();
   }
 
   char word[max_word_length];
   char str[max_str_length];
 
   unsigned int match_start_idx, match_end;
+  bool match_at_start, match_at_end;
   unsigned int word_true_len, str_true_len;
 };
 
@@ -76,9 +76,16 @@ void MergeJoin() {
   [[intel::initiation_interval(1)]]
   while (keep_going) {
     //////////////////////////////////////////////////////
+    // decide which windows to update from the state at the start of this
+    // iteration, so that a table 2 window read before the first table 1
+    // window is not dropped when table 1 becomes valid
+    bool update_t1 = !t1_initialized || !t1_win_valid ||
+                     (move_t1_win && t2_win_valid) || (done_comp && !t1_done);
+    bool update_t2 = !t2_initialized || !t2_win_valid ||
+                     (!move_t1_win && t1_win_valid) || (done_comp && !t2_done);
+
     // update T1 window
-    if (!t1_initialized || !t1_win_valid || (move_t1_win && t2_win_valid) ||
-        (done_comp && !t1_done)) {
+    if (update_t1) {
       t1_win = T1Pipe::read(t1_win_valid);
 
       if (t1_win_valid) {
@@ -87,8 +94,7 @@ void MergeJoin() {
       }
     }
     // update T2 window
-    if (!t2_initialized || !t2_win_valid || (!move_t1_win && t1_win_valid) ||
-        (done_comp && !t2_done)) {
+    if (update_t2) {
       t2_win = T2Pipe::read(t2_win_valid);
       
       if (t2_win_valid) {
@@ -213,9 +219,16 @@ void DuplicateMergeJoin() {
   [[intel::initiation_interval(1)]]
   while (keep_going) {
     //////////////////////////////////////////////////////
+    // decide which windows to update from the state at the start of this
+    // iteration, so that a table 2 window read before the first table 1
+    // window is not dropped when table 1 becomes valid
+    bool update_t1 = !t1_initialized || !t1_win_valid ||
+                     (move_t1_win && t2_win_valid) || (done_comp && !t1_done);
+    bool update_t2 = !t2_initialized || !t2_win_valid ||
+                     (!move_t1_win && t1_win_valid) || (done_comp && !t2_done);
+
     // update T1 window
-    if (!t1_initialized || !t1_win_valid || (move_t1_win && t2_win_valid) ||
-        (done_comp && !t1_done)) {
+    if (update_t1) {
       t1_win = T1Pipe::read(t1_win_valid);
 
       if (t1_win_valid) {
@@ -224,8 +237,7 @@ void DuplicateMergeJoin() {
       }
     }
     // update T2 window
-    if (!t2_initialized || !t2_win_valid || (!move_t1_win && t1_win_valid) ||
-        (done_comp && !t2_done)) {
+    if (update_t2) {
       t2_win = T2Pipe::read(t2_win_valid);
       
       if (t2_win_valid) {
@@ -0,0 +1,130 @@
+#ifndef __PREDICATE_HPP__
+#define __PREDICATE_HPP__
+#pragma once
+
+#include <array>
+#include <vector>
+
+//
+// The operations of a predicate program
+//
+enum class PredicateOp : unsigned char {
+  kTrue,      // an unused instruction, always true
+  kInRange,   // lo <= column < hi
+  kInSet,     // the bit 'column' of 'set' is 1 (for column values in [0,32))
+  kLessThan   // column < other column
+};
+
+//
+// A single predicate on the columns of a row
+//
+struct PredicateInstr {
+  PredicateOp op = PredicateOp::kTrue;
+  unsigned char column = 0;
+  unsigned char other = 0;
+  unsigned int lo = 0;
+  unsigned int hi = 0;
+  unsigned int set = 0;
+};
+
+//
+// A conjunction of at most 'max_instrs' predicates on the 'num_columns'
+// columns of a row. The host builds the program and passes it to a kernel as
+// an argument. The kernel evaluates every instruction of the program in
+// parallel (II=1), so the predicates and their constants can change from one
+// run of a query to the next without rebuilding the kernel. Only the columns
+// and the maximum number of predicates are fixed at compile time.
+//
+template <unsigned int num_columns, unsigned int max_instrs>
+class PredicateProgram {
+  // static asserts
+  static_assert(num_columns > 0,
+    "The program must read at least one column");
+  static_assert(num_columns <= 256,
+    "The program can read at most 256 columns");
+  static_assert(max_instrs > 0,
+    "The program must have at least one instruction");
+
+ public:
+  using Row = std::array<unsigned int, num_columns>;
+
+  // the functions to build the program on the host, they return false if
+  // the program is full or the arguments are out of range
+  // lo <= column < hi
+  bool AddInRange(unsigned int column, unsigned int lo, unsigned int hi) {
+    PredicateInstr instr;
+    instr.op = PredicateOp::kInRange;
+    instr.column = column;
+    instr.lo = lo;
+    instr.hi = hi;
+    return column < num_columns && lo < hi && Add(instr);
+  }
+
+  // column == value
+  bool AddEquals(unsigned int column, unsigned int value) {
+    return value + 1 != 0 && AddInRange(column, value, value + 1);
+  }
+
+  // column IN (values...), for values in [0,32)
+  bool AddInSet(unsigned int column, const std::vector<unsigned int>& values) {
+    PredicateInstr instr;
+    instr.op = PredicateOp::kInSet;
+    instr.column = column;
+    for (auto v : values) {
+      if (v >= 32) {
+        return false;
+      }
+      instr.set |= (1u << v);
+    }
+    return column < num_columns && Add(instr);
+  }
+
+  // column < other
+  bool AddLessThan(unsigned int column, unsigned int other) {
+    PredicateInstr instr;
+    instr.op = PredicateOp::kLessThan;
+    instr.column = column;
+    instr.other = other;
+    return column < num_columns && other < num_columns && Add(instr);
+  }
+
+  // evaluate the program on a row
+  bool Evaluate(const Row& row) const {
+    bool result = true;
+
+    #pragma unroll
+    for (unsigned int i = 0; i < max_instrs; i++) {
+      const PredicateInstr& instr = instrs[i];
+      const unsigned int value = row[instr.column];
+      const unsigned int other = row[instr.other];
+
+      const bool in_range = (instr.lo <= value) && (value < instr.hi);
+      const bool in_set = (value < 32) && ((instr.set >> value) & 1);
+      const bool less_than = (value < other);
+
+      const bool pass = (instr.op == PredicateOp::kTrue) ||
+                        (instr.op == PredicateOp::kInRange && in_range) ||
+                        (instr.op == PredicateOp::kInSet && in_set) ||
+                        (instr.op == PredicateOp::kLessThan && less_than);
+      result &= pass;
+    }
+
+    return result;
+  }
+
+  // the number of instructions in use
+  unsigned int size = 0;
+
+  PredicateInstr instrs[max_instrs];
+
+ private:
+  bool Add(const PredicateInstr& instr) {
+    if (size == max_instrs) {
+      return false;
+    }
+    instrs[size++] = instr;
+    return true;
+  }
+};
+
+#endif /* __PREDICATE_HPP__ */
@@ -0,0 +1,269 @@
+#ifndef __RADIXSORT_HPP__
+#define __RADIXSORT_HPP__
+#pragma once
+
+#include <stddef.h>
+#include <type_traits>
+
+#include "Misc.hpp"
+#include "fifo_sort.hpp"
+
+#include "onchip_memory_with_cache.hpp" // From the include directory
+
+//
+// A run of the RadixSort, sent by RadixSortFeed to the sorter and to
+// RadixSortConsume ahead of its rows. The 'count' rows of a sorted run go
+// through the sorter, followed by 'sort_size - count' padding rows. The rows
+// of a run that is not sorted all have the same key, so they skip the sorter.
+//
+struct RadixSortRun {
+  RadixSortRun() : done(true), sort(false), count(0) {}
+  RadixSortRun(bool v_sort, size_t v_count)
+      : done(false), sort(v_sort), count(v_count) {}
+
+  bool done;
+  bool sort;
+  size_t count;
+};
+
+//
+// The number of bits of the keys of a RadixSort whose largest key is 'max_key'
+//
+inline unsigned int RadixSortKeyBits(unsigned int max_key) {
+  return (max_key == 0) ? 1 : Log2(max_key) + 1;
+}
+
+//
+// RadixSort implementation
+//
+// Sorts any number of rows with the fixed size merge sorter of fifo_sort.hpp
+// (ihc::sort), which sorts 'sort_size' rows at a time. The rows are first
+// written to device memory ('data'), then:
+//  - If they fit in the sorter, they are sorted in a single run.
+//  - Otherwise, they are partitioned into 2^radix_bits buckets by the highest
+//    'radix_bits' bits of their keys (a histogram of the keys is built, and
+//    each row is written to the range of its bucket in 'scratch'). The
+//    buckets are visited in the order of their keys. Consecutive buckets are
+//    sorted together in a run, as long as they fit in the sorter, and a
+//    bucket that does not fit is partitioned again by the next 'radix_bits'
+//    bits of the keys, and so on. The levels of partitioning alternate
+//    between 'data' and 'scratch'. A bucket of a single key is already
+//    sorted, and skips the sorter.
+// The runs come out of the sorter in the order of their keys, so the rows are
+// sorted in ascending order of their keys, regardless of their number and
+// the distribution of their keys. Padding is only needed to fill the last
+// rows of a run.
+//
+// The sort is made of three kernels:
+//  - RadixSortFeed partitions the rows and feeds the runs to the sorter, or
+//    their rows to BypassPipe when they skip the sorter.
+//  - RadixSortSorter runs the sorter once for every sorted run.
+//  - RadixSortConsume forwards the rows of each run, in order, to a function.
+// RadixSortFeed sends each run to the other two kernels through SorterRunPipe
+// and ConsumeRunPipe.
+//
+// SortType must have an 'unsigned int PrimaryKey() const' function, which is
+// the key of the sort, and 'pad' must compare greater than every row.
+//
+template <typename SortType, int sort_size, int radix_bits, class SortInPipe,
+          class BypassPipe, class SorterRunPipe, class ConsumeRunPipe,
+          typename DataAccessor, typename ScratchAccessor>
+void RadixSortFeed(DataAccessor data, ScratchAccessor scratch, size_t rows,
+                   unsigned int key_bits, const SortType& pad) {
+  //////////////////////////////////////////////////////////////////////////////
+  // static asserts
+  static_assert(sort_size > 0, "The sort size must be positive and non-zero");
+  static_assert(radix_bits > 0 && radix_bits <= 16,
+    "The radix must be in the range [1,16] bits");
+  static_assert(
+      std::is_same<unsigned int, decltype(SortType().PrimaryKey())>::value,
+      "SortType must have 'PrimaryKey()' function that returns an 'unsigned "
+      "int'");
+  //////////////////////////////////////////////////////////////////////////////
+
+  constexpr int kBuckets = Pow2(radix_bits);
+  constexpr int kMaxLevels = (32 + radix_bits - 1) / radix_bits;
+  constexpr int kCacheDepth = 8;
+
+  // the row 'i' of the level 'level'. The rows of the first level are in
+  // 'data', and each level is partitioned into the other buffer
+  auto read_row = [&](int level, size_t i) {
+    return (level % 2 == 0) ? SortType(data[i]) : SortType(scratch[i]);
+  };
+
+  // send the rows [begin, end) of the buffer of 'level' to the sorter, or to
+  // the bypass pipe if they skip the sorter
+  auto send_run = [&](int level, size_t begin, size_t end, bool sort) {
+    const size_t count = end - begin;
+    ConsumeRunPipe::write(RadixSortRun(sort, count));
+
+    if (sort) {
+      SorterRunPipe::write(RadixSortRun(true, count));
+
+      [[intel::initiation_interval(1)]]
+      for (size_t i = 0; i < sort_size; i++) {
+        SortInPipe::write((i < count) ? read_row(level, begin + i) : pad);
+      }
+    } else {
+      [[intel::initiation_interval(1)]]
+      for (size_t i = begin; i < end; i++) {
+        BypassPipe::write(read_row(level, i));
+      }
+    }
+  };
+
+  if (rows <= sort_size) {
+    // the rows fit in the sorter
+    if (rows > 0) {
+      send_run(0, 0, rows, true);
+    }
+  } else {
+    // the bucket boundaries of each level, and the next bucket to visit
+    size_t offsets[kMaxLevels][kBuckets + 1];
+    int next_bucket[kMaxLevels];
+    unsigned int shift[kMaxLevels];
+
+    fpga_tools::OnchipMemoryWithCache<size_t, kBuckets, kCacheDepth> counts;
+
+    // partition the rows [begin, end) of 'level' by the bits [s, s+radix_bits)
+    // of their keys into the buffer of 'level + 1'
+    auto partition = [&](int level, size_t begin, size_t end, unsigned int s) {
+      // build the histogram of the keys
+      counts.init(0);
+      [[intel::initiation_interval(1)]]
+      for (size_t i = begin; i < end; i++) {
+        const unsigned int b =
+            (read_row(level, i).PrimaryKey() >> s) & (kBuckets - 1);
+        counts.write(b, counts.read(b) + 1);
+      }
+
+      // the first row of each bucket
+      size_t offset = begin;
+      for (int b = 0; b < kBuckets; b++) {
+        offsets[level][b] = offset;
+        const size_t count = counts.read(b);
+        counts.write(b, offset);
+        offset += count;
+      }
+      offsets[level][kBuckets] = end;
+      next_bucket[level] = 0;
+      shift[level] = s;
+
+      // scatter the rows to their buckets
+      [[intel::initiation_interval(1)]]
+      for (size_t i = begin; i < end; i++) {
+        const SortType row = read_row(level, i);
+        const unsigned int b = (row.PrimaryKey() >> s) & (kBuckets - 1);
+        const size_t pos = counts.read(b);
+        counts.write(b, pos + 1);
+        if (level % 2 == 0) {
+          scratch[pos] = row;
+        } else {
+          data[pos] = row;
+        }
+      }
+    };
+
+    // the highest bits of the keys first
+    partition(0, 0, rows, (key_bits > radix_bits) ? key_bits - radix_bits : 0);
+    int level = 0;
+
+    // the consecutive buckets of the current level that are sorted together
+    size_t run_begin = 0;
+    size_t run_end = 0;
+
+    while (level >= 0) {
+      if (next_bucket[level] == kBuckets) {
+        // the level is done, sort its last run and go back to the previous
+        if (run_end > run_begin) {
+          send_run(level + 1, run_begin, run_end, true);
+        }
+        run_begin = run_end;
+        level--;
+      } else {
+        const int b = next_bucket[level]++;
+        const size_t begin = offsets[level][b];
+        const size_t end = offsets[level][b + 1];
+
+        if (end - begin <= sort_size) {
+          // sort the bucket with the previous ones, if they all fit
+          if (end - run_begin > sort_size) {
+            send_run(level + 1, run_begin, run_end, true);
+            run_begin = begin;
+          }
+          run_end = end;
+        } else {
+          // sort the previous buckets before this one
+          if (run_end > run_begin) {
+            send_run(level + 1, run_begin, run_end, true);
+          }
+
+          if (shift[level] == 0) {
+            // all rows of the bucket have the same key
+            send_run(level + 1, begin, end, false);
+            run_begin = end;
+            run_end = end;
+          } else {
+            // partition the bucket by the next bits of the keys
+            const unsigned int s = shift[level];
+            partition(level + 1, begin, end,
+                      (s > radix_bits) ? s - radix_bits : 0);
+            run_begin = begin;
+            run_end = begin;
+            level++;
+          }
+        }
+      }
+    }
+  }
+
+  // tell the other kernels that the sort is done
+  SorterRunPipe::write(RadixSortRun());
+  ConsumeRunPipe::write(RadixSortRun());
+}
+
+//
+// Run the sorter of a RadixSort once for every sorted run (see RadixSortFeed)
+//
+template <typename SortType, int sort_size, class SortInPipe, class SortOutPipe,
+          class SorterRunPipe, class Compare>
+void RadixSortSorter(Compare compare) {
+  bool done = false;
+  while (!done) {
+    done = SorterRunPipe::read().done;
+    if (!done) {
+      ihc::sort<SortType, sort_size, SortInPipe, SortOutPipe>(compare);
+    }
+  }
+}
+
+//
+// Call 'func' for every row of a RadixSort, in sorted order, and drop the
+// padding rows of the runs (see RadixSortFeed)
+//
+template <typename SortType, int sort_size, class SortOutPipe,
+          class BypassPipe, class ConsumeRunPipe, typename Func>
+void RadixSortConsume(Func&& func) {
+  bool done = false;
+  while (!done) {
+    const RadixSortRun run = ConsumeRunPipe::read();
+    done = run.done;
+
+    if (!done && run.sort) {
+      [[intel::initiation_interval(1)]]
+      for (size_t i = 0; i < sort_size; i++) {
+        const SortType row = SortOutPipe::read();
+        if (i < run.count) {
+          func(row);
+        }
+      }
+    } else if (!done) {
+      [[intel::initiation_interval(1)]]
+      for (size_t i = 0; i < run.count; i++) {
+        func(BypassPipe::read());
+      }
+    }
+  }
+}
+
+#endif /* __RADIXSORT_HPP__ */
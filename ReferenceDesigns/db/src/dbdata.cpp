@@ -1,17 +1,22 @@
 #include <assert.h>
 #include <algorithm>
 #include <cctype>
+#include <chrono>
 #include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <iomanip>
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <string>
 #include <stdio.h>
+#include <thread>
 #include <vector>
 
 #include "dbdata.hpp"
 #include "db_utils/Date.hpp"
+#include "mapped_file.hpp"
 
 // choose a file separator based on the platform (Windows or Linux)
 #if defined(WIN32) || defined(_WIN32) || defined(_MSC_VER)
@@ -48,47 +53,29 @@ void AppendStringToCharVec(std::vector<char>& v, const std::string& str,
 }
 
 //
-// convert a money string (i.e. '1209.12' dollars) to
-// the internal 'cents' representation (i.e. '120912' cents)
+// convert a SHIPMODE string of 'len' characters to the internal
+// representation (integer)
 //
-DBDecimal MoneyFloatToCents(const std::string& money_float_str) {
-  // parse money string
-  std::istringstream ss(money_float_str);
-  std::string dollars_str, cents_str;
-
-  std::getline(ss, dollars_str, '.');
-  std::getline(ss, cents_str, '.');
-  
-  DBDecimal dollars = atoi(dollars_str.c_str());
-  DBDecimal cents = atoi(cents_str.c_str());
+int ShipmodeStrToInt(const char* shipmode_str, size_t len) {
+  static const char* kShipmodes[] = {"REG AIR", "AIR",  "RAIL", "SHIP",
+                                     "TRUCK",   "MAIL", "FOB"};
+  for (int i = 0; i < 7; i++) {
+    if (strlen(kShipmodes[i]) == len &&
+        strncmp(kShipmodes[i], shipmode_str, len) == 0) {
+      return i;
+    }
+  }
 
-  // convert to fixed point format (i.e. in cents)
-  return dollars * 100 + cents;
+  std::cerr << "WARNING: Found unknown SHIPMODE '"
+            << std::string(shipmode_str, len) << " defaulting to REG AIR\n";
+  return 0;
 }
 
 //
 // convert a SHIPMODE string to the internal representation (integer)
 //
 int ShipmodeStrToInt(std::string& shipmode_str) {
-  if (shipmode_str == "REG AIR") {
-    return 0;
-  } else if (shipmode_str == "AIR") {
-    return 1;
-  } else if (shipmode_str == "RAIL") {
-    return 2;
-  } else if (shipmode_str == "SHIP") {
-    return 3;
-  } else if (shipmode_str == "TRUCK") {
-    return 4;
-  } else if (shipmode_str == "MAIL") {
-    return 5;
-  } else if (shipmode_str == "FOB") {
-    return 6;
-  } else {
-    std::cerr << "WARNING: Found unknown SHIPMODE '" << shipmode_str
-              << " defaulting to REG AIR\n";
-    return 0;
-  }
+  return ShipmodeStrToInt(shipmode_str.c_str(), shipmode_str.size());
 }
 
 //
@@ -125,89 +112,440 @@ void trim(std::string& s) {
 }
 
 //
-// the main parsing function
-// parses '*.tbl' files location in directory 'db_root_dir'
+// A cursor over the '|' separated fields of one row of a '.tbl' file. The
+// fields are converted in place, without allocating any memory.
 //
-bool Database::Parse(std::string db_root_dir) {
-  std::cout << "Parsing database files in: " << db_root_dir << std::endl;
+class TblRowReader {
+ public:
+  TblRowReader(const char* begin, const char* end) : pos_(begin), end_(end) {}
+
+  // whether every field that was read was in the row
+  bool Valid() const { return valid_; }
+
+  // an integer field. Anything after the integer is ignored, so '25.0' is 25.
+  long long Int() {
+    const char *b, *e;
+    NextField(b, e);
+    bool negative = (b < e && *b == '-');
+    if (negative) b++;
+    long long val = 0;
+    for (; b < e && *b >= '0' && *b <= '9'; b++) {
+      val = val * 10 + (*b - '0');
+    }
+    return negative ? -val : val;
+  }
 
-  bool success = true;
+  // a money field (i.e. '1209.12' dollars) in cents (i.e. 120912 cents)
+  DBDecimal Money() {
+    const char *b, *e;
+    NextField(b, e);
+    bool negative = (b < e && *b == '-');
+    if (negative) b++;
+    DBDecimal dollars = 0, cents = 0;
+    for (; b < e && *b >= '0' && *b <= '9'; b++) {
+      dollars = dollars * 10 + (*b - '0');
+    }
+    if (b < e && *b == '.') b++;
+    for (int i = 0; i < 2; i++, b++) {
+      cents = cents * 10 + ((b < e && *b >= '0' && *b <= '9') ? *b - '0' : 0);
+    }
+    DBDecimal val = dollars * 100 + cents;
+    return negative ? -val : val;
+  }
 
-  // parse each table
-  success &= ParseLineItemTable(db_root_dir + kSeparator + "lineitem.tbl", l);
-  success &= ParseOrdersTable(db_root_dir + kSeparator +"orders.tbl", o);
-  success &= ParsePartsTable(db_root_dir + kSeparator + "part.tbl", p);
-  success &= ParseSupplierTable(db_root_dir + kSeparator + "supplier.tbl", s);
-  success &= ParsePartSupplierTable(db_root_dir + kSeparator + "partsupp.tbl", ps);
-  success &= ParseNationTable(db_root_dir + kSeparator + "nation.tbl", n);
+  // a date field (i.e. '1995-03-15') in the compact format (see Date.hpp)
+  DBDate CompactDate() {
+    const char *b, *e;
+    NextField(b, e);
+    int parts[3] = {0, 0, 0};
+    for (int i = 0; i < 3; i++) {
+      for (; b < e && *b >= '0' && *b <= '9'; b++) {
+        parts[i] = parts[i] * 10 + (*b - '0');
+      }
+      if (b < e && *b == '-') b++;
+    }
+    return Date(parts[0], parts[1], parts[2]).ToCompact();
+  }
 
-  return success;
+  // the first character of a field
+  char Char() {
+    const char *b, *e;
+    NextField(b, e);
+    return (b < e) ? *b : '\0';
+  }
+
+  // a string field copied to 'n' characters at 'dst', truncated or padded
+  // with null terminators ('\0')
+  void String(char* dst, size_t n, bool to_upper = false) {
+    const char *b, *e;
+    NextField(b, e);
+    const size_t len = e - b;
+    for (size_t i = 0; i < n; i++) {
+      char c = (i < len) ? b[i] : '\0';
+      dst[i] = to_upper ? (char)toupper(c) : c;
+    }
+  }
+
+  // a SHIPMODE field in the internal representation
+  int Shipmode() {
+    const char *b, *e;
+    NextField(b, e);
+    return ShipmodeStrToInt(b, e - b);
+  }
+
+ private:
+  // find the extent [b, e) of the next field
+  void NextField(const char*& b, const char*& e) {
+    if (pos_ > end_) {
+      // there are no more fields
+      valid_ = false;
+      b = e = end_;
+      return;
+    }
+    b = pos_;
+    e = (const char*)memchr(b, '|', end_ - b);
+    if (e == nullptr) e = end_;
+    pos_ = e + 1;
+  }
+
+  const char* pos_;
+  const char* end_;
+  bool valid_ = true;
+};
+
+//
+// Parses the rows of the '.tbl' file 'f' with several threads. The file is
+// mapped into memory and split into one chunk of whole rows per thread. Each
+// thread counts the rows of its chunk, 'resize' is called with the total
+// number of rows to size the columns, then each thread calls 'parse_row' with
+// a TblRowReader and the row index for each row of its chunk. Empty lines are
+// skipped.
+//
+template <typename ResizeFunc, typename ParseRowFunc>
+bool ParseTblFile(const std::string& f, size_t& rows, ResizeFunc resize,
+                  ParseRowFunc parse_row) {
+  // don't bother splitting small files
+  constexpr size_t kMinBytesPerThread = 1 << 20;
+
+  MappedFile file;
+  if (!file.Open(f)) {
+    return false;
+  }
+  const char* data = file.data();
+  const size_t size = file.size();
+
+  size_t num_threads =
+      std::max(1u, std::thread::hardware_concurrency());
+  num_threads = std::min(num_threads, size / kMinBytesPerThread + 1);
+
+  // each chunk starts at the beginning of a row
+  std::vector<size_t> chunk_start(num_threads + 1);
+  chunk_start[0] = 0;
+  chunk_start[num_threads] = size;
+  for (size_t t = 1; t < num_threads; t++) {
+    const char* nl = (const char*)memchr(data + size * t / num_threads, '\n',
+                                         size - size * t / num_threads);
+    chunk_start[t] = (nl == nullptr) ? size : (nl - data) + 1;
+    chunk_start[t] = std::max(chunk_start[t], chunk_start[t - 1]);
+  }
+
+  // calls 'func' with the extent of each non-empty row of chunk 't', without
+  // the end of line characters
+  auto for_each_row = [&](size_t t, auto func) {
+    const char* pos = data + chunk_start[t];
+    const char* chunk_end = data + chunk_start[t + 1];
+    while (pos < chunk_end) {
+      const char* nl = (const char*)memchr(pos, '\n', chunk_end - pos);
+      const char* row_end = (nl == nullptr) ? chunk_end : nl;
+      const char* next = (nl == nullptr) ? chunk_end : nl + 1;
+      if (row_end > pos && row_end[-1] == '\r') row_end--;
+      if (row_end > pos) func(pos, row_end);
+      pos = next;
+    }
+  };
+
+  auto run_threads = [&](auto func) {
+    std::vector<std::thread> threads;
+    for (size_t t = 1; t < num_threads; t++) {
+      threads.emplace_back(func, t);
+    }
+    func(0);
+    for (auto& thread : threads) {
+      thread.join();
+    }
+  };
+
+  // count the rows of each chunk
+  std::vector<size_t> chunk_rows(num_threads + 1, 0);
+  run_threads([&](size_t t) {
+    size_t count = 0;
+    for_each_row(t, [&](const char*, const char*) { count++; });
+    chunk_rows[t + 1] = count;
+  });
+
+  // the index of the first row of each chunk
+  for (size_t t = 0; t < num_threads; t++) {
+    chunk_rows[t + 1] += chunk_rows[t];
+  }
+  rows = chunk_rows[num_threads];
+  resize(rows);
+
+  // parse the rows straight into the columns
+  std::vector<char> chunk_valid(num_threads, 1);
+  run_threads([&](size_t t) {
+    size_t r = chunk_rows[t];
+    for_each_row(t, [&](const char* b, const char* e) {
+      TblRowReader row(b, e);
+      parse_row(row, r++);
+      if (!row.Valid()) chunk_valid[t] = 0;
+    });
+  });
+
+  if (std::find(chunk_valid.begin(), chunk_valid.end(), 0) !=
+      chunk_valid.end()) {
+    std::cout << "Found a row with too few columns in " << f << "\n";
+    return false;
+  }
+
+  return true;
 }
 
 //
-// parse the LINEITEM table
+// The binary snapshot of a table is a SnapshotHeader, a SnapshotColumn per
+// column, and the data of each column, which starts on a kSnapshotAlignment
+// byte boundary. It is only valid on a host with the same endianness and
+// type sizes as the host that wrote it.
 //
-bool Database::ParseLineItemTable(std::string f, LineItemTable& tbl) {
-  std::cout << "Parsing LINEITEM table from: " << f << "\n";
+constexpr char kSnapshotMagic[8] = {'D', 'B', 'S', 'N', 'A', 'P', '0', '1'};
+constexpr size_t kSnapshotAlignment = 64;
+
+struct SnapshotHeader {
+  char magic[8];
+  uint64_t tbl_bytes;    // the size of the '.tbl' file it was parsed from
+  uint64_t rows;
+  uint64_t num_columns;
+};
+
+struct SnapshotColumn {
+  uint64_t offset;  // from the start of the file
+  uint64_t count;   // the number of elements, including the padding rows
+  uint64_t element_bytes;
+};
 
-  // populate data row by row (as presented in the file)
-  std::ifstream ifs(f);
-  std::string line;
-  tbl.rows = 0;
+//
+// get the size of a file, or 0 if it does not exist
+//
+uint64_t FileBytes(const std::string& f) {
+  std::ifstream ifs(f, std::ios::binary | std::ios::ate);
+  return ifs.is_open() ? (uint64_t)ifs.tellg() : 0;
+}
 
-  if (!ifs.is_open()) {
-    std::cout << "Failed to parse LINEITEM table\n";
+//
+// load a table from the binary snapshot 'f' of the '.tbl' file 'tbl_f'. The
+// columns map the snapshot, so nothing is copied. Returns false if the
+// snapshot does not exist or does not match the '.tbl' file.
+//
+template <typename Table>
+bool Database::LoadSnapshot(std::string f, std::string tbl_f, std::string name,
+                            Table& tbl) {
+  auto file = std::make_shared<MappedFile>();
+  if (!file->Open(f)) {
     return false;
   }
 
-  while (std::getline(ifs, line)) {
-    // split row into column strings by separator ('|')
-    std::vector<std::string> column_data = SplitRowStr(line);
-    assert(column_data.size() == 16);
+  std::cout << "Loading " << name << " table from snapshot: " << f << "\n";
+
+  // check the header and the column descriptors
+  SnapshotHeader header;
+  size_t num_columns = 0;
+  tbl.ForEachColumn(0, [&](auto&, size_t) { num_columns++; });
+  size_t header_bytes = sizeof(SnapshotHeader) +
+                        num_columns * sizeof(SnapshotColumn);
+  bool valid = file->size() >= header_bytes;
+  if (valid) {
+    memcpy(&header, file->data(), sizeof(SnapshotHeader));
+    // every row takes at least one byte of the file, which also keeps the
+    // column sizes computed from the rows below from overflowing
+    valid = memcmp(header.magic, kSnapshotMagic, sizeof(kSnapshotMagic)) == 0 &&
+            header.num_columns == num_columns &&
+            header.rows <= file->size();
+  }
+  if (valid && header.tbl_bytes != FileBytes(tbl_f)) {
+    std::cout << "The snapshot does not match " << tbl_f << "\n";
+    return false;
+  }
 
-    tbl.orderkey.push_back(std::stoll(column_data[0]));
-    tbl.partkey.push_back(std::stoll(column_data[1]));
-    tbl.suppkey.push_back(std::stoll(column_data[2]));
-    tbl.linenumber.push_back(std::stoll(column_data[3]));
-    tbl.quantity.push_back(std::stoll(column_data[4]));
+  std::vector<SnapshotColumn> columns(num_columns);
+  if (valid) {
+    memcpy(columns.data(), file->data() + sizeof(SnapshotHeader),
+           num_columns * sizeof(SnapshotColumn));
+    // each column must hold exactly the elements of 'header.rows' rows,
+    // including the padding rows the kernels read past the last row, and
+    // those elements must lie within the file
+    size_t c = 0;
+    tbl.ForEachColumn(header.rows, [&](auto& column, size_t n) {
+      using T = typename std::remove_reference_t<decltype(column)>::value_type;
+      const SnapshotColumn& desc = columns[c++];
+      valid &= desc.element_bytes == sizeof(T) && desc.count == n &&
+               desc.offset % kSnapshotAlignment == 0 &&
+               desc.offset <= file->size() &&
+               desc.count <= (file->size() - desc.offset) / sizeof(T);
+    });
+  }
+  if (!valid) {
+    std::cout << "Invalid snapshot " << f << "\n";
+    return false;
+  }
 
-    tbl.extendedprice.push_back(MoneyFloatToCents(column_data[5]));
-    tbl.discount.push_back(MoneyFloatToCents(column_data[6]));
-    tbl.tax.push_back(MoneyFloatToCents(column_data[7]));
+  // point the columns at the mapped data
+  size_t c = 0;
+  tbl.ForEachColumn(header.rows, [&](auto& column, size_t) {
+    using T = typename std::remove_reference_t<decltype(column)>::value_type;
+    const SnapshotColumn& desc = columns[c++];
+    column.Map(file, (T*)(file->data() + desc.offset), desc.count);
+  });
+  tbl.rows = header.rows;
 
-    tbl.returnflag.push_back(column_data[8].at(0));
-    tbl.linestatus.push_back(column_data[9].at(0));
+  std::cout << "Finished loading " << name << " table with " << tbl.rows
+            << " rows\n";
 
-    tbl.shipdate.push_back(Date(column_data[10]).ToCompact());
-    tbl.commitdate.push_back(Date(column_data[11]).ToCompact());
-    tbl.receiptdate.push_back(Date(column_data[12]).ToCompact());
+  return true;
+}
 
-    AppendStringToCharVec(tbl.shipinstruct, column_data[13], 25);
-    tbl.shipmode.push_back(ShipmodeStrToInt(column_data[14]));
-    AppendStringToCharVec(tbl.comment, column_data[15], 44);
+//
+// write the binary snapshot 'f' of a table parsed from the '.tbl' file 'tbl_f'
+//
+template <typename Table>
+bool Database::WriteSnapshot(std::string f, std::string tbl_f, Table& tbl) {
+  std::cout << "Writing snapshot: " << f << "\n";
+
+  SnapshotHeader header;
+  memcpy(header.magic, kSnapshotMagic, sizeof(kSnapshotMagic));
+  header.tbl_bytes = FileBytes(tbl_f);
+  header.rows = tbl.rows;
+  header.num_columns = 0;
+  tbl.ForEachColumn(0, [&](auto&, size_t) { header.num_columns++; });
+
+  // lay out the columns after the header
+  std::vector<SnapshotColumn> columns;
+  uint64_t offset = sizeof(SnapshotHeader) +
+                    header.num_columns * sizeof(SnapshotColumn);
+  tbl.ForEachColumn(tbl.rows, [&](auto& column, size_t) {
+    using T = typename std::remove_reference_t<decltype(column)>::value_type;
+    offset = (offset + kSnapshotAlignment - 1) / kSnapshotAlignment *
+             kSnapshotAlignment;
+    columns.push_back({offset, column.size(), sizeof(T)});
+    offset += column.size() * sizeof(T);
+  });
 
-    tbl.rows++;
+  std::ofstream ofs(f, std::ios::binary | std::ios::trunc);
+  ofs.write((const char*)&header, sizeof(SnapshotHeader));
+  ofs.write((const char*)columns.data(),
+            columns.size() * sizeof(SnapshotColumn));
+
+  size_t c = 0;
+  tbl.ForEachColumn(tbl.rows, [&](auto& column, size_t) {
+    using T = typename std::remove_reference_t<decltype(column)>::value_type;
+    const char zeros[kSnapshotAlignment] = {0};
+    ofs.write(zeros, columns[c].offset - (uint64_t)ofs.tellp());
+    ofs.write((const char*)column.data(), column.size() * sizeof(T));
+    c++;
+  });
+
+  ofs.close();
+  if (!ofs) {
+    std::cerr << "WARNING: failed to write snapshot " << f << "\n";
+    std::remove(f.c_str());
+    return false;
+  }
+
+  return true;
+}
+
+//
+// the main parsing function
+// parses '*.tbl' files location in directory 'db_root_dir'
+//
+bool Database::Parse(std::string db_root_dir, bool write_snapshots) {
+  std::cout << "Parsing database files in: " << db_root_dir << std::endl;
+
+  auto start = std::chrono::high_resolution_clock::now();
+  bool success = true;
+
+  // load the LINEITEM and ORDERS tables from their snapshots, or parse them
+  std::string l_tbl = db_root_dir + kSeparator + "lineitem.tbl";
+  std::string l_bin = db_root_dir + kSeparator + "lineitem.bin";
+  if (!LoadSnapshot(l_bin, l_tbl, "LINEITEM", l)) {
+    bool parsed = ParseLineItemTable(l_tbl, l);
+    if (parsed && write_snapshots) {
+      WriteSnapshot(l_bin, l_tbl, l);
+    }
+    success &= parsed;
+  }
+
+  std::string o_tbl = db_root_dir + kSeparator + "orders.tbl";
+  std::string o_bin = db_root_dir + kSeparator + "orders.bin";
+  if (!LoadSnapshot(o_bin, o_tbl, "ORDERS", o)) {
+    bool parsed = ParseOrdersTable(o_tbl, o);
+    if (parsed && write_snapshots) {
+      WriteSnapshot(o_bin, o_tbl, o);
+    }
+    success &= parsed;
   }
 
-  for (size_t i = 0; i < kPaddingRows; i++) {
-    tbl.orderkey.push_back(0);
-    tbl.partkey.push_back(0);
-    tbl.suppkey.push_back(0);
-    tbl.linenumber.push_back(0);
-    tbl.quantity.push_back(0);
+  // parse the other tables
+  success &= ParsePartsTable(db_root_dir + kSeparator + "part.tbl", p);
+  success &= ParseSupplierTable(db_root_dir + kSeparator + "supplier.tbl", s);
+  success &= ParsePartSupplierTable(db_root_dir + kSeparator + "partsupp.tbl", ps);
+  success &= ParseNationTable(db_root_dir + kSeparator + "nation.tbl", n);
 
-    tbl.extendedprice.push_back(0);
-    tbl.discount.push_back(0);
-    tbl.tax.push_back(0);
+  std::chrono::duration<double, std::milli> diff =
+      std::chrono::high_resolution_clock::now() - start;
+  std::cout << "Finished loading the database in " << diff.count() << " ms\n";
 
-    tbl.returnflag.push_back(0);
-    tbl.linestatus.push_back(0);
+  return success;
+}
 
-    tbl.shipdate.push_back(0);
-    tbl.commitdate.push_back(0);
-    tbl.receiptdate.push_back(0);
+//
+// parse the LINEITEM table
+//
+bool Database::ParseLineItemTable(std::string f, LineItemTable& tbl) {
+  std::cout << "Parsing LINEITEM table from: " << f << "\n";
 
-    tbl.shipmode.push_back(0);
+  bool success = ParseTblFile(
+      f, tbl.rows,
+      [&](size_t rows) {
+        // add some padding rows to the end of the table (see dbdata.hpp)
+        tbl.ForEachColumn(rows, [&](auto& column, size_t n) {
+          column.resize(n);
+        });
+      },
+      [&](TblRowReader& row, size_t r) {
+        tbl.orderkey[r] = row.Int();
+        tbl.partkey[r] = row.Int();
+        tbl.suppkey[r] = row.Int();
+        tbl.linenumber[r] = row.Int();
+        tbl.quantity[r] = row.Int();
+
+        tbl.extendedprice[r] = row.Money();
+        tbl.discount[r] = row.Money();
+        tbl.tax[r] = row.Money();
+
+        tbl.returnflag[r] = row.Char();
+        tbl.linestatus[r] = row.Char();
+
+        tbl.shipdate[r] = row.CompactDate();
+        tbl.commitdate[r] = row.CompactDate();
+        tbl.receiptdate[r] = row.CompactDate();
+
+        row.String(&tbl.shipinstruct[r * 25], 25);
+        tbl.shipmode[r] = row.Shipmode();
+        row.String(&tbl.comment[r * 44], 44);
+      });
+
+  if (!success) {
+    std::cout << "Failed to parse LINEITEM table\n";
+    return false;
   }
 
   std::cout << "Finished parsing LINEITEM table with " << tbl.rows << " rows\n";
@@ -221,46 +559,30 @@ bool Database::ParseLineItemTable(std::string f, LineItemTable& tbl) {
 bool Database::ParseOrdersTable(std::string f, OrdersTable& tbl) {
   std::cout << "Parsing ORDERS table from: " << f << "\n";
 
-  // populate data row by row (as presented in the file)
-  std::ifstream ifs(f);
-  std::string line;
-  tbl.rows = 0;
-
-  if (!ifs.is_open()) {
+  bool success = ParseTblFile(
+      f, tbl.rows,
+      [&](size_t rows) {
+        tbl.ForEachColumn(rows, [&](auto& column, size_t n) {
+          column.resize(n);
+        });
+      },
+      [&](TblRowReader& row, size_t r) {
+        tbl.orderkey[r] = row.Int();
+        tbl.custkey[r] = row.Int();
+        tbl.orderstatus[r] = row.Char();
+        tbl.totalprice[r] = row.Money();
+        tbl.orderdate[r] = row.CompactDate();
+        tbl.orderpriority[r] = (int)(row.Char() - '0');
+        row.String(&tbl.clerk[r * 15], 15);
+        tbl.shippriority[r] = row.Int();
+        row.String(&tbl.comment[r * 80], 80);
+      });
+
+  if (!success) {
     std::cout << "Failed to parse ORDERS table\n";
     return false;
   }
 
-  while (std::getline(ifs, line)) {
-    // split row into column strings by separator ('|')
-    std::vector<std::string> column_data = SplitRowStr(line);
-    assert(column_data.size() == 9);
-
-    // store date for this row
-    tbl.orderkey.push_back(std::stoll(column_data[0]));
-    tbl.custkey.push_back(std::stoll(column_data[1]));
-    tbl.orderstatus.push_back(column_data[2][0]);
-    tbl.totalprice.push_back(MoneyFloatToCents(column_data[3]));
-    tbl.orderdate.push_back(Date(column_data[4]).ToCompact());
-    tbl.orderpriority.push_back((int)(column_data[5][0] - '0'));
-    AppendStringToCharVec(tbl.clerk, column_data[6], 15);
-    tbl.shippriority.push_back(std::stoi(column_data[7]));
-    AppendStringToCharVec(tbl.comment, column_data[8], 80);
-
-    tbl.rows++;
-  }
-
-  for (size_t i = 0; i < kPaddingRows; i++) {
-    tbl.orderkey.push_back(0);
-    tbl.custkey.push_back(0);
-    tbl.orderstatus.push_back(0);
-    tbl.totalprice.push_back(0);
-    tbl.orderdate.push_back(0);
-    tbl.orderpriority.push_back(0);
-    tbl.shippriority.push_back(0);
-  }
-
-
   std::cout << "Finished parsing ORDERS table with " << tbl.rows << " rows\n";
 
   return true;
@@ -272,42 +594,41 @@ bool Database::ParseOrdersTable(std::string f, OrdersTable& tbl) {
 bool Database::ParsePartsTable(std::string f, PartsTable& tbl) {
   std::cout << "Parsing PARTS table from: " << f << "\n";
 
-  // populate data row by row (as presented in the file)
-  std::ifstream ifs(f);
-  std::string line;
-  tbl.rows = 0;
-
-  if (!ifs.is_open()) {
+  bool success = ParseTblFile(
+      f, tbl.rows,
+      [&](size_t rows) {
+        tbl.partkey.resize(rows + kPaddingRows);
+        tbl.name.resize((rows + kPaddingRows) * 55);
+        tbl.mfgr.resize(rows * 25);
+        tbl.brand.resize(rows * 10);
+        tbl.type.resize(rows * 25);
+        tbl.size.resize(rows);
+        tbl.container.resize(rows * 10);
+        tbl.retailprice.resize(rows);
+        tbl.comment.resize(rows * 23);
+      },
+      [&](TblRowReader& row, size_t r) {
+        tbl.partkey[r] = row.Int();
+
+        // formatting part name: all uppercase
+        row.String(&tbl.name[r * 55], 55, true);
+
+        row.String(&tbl.mfgr[r * 25], 25);
+        row.String(&tbl.brand[r * 10], 10);
+        row.String(&tbl.type[r * 25], 25);
+        tbl.size[r] = row.Int();
+        row.String(&tbl.container[r * 10], 10);
+        tbl.retailprice[r] = row.Money();
+        row.String(&tbl.comment[r * 23], 23);
+      });
+
+  if (!success) {
     std::cout << "Failed to parse PARTS table\n";
     return false;
   }
 
-  while (std::getline(ifs, line)) {
-    // split row into column strings by separator ('|')
-    std::vector<std::string> column_data = SplitRowStr(line);
-    assert(column_data.size() == 9);
-
-    tbl.partkey.push_back(std::stoll(column_data[0]));
-
-    // formatting part name: no spaces, all uppercase
-    transform(column_data[1].begin(), column_data[1].end(),
-              column_data[1].begin(), ::toupper);
-    AppendStringToCharVec(tbl.name, column_data[1], 55);
-
-    AppendStringToCharVec(tbl.mfgr, column_data[2], 25);
-    AppendStringToCharVec(tbl.brand, column_data[3], 10);
-    AppendStringToCharVec(tbl.type, column_data[4], 25);
-    tbl.size.push_back(std::stoi(column_data[5]));
-    AppendStringToCharVec(tbl.container, column_data[6], 10);
-    tbl.retailprice.push_back(MoneyFloatToCents(column_data[7]));
-    AppendStringToCharVec(tbl.comment, column_data[8], 23);
-
-    tbl.rows++;
-  }
-
-  for (size_t i = 0; i < kPaddingRows; i++) {
-    tbl.partkey.push_back(0);
-    AppendStringToCharVec(tbl.name, "INVALID", 55);
+  for (size_t i = tbl.rows; i < tbl.rows + kPaddingRows; i++) {
+    strncpy(&tbl.name[i * 55], "INVALID", 55);
   }
 
   std::cout << "Finished parsing PARTS table with " << tbl.rows << " rows\n";
@@ -321,37 +642,34 @@ bool Database::ParsePartsTable(std::string f, PartsTable& tbl) {
 bool Database::ParseSupplierTable(std::string f, SupplierTable& tbl) {
   std::cout << "Parsing SUPPLIER table from: " << f << "\n";
 
-  // populate data row by row (as presented in the file)
-  std::ifstream ifs(f);
-  std::string line;
-  tbl.rows = 0;
-
-  if (!ifs.is_open()) {
+  bool success = ParseTblFile(
+      f, tbl.rows,
+      [&](size_t rows) {
+        tbl.suppkey.resize(rows + kPaddingRows);
+        tbl.name.resize((rows + kPaddingRows) * 25);
+        tbl.address.resize(rows * 40);
+        tbl.nationkey.resize(rows + kPaddingRows);
+        tbl.phone.resize(rows * 15);
+        tbl.acctbal.resize(rows + kPaddingRows);
+        tbl.comment.resize(rows * 101);
+      },
+      [&](TblRowReader& row, size_t r) {
+        tbl.suppkey[r] = row.Int();
+        row.String(&tbl.name[r * 25], 25);
+        row.String(&tbl.address[r * 40], 40);
+        tbl.nationkey[r] = (unsigned char)(row.Int());
+        row.String(&tbl.phone[r * 15], 15);
+        tbl.acctbal[r] = row.Money();
+        row.String(&tbl.comment[r * 101], 101);
+      });
+
+  if (!success) {
     std::cout << "Failed to parse SUPPLIER table\n";
     return false;
   }
 
-  while (std::getline(ifs, line)) {
-    // split row into column strings by separator ('|')
-    std::vector<std::string> column_data = SplitRowStr(line);
-    assert(column_data.size() == 7);
-
-    tbl.suppkey.push_back(std::stoll(column_data[0]));
-    AppendStringToCharVec(tbl.name, column_data[1], 25);
-    AppendStringToCharVec(tbl.address, column_data[2], 40);
-    tbl.nationkey.push_back((unsigned char)(std::stoul(column_data[3])));
-    AppendStringToCharVec(tbl.phone, column_data[4], 15);
-    tbl.acctbal.push_back(MoneyFloatToCents(column_data[5]));
-    AppendStringToCharVec(tbl.comment, column_data[6], 101);
-
-    tbl.rows++;
-  }
-
-  for (size_t i = 0; i < kPaddingRows; i++) {
-    tbl.suppkey.push_back(0);
-    AppendStringToCharVec(tbl.name, "INVALID", 25);
-    tbl.nationkey.push_back(0);
-    tbl.acctbal.push_back(0);
+  for (size_t i = tbl.rows; i < tbl.rows + kPaddingRows; i++) {
+    strncpy(&tbl.name[i * 25], "INVALID", 25);
   }
 
   std::cout << "Finished parsing SUPPLIER table with " << tbl.rows << " rows\n";
@@ -365,37 +683,28 @@ bool Database::ParseSupplierTable(std::string f, SupplierTable& tbl) {
 bool Database::ParsePartSupplierTable(std::string f, PartSupplierTable& tbl) {
   std::cout << "Parsing PARTSUPPLIER table from: " << f << "\n";
 
-  // populate data row by row (as presented in the file)
-  std::ifstream ifs(f);
-  std::string line;
-  tbl.rows = 0;
-
-  if (!ifs.is_open()) {
+  bool success = ParseTblFile(
+      f, tbl.rows,
+      [&](size_t rows) {
+        tbl.partkey.resize(rows + kPaddingRows);
+        tbl.suppkey.resize(rows + kPaddingRows);
+        tbl.availqty.resize(rows + kPaddingRows);
+        tbl.supplycost.resize(rows + kPaddingRows);
+        tbl.comment.resize(rows * 199);
+      },
+      [&](TblRowReader& row, size_t r) {
+        tbl.partkey[r] = row.Int();
+        tbl.suppkey[r] = row.Int();
+        tbl.availqty[r] = row.Int();
+        tbl.supplycost[r] = row.Money();
+        row.String(&tbl.comment[r * 199], 199);
+      });
+
+  if (!success) {
     std::cout << "Failed to parse PARTSUPPLIER table\n";
     return false;
   }
 
-  while (std::getline(ifs, line)) {
-    // split row into column strings by separator ('|')
-    std::vector<std::string> column_data = SplitRowStr(line);
-    assert(column_data.size() == 5);
-
-    tbl.partkey.push_back(std::stoll(column_data[0]));
-    tbl.suppkey.push_back(std::stoll(column_data[1]));
-    tbl.availqty.push_back(std::stoi(column_data[2]));
-    tbl.supplycost.push_back(MoneyFloatToCents(column_data[3]));
-    AppendStringToCharVec(tbl.comment, column_data[4], 199);
-
-    tbl.rows++;
-  }
-
-  for (size_t i = 0; i < kPaddingRows; i++) {
-    tbl.partkey.push_back(0);
-    tbl.suppkey.push_back(0);
-    tbl.availqty.push_back(0);
-    tbl.supplycost.push_back(0);
-  }
-
   std::cout << "Finished parsing PARTSUPPLIER table with " << tbl.rows
             << " rows\n";
 
@@ -450,39 +759,80 @@ bool Database::ParseNationTable(std::string f, NationTable& tbl) {
 }
 
 //
-// Checks the size of each parsed table against the expected size based
-// on the selected scale factor
+// table sizes based on the scale factor
+//
+size_t PartTableSize(float sf) { return std::llround(sf * 200000); }
+size_t PartSupplierTableSize(float sf) { return std::llround(sf * 800000); }
+size_t OrdersTableSize(float sf) { return std::llround(sf * 1500000); }
+size_t SupplierTableSize(float sf) { return std::llround(sf * 10000); }
+size_t CustomerTableSize(float sf) { return std::llround(sf * 150000); }
+
+//
+// The LINEITEM table is not a strict multiple of the scale factor. These are
+// the sizes generated by the TPC-H 'dbgen' tool. Returns 0 for other scale
+// factors.
+//
+size_t LineItemTableSize(float sf) {
+  const std::pair<float, size_t> kSizes[] = {
+      {0.01f, 60175},       {0.1f, 600572},         {1.0f, 6001215},
+      {10.0f, 59986052},    {30.0f, 179998372},     {100.0f, 600037902},
+      {300.0f, 1799989091}, {1000.0f, 5999989709}};
+
+  for (auto& size : kSizes) {
+    if (AlmostEqual(sf, size.first, 1e-4)) {
+      return size.second;
+    }
+  }
+  return 0;
+}
+
+//
+// Derives the scale factor of the database from the size of the SUPPLIER
+// table and checks the size of each parsed table against it
 //
 bool Database::ValidateSF() {
   bool ret = true;
 
-  if (l.rows != kLineItemTableSize) {
+  sf = s.rows / 10000.0f;
+
+  // the size of the LINEITEM table is only known for the scale factors that
+  // are commonly used, for the others it should be within 0.1% of
+  // 6 million rows per unit of scale factor
+  size_t l_rows_expected = LineItemTableSize(sf);
+  bool l_rows_valid;
+  if (l_rows_expected != 0) {
+    l_rows_valid = l.rows == l_rows_expected;
+  } else {
+    l_rows_expected = std::llround(sf * 6000000);
+    l_rows_valid = AlmostEqual(l.rows, l_rows_expected, l_rows_expected * 1e-3);
+  }
+
+  if (!l_rows_valid) {
     std::cerr << "LineItem table size has " << l.rows << " rows"
-              << " when it should have " << kLineItemTableSize << "\n";
+              << " when it should have " << l_rows_expected << "\n";
     ret = false;
   }
 
-  if (o.rows != kOrdersTableSize) {
+  if (o.rows != OrdersTableSize(sf)) {
     std::cerr << "Orders table size has " << o.rows << " rows"
-              << " when it should have " << kOrdersTableSize << "\n";
+              << " when it should have " << OrdersTableSize(sf) << "\n";
     ret = false;
   }
 
-  if (p.rows != kPartTableSize) {
+  if (p.rows != PartTableSize(sf)) {
     std::cerr << "Parts table size has " << p.rows << " rows"
-              << " when it should have " << kPartTableSize << "\n";
+              << " when it should have " << PartTableSize(sf) << "\n";
     ret = false;
   }
 
-  if (s.rows != kSupplierTableSize) {
-    std::cerr << "Supplier table size has " << s.rows << " rows"
-              << " when it should have " << kSupplierTableSize << "\n";
+  if (s.rows == 0) {
+    std::cerr << "Supplier table is empty\n";
     ret = false;
   }
 
-  if (ps.rows != kPartSupplierTableSize) {
+  if (ps.rows != PartSupplierTableSize(sf)) {
     std::cerr << "PartSupplier table size has " << ps.rows << " rows"
-              << " when it should have " << kPartSupplierTableSize << "\n";
+              << " when it should have " << PartSupplierTableSize(sf) << "\n";
     ret = false;
   }
 
@@ -495,6 +845,56 @@ bool Database::ValidateSF() {
   return ret;
 }
 
+//
+// split the LINEITEM and ORDERS tables into partitions of at most 'max_rows'
+// LINEITEM rows, without splitting the rows of an order
+//
+std::vector<TablePartition> Database::PartitionLineItem(size_t max_rows) const {
+  std::vector<TablePartition> partitions;
+  const DBIdentifier* l_orderkey = l.orderkey.data();
+  const DBIdentifier* o_orderkey = o.orderkey.data();
+
+  size_t l_begin = 0;
+  size_t o_begin = 0;
+  while (l_begin < l.rows) {
+    size_t l_end = std::min(l_begin + std::max(max_rows, (size_t)1), l.rows);
+
+    // move the end back to the first row of the order it splits, unless that
+    // order is the only one in the partition
+    size_t end = l_end;
+    while (end > l_begin && end < l.rows &&
+           l_orderkey[end] == l_orderkey[end - 1]) {
+      end--;
+    }
+    if (end > l_begin) {
+      l_end = end;
+    } else {
+      while (l_end < l.rows && l_orderkey[l_end] == l_orderkey[l_end - 1]) {
+        l_end++;
+      }
+    }
+
+    // the ORDERS rows up to the last ORDERKEY of the partition, the last
+    // partition gets the rest of the ORDERS table
+    size_t o_end = std::upper_bound(o_orderkey + o_begin, o_orderkey + o.rows,
+                                    l_orderkey[l_end - 1]) - o_orderkey;
+    if (l_end == l.rows) {
+      o_end = o.rows;
+    }
+
+    partitions.push_back({l_begin, l_end, o_begin, o_end});
+    l_begin = l_end;
+    o_begin = o_end;
+  }
+
+  // an empty table is a single empty partition
+  if (partitions.empty()) {
+    partitions.push_back({0, 0, 0, o.rows});
+  }
+
+  return partitions;
+}
+
 //
 // validate the results of Query 1
 //
@@ -706,7 +1106,7 @@ bool Database::ValidateQ11(std::string db_root_dir,
     // split row into column strings by separator ('|')
     std::vector<std::string> column_data = SplitRowStr(line);
     assert(column_data.size() == 2);
-    assert(i < kPartTableSize);
+    assert(i < kMaxPartTableSize);
 
     DBIdentifier partkey_gold = std::stoll(column_data[0]);
     double value_gold = std::stod(column_data[1]);
@@ -933,7 +1333,7 @@ void Database::PrintQ11(std::vector<DBIdentifier>& partkeys,
 //
 // print the results of Query 12
 //
-void Database::PrintQ12(std::string& SM1, std::string& SM2,
+void Database::PrintQ12(const std::string& SM1, const std::string& SM2,
                         std::array<DBDecimal, 2> high_line_count,
                         std::array<DBDecimal, 2> low_line_count) {
   // print the header
@@ -3,6 +3,7 @@
 #pragma once
 
 #include <array>
+#include <memory>
 #include <string>
 #include <type_traits>
 #include <unordered_map>
@@ -15,19 +16,23 @@ using DBInt = unsigned int;
 using DBDecimal = long long;
 using DBDate = unsigned int;
 
-// Set the scale factor
+// The scale factor (SF) of the database is only known at runtime, when the
+// tables are parsed (see Database::sf). However, the kernels that keep
+// per-key state on-chip (the PARTS and SUPPLIER keys in Queries 9 and 11) are
+// sized at compile time, for a maximum scale factor (kMaxSF).
 //
-// The default (and only option) scale factor for
-// emulation is 0.01; a scale factor of 1 for emulation
-// takes far too long.
+// The default maximum scale factor for emulation and simulation is 0.01; a
+// scale factor of 1 for emulation takes far too long.
 //
-// The default scale factor for hardware is 1. However,
-// the SF_SMALL flag allows the hardware design to be compiled
-// with a scale factor of 0.01
-#if defined(FPGA_EMULATOR) || defined(FPGA_SIMULATOR) || defined(SF_SMALL)
-constexpr float kSF = 0.01f;
+// The default maximum scale factor for hardware is 1. However, the SF_SMALL
+// flag allows the hardware design to be compiled with a maximum scale factor
+// of 0.01, and MAX_SF sets any other maximum scale factor.
+#if defined(MAX_SF)
+constexpr float kMaxSF = MAX_SF;
+#elif defined(FPGA_EMULATOR) || defined(FPGA_SIMULATOR) || defined(SF_SMALL)
+constexpr float kMaxSF = 0.01f;
 #else
-constexpr float kSF = 1.0f;
+constexpr float kMaxSF = 1.0f;
 #endif
 
 // add some padding rows to the end of each table.
@@ -36,28 +41,18 @@ constexpr float kSF = 1.0f;
 // 16 was chosen because it is the largest access granularity
 constexpr size_t kPaddingRows = 16;
 
-// ensure the selected scale factor is supported
-static_assert((kSF == 0.01f || kSF == 1.0f), "Unsupported Scale Factor (kSF)");
-
-// table sizes based on the Scale Factor (kSF)
-constexpr int kPartTableSize = kSF * 200000;
-constexpr int kPartSupplierTableSize = kSF * 800000;
-constexpr int kOrdersTableSize = kSF * 1500000;
-constexpr int kSupplierTableSize = kSF * 10000;
-constexpr int kCustomerTableSize = kSF * 150000;
-
-// LINEITEM table is not a strict multiple of kSF
-constexpr int LineItemTableSizeFnc() {
-  if (kSF == 0.01f) {
-    return 60175;
-  } else if (kSF == 1.0f) {
-    return 6001215;
-  } else {
-    return 0;  // error, should be caught by kSF static_assert
-  }
-}
+// the largest PARTS and SUPPLIER tables the on-chip memories are sized for
+constexpr int kMaxPartTableSize = kMaxSF * 200000;
+constexpr int kMaxSupplierTableSize = kMaxSF * 10000;
+
+// table sizes based on the scale factor ('sf') of the database
+size_t PartTableSize(float sf);
+size_t PartSupplierTableSize(float sf);
+size_t OrdersTableSize(float sf);
+size_t SupplierTableSize(float sf);
+size_t CustomerTableSize(float sf);
+size_t LineItemTableSize(float sf);
 
-constexpr int kLineItemTableSize = LineItemTableSizeFnc();
 constexpr int kNationTableSize = 25;
 constexpr int kRegionTableSize = 5;
 
@@ -69,41 +64,129 @@ constexpr int kQuery1OutSize = kReturnFlagSize * kLineStatusSize;
 DBDate DateFromString(std::string& date_str);
 int ShipmodeStrToInt(std::string& shipmode_str);
 
+//
+// A partition of the LINEITEM table and the rows of the ORDERS table with the
+// same ORDERKEYs. Both tables are sorted by ORDERKEY, so each partition is a
+// range of rows [begin, end) of each table, and the rows of an order are never
+// split between partitions.
+//
+struct TablePartition {
+  size_t l_begin, l_end;
+  size_t o_begin, o_end;
+};
+
+// a mapped file, see mapped_file.hpp
+class MappedFile;
+
+//
+// A column of a table. The column either owns its data, or is a view into a
+// mapped snapshot file, which it keeps mapped. It is a contiguous container,
+// so a SYCL buffer can be constructed from it like from a std::vector.
+//
+template <typename T>
+class Column {
+ public:
+  using value_type = T;
+
+  Column() {}
+  Column(const Column&) = delete;
+  Column& operator=(const Column&) = delete;
+  Column(Column&&) = default;
+  Column& operator=(Column&&) = default;
+
+  // own 'n' zero initialized elements
+  void resize(size_t n) {
+    file_.reset();
+    owned_.assign(n, T());
+    data_ = owned_.data();
+    size_ = n;
+  }
+
+  // view 'n' elements at 'data' in the mapped 'file'
+  void Map(std::shared_ptr<MappedFile> file, T* data, size_t n) {
+    owned_.clear();
+    owned_.shrink_to_fit();
+    file_ = file;
+    data_ = data;
+    size_ = n;
+  }
+
+  T* data() { return data_; }
+  const T* data() const { return data_; }
+  size_t size() const { return size_; }
+  T& operator[](size_t i) { return data_[i]; }
+  const T& operator[](size_t i) const { return data_[i]; }
+  T* begin() { return data_; }
+  T* end() { return data_ + size_; }
+
+ private:
+  std::vector<T> owned_;
+  std::shared_ptr<MappedFile> file_;
+  T* data_ = nullptr;
+  size_t size_ = 0;
+};
+
 // LINEITEM table
 struct LineItemTable {
-  std::vector<DBIdentifier> orderkey;
-  std::vector<DBIdentifier> partkey;
-  std::vector<DBIdentifier> suppkey;
-  std::vector<DBInt> linenumber;
-  std::vector<DBDecimal> quantity;
-  std::vector<DBDecimal> extendedprice;
-  std::vector<DBDecimal> discount;
-  std::vector<DBDecimal> tax;
-  std::vector<char> returnflag;
-  std::vector<char> linestatus;
-  std::vector<DBDate> shipdate;
-  std::vector<DBDate> commitdate;
-  std::vector<DBDate> receiptdate;
-  std::vector<char> shipinstruct;
-  std::vector<int> shipmode;
-  std::vector<char> comment;
+  Column<DBIdentifier> orderkey;
+  Column<DBIdentifier> partkey;
+  Column<DBIdentifier> suppkey;
+  Column<DBInt> linenumber;
+  Column<DBDecimal> quantity;
+  Column<DBDecimal> extendedprice;
+  Column<DBDecimal> discount;
+  Column<DBDecimal> tax;
+  Column<char> returnflag;
+  Column<char> linestatus;
+  Column<DBDate> shipdate;
+  Column<DBDate> commitdate;
+  Column<DBDate> receiptdate;
+  Column<char> shipinstruct;
+  Column<int> shipmode;
+  Column<char> comment;
 
   size_t rows;
+
+  // call 'f' on every column, in the order they are stored in a snapshot,
+  // with the number of elements of the column in a table of 'n' rows: the
+  // rows and the padding rows (see kPaddingRows), or a fixed number of
+  // characters per row for the strings
+  template <typename F>
+  void ForEachColumn(size_t n, F&& f) {
+    const size_t padded = n + kPaddingRows;
+    f(orderkey, padded); f(partkey, padded); f(suppkey, padded);
+    f(linenumber, padded); f(quantity, padded); f(extendedprice, padded);
+    f(discount, padded); f(tax, padded); f(returnflag, padded);
+    f(linestatus, padded); f(shipdate, padded); f(commitdate, padded);
+    f(receiptdate, padded); f(shipinstruct, n * 25); f(shipmode, padded);
+    f(comment, n * 44);
+  }
 };
 
 // ORDERS table
 struct OrdersTable {
-  std::vector<DBIdentifier> orderkey;
-  std::vector<DBIdentifier> custkey;
-  std::vector<char> orderstatus;
-  std::vector<DBDecimal> totalprice;
-  std::vector<DBDate> orderdate;
-  std::vector<int> orderpriority;
-  std::vector<char> clerk;
-  std::vector<int> shippriority;
-  std::vector<char> comment;
+  Column<DBIdentifier> orderkey;
+  Column<DBIdentifier> custkey;
+  Column<char> orderstatus;
+  Column<DBDecimal> totalprice;
+  Column<DBDate> orderdate;
+  Column<int> orderpriority;
+  Column<char> clerk;
+  Column<int> shippriority;
+  Column<char> comment;
 
   size_t rows;
+
+  // call 'f' on every column, in the order they are stored in a snapshot,
+  // with the number of elements of the column in a table of 'n' rows (see
+  // LineItemTable::ForEachColumn)
+  template <typename F>
+  void ForEachColumn(size_t n, F&& f) {
+    const size_t padded = n + kPaddingRows;
+    f(orderkey, padded); f(custkey, padded); f(orderstatus, padded);
+    f(totalprice, padded); f(orderdate, padded); f(orderpriority, padded);
+    f(clerk, n * 15); f(shippriority, padded); f(comment, n * 80);
+  }
 };
 
 // PARTS table
@@ -166,7 +249,27 @@ struct Database {
   PartSupplierTable ps;
   NationTable n;
 
-  bool Parse(std::string db_root_dir);
+  // parse the '.tbl' files in 'db_root_dir'. The LINEITEM and ORDERS tables
+  // are loaded from their binary snapshots ('.bin') instead, if they exist
+  // and match the '.tbl' files. 'write_snapshots' writes the snapshots after
+  // parsing the '.tbl' files.
+  bool Parse(std::string db_root_dir, bool write_snapshots = false);
+
+  // the scale factor of the database, which ValidateSF() derives from the
+  // size of the SUPPLIER table
+  float sf = 0;
+
+  // the maximum number of LINEITEM rows the queries stream through the kernels
+  // at once. 0 sizes the partitions to the device memory.
+  size_t partition_rows = 0;
+
+  // the number of queries that run at the same time and share the device
+  // memory, which the QueryScheduler sets when it runs a queue of queries
+  size_t concurrent_queries = 1;
+
+  // split the LINEITEM and ORDERS tables into partitions of at most
+  // 'max_rows' LINEITEM rows
+  std::vector<TablePartition> PartitionLineItem(size_t max_rows) const;
 
   // validation functions
   bool ValidateSF();
@@ -206,7 +309,7 @@ struct Database {
   void PrintQ11(std::vector<DBIdentifier>& partkeys,
                 std::vector<DBDecimal>& partkey_values);
 
-  void PrintQ12(std::string& SM1, std::string& SM2,
+  void PrintQ12(const std::string& SM1, const std::string& SM2,
                 std::array<DBDecimal, 2> high_line_count,
                 std::array<DBDecimal, 2> low_line_count);
 
@@ -217,6 +320,12 @@ struct Database {
   bool ParseSupplierTable(std::string f, SupplierTable& tbl);
   bool ParsePartSupplierTable(std::string f, PartSupplierTable& tbl);
   bool ParseNationTable(std::string f, NationTable& tbl);
+
+  template <typename Table>
+  bool LoadSnapshot(std::string f, std::string tbl_f, std::string name,
+                    Table& tbl);
+  template <typename Table>
+  bool WriteSnapshot(std::string f, std::string tbl_f, Table& tbl);
 };
 
 #endif /* __DBDATA_HPP__ */
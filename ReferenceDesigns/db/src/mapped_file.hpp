@@ -0,0 +1,104 @@
+#ifndef __MAPPED_FILE_HPP__
+#define __MAPPED_FILE_HPP__
+#pragma once
+
+#include <string>
+
+#if defined(WIN32) || defined(_WIN32) || defined(_MSC_VER)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+//
+// A file mapped into memory. The mapping is private (copy-on-write), so the
+// data can be handed out as non-const pointers, for example as the host
+// memory of a SYCL buffer, without ever changing the file.
+//
+class MappedFile {
+ public:
+  MappedFile() {}
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+  ~MappedFile() { Close(); }
+
+  // map the file 'path', returns false if it does not exist or is empty
+  bool Open(const std::string& path) {
+    Close();
+#if defined(WIN32) || defined(_WIN32) || defined(_MSC_VER)
+    file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+                        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file_ == INVALID_HANDLE_VALUE) {
+      return false;
+    }
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file_, &file_size) || file_size.QuadPart == 0) {
+      Close();
+      return false;
+    }
+    size_ = (size_t)file_size.QuadPart;
+    mapping_ = CreateFileMappingA(file_, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+    if (mapping_ == NULL) {
+      Close();
+      return false;
+    }
+    data_ = (char*)MapViewOfFile(mapping_, FILE_MAP_COPY, 0, 0, 0);
+    if (data_ == NULL) {
+      Close();
+      return false;
+    }
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+      close(fd);
+      return false;
+    }
+    size_ = (size_t)st.st_size;
+    void* addr = mmap(NULL, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+      size_ = 0;
+      return false;
+    }
+    data_ = (char*)addr;
+#endif
+    return true;
+  }
+
+  void Close() {
+#if defined(WIN32) || defined(_WIN32) || defined(_MSC_VER)
+    if (data_ != nullptr) UnmapViewOfFile(data_);
+    if (mapping_ != NULL) CloseHandle(mapping_);
+    if (file_ != INVALID_HANDLE_VALUE) CloseHandle(file_);
+    mapping_ = NULL;
+    file_ = INVALID_HANDLE_VALUE;
+#else
+    if (data_ != nullptr) munmap(data_, size_);
+#endif
+    data_ = nullptr;
+    size_ = 0;
+  }
+
+  char* data() const { return data_; }
+  size_t size() const { return size_; }
+
+ private:
+  char* data_ = nullptr;
+  size_t size_ = 0;
+#if defined(WIN32) || defined(_WIN32) || defined(_MSC_VER)
+  HANDLE file_ = INVALID_HANDLE_VALUE;
+  HANDLE mapping_ = NULL;
+#endif
+};
+
+#endif /* __MAPPED_FILE_HPP__ */
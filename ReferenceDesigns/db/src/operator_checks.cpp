@@ -0,0 +1,163 @@
+#include <algorithm>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "db_utils/GroupBy.hpp"
+#include "db_utils/LikeRegex.hpp"
+#include "operator_checks.hpp"
+
+//
+// The key of the GroupBy check: its hash only keeps the lowest bits of the
+// key, so that several groups share each bucket and evict each other
+//
+struct CheckGroupKey {
+  unsigned int id = 0;
+  unsigned int Hash() const { return id; }
+  bool operator==(const CheckGroupKey& other) const { return id == other.id; }
+};
+
+//
+// check every aggregate of the GroupBy operator on the host, including the
+// groups that are evicted to the spill buffer and merged back together
+//
+bool CheckGroupBy() {
+  using TestGroupBy =
+      GroupBy<CheckGroupKey, long long, 4, 2, AggregateOp::kSum,
+              AggregateOp::kCount, AggregateOp::kMin, AggregateOp::kMax,
+              AggregateOp::kAvg>;
+  using Entry = TestGroupBy::Entry;
+
+  // 12 groups in 4 buckets, in an order that evicts groups mid-stream
+  constexpr int kRows = 1000;
+  constexpr unsigned int kGroups = 12;
+  std::vector<CheckGroupKey> keys(kRows);
+  std::vector<long long> values(kRows);
+  for (int i = 0; i < kRows; i++) {
+    keys[i].id = ((i / 3) * 7) % kGroups;
+    values[i] = ((i * 7919) % 2001) - 1000;
+  }
+
+  // aggregate the rows, spilling the evicted groups and then the table
+  std::vector<Entry> spill(2 * kRows);
+  size_t count = 0;
+  TestGroupBy group_by;
+  group_by.Init();
+  for (int i = 0; i < kRows; i++) {
+    const long long v = values[i];
+    Entry evicted;
+    if (group_by.Aggregate(keys[i], {v, v, v, v, v}, evicted)) {
+      GroupBySpill(spill.data(), spill.size(), count, evicted);
+    }
+  }
+  const size_t evictions = count;
+  group_by.Flush(spill.data(), spill.size(), count);
+
+  // merge the spilled groups with the same key
+  std::vector<Entry> groups(kGroups);
+  for (size_t i = 0; i < count; i++) {
+    TestGroupBy::Merge(groups[spill[i].key.id], spill[i]);
+  }
+
+  // compare each group with the aggregates of its rows
+  bool success = evictions > 0;
+  for (unsigned int g = 0; g < kGroups; g++) {
+    long long sum = 0, rows = 0;
+    long long min = std::numeric_limits<long long>::max();
+    long long max = std::numeric_limits<long long>::lowest();
+    for (int i = 0; i < kRows; i++) {
+      if (keys[i].id == g) {
+        sum += values[i];
+        rows++;
+        min = std::min(min, values[i]);
+        max = std::max(max, values[i]);
+      }
+    }
+
+    const Entry& e = groups[g];
+    const double avg = (double)sum / rows;
+    if (!e.valid || e.count != rows || e.values[0] != sum ||
+        e.values[1] != rows || e.values[2] != min || e.values[3] != max ||
+        TestGroupBy::Average(e, 4) != avg) {
+      std::cerr << "ERROR: GroupBy group " << g << " has (SUM, COUNT, MIN, "
+                << "MAX, AVG) = (" << e.values[0] << ", " << e.values[1]
+                << ", " << e.values[2] << ", " << e.values[3] << ", "
+                << TestGroupBy::Average(e, 4) << "), expected (" << sum
+                << ", " << rows << ", " << min << ", " << max << ", " << avg
+                << ")\n";
+      success = false;
+    }
+  }
+
+  if (evictions == 0) {
+    std::cerr << "ERROR: the GroupBy check did not evict any group\n";
+  }
+
+  return success;
+}
+
+//
+// check the LIKE patterns that LikePattern parses, and the strings that
+// LikeRegex matches with them, on the host
+//
+bool CheckLikePatterns() {
+  constexpr unsigned int kWordLength = 11;
+  constexpr unsigned int kStrLength = 55;
+  const std::string kStr = "forest green lace";
+
+  // a pattern, whether it parses, and whether it matches kStr
+  const std::vector<std::tuple<std::string, bool, bool>> kPatterns = {
+      {"%green%", true, true},        {"%lace%", true, true},
+      {"%blue%", true, false},        {"forest%", true, true},
+      {"green%", true, false},        {"%lace", true, true},
+      {"%green", true, false},        {"forest green lace", false, false},
+      {"forest", true, false},        {"%", true, true},
+      {"%%", true, true},             {"", false, false},
+      {"gr%en", false, false},        {"%averylongword%", false, false}};
+
+  LikeRegex<kWordLength, kStrLength> regex;
+  for (size_t i = 0; i < kStrLength; i++) {
+    regex.str[i] = (i < kStr.size()) ? kStr[i] : '\0';
+  }
+
+  bool success = true;
+  for (const auto& [pattern, parses, matches] : kPatterns) {
+    LikePattern<kWordLength> like;
+    bool parsed = like.Parse(pattern);
+    bool matched = false;
+    if (parsed) {
+      for (size_t i = 0; i < kWordLength; i++) {
+        regex.word[i] = like.word[i];
+      }
+      regex.Match();
+      matched = regex.Matches(like.mode);
+    }
+
+    if (parsed != parses || matched != matches) {
+      std::cerr << "ERROR: LIKE '" << pattern << "' on '" << kStr << "' "
+                << (parsed ? "parsed" : "did not parse") << " and "
+                << (matched ? "matched" : "did not match") << "\n";
+      success = false;
+    }
+  }
+
+  // an exact pattern matches a string that is exactly its word
+  LikePattern<kWordLength> like;
+  like.Parse("lace");
+  const std::string kWord = "lace";
+  for (size_t i = 0; i < kStrLength; i++) {
+    regex.str[i] = (i < kWord.size()) ? kWord[i] : '\0';
+  }
+  for (size_t i = 0; i < kWordLength; i++) {
+    regex.word[i] = like.word[i];
+  }
+  regex.Match();
+  if (!regex.Matches(like.mode)) {
+    std::cerr << "ERROR: LIKE 'lace' did not match 'lace'\n";
+    success = false;
+  }
+
+  return success;
+}
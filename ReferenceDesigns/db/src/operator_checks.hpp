@@ -0,0 +1,19 @@
+#ifndef __OPERATOR_CHECKS_HPP__
+#define __OPERATOR_CHECKS_HPP__
+#pragma once
+
+//
+// Checks of the database operators that run on the host and do not need the
+// database (--check-operators). Each check prints the cases that fail to
+// std::cerr and returns whether they all passed.
+//
+
+// the SUM, COUNT, MIN, MAX and AVG aggregates of GroupBy, with groups that are
+// evicted to the spill buffer and merged back together
+bool CheckGroupBy();
+
+// the forms of LIKE pattern that LikePattern parses, and the strings that
+// LikeRegex matches with them
+bool CheckLikePatterns();
+
+#endif /* __OPERATOR_CHECKS_HPP__ */
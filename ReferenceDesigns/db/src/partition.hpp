@@ -0,0 +1,49 @@
+#ifndef __PARTITION_HPP__
+#define __PARTITION_HPP__
+#pragma once
+
+#include <algorithm>
+
+#include <sycl/sycl.hpp>
+
+#include "dbdata.hpp"
+
+//
+// A read-only buffer of the rows [begin, end) of a column and the padding rows
+// that follow them (see kPaddingRows). The padding rows belong to the next
+// partition, or are the padding rows of the table, so the kernels can read
+// them without predication. The buffer never writes back to the column.
+//
+template <typename T>
+sycl::buffer<T, 1> PartitionBuffer(const Column<T>& column, size_t begin,
+                                   size_t end) {
+  return sycl::buffer<T, 1>(column.data() + begin,
+                            sycl::range<1>(end - begin + kPaddingRows));
+}
+
+//
+// The number of LINEITEM rows a query streams through its kernels at once. The
+// query keeps 'fixed_bytes' of the other tables in device memory, and copies
+// 'row_bytes' per LINEITEM row (including its share of the ORDERS table).
+// Each of the Database::concurrent_queries queries that the QueryScheduler
+// runs at the same time gets an equal share of the device memory for its
+// fixed buffers and its partitions, which have at most 'max_rows' rows.
+// Database::partition_rows, if set, overrides the size derived from the
+// device memory.
+//
+inline size_t LineItemPartitionRows(sycl::queue& q, const Database& dbinfo,
+                                    size_t fixed_bytes, size_t row_bytes,
+                                    size_t max_rows) {
+  size_t rows = dbinfo.partition_rows;
+  if (rows == 0) {
+    size_t device_bytes =
+        q.get_device().get_info<sycl::info::device::global_mem_size>() /
+        std::max((size_t)1, dbinfo.concurrent_queries);
+    rows = (device_bytes > fixed_bytes) ? (device_bytes - fixed_bytes) /
+                                              row_bytes
+                                        : 1;
+  }
+  return std::max((size_t)1, std::min(rows, max_rows));
+}
+
+#endif /* __PARTITION_HPP__ */
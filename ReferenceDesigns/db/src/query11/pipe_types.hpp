@@ -5,11 +5,14 @@
 #include <sycl/sycl.hpp>
 #include <sycl/ext/intel/fpga_extensions.hpp>
 
+#include "../db_utils/Misc.hpp"
 #include "../db_utils/StreamingData.hpp"
 #include "../dbdata.hpp"
 
 using namespace sycl;
 
+namespace query11 {
+
 //
 // A single row of the PARTSUPPLIER table
 // with a subset of the columns (needed for this query)
@@ -26,7 +29,7 @@ class PartSupplierRow {
         availqty(v_availqty),
         supplycost(v_supplycost) {}
 
-  // NOTE: this is not true, but is key to be used by MapJoin
+  // NOTE: this is not true, but is key to be used by HashJoin
   DBIdentifier PrimaryKey() const { return suppkey; }
 
   bool valid;
@@ -93,6 +96,21 @@ class OutputData {
 
 constexpr int kJoinWinSize = 1;
 
+// the hash table of the SUPPLIER table in the join. By default, it has at most
+// one slot per SUPPLIER row of a database with the scale factor kMaxSF, so it
+// takes less on-chip memory than a map indexed by SUPPKEY. The rows of the
+// buckets that more keys hash to are joined in a second pass (HashJoin).
+// SUPPLIER_HASH_BUCKETS sets another (power of 2) number of buckets, for
+// example to trade on-chip memory for more rows joined in the second pass.
+constexpr int kSupplierBucketSize = 4;
+#if defined(SUPPLIER_HASH_BUCKETS)
+constexpr int kSupplierBuckets = SUPPLIER_HASH_BUCKETS;
+#else
+constexpr int kSupplierBuckets =
+    Pow2(Log2(kMaxSupplierTableSize / kSupplierBucketSize));
+#endif
+constexpr int kSupplierCacheDepth = 8;
+
 // pipe types
 using PartSupplierRowPipeData =
   StreamingData<PartSupplierRow, kJoinWinSize>;
@@ -108,4 +126,6 @@ using ProducePartSupplierPipe =
 using PartSupplierPartsPipe =
   pipe<class PartSupplierPartsPipeClass, SupplierPartSupplierJoinedPipeData>;
 
+}  // namespace query11
+
 #endif /* __PIPE_TYPES_H__ */
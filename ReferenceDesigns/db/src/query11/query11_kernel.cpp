@@ -1,11 +1,13 @@
 #include <stdio.h>
 
+#include <algorithm>
+#include <array>
 #include <type_traits>
 
 #include "query11_kernel.hpp"
 #include "pipe_types.hpp"
 #include "../db_utils/CachedMemory.hpp"
-#include "../db_utils/MapJoin.hpp"
+#include "../db_utils/HashJoin.hpp"
 #include "../db_utils/Misc.hpp"
 #include "../db_utils/Tuple.hpp"
 #include "../db_utils/Unroller.hpp"
@@ -15,6 +17,8 @@
 
 using namespace std::chrono;
 
+namespace query11 {
+
 // kernel class names
 class ProducePartSupplier;
 class JoinPartSupplierParts;
@@ -22,13 +26,17 @@ class Compute;
 class FifoSort;
 class ConsumeSort;
 
+// the hash table of the SUPPLIER table in the join
+using SupplierHashTable = HashTable<unsigned char, kSupplierBuckets,
+                                    kSupplierBucketSize, kSupplierCacheDepth>;
+
 ///////////////////////////////////////////////////////////////////////////////
 // sort configuration
 using SortType = OutputData;
-constexpr int kNumSortStages = CeilLog2(kPartTableSize);
+constexpr int kNumSortStages = CeilLog2(kMaxPartTableSize);
 constexpr int kSortSize = Pow2(kNumSortStages);
 
-static_assert(kPartTableSize <= kSortSize,
+static_assert(kMaxPartTableSize <= kSortSize,
               "Must be able to sort all part keys");
 
 // comparator for the sorter to sort in descending order
@@ -43,17 +51,48 @@ using SortInPipe = pipe<class SortInputPipe, SortType>;
 using SortOutPipe = pipe<class SortOutputPipe, SortType>;
 ///////////////////////////////////////////////////////////////////////////////
 
-bool SubmitQuery11(queue& q, Database& dbinfo, std::string& nation,
-                    std::vector<DBIdentifier>& partkeys,
-                    std::vector<DBDecimal>& values,
-                    double& kernel_latency, double& total_latency) {
-  // find the nationkey based on the nation name
-  assert(dbinfo.n.name_key_map.find(nation) != dbinfo.n.name_key_map.end());
-  unsigned char nationkey = dbinfo.n.name_key_map[nation];
+}  // namespace query11
+
+using namespace query11;
+
+bool PrepareQuery11(Database& dbinfo, const std::vector<std::string>& nations,
+                    Query11Plan& plan) {
+  plan = Query11Plan();
+
+  // find the nationkeys based on the nation names
+  std::vector<unsigned int> nationkeys;
+  for (auto& nation : nations) {
+    auto it = dbinfo.n.name_key_map.find(nation);
+    if (it == dbinfo.n.name_key_map.end()) {
+      std::cerr << "ERROR: unknown nation '" << nation << "'\n";
+      return false;
+    }
+    nationkeys.push_back(it->second);
+  }
+
+  // s_nationkey in (nationkeys...)
+  return plan.supplier.AddInSet(kNationKey, nationkeys);
+}
+
+bool SubmitQuery11(queue& q, Database& dbinfo, const Query11Plan& plan,
+                   std::vector<DBIdentifier>& partkeys,
+                   std::vector<DBDecimal>& values,
+                   double& kernel_latency, double& total_latency) {
+  // the predicate program is an argument of the Compute kernel
+  const auto supplier = plan.supplier;
+
+  // the values of the PARTS keys are kept in the on-chip memories of the
+  // kernels, which are sized for kMaxSF
+  if (dbinfo.p.rows > kMaxPartTableSize) {
+    std::cerr << "ERROR: Query 11 supports databases with a scale factor of "
+              << "at most " << kMaxSF << ", rebuild the design with a larger "
+              << "MAX_SF\n";
+    return false;
+  }
 
   // ensure correctly sized output buffers
-  partkeys.resize(kPartTableSize);
-  values.resize(kPartTableSize);
+  partkeys.resize(kMaxPartTableSize);
+  values.resize(kMaxPartTableSize);
 
   // create space for the input buffers
   // SUPPLIER
@@ -73,6 +112,33 @@ bool SubmitQuery11(queue& q, Database& dbinfo, std::string& nation,
   const size_t ps_rows = dbinfo.ps.rows;
   const size_t ps_iters = (ps_rows + kJoinWinSize - 1) / kJoinWinSize;
 
+  // the SUPPLIER and PARTSUPPLIER rows that the join spills to device memory
+  // for the buckets of its hash table that overflow. The join is replayed on
+  // the host to size the spill buffers for the rows that actually spill
+  const size_t s_rows = dbinfo.s.rows;
+  HashJoinSpillCounter<SupplierHashTable> spill_counter;
+  for (size_t i = 0; i < s_rows; i++) {
+    spill_counter.Build(i + 1);
+  }
+  const size_t s_spill_rows = spill_counter.BuildSpilled();
+
+  size_t ps_spill_windows = 0;
+  if (s_spill_rows > 0) {
+    for (size_t i = 0; i < ps_iters; i++) {
+      bool spill_window = false;
+      for (size_t j = i * kJoinWinSize;
+           j < std::min((i + 1) * kJoinWinSize, ps_rows); j++) {
+        spill_window |= spill_counter.Spills(dbinfo.ps.suppkey[j]);
+      }
+      ps_spill_windows += spill_window ? 1 : 0;
+    }
+  }
+
+  buffer<DBIdentifier, 1> s_spill_suppkey_buf(range<1>(s_spill_rows + 1));
+  buffer<unsigned char, 1> s_spill_nationkey_buf(range<1>(s_spill_rows + 1));
+  buffer<PartSupplierRowPipeData, 1> ps_spill_buf(
+      range<1>(ps_spill_windows + 1));
+
   // start timer
   high_resolution_clock::time_point host_start = high_resolution_clock::now();
 
@@ -80,37 +146,40 @@ bool SubmitQuery11(queue& q, Database& dbinfo, std::string& nation,
   //// JoinPartSupplierParts Kernel
   auto join_event = q.submit([&](handler& h) {
     // SUPPLIER table accessors
-    size_t s_rows = dbinfo.s.rows;
     accessor s_nationkey_accessor(s_nationkey_buf, h, read_only);
 
+    // spill accessors
+    accessor s_spill_suppkey_accessor(s_spill_suppkey_buf, h, read_write,
+                                      no_init);
+    accessor s_spill_nationkey_accessor(s_spill_nationkey_buf, h, read_write,
+                                        no_init);
+    accessor ps_spill_accessor(ps_spill_buf, h, read_write, no_init);
+
     h.single_task<JoinPartSupplierParts>([=]() [[intel::kernel_args_restrict]] {
-      // initialize the array map
-      // +1 is to account for fact that SUPPKEY is [1,kSF*10000]
-      unsigned char nation_key_map_data[kSupplierTableSize + 1];
-      bool nation_key_map_valid[kSupplierTableSize + 1];
-      for (int i = 0; i < kSupplierTableSize + 1; i++) {
-        nation_key_map_valid[i] = false;
-      }
+      // the hash table of the SUPPLIER table
+      SupplierHashTable nation_key_table;
+      nation_key_table.Clear();
 
-      // populate MapJoiner map
-      // why a map? keys may not be sequential
+      // populate the hash table
+      size_t s_spilled = 0;
       [[intel::initiation_interval(1)]]
       for (size_t i = 0; i < s_rows; i++) {
         // NOTE: based on TPCH docs, SUPPKEY is guaranteed to be unique
-        // in the range [1:kSF*10000]
+        // in the range [1:SF*10000]
         DBIdentifier s_suppkey = i + 1;
         unsigned char s_nationkey = s_nationkey_accessor[i];
-        
-        nation_key_map_data[s_suppkey] = s_nationkey;
-        nation_key_map_valid[s_suppkey] = true;
+
+        HashJoinBuild(nation_key_table, s_suppkey, s_nationkey,
+                      s_spill_suppkey_accessor, s_spill_nationkey_accessor,
+                      s_spilled);
       }
 
-      // MAPJOIN PARTSUPPLIER and SUPPLIER tables by suppkey
-      MapJoin<unsigned char, ProducePartSupplierPipe, PartSupplierRow,
-              kJoinWinSize, PartSupplierPartsPipe,
-              SupplierPartSupplierJoined>(nation_key_map_data,
-                                          nation_key_map_valid);
-      
+      // HASHJOIN PARTSUPPLIER and SUPPLIER tables by suppkey
+      HashJoin<ProducePartSupplierPipe, PartSupplierRow, kJoinWinSize,
+               PartSupplierPartsPipe, SupplierPartSupplierJoined>(
+          nation_key_table, s_spill_suppkey_accessor,
+          s_spill_nationkey_accessor, s_spilled, ps_spill_accessor);
+
       // tell downstream we are done
       PartSupplierPartsPipe::write(
           SupplierPartSupplierJoinedPipeData(true,false));
@@ -122,7 +191,7 @@ bool SubmitQuery11(queue& q, Database& dbinfo, std::string& nation,
   //// Compute Kernel
   auto compute_event = q.single_task<Compute>([=] {
     constexpr int kAccumCacheSize = 15;
-    fpga_tools::OnchipMemoryWithCache<DBDecimal, kPartTableSize, 
+    fpga_tools::OnchipMemoryWithCache<DBDecimal, kMaxPartTableSize,
                                       kAccumCacheSize> partkey_values;
 
     // initialize accumulator
@@ -133,7 +202,7 @@ bool SubmitQuery11(queue& q, Database& dbinfo, std::string& nation,
     [[intel::initiation_interval(1)]]
     while (!done) {
       bool valid_pipe_read;
-      SupplierPartSupplierJoinedPipeData pipe_data = 
+      SupplierPartSupplierJoinedPipeData pipe_data =
           PartSupplierPartsPipe::read(valid_pipe_read);
 
       done = pipe_data.done && valid_pipe_read;
@@ -142,7 +211,10 @@ bool SubmitQuery11(queue& q, Database& dbinfo, std::string& nation,
         UnrolledLoop<0, kJoinWinSize>([&](auto j) {
           SupplierPartSupplierJoined data = pipe_data.data.template get<j>();
 
-          if (data.valid && data.nationkey == nationkey) {
+          const std::array<unsigned int, kNumColumns> cols = {
+              (unsigned int)data.nationkey};
+
+          if (data.valid && supplier.Evaluate(cols)) {
             // partkeys start at 1
             DBIdentifier index = data.partkey - 1;
             DBDecimal val = data.supplycost * (DBDecimal)(data.availqty);
@@ -154,12 +226,12 @@ bool SubmitQuery11(queue& q, Database& dbinfo, std::string& nation,
     }
 
     // sort the {partkey, partvalue} pairs based on partvalue.
-    // we will send in kSortSize - kPartTableSize dummy values with a
+    // we will send in kSortSize - kMaxPartTableSize dummy values with a
     // minimum value so that they are last (sorting from highest to lowest)
     [[intel::initiation_interval(1)]]
     for (size_t i = 0; i < kSortSize; i++) {
-      size_t key = (i < kPartTableSize) ? (i + 1) : 0;
-      auto val = (i < kPartTableSize) ? partkey_values.read(i)
+      size_t key = (i < kMaxPartTableSize) ? (i + 1) : 0;
+      auto val = (i < kMaxPartTableSize) ? partkey_values.read(i)
                                       : std::numeric_limits<DBDecimal>::min();
       SortInPipe::write(OutputData(key, val));
     }
@@ -177,8 +249,8 @@ bool SubmitQuery11(queue& q, Database& dbinfo, std::string& nation,
       int i = 0;
       bool i_in_range = 0 < kSortSize;
       bool i_next_in_range = 1 < kSortSize;
-      bool i_in_parttable_range = 0 < kPartTableSize;
-      bool i_next_in_parttable_range = 1 < kPartTableSize;
+      bool i_in_parttable_range = 0 < kMaxPartTableSize;
+      bool i_next_in_parttable_range = 1 < kMaxPartTableSize;
 
       // grab all kSortSize elements from the sorter
       [[intel::initiation_interval(1)]]
@@ -195,7 +267,7 @@ bool SubmitQuery11(queue& q, Database& dbinfo, std::string& nation,
           i_in_range = i_next_in_range;
           i_next_in_range = i < kSortSize - 2;
           i_in_parttable_range = i_next_in_parttable_range;
-          i_next_in_parttable_range = i < kPartTableSize - 2;
+          i_next_in_parttable_range = i < kMaxPartTableSize - 2;
           i++;
         }
       }
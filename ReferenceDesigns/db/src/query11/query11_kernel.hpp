@@ -6,11 +6,39 @@
 #include <sycl/ext/intel/fpga_extensions.hpp>
 
 #include "../dbdata.hpp"
+#include "../db_utils/Predicate.hpp"
 
 using namespace sycl;
 
-bool SubmitQuery11(queue& q, Database& dbinfo,
-                   std::string& nation,
+namespace query11 {
+
+// the columns of a SUPPLIER row that the predicates read
+enum Column : unsigned int {
+  kNationKey,
+  kNumColumns
+};
+
+// the maximum number of predicates on the SUPPLIER table
+constexpr unsigned int kMaxSupplierPredicates = 2;
+
+}  // namespace query11
+
+//
+// The arguments of query 11, compiled into the predicate program of its
+// kernels. A plan is prepared once and can be submitted any number of times.
+//
+struct Query11Plan {
+  // the suppliers whose stock is valued
+  PredicateProgram<query11::kNumColumns, query11::kMaxSupplierPredicates>
+      supplier;
+};
+
+// prepare the plan for the suppliers of the given nations, returns false if
+// a nation is not in the NATION table
+bool PrepareQuery11(Database& dbinfo, const std::vector<std::string>& nations,
+                    Query11Plan& plan);
+
+bool SubmitQuery11(queue& q, Database& dbinfo, const Query11Plan& plan,
                    std::vector<DBIdentifier>& partkeys,
                    std::vector<DBDecimal>& values,
                    double& kernel_latency, double& total_latency);
@@ -10,6 +10,8 @@
 
 using namespace sycl;
 
+namespace query12 {
+
 //
 // A single row of the ORDERS table
 // with a subset of the columns (needed for this query)
@@ -126,4 +128,6 @@ using LineItemProducerStartPipe =
 
 #endif
 
+}  // namespace query12
+
 #endif /* __PIPE_TYPES_H__ */
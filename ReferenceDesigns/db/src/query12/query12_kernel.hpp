@@ -6,12 +6,46 @@
 #include <sycl/ext/intel/fpga_extensions.hpp>
 
 #include "../dbdata.hpp"
+#include "../db_utils/Predicate.hpp"
 
 using namespace sycl;
 
-bool SubmitQuery12(queue& q, Database& dbinfo,
-                   DBDate low_date, DBDate high_date,
-                   int shipmode1, int shipmode2,
+namespace query12 {
+
+// the columns of a joined LINEITEM and ORDERS row that the predicates read
+enum Column : unsigned int {
+  kShipMode,
+  kCommitDate,
+  kShipDate,
+  kReceiptDate,
+  kOrderPriority,
+  kNumColumns
+};
+
+// the maximum number of predicates in the WHERE clause
+constexpr unsigned int kMaxWherePredicates = 6;
+
+}  // namespace query12
+
+//
+// The arguments of query 12, compiled into the predicate programs of its
+// kernels. A plan is prepared once and can be submitted any number of times.
+//
+struct Query12Plan {
+  // the WHERE clause of the query
+  PredicateProgram<query12::kNumColumns, query12::kMaxWherePredicates> where;
+
+  // the lines counted as high priority lines, the others are low priority
+  PredicateProgram<query12::kNumColumns, 1> high_priority;
+
+  // the two shipmodes that the lines are counted for
+  int shipmode1, shipmode2;
+};
+
+bool PrepareQuery12(DBDate low_date, DBDate high_date,
+                    int shipmode1, int shipmode2, Query12Plan& plan);
+
+bool SubmitQuery12(queue& q, Database& dbinfo, const Query12Plan& plan,
                    std::array<DBDecimal, 2>& high_line_count,
                    std::array<DBDecimal, 2>& low_line_count,
                    double& kernel_latency, double& total_latency);
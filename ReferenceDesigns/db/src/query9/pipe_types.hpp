@@ -5,11 +5,14 @@
 #include <sycl/sycl.hpp>
 #include <sycl/ext/intel/fpga_extensions.hpp>
 
+#include "../db_utils/GroupBy.hpp"
 #include "../db_utils/StreamingData.hpp"
 #include "../dbdata.hpp"
 
 using namespace sycl;
 
+namespace query9 {
+
 //
 // A single row of the PARTSUPPLIER table
 // with a subset of the columns (needed for this query)
@@ -155,6 +158,8 @@ class SortData {
         suppkey(d.suppkey),
         orderdate(d.orderdate) {}
 
+  DBIdentifier PrimaryKey() const { return partkey; }
+
   bool operator<(const SortData& t) const { return partkey < t.partkey; }
   bool operator>(const SortData& t) const { return partkey > t.partkey; }
   bool operator<=(const SortData& t) const { return partkey <= t.partkey; }
@@ -222,6 +227,39 @@ constexpr int kPartSupplierDuplicatePartkeys = 4;
 constexpr int kFinalDataMaxSize =
     kPartSupplierDuplicatePartkeys * kLineItemOrdersSortedWinSize;
 
+//
+// The GROUP BY key of the query: the nation of the supplier and the year of
+// the order
+//
+class NationYear {
+ public:
+  NationYear() : nation(0), year(1992) {}
+  NationYear(unsigned char v_nation, unsigned short v_year)
+      : nation(v_nation), year(v_year) {}
+
+  // a dense hash: only the years 1992 to 1998 are in the database, so no two
+  // groups of the query share a bucket of the ProfitGroupBy
+  unsigned int Hash() const { return (year - 1992) * 25 + nation; }
+
+  bool operator==(const NationYear& other) const {
+    return nation == other.nation && year == other.year;
+  }
+
+  unsigned char nation;
+  unsigned short year;
+};
+
+// the sum of the profit of each nation and year
+constexpr int kProfitGroupBuckets = 256;
+constexpr int kProfitGroupCacheDepth = 8;
+using ProfitGroupBy = GroupBy<NationYear, DBDecimal, kProfitGroupBuckets,
+                              kProfitGroupCacheDepth, AggregateOp::kSum>;
+using ProfitGroup = ProfitGroupBy::Entry;
+
+// the groups each accumulator of the Compute kernel can write to the spill
+// buffer, its groups that are evicted and those left in it at the end
+constexpr int kProfitSpillSize = 2 * kProfitGroupBuckets;
+
 // pipe data
 using LineItemMinimalRowPipeData =
     StreamingData<LineItemMinimalRow, kLineItemJoinWinSize>;
@@ -269,4 +307,6 @@ using PartSupplierPipe =
 using FinalPipe =
     sycl::pipe<class FinalPipeClass, FinalPipeData>;
 
+}  // namespace query9
+
 #endif /* __PIPE_TYPES_H__ */
@@ -6,11 +6,33 @@
 #include <sycl/ext/intel/fpga_extensions.hpp>
 
 #include "../dbdata.hpp"
+#include "../db_utils/LikeRegex.hpp"
 
 using namespace sycl;
 
-bool SubmitQuery9(queue& q, Database& dbinfo,
-                  std::string colour,
+namespace query9 {
+
+// the maximum length of the LIKE word (including the '\0') and of P_NAME
+constexpr unsigned int kRegexWordLength = 11;
+constexpr unsigned int kPartNameLength = 55;
+
+}  // namespace query9
+
+//
+// The arguments of query 9, compiled into the arguments of its kernels. A
+// plan is prepared once and can be submitted any number of times.
+//
+struct Query9Plan {
+  // the pattern the part names are matched against
+  LikePattern<query9::kRegexWordLength> part_name;
+};
+
+// prepare the plan for a LIKE pattern of the form %WORD%, WORD% or %WORD, a
+// WORD without wildcards is matched as %WORD% (the colour of the TPCH query).
+// Returns false if the pattern is not supported.
+bool PrepareQuery9(const std::string& pattern, Query9Plan& plan);
+
+bool SubmitQuery9(queue& q, Database& dbinfo, const Query9Plan& plan,
                   std::array<DBDecimal, 25 * 2020>& sum_profit,
                   double& kernel_latency, double& total_latency);
 
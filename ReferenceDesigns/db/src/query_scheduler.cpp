@@ -0,0 +1,93 @@
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <set>
+#include <thread>
+
+#include "query_scheduler.hpp"
+
+using namespace std::chrono;
+
+void QueryScheduler::Push(unsigned int query, const std::string& args) {
+  ScheduledQuery entry;
+  entry.query = query;
+  entry.args = args;
+  queue_.push_back(entry);
+}
+
+size_t QueryScheduler::Concurrency() const {
+  std::set<unsigned int> types;
+  for (const ScheduledQuery& entry : queue_) {
+    types.insert(entry.query);
+  }
+  return types.size();
+}
+
+bool QueryScheduler::Run() {
+  // group the queue by query type, keeping the order within each type
+  std::map<unsigned int, std::vector<size_t>> pipelines;
+  for (size_t i = 0; i < queue_.size(); i++) {
+    queue_[i].success = false;
+    pipelines[queue_[i].query].push_back(i);
+  }
+
+  high_resolution_clock::time_point queue_start = high_resolution_clock::now();
+
+  // one thread per query pipeline
+  std::vector<std::thread> threads;
+  for (auto& pipeline : pipelines) {
+    const std::vector<size_t>& indices = pipeline.second;
+    threads.emplace_back([&, indices] {
+      for (size_t i : indices) {
+        ScheduledQuery& entry = queue_[i];
+        std::string args = entry.args;
+
+        duration<double, std::milli> start =
+            high_resolution_clock::now() - queue_start;
+        entry.success = run_(entry.query, args, entry.kernel_latency,
+                             entry.total_latency);
+        duration<double, std::milli> end =
+            high_resolution_clock::now() - queue_start;
+
+        entry.start_time = start.count();
+        entry.end_time = end.count();
+      }
+    });
+  }
+
+  for (auto& t : threads) {
+    t.join();
+  }
+
+  duration<double, std::milli> diff = high_resolution_clock::now() - queue_start;
+  makespan_ = diff.count();
+
+  return std::all_of(queue_.begin(), queue_.end(),
+                     [](const ScheduledQuery& e) { return e.success; });
+}
+
+void QueryScheduler::PrintReport() const {
+  std::cout << "Query schedule:\n";
+  std::cout << std::setw(6) << "#" << std::setw(8) << "query"
+            << std::setw(14) << "start (ms)" << std::setw(14) << "end (ms)"
+            << std::setw(14) << "total (ms)" << std::setw(14) << "kernel (ms)"
+            << "\n";
+
+  double serial_time = 0;
+  for (size_t i = 0; i < queue_.size(); i++) {
+    const ScheduledQuery& entry = queue_[i];
+    std::cout << std::setw(6) << i << std::setw(8) << ("Q" +
+              std::to_string(entry.query)) << std::setw(14) << entry.start_time
+              << std::setw(14) << entry.end_time << std::setw(14)
+              << entry.total_latency << std::setw(14) << entry.kernel_latency
+              << (entry.success ? "" : "  FAILED") << "\n";
+    serial_time += entry.end_time - entry.start_time;
+  }
+
+  std::cout << "Queue time: " << makespan_ << " ms\n";
+  std::cout << "Sum of query times: " << serial_time << " ms\n";
+  std::cout << "Throughput: " << (queue_.size() / makespan_) * 1e3
+            << " queries/s\n";
+}
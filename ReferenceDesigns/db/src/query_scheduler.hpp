@@ -0,0 +1,66 @@
+#ifndef __QUERY_SCHEDULER_HPP__
+#define __QUERY_SCHEDULER_HPP__
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+//
+// The result of one query in the scheduler's queue. All times are in ms.
+//
+struct ScheduledQuery {
+  unsigned int query;
+  std::string args;
+
+  bool success = false;
+  double start_time = 0;      // when it started, relative to the queue start
+  double end_time = 0;        // when it finished, relative to the queue start
+  double kernel_latency = 0;  // the kernel time reported by the query
+  double total_latency = 0;   // the processing time reported by the query
+};
+
+//
+// Runs a queue of (possibly different) queries against an already loaded
+// database. Each query has its own pipeline of kernels in the FPGA, so the
+// scheduler runs the queries of different types concurrently, one host thread
+// per type, while the queries of the same type run in the order they were
+// pushed. This overlaps the table transfers and host processing of one query
+// with the kernels of another.
+//
+class QueryScheduler {
+ public:
+  // runs a query and returns whether it succeeded, the callback must be safe
+  // to call concurrently for different queries
+  using RunFunction =
+      std::function<bool(unsigned int query, std::string& args,
+                         double& kernel_latency, double& total_latency)>;
+
+  explicit QueryScheduler(RunFunction run) : run_(run) {}
+
+  // add a query to the end of the queue
+  void Push(unsigned int query, const std::string& args = "");
+
+  // run every query in the queue and return whether they all succeeded, the
+  // queue is kept so that it can be run again
+  bool Run();
+
+  // the number of queries that run at the same time, one per query type
+  size_t Concurrency() const;
+
+  // the results of the last Run(), in the order the queries were pushed
+  const std::vector<ScheduledQuery>& Results() const { return queue_; }
+
+  // the wall clock time of the last Run() in ms
+  double Makespan() const { return makespan_; }
+
+  // print the latency of every query and the throughput of the last Run()
+  void PrintReport() const;
+
+ private:
+  RunFunction run_;
+  std::vector<ScheduledQuery> queue_;
+  double makespan_ = 0;
+};
+
+#endif /* __QUERY_SCHEDULER_HPP__ */
@@ -2,9 +2,19 @@
 #define __COMMON_HPP__
 
 #include <sycl/sycl.hpp>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <fstream>
 #include <functional>
 #include <iostream>
+#include <limits>
+#include <numeric>
 #include <optional>
+#include <string>
+#include <thread>
+#include <vector>
 #include <sycl/ext/intel/ac_types/ac_int.hpp>
 #include <sycl/ext/intel/fpga_extensions.hpp>
 
@@ -232,15 +242,74 @@ void WriteOutputFile(const std::string& filename,
   fout.close();
 }
 
+//
+// Allocates 'count' elements of type T for the kernels to read or write. When
+// targeting a BSP, this is device memory that the host accesses with
+// q.memcpy. Otherwise, it is shared memory that the host can access directly.
+//
+template <typename T>
+T* AllocateKernelMemory(sycl::queue& q, size_t count, const std::string& name) {
+#if defined (IS_BSP)
+  T* ptr = sycl::malloc_device<T>(count, q);
+#else
+  T* ptr = sycl::malloc_shared<T>(count, q);
+#endif
+  if (ptr == nullptr) {
+    std::cerr << "ERROR: could not allocate space for '" << name << "'\n";
+    std::terminate();
+  }
+  return ptr;
+}
+
+//
+// The result of one launch of the Consumer kernel (see SubmitConsumer below):
+// the number of bytes it wrote, and whether it read the 'done' signal from
+// the decompression engine.
+//
+struct ConsumerResult {
+  unsigned count;
+  bool done;
+};
+
+//
+// A part of a compressed file that can be decompressed independently of the
+// rest of the file, e.g. a GZIP member or a chunk of a framed Snappy stream.
+//
+struct DecompressUnit {
+  size_t in_offset;   // the offset of the unit in the compressed file
+  size_t in_count;    // the number of compressed bytes
+  size_t out_offset;  // the offset of the unit's output in the output file
+  size_t out_count;   // the number of decompressed bytes
+};
+
 //
 // A base class for a decmompressor
 // This class is purely virtual, i.e. another class must inherit from it and
-// override the 'DecompressBytes' function. This is done in
-// ../gzip/gzip_decompress.hpp and ../src/snappy/snappy_decompressor.hpp for the
-// GZIP and SNAPPY decompressors, respectively.
+// override the 'DecompressBytes' function and the streaming and unit
+// functions. This is done in ../gzip/gzip_decompress.hpp and
+// ../src/snappy/snappy_decompressor.hpp for the GZIP and SNAPPY decompressors,
+// respectively.
 //
 class DecompressorBase {
  public:
+  // The size of the chunks DecompressStream feeds to the producer kernel and
+  // drains from the consumer kernel. This must be a multiple of the
+  // literals_per_cycle of both the producer and the consumer.
+  static constexpr size_t kStreamChunkBytes = 1 << 20;
+
+  // The number of input chunks in flight between the host and the producer
+  // kernel. The output chunks are double-buffered.
+  static constexpr int kStreamInputBuffers = 4;
+  static constexpr int kStreamOutputBuffers = 2;
+
+  // The number of bytes at the start of the stream passed to
+  // SubmitStreamEngine.
+  static constexpr size_t kStreamHeadBytes = 16;
+
+  // The alignment of the output slot of each unit in DecompressUnits. This
+  // must be a multiple of the literals_per_cycle of the consumer.
+  static constexpr size_t kUnitSlotAlignment = 64;
+
   //
   // A virtual function that must be overriden by a deriving class.
   // The overriding function performs the actual decompression using the FPGA.
@@ -250,10 +319,261 @@ class DecompressorBase {
   virtual std::optional<std::vector<unsigned char>> DecompressBytes(
       sycl::queue&, std::vector<unsigned char>&, int, bool) = 0;
 
+  //
+  // The virtual functions used by DecompressStream below. The deriving class
+  // overrides these to:
+  //    SubmitStreamEngine: launch the decompression engine kernels for
+  //      'in_count' compressed bytes, which start with the bytes in 'head'
+  //      (e.g. to detect the format of the stream).
+  //    SubmitStreamProducer: launch the producer kernel for 'count' bytes at
+  //      'in_ptr', after the events in 'depends_on'. The bytes after 'count'
+  //      are zero up to the end of the chunk, so the count can be padded.
+  //    SubmitStreamConsumer: launch the consumer kernel to write at most
+  //      'max_count' bytes to 'out_ptr' and the ConsumerResult to 'result'.
+  //    StreamOutput: inspect each chunk of output (e.g. to compute a CRC).
+  //    FinishStream: check the stream metadata the engine produced against
+  //      the 'out_count' bytes written, and release the resources allocated
+  //      by SubmitStreamEngine. Returns whether the stream is valid.
+  //
+  virtual std::vector<sycl::event> SubmitStreamEngine(
+      sycl::queue&, size_t in_count,
+      const std::vector<unsigned char>& head) = 0;
+  virtual sycl::event SubmitStreamProducer(
+      sycl::queue&, unsigned char* in_ptr, unsigned count,
+      const std::vector<sycl::event>& depends_on) = 0;
+  virtual sycl::event SubmitStreamConsumer(
+      sycl::queue&, unsigned char* out_ptr, unsigned max_count,
+      ConsumerResult* result) = 0;
+  virtual void StreamOutput(const unsigned char*, size_t) {}
+  virtual bool FinishStream(sycl::queue&, size_t out_count) = 0;
+
+  //
+  // The virtual functions used by DecompressUnits below. The deriving class
+  // overrides these to:
+  //    NumEngines: return the number of decompression engines in the design.
+  //    IndexUnits: split the compressed file into DecompressUnits, in order.
+  //      Returns an empty list if the file cannot be split, in which case it
+  //      is decompressed with DecompressBytes.
+  //    PrepareUnits: allocate what the engines need to decompress
+  //      'unit_count' units.
+  //    SubmitUnit: launch the producer, consumer, and engine kernels of engine
+  //      'engine' to decompress unit 'unit_idx' from 'in_ptr' to 'out_ptr',
+  //      which has room for 'max_count' bytes.
+  //    CheckUnits: check the metadata the engines produced for each unit
+  //      against the decompressed output 'out_bytes'.
+  //    FreeUnits: release the resources allocated by PrepareUnits.
+  //
+  virtual int NumEngines() const = 0;
+  virtual std::vector<DecompressUnit> IndexUnits(
+      const std::vector<unsigned char>& in_bytes) = 0;
+  virtual void PrepareUnits(sycl::queue&, size_t unit_count) = 0;
+  virtual std::vector<sycl::event> SubmitUnit(
+      sycl::queue&, int engine, size_t unit_idx, const DecompressUnit& unit,
+      unsigned char* in_ptr, unsigned char* out_ptr, unsigned max_count,
+      ConsumerResult* result) = 0;
+  virtual bool CheckUnits(sycl::queue&, const std::vector<DecompressUnit>&,
+                          const std::vector<unsigned char>& out_bytes) = 0;
+  virtual void FreeUnits(sycl::queue&) = 0;
+
+  //
+  // Decompresses 'in_bytes' with DecompressUnits if IndexUnits can split it,
+  // and with DecompressBytes otherwise.
+  //
+  std::optional<std::vector<unsigned char>> Decompress(
+      sycl::queue& q, std::vector<unsigned char>& in_bytes, int runs,
+      bool print_stats) {
+    auto units = IndexUnits(in_bytes);
+    if (units.empty()) {
+      return DecompressBytes(q, in_bytes, runs, print_stats);
+    }
+    return DecompressUnits(q, in_bytes, units, runs, print_stats);
+  }
+
+  //
+  // Merges consecutive 'units' into at most 'count' units with about the same
+  // number of compressed bytes each. This is for engines that can decompress
+  // several units back to back in one launch (e.g. GZIP members), which saves
+  // launching the kernels for every unit.
+  //
+  static std::vector<DecompressUnit> MergeUnits(
+      const std::vector<DecompressUnit>& units, size_t count) {
+    std::vector<DecompressUnit> merged;
+    if (units.empty()) return merged;
+    size_t in_total = units.back().in_offset + units.back().in_count -
+                      units.front().in_offset;
+    size_t target = (in_total + count - 1) / count;
+    for (auto& unit : units) {
+      if (merged.empty() || merged.back().in_count >= target) {
+        merged.push_back(unit);
+      } else {
+        merged.back().in_count += unit.in_count;
+        merged.back().out_count += unit.out_count;
+      }
+    }
+    return merged;
+  }
+
+  //
+  // Decompresses the independent 'units' of 'in_bytes' in parallel on the
+  // NumEngines() engines and stitches their output together in order.
+  //
+  // The host launches the next unit on whichever engine finishes first, so
+  // that the engines stay busy even when the units have different sizes.
+  // Each unit is written to its own padded slot of the output buffer, so that
+  // the engines never write to the same memory, and the host copies the slots
+  // to their place in the output.
+  //
+  std::optional<std::vector<unsigned char>> DecompressUnits(
+      sycl::queue& q, std::vector<unsigned char>& in_bytes,
+      const std::vector<DecompressUnit>& units, int runs, bool print_stats) {
+    size_t in_count = in_bytes.size();
+    size_t unit_count = units.size();
+    int num_engines = NumEngines();
+
+    // the units must cover the output without gaps
+    size_t out_count = 0;
+    for (auto& unit : units) {
+      if (unit.out_offset != out_count ||
+          unit.in_offset + unit.in_count > in_count) {
+        std::cerr << "ERROR: the index of the compressed file is invalid\n";
+        return {};
+      }
+      out_count += unit.out_count;
+    }
+
+    // the output slot of each unit. The consumer writes whole elements of up
+    // to kUnitSlotAlignment bytes, and needs room for one more to read the
+    // 'done' signal.
+    std::vector<size_t> slot_offset(unit_count), slot_count(unit_count);
+    size_t out_alloc_count = 0;
+    for (size_t u = 0; u < unit_count; u++) {
+      slot_offset[u] = out_alloc_count;
+      slot_count[u] = fpga_tools::RoundUpToMultiple(units[u].out_count,
+                                                    kUnitSlotAlignment) +
+                      kUnitSlotAlignment;
+      out_alloc_count += slot_count[u];
+      if (slot_count[u] > std::numeric_limits<unsigned>::max()) {
+        std::cerr << "ERROR: unit " << u << " is too large\n";
+        return {};
+      }
+    }
+
+    std::vector<unsigned char> out_bytes(out_count);
+    std::vector<unsigned char> slots_h(out_alloc_count);
+    std::vector<ConsumerResult> results_h(unit_count);
+    std::vector<double> time_ms(runs);
+    bool passed = true;
+
+    // the producer may read up to kUnitSlotAlignment bytes past the last unit
+    unsigned char* in = AllocateKernelMemory<unsigned char>(
+        q, in_count + kUnitSlotAlignment, "in");
+    unsigned char* out = AllocateKernelMemory<unsigned char>(
+        q, std::max(out_alloc_count, (size_t)1), "out");
+    ConsumerResult* results =
+        AllocateKernelMemory<ConsumerResult>(q, unit_count, "results");
+    PrepareUnits(q, unit_count);
+
+    auto is_complete = [](sycl::event& e) {
+      return e.get_info<sycl::info::event::command_execution_status>() ==
+             sycl::info::event_command_status::complete;
+    };
+
+    try {
+      q.memcpy(in, in_bytes.data(), in_count).wait();
+
+      for (int i = 0; i < runs; i++) {
+        std::cout << "Launching kernels for run " << i << " on "
+                  << num_engines << (num_engines == 1 ? " engine" : " engines")
+                  << std::endl;
+        auto s = std::chrono::high_resolution_clock::now();
+
+        // the kernels of the unit each engine is working on
+        std::vector<std::vector<sycl::event>> engine_events(num_engines);
+        size_t next_unit = 0;
+        bool busy = true;
+        while (busy) {
+          busy = false;
+          for (int eng = 0; eng < num_engines; eng++) {
+            auto& events = engine_events[eng];
+            bool idle = std::all_of(events.begin(), events.end(), is_complete);
+            if (idle && next_unit < unit_count) {
+              size_t u = next_unit++;
+              events = SubmitUnit(q, eng, u, units[u], in + units[u].in_offset,
+                                  out + slot_offset[u], slot_count[u],
+                                  results + u);
+              idle = false;
+            }
+            busy |= !idle;
+          }
+          if (busy) std::this_thread::yield();
+        }
+
+        // copy the output back from the device and stitch it together
+        q.memcpy(slots_h.data(), out, out_alloc_count).wait();
+        q.memcpy(results_h.data(), results, unit_count * sizeof(ConsumerResult))
+            .wait();
+        for (size_t u = 0; u < unit_count; u++) {
+          std::copy_n(slots_h.begin() + slot_offset[u], units[u].out_count,
+                      out_bytes.begin() + units[u].out_offset);
+        }
+        auto e = std::chrono::high_resolution_clock::now();
+
+        std::cout << "All kernels have finished for run " << i << std::endl;
+        time_ms[i] = std::chrono::duration<double, std::milli>(e - s).count();
+
+        // validating the output
+        for (size_t u = 0; u < unit_count; u++) {
+          auto& r = results_h[u];
+          if (!r.done || r.count != units[u].out_count) {
+            std::cerr << "ERROR: Out counts do not match for unit " << u
+                      << ": " << r.count << " != " << units[u].out_count
+                      << " (result != index)\n";
+            passed = false;
+          }
+        }
+        passed &= CheckUnits(q, units, out_bytes);
+      }
+    } catch (sycl::exception const& e) {
+      std::cout << "Caught a synchronous SYCL exception: " << e.what() << "\n";
+      std::terminate();
+    }
+
+    FreeUnits(q);
+    sycl::free(in, q);
+    sycl::free(out, q);
+    sycl::free(results, q);
+
+    // print the performance results
+    if (passed && print_stats) {
+      // NOTE: when run in emulation, these results do not accurately represent
+      // the performance of the kernels on real FPGA hardware
+      double avg_time_ms;
+      if (runs > 1) {
+        avg_time_ms = std::accumulate(time_ms.begin() + 1, time_ms.end(), 0.0) /
+                      (runs - 1);
+      } else {
+        avg_time_ms = time_ms[0];
+      }
+      double out_mb = out_count * sizeof(unsigned char) * 1e-6;
+      std::cout << "Independent units: " << unit_count << "\n";
+      std::cout << "Execution time: " << avg_time_ms << " ms\n";
+      std::cout << "Output Throughput: " << (out_mb / (avg_time_ms * 1e-3))
+                << " MB/s\n";
+      std::cout << "Compression Ratio: " << (double)out_count / in_count
+                << ":1\n";
+    }
+
+    if (passed) {
+      return out_bytes;
+    } else {
+      return {};
+    }
+  }
+
   //
   // Reads the bytes in 'in_filename', decompresses them, and writes the
   // output to 'out_filename' (if write_output == true). This function uses
-  // the DecompressBytes virtual function above to do the actual decompression.
+  // Decompress above to do the actual decompression.
   //
   // Arguments:
   //    q: the SYCL queue
@@ -272,7 +592,7 @@ class DecompressorBase {
               << ((runs == 1) ? " time" : " times") << std::endl;
 
     auto in_bytes = ReadInputFile(in_filename);
-    auto result = DecompressBytes(q, in_bytes, runs, print_stats);
+    auto result = Decompress(q, in_bytes, runs, print_stats);
 
     if (result != std::nullopt) {
       if (write_output) {
@@ -287,6 +607,234 @@ class DecompressorBase {
       return false;
     }
   }
+
+  //
+  // Decompresses the bytes read from 'in' and writes the output to 'out'
+  // without holding the whole input or output in memory.
+  //
+  // The compressed data is read kStreamChunkBytes at a time into a ring of
+  // kStreamInputBuffers pinned buffers, and a producer kernel is launched for
+  // each chunk. Likewise, the consumer kernel is launched for one chunk of
+  // output at a time, alternating between kStreamOutputBuffers buffers, so
+  // that the host writes one chunk to 'out' while the kernel fills the next.
+  // The host memory used is therefore constant, and the file I/O overlaps
+  // with the kernels.
+  //
+  // 'in' must be seekable, since the engine needs the compressed size up
+  // front.
+  //
+  bool DecompressStream(sycl::queue& q, std::istream& in, std::ostream& out,
+                        bool print_stats) {
+    // find the number of compressed bytes
+    in.seekg(0, std::ios::end);
+    auto in_end = in.tellg();
+    in.seekg(0, std::ios::beg);
+    if (!in.good() || in_end <= 0) {
+      std::cerr << "ERROR: the input stream must be seekable and not empty\n";
+      return false;
+    }
+    size_t in_count = in_end;
+
+    // the first bytes of the stream, which identify its format
+    std::vector<unsigned char> head(std::min(in_count, kStreamHeadBytes));
+    in.read(reinterpret_cast<char*>(head.data()), head.size());
+    in.seekg(0, std::ios::beg);
+
+    size_t in_chunks = (in_count + kStreamChunkBytes - 1) / kStreamChunkBytes;
+
+    // the pinned host buffers that the host reads and writes. When targeting
+    // a BSP, the kernels use separate device buffers and the data is copied
+    // between them. Otherwise, the kernels access the shared buffers directly.
+    std::array<unsigned char*, kStreamInputBuffers> in_host, in_dev;
+    std::array<unsigned char*, kStreamOutputBuffers> out_host, out_dev;
+    std::array<ConsumerResult*, kStreamOutputBuffers> result_dev;
+    for (int i = 0; i < kStreamInputBuffers; i++) {
+      in_dev[i] = AllocateKernelMemory<unsigned char>(q, kStreamChunkBytes,
+                                                      "in_dev");
+#if defined (IS_BSP)
+      in_host[i] = sycl::malloc_host<unsigned char>(kStreamChunkBytes, q);
+      if (in_host[i] == nullptr) {
+        std::cerr << "ERROR: could not allocate space for 'in_host'\n";
+        std::terminate();
+      }
+#else
+      in_host[i] = in_dev[i];
+#endif
+    }
+    for (int i = 0; i < kStreamOutputBuffers; i++) {
+      out_dev[i] = AllocateKernelMemory<unsigned char>(q, kStreamChunkBytes,
+                                                       "out_dev");
+      result_dev[i] = AllocateKernelMemory<ConsumerResult>(q, 1, "result_dev");
+#if defined (IS_BSP)
+      out_host[i] = sycl::malloc_host<unsigned char>(kStreamChunkBytes, q);
+      if (out_host[i] == nullptr) {
+        std::cerr << "ERROR: could not allocate space for 'out_host'\n";
+        std::terminate();
+      }
+#else
+      out_host[i] = out_dev[i];
+#endif
+    }
+
+    auto is_complete = [](sycl::event& e) {
+      return e.get_info<sycl::info::event::command_execution_status>() ==
+             sycl::info::event_command_status::complete;
+    };
+
+    // Reads the next chunks of 'in' into the free input buffers and launches
+    // the producer kernel for them. The producer kernels run one after the
+    // other, in the order of the chunks.
+    std::array<sycl::event, kStreamInputBuffers> producer_events;
+    size_t next_in_chunk = 0;
+    auto feed_input = [&] {
+      while (next_in_chunk < in_chunks) {
+        int slot = next_in_chunk % kStreamInputBuffers;
+        if (next_in_chunk >= kStreamInputBuffers &&
+            !is_complete(producer_events[slot])) {
+          break;
+        }
+
+        size_t count = std::min(kStreamChunkBytes,
+                                in_count - next_in_chunk * kStreamChunkBytes);
+        in.read(reinterpret_cast<char*>(in_host[slot]), count);
+        if ((size_t)in.gcount() != count) {
+          std::cerr << "ERROR: could not read the input stream\n";
+          std::terminate();
+        }
+        std::memset(in_host[slot] + count, 0, kStreamChunkBytes - count);
+
+        std::vector<sycl::event> depends_on;
+        if (next_in_chunk > 0) {
+          int prev_slot = (next_in_chunk - 1) % kStreamInputBuffers;
+          depends_on.push_back(producer_events[prev_slot]);
+        }
+#if defined (IS_BSP)
+        depends_on.push_back(
+            q.memcpy(in_dev[slot], in_host[slot], kStreamChunkBytes));
+#endif
+        producer_events[slot] =
+            SubmitStreamProducer(q, in_dev[slot], count, depends_on);
+        next_in_chunk++;
+      }
+    };
+
+    size_t out_count = 0;
+    bool passed = true;
+    auto s = std::chrono::high_resolution_clock::now();
+
+    try {
+      auto engine_events = SubmitStreamEngine(q, in_count, head);
+      feed_input();
+
+      int out_slot = 0;
+      auto consumer_event = SubmitStreamConsumer(
+          q, out_dev[out_slot], kStreamChunkBytes, result_dev[out_slot]);
+
+      bool done = false;
+      while (!done) {
+        // keep the producer fed while the consumer fills the current chunk
+        feed_input();
+        if (!is_complete(consumer_event)) {
+          std::this_thread::yield();
+          continue;
+        }
+
+        ConsumerResult result;
+#if defined (IS_BSP)
+        q.memcpy(&result, result_dev[out_slot], sizeof(ConsumerResult)).wait();
+#else
+        result = *result_dev[out_slot];
+#endif
+        done = result.done;
+
+        // start draining the next chunk before writing this one
+        int next_slot = (out_slot + 1) % kStreamOutputBuffers;
+        if (!done) {
+          consumer_event = SubmitStreamConsumer(
+              q, out_dev[next_slot], kStreamChunkBytes, result_dev[next_slot]);
+        }
+
+#if defined (IS_BSP)
+        q.memcpy(out_host[out_slot], out_dev[out_slot], result.count).wait();
+#endif
+        StreamOutput(out_host[out_slot], result.count);
+        out.write(reinterpret_cast<char*>(out_host[out_slot]), result.count);
+        out_count += result.count;
+        out_slot = next_slot;
+      }
+
+      // wait for the remaining kernels to finish
+      for (auto& e : producer_events) {
+        e.wait();
+      }
+      for (auto& e : engine_events) {
+        e.wait();
+      }
+    } catch (sycl::exception const& e) {
+      std::cout << "Caught a synchronous SYCL exception: " << e.what() << "\n";
+      std::terminate();
+    }
+
+    auto e = std::chrono::high_resolution_clock::now();
+
+    passed &= FinishStream(q, out_count);
+    if (!out.good()) {
+      std::cerr << "ERROR: could not write the output stream\n";
+      passed = false;
+    }
+
+    for (int i = 0; i < kStreamInputBuffers; i++) {
+      sycl::free(in_dev[i], q);
+#if defined (IS_BSP)
+      sycl::free(in_host[i], q);
+#endif
+    }
+    for (int i = 0; i < kStreamOutputBuffers; i++) {
+      sycl::free(out_dev[i], q);
+      sycl::free(result_dev[i], q);
+#if defined (IS_BSP)
+      sycl::free(out_host[i], q);
+#endif
+    }
+
+    // print the performance results
+    if (passed && print_stats) {
+      // NOTE: when run in emulation, these results do not accurately represent
+      // the performance of the kernels on real FPGA hardware
+      double time_ms = std::chrono::duration<double, std::milli>(e - s).count();
+      double out_mb = out_count * sizeof(unsigned char) * 1e-6;
+      std::cout << "Execution time: " << time_ms << " ms\n";
+      std::cout << "Output Throughput: " << (out_mb / (time_ms * 1e-3))
+                << " MB/s\n";
+      std::cout << "Compression Ratio: " << (double)out_count / in_count
+                << ":1\n";
+    }
+
+    return passed;
+  }
+
+  //
+  // Decompresses 'in_filename' to 'out_filename' with DecompressStream.
+  //
+  bool DecompressFileStreaming(sycl::queue& q, const std::string& in_filename,
+                               const std::string& out_filename,
+                               bool print_stats) {
+    std::cout << "Streaming decompression of '" << in_filename << "' to '"
+              << out_filename << "'" << std::endl;
+
+    std::ifstream fin(in_filename, std::ios::binary);
+    if (!fin.good() || !fin.is_open()) {
+      std::cerr << "ERROR: could not open " << in_filename << " for reading\n";
+      std::terminate();
+    }
+    std::ofstream fout(out_filename, std::ios::binary);
+    if (!fout.good() || !fout.is_open()) {
+      std::cerr << "ERROR: could not open " << out_filename << " for writing\n";
+      std::terminate();
+    }
+
+    return DecompressStream(q, fin, fout, print_stats);
+  }
 };
 
 //
@@ -307,13 +855,17 @@ class DecompressorBase {
 //      to the input pipe. In this design, we pad the size to be a multiple of
 //      literals_per_cycle.
 //    in_ptr: a pointer to the input data
+//    depends_on: the events the kernel must wait for before it starts. The
+//      streaming decompression uses this to launch the producer for each
+//      chunk of input in order.
 //
 template <typename Id, typename InPipe, unsigned literals_per_cycle>
 sycl::event SubmitProducer(sycl::queue& q, unsigned in_count_padded,
-                           unsigned char* in_ptr) {
+                           unsigned char* in_ptr,
+                           const std::vector<sycl::event>& depends_on = {}) {
   assert(in_count_padded % literals_per_cycle == 0);
   auto iteration_count = in_count_padded / literals_per_cycle;
-  return q.single_task<Id>([=] {
+  return q.single_task<Id>(depends_on, [=] {
     // Use the MemoryToPipe utility to read from in_ptr 'literals_per_cycle'
     // elements at once and write them to 'InPipe'.
     // The 'false' template argument is our way of guaranteeing to the library
@@ -339,7 +891,11 @@ sycl::event SubmitProducer(sycl::queue& q, unsigned in_count_padded,
 
 //
 // Same idea as SubmitProducer but in the opposite direction. Data is streamed
-// from the SYCL pipe (OutPipe) and written to memory (out_ptr).
+// from the SYCL pipe (OutPipe) and written to memory (out_ptr), until either
+// the decompression engine signals that it is done or out_ptr is full. The
+// number of bytes written, and whether the engine is done, are written to
+// 'result'. When the output is larger than 'max_count', the kernel is launched
+// again to read the rest (see DecompressorBase::DecompressStream).
 //
 //  Template parameters:
 //    Id: the type to use for the kernel ID
@@ -350,44 +906,53 @@ sycl::event SubmitProducer(sycl::queue& q, unsigned in_count_padded,
 //
 //  Arguments:
 //    q: the SYCL queue
-//    out_count_padded: the total number of bytes to read from input pipe and
-//      write to out_ptr. In this design, we pad the size to be a multiple of
+//    max_count: the size of out_ptr. This must be a multiple of
 //      literals_per_cycle.
 //    out_ptr: a pointer to the output data
+//    result: where to write the number of bytes written and whether the
+//      'done' signal was read
 //
 template <typename Id, typename OutPipe, unsigned literals_per_cycle>
-sycl::event SubmitConsumer(sycl::queue& q, unsigned out_count_padded,
-                           unsigned char* out_ptr) {
-  assert(out_count_padded % literals_per_cycle == 0);
-  auto iteration_count = out_count_padded / literals_per_cycle;
+sycl::event SubmitConsumer(sycl::queue& q, unsigned max_count,
+                           unsigned char* out_ptr, ConsumerResult* result) {
+  assert(max_count % literals_per_cycle == 0);
+  auto iteration_count = max_count / literals_per_cycle;
   return q.single_task<Id>([=] {
-    // Use the PipeToMemory utility to read 'literals_per_cycle'
-    // elements at once from 'OutPipe' and write them to 'out_ptr'.
-    // For details about the 'false' template parameter, see the SubmitProducer
-    // function above.
-
 #if defined (IS_BSP)
     // When targeting a BSP, we instruct the compiler that this pointer
     // lives on the device.
     // Knowing this, the compiler won't generate hardware to
     // potentially get data from the host.
     sycl::ext::intel::device_ptr<unsigned char> out(out_ptr);
+    sycl::ext::intel::device_ptr<ConsumerResult> result_ptr(result);
 #else
     // Device pointers are not supported when targeting an FPGA 
     // family/part
     unsigned char* out(out_ptr);
+    ConsumerResult* result_ptr(result);
 #endif
-    
-    fpga_tools::PipeToMemory<OutPipe, literals_per_cycle, false>(
-        out, iteration_count);
 
-    // read the last 'done' signal
+    // Every element from the engine holds 'literals_per_cycle' valid bytes,
+    // except for the last one before the 'done' signal. Therefore, element 'i'
+    // always goes to out[i * literals_per_cycle], and the byte count is only
+    // needed for the last one.
+    unsigned i = 0;
+    unsigned count = 0;
     bool done = false;
-    while (!done) {
-      bool valid;
-      auto d = OutPipe::read(valid);
-      done = d.flag && valid;
+    while (!done && i < iteration_count) {
+      auto d = OutPipe::read();
+      done = d.flag;
+      if (!done) {
+#pragma unroll
+        for (unsigned j = 0; j < literals_per_cycle; j++) {
+          out[i * literals_per_cycle + j] = d.data[j];
+        }
+        count = i * literals_per_cycle + d.data.valid_count;
+        i++;
+      }
     }
+
+    result_ptr[0] = ConsumerResult{count, done};
   });
 }
 
@@ -2,7 +2,9 @@
 #define __SIMPLE_CRC32_HPP__
 
 //
-// A simple CRC-32 implementation (not optimized for high performance).
+// A simple CRC-32 implementation. It processes 8 bytes per iteration with
+// slice-by-8 tables, which is enough to keep the validation of large outputs
+// from dominating the run time.
 // Compute CRC-32 on 'len' elements in 'buf', starting with a CRC of 'init'.
 //
 // Arguments:
@@ -12,10 +14,12 @@
 //    len: the number of bytes pointer to by 'buf'
 //
 unsigned int SimpleCRC32(unsigned init, const void* buf, size_t len) {
-  // generate the 256-element table
+  // generate the 8 256-element tables. table[0] is the byte-wise CRC table,
+  // table[k][b] is the CRC of byte 'b' followed by 'k' zero bytes.
   constexpr uint32_t polynomial = 0xEDB88320;
+  constexpr int kSlices = 8;
   constexpr auto table = [] {
-    std::array<uint32_t, 256> a{};
+    std::array<std::array<uint32_t, 256>, kSlices> a{};
     for (uint32_t i = 0; i < 256; i++) {
       uint32_t c = i;
       for (uint32_t j = 0; j < 8; j++) {
@@ -25,16 +29,32 @@ unsigned int SimpleCRC32(unsigned init, const void* buf, size_t len) {
           c >>= 1;
         }
       }
-      a[i] = c;
+      a[0][i] = c;
+    }
+    for (int k = 1; k < kSlices; k++) {
+      for (uint32_t i = 0; i < 256; i++) {
+        a[k][i] = (a[k - 1][i] >> 8) ^ a[0][a[k - 1][i] & 0xFF];
+      }
     }
     return a;
   }();
 
-  // compute the CRC-32 for the input data
+  // compute the CRC-32 for the input data, 8 bytes at a time
   unsigned c = init ^ 0xFFFFFFFF;
   const uint8_t* u = static_cast<const uint8_t*>(buf);
-  for (size_t i = 0; i < len; i++) {
-    c = table[(c ^ u[i]) & 0xFF] ^ (c >> 8);
+  size_t i = 0;
+  for (; i + kSlices <= len; i += kSlices) {
+    uint32_t lo = c ^ ((uint32_t)u[i] | ((uint32_t)u[i + 1] << 8) |
+                       ((uint32_t)u[i + 2] << 16) | ((uint32_t)u[i + 3] << 24));
+    uint32_t hi = (uint32_t)u[i + 4] | ((uint32_t)u[i + 5] << 8) |
+                  ((uint32_t)u[i + 6] << 16) | ((uint32_t)u[i + 7] << 24);
+    c = table[7][lo & 0xFF] ^ table[6][(lo >> 8) & 0xFF] ^
+        table[5][(lo >> 16) & 0xFF] ^ table[4][lo >> 24] ^
+        table[3][hi & 0xFF] ^ table[2][(hi >> 8) & 0xFF] ^
+        table[1][(hi >> 16) & 0xFF] ^ table[0][hi >> 24];
+  }
+  for (; i < len; i++) {
+    c = table[0][(c ^ u[i]) & 0xFF] ^ (c >> 8);
   }
   return c ^ 0xFFFFFFFF;
 }
@@ -14,15 +14,24 @@
 #include "gzip_metadata_reader.hpp"
 #include "huffman_decoder.hpp"
 #include "metaprogramming_utils.hpp"  // included from ../../../../include
+#include "unrolled_loop.hpp"         // included from ../../../../include
 
-// declare the kernel and pipe names globally to reduce name mangling
+// declare the kernel and pipe names globally to reduce name mangling. They are
+// templated on the index of the engine, since the design can have several.
+template <int engine_id>
 class GzipMetadataReaderKernelID;
+template <int engine_id>
 class HuffmanDecoderKernelID;
+template <int engine_id>
 class LZ77DecoderKernelID;
+template <int engine_id>
 class ByteStackerKernelID;
 
+template <int engine_id>
 class GzipMetadataToHuffmanPipeID;
+template <int engine_id>
 class HuffmanToLZ77PipeID;
+template <int engine_id>
 class LZ77ToByteStackerPipeID;
 
 // the depth of the pipe between the Huffman decoder and the LZ77 decoder.
@@ -30,6 +39,136 @@ class LZ77ToByteStackerPipeID;
 // decoder can computing while the LZ77 kernel reads from the history buffer
 constexpr int kHuffmanToLZ77PipeDepth = 64;
 
+// the maximum number of GZIP members whose footers are kept for validation.
+// A file can have more members than this. Those members are not checked one at
+// a time, but they are part of the combined footer of all of the members (see
+// CombineGzipFooters), which is checked against the whole output.
+constexpr unsigned kGzipMaxMembers = 1 << 16;
+
+//
+// Checks each GZIP member's CRC-32 and size against the part of the
+// 'out_count' bytes of decompressed output at 'out' it produced. The members
+// are back to back in the output, in order. When there are more members than
+// 'footers', the whole output is also checked against 'combined_footer'.
+// Returns whether all of the members are valid.
+//
+bool CheckGzipMembers(const unsigned char *out, size_t out_count,
+                      const std::vector<GzipFooterData> &footers,
+                      const GzipFooterData &combined_footer,
+                      unsigned member_count) {
+  bool passed = true;
+  size_t offset = 0;
+  for (size_t m = 0; m < footers.size(); m++) {
+    if (footers[m].size > out_count - offset) {
+      std::cerr << "ERROR: member " << m << " is larger than the remaining "
+                << "output (" << footers[m].size << " > "
+                << (out_count - offset) << ")\n";
+      return false;
+    }
+
+    auto crc32_out = SimpleCRC32(0, out + offset, footers[m].size);
+    if (crc32_out != footers[m].crc) {
+      auto save_flags = std::cerr.flags();
+      std::cerr << std::hex << std::setw(4) << std::setfill('0');
+      std::cerr << "ERROR: output data CRC of member " << std::dec << m
+                << std::hex << " does not match the expected CRC "
+                << "0x" << crc32_out << " != 0x" << footers[m].crc
+                << " (result != expected)\n";
+      std::cerr.flags(save_flags);
+      passed = false;
+    }
+    offset += footers[m].size;
+  }
+
+  // all of the output must belong to a member, unless some members were not
+  // recorded
+  if (member_count <= footers.size() && offset != out_count) {
+    std::cerr << "ERROR: Out counts do not match: " << offset
+              << " != " << out_count << " (members != output)\n";
+    passed = false;
+  }
+
+  // check the members that were not recorded with the combined footer. The
+  // ISIZE field of a member is its size modulo 2^32, so the sizes can only be
+  // checked modulo 2^32.
+  if (member_count > footers.size()) {
+    if (combined_footer.size != (uint32_t)out_count) {
+      std::cerr << "ERROR: Out counts do not match: " << combined_footer.size
+                << " != " << (uint32_t)out_count
+                << " (mod 2^32) (members != output)\n";
+      passed = false;
+    }
+    auto crc32_out = SimpleCRC32(0, out, out_count);
+    if (crc32_out != combined_footer.crc) {
+      auto save_flags = std::cerr.flags();
+      std::cerr << std::hex << std::setw(4) << std::setfill('0');
+      std::cerr << "ERROR: output data CRC does not match the expected CRC "
+                << "0x" << crc32_out << " != 0x" << combined_footer.crc
+                << " (result != expected)\n";
+      std::cerr.flags(save_flags);
+      passed = false;
+    }
+  }
+  return passed;
+}
+
+//
+// Finds the members of a BGZF file, the blocked GZIP format written by
+// 'bgzip' (see the README). Each BGZF member has a 'BC' subfield in its header
+// that holds the compressed size of the member, so the members are found
+// without decoding them. Returns an empty list if 'in_bytes' is not a BGZF
+// file.
+//
+std::vector<DecompressUnit> IndexBgzfMembers(
+    const std::vector<unsigned char> &in_bytes) {
+  auto read_le = [&](size_t idx, int bytes) {
+    size_t val = 0;
+    for (int i = 0; i < bytes; i++) {
+      val |= (size_t)(in_bytes[idx + i]) << (i * 8);
+    }
+    return val;
+  };
+
+  std::vector<DecompressUnit> members;
+  size_t in_count = in_bytes.size();
+  size_t offset = 0;
+  size_t out_offset = 0;
+  while (offset < in_count) {
+    // the fixed header, the extra field length (XLEN), and the footer
+    constexpr size_t kMinMemberBytes = 10 + 2 + 8;
+    if (in_count - offset < kMinMemberBytes || in_bytes[offset] != 0x1f ||
+        in_bytes[offset + 1] != 0x8b || in_bytes[offset + 2] != 8 ||
+        (in_bytes[offset + 3] & 0x04) == 0) {
+      return {};
+    }
+
+    // look for the 'BC' subfield in the extra field
+    size_t field = offset + 12;
+    size_t extra_end = field + read_le(offset + 10, 2);
+    size_t member_bytes = 0;
+    if (extra_end > in_count) return {};
+    while (field + 4 <= extra_end) {
+      size_t field_len = read_le(field + 2, 2);
+      if (in_bytes[field] == 'B' && in_bytes[field + 1] == 'C' &&
+          field_len == 2 && field + 6 <= extra_end) {
+        member_bytes = read_le(field + 4, 2) + 1;
+      }
+      field += 4 + field_len;
+    }
+    if (member_bytes < extra_end - offset + 8 ||
+        member_bytes > in_count - offset) {
+      return {};
+    }
+
+    // the uncompressed size is the last 4 bytes of the member
+    size_t out_count = read_le(offset + member_bytes - 4, 4);
+    members.push_back({offset, member_bytes, out_offset, out_count});
+    offset += member_bytes;
+    out_offset += out_count;
+  }
+  return members;
+}
+
 //
 // Submits the kernels for the GZIP decompression engine and returns a list of
 // SYCL events from each kernel launch.
@@ -41,18 +180,25 @@ constexpr int kHuffmanToLZ77PipeDepth = 64;
 //    literals_per_cycle: the maximum number of literals written to the output
 //      stream every cycle. This sets how many literals can be read from the
 //      LZ77 history buffer at once.
+//    engine_id: the index of the engine, which sets the kernel and pipe names
 //
 //  Arguments:
 //    q: the SYCL queue
 //    in_count: the number of compressed bytes
-//    hdr_data_out: a output buffer for the GZIP header data
-//    crc_out: an output buffer for the CRC in the GZIP footer
-//    count_out: an output buffer for the uncompressed size in the GZIP footer
+//    hdr_data_out: a output buffer for the GZIP header data of the first member
+//    footers_out: an output buffer for the GZIP footer (CRC and uncompressed
+//      size) of each member
+//    max_footers: the number of footers that fit in 'footers_out'
+//    combined_footer_out: an output buffer for the footers of all of the
+//      members combined (see CombineGzipFooters)
+//    member_count_out: an output buffer for the number of GZIP members
 //
-template <typename InPipe, typename OutPipe, unsigned literals_per_cycle>
+template <typename InPipe, typename OutPipe, unsigned literals_per_cycle,
+          int engine_id = 0>
 std::vector<sycl::event> SubmitGzipDecompressKernels(
-    sycl::queue &q, int in_count, GzipHeaderData *hdr_data_out, int *crc_out,
-    int *count_out) {
+    sycl::queue &q, size_t in_count, GzipHeaderData *hdr_data_out,
+    GzipFooterData *footers_out, unsigned max_footers,
+    GzipFooterData *combined_footer_out, unsigned *member_count_out) {
   // check that the input and output pipe types are actually pipes
   static_assert(fpga_tools::is_sycl_pipe_v<InPipe>);
   static_assert(fpga_tools::is_sycl_pipe_v<OutPipe>);
@@ -63,83 +209,107 @@ std::vector<sycl::event> SubmitGzipDecompressKernels(
 
   // the inter-kernel pipes for the GZIP decompression engine
   using GzipMetadataToHuffmanPipe =
-      sycl::ext::intel::pipe<GzipMetadataToHuffmanPipeID,
+      sycl::ext::intel::pipe<GzipMetadataToHuffmanPipeID<engine_id>,
                              FlagBundle<ByteSet<1>>>;
   using HuffmanToLZ77Pipe =
-      sycl::ext::intel::pipe<HuffmanToLZ77PipeID, FlagBundle<GzipLZ77InputData>,
+      sycl::ext::intel::pipe<HuffmanToLZ77PipeID<engine_id>,
+                             FlagBundle<GzipLZ77InputData>,
                              kHuffmanToLZ77PipeDepth>;
 
   // submit the GZIP decompression kernels
   auto header_event =
-      SubmitGzipMetadataReader<GzipMetadataReaderKernelID, InPipe,
-                               GzipMetadataToHuffmanPipe>(
-          q, in_count, hdr_data_out, crc_out, count_out);
+      SubmitGzipMetadataReader<GzipMetadataReaderKernelID<engine_id>, InPipe,
+                               GzipMetadataToHuffmanPipe>(q, in_count,
+                                                          hdr_data_out);
   auto huffman_event =
-      SubmitHuffmanDecoder<HuffmanDecoderKernelID, GzipMetadataToHuffmanPipe,
-                           HuffmanToLZ77Pipe>(q);
+      SubmitHuffmanDecoder<HuffmanDecoderKernelID<engine_id>,
+                           GzipMetadataToHuffmanPipe, HuffmanToLZ77Pipe>(
+          q, footers_out, max_footers, combined_footer_out, member_count_out);
 
   // the design only needs a ByteStacker kernel when literals_per_cycle > 1
   if constexpr (literals_per_cycle > 1) {
     using LZ77ToByteStackerPipe =
-        sycl::ext::intel::pipe<LZ77ToByteStackerPipeID,
+        sycl::ext::intel::pipe<LZ77ToByteStackerPipeID<engine_id>,
                                FlagBundle<BytePack<literals_per_cycle>>>;
 
     auto lz77_event =
-        SubmitLZ77Decoder<LZ77DecoderKernelID, HuffmanToLZ77Pipe,
+        SubmitLZ77Decoder<LZ77DecoderKernelID<engine_id>, HuffmanToLZ77Pipe,
                           LZ77ToByteStackerPipe, literals_per_cycle,
                           kGzipMaxLZ77Distance, kGzipMaxLZ77Length>(q);
     auto byte_stacker_event =
-        SubmitByteStacker<ByteStackerKernelID, LZ77ToByteStackerPipe, OutPipe,
-                          literals_per_cycle>(q);
+        SubmitByteStacker<ByteStackerKernelID<engine_id>, LZ77ToByteStackerPipe,
+                          OutPipe, literals_per_cycle>(q);
 
     return {header_event, huffman_event, lz77_event, byte_stacker_event};
   } else {
     auto lz77_event =
-        SubmitLZ77Decoder<LZ77DecoderKernelID, HuffmanToLZ77Pipe, OutPipe,
-                          literals_per_cycle, kGzipMaxLZ77Distance,
+        SubmitLZ77Decoder<LZ77DecoderKernelID<engine_id>, HuffmanToLZ77Pipe,
+                          OutPipe, literals_per_cycle, kGzipMaxLZ77Distance,
                           kGzipMaxLZ77Length>(q);
     return {header_event, huffman_event, lz77_event};
   }
 }
 
 // declare kernel and pipe names at the global scope to reduce name mangling
+template <int engine_id>
 class ProducerId;
+template <int engine_id>
 class ConsumerId;
+template <int engine_id>
 class InPipeId;
+template <int engine_id>
 class OutPipeId;
 
-// the input and output pipe
-using InPipe = sycl::ext::intel::pipe<InPipeId, ByteSet<1>>;
-using OutPipe =
-    sycl::ext::intel::pipe<OutPipeId, FlagBundle<BytePack<kLiteralsPerCycle>>>;
+// the input and output pipe of each engine
+template <int engine_id>
+using InPipe = sycl::ext::intel::pipe<InPipeId<engine_id>, ByteSet<1>>;
+template <int engine_id>
+using OutPipe = sycl::ext::intel::pipe<OutPipeId<engine_id>,
+                                       FlagBundle<BytePack<kLiteralsPerCycle>>>;
 
 //
 // The GZIP decompressor. See ../common/common.hpp for more information.
+// 'num_engines' is the number of decompression engines used by
+// DecompressUnits. DecompressBytes and DecompressStream use the first one.
 //
-template <unsigned literals_per_cycle>
+template <unsigned literals_per_cycle, int num_engines>
 class GzipDecompressor : public DecompressorBase {
+  static_assert(num_engines > 0);
+  static_assert(kUnitSlotAlignment % literals_per_cycle == 0);
+
  public:
   std::optional<std::vector<unsigned char>> DecompressBytes(
       sycl::queue &q, std::vector<unsigned char> &in_bytes, int runs,
       bool print_stats) {
     int in_count = in_bytes.size();
 
-    // read the expected output size from the last 4 bytes of the file
+    // read the expected output size from the last 4 bytes of the file. For a
+    // file with multiple members, this is only the size of the last member, so
+    // the output buffer may fill up before the engine is done. In that case,
+    // the output is drained from it and the consumer is launched again.
     std::vector<unsigned char> last_4_bytes(in_bytes.end() - 4, in_bytes.end());
     unsigned out_count = *(reinterpret_cast<unsigned *>(last_4_bytes.data()));
-    std::vector<unsigned char> out_bytes(out_count);
+    std::vector<unsigned char> out_bytes;
 
     // round up the output count to the nearest multiple of literals_per_cycle,
     // which allows us to not predicate the last writes to the output buffer
-    // from the device.
+    // from the device. The consumer needs room for one more element to read
+    // the 'done' signal from the engine in the same launch. The buffer is at
+    // least kStreamChunkBytes, so that a small last member does not make the
+    // consumer drain the output a few bytes at a time.
     int out_count_padded =
         fpga_tools::RoundUpToMultiple(out_count, literals_per_cycle);
+    int out_alloc_count =
+        std::max(out_count_padded, (int)kStreamChunkBytes) + literals_per_cycle;
 
     // the GZIP header data. This is parsed by the GZIPMetadataReader kernel
     GzipHeaderData hdr_data_h;
 
-    // the GZIP footer data. This is parsed by the GZIPMetadataReader kernel.
-    unsigned int crc_h, count_h;
+    // the GZIP footer data of each member. This is parsed by the
+    // HuffmanDecoder kernel.
+    unsigned member_count_h = 0;
+    std::vector<GzipFooterData> footers_h;
+    GzipFooterData combined_footer_h;
 
     // track timing information in ms
     std::vector<double> time_ms(runs);
@@ -147,12 +317,17 @@ class GzipDecompressor : public DecompressorBase {
     // input and output data pointers on the device using USM device allocations
     unsigned char *in, *out;
 
+    // the number of bytes written by the consumer kernel
+    ConsumerResult *consumer_result;
+
     // the GZIP header data (see gzip_header_data.hpp)
     GzipHeaderData *hdr_data;
 
-    // the GZIP footer data, where 'count' is the expected number of bytes
-    // in the uncompressed file
-    int *crc, *count;
+    // the GZIP footer data of each member, of all of the members combined,
+    // and the number of members
+    GzipFooterData *footers;
+    GzipFooterData *combined_footer;
+    unsigned *member_count;
 
     bool passed = true;
 
@@ -163,7 +338,7 @@ class GzipDecompressor : public DecompressorBase {
         std::cerr << "ERROR: could not allocate space for 'in'\n";
         std::terminate();
       }
-      if ((out = sycl::malloc_device<unsigned char>(out_count_padded, q)) ==
+      if ((out = sycl::malloc_device<unsigned char>(out_alloc_count, q)) ==
           nullptr) {
         std::cerr << "ERROR: could not allocate space for 'out'\n";
         std::terminate();
@@ -172,21 +347,13 @@ class GzipDecompressor : public DecompressorBase {
         std::cerr << "ERROR: could not allocate space for 'hdr_data'\n";
         std::terminate();
       }
-      if ((crc = sycl::malloc_device<int>(1, q)) == nullptr) {
-        std::cerr << "ERROR: could not allocate space for 'crc'\n";
-        std::terminate();
-      }
-      if ((count = sycl::malloc_device<int>(1, q)) == nullptr) {
-        std::cerr << "ERROR: could not allocate space for 'count'\n";
-        std::terminate();
-      }
 #else
       // allocate shared memory 
       if ((in = sycl::malloc_shared<unsigned char>(in_count, q)) == nullptr) {
         std::cerr << "ERROR: could not allocate space for 'in'\n";
         std::terminate();
       }
-      if ((out = sycl::malloc_shared<unsigned char>(out_count_padded, q)) ==
+      if ((out = sycl::malloc_shared<unsigned char>(out_alloc_count, q)) ==
           nullptr) {
         std::cerr << "ERROR: could not allocate space for 'out'\n";
         std::terminate();
@@ -195,15 +362,14 @@ class GzipDecompressor : public DecompressorBase {
         std::cerr << "ERROR: could not allocate space for 'hdr_data'\n";
         std::terminate();
       }
-      if ((crc = sycl::malloc_shared<int>(1, q)) == nullptr) {
-        std::cerr << "ERROR: could not allocate space for 'crc'\n";
-        std::terminate();
-      }
-      if ((count = sycl::malloc_shared<int>(1, q)) == nullptr) {
-        std::cerr << "ERROR: could not allocate space for 'count'\n";
-        std::terminate();
-      }
 #endif
+      consumer_result =
+          AllocateKernelMemory<ConsumerResult>(q, 1, "consumer_result");
+      footers =
+          AllocateKernelMemory<GzipFooterData>(q, kGzipMaxMembers, "footers");
+      combined_footer =
+          AllocateKernelMemory<GzipFooterData>(q, 1, "combined_footer");
+      member_count = AllocateKernelMemory<unsigned>(q, 1, "member_count");
 
       // copy the input data to the device memory and wait for the copy to
       // finish
@@ -214,19 +380,40 @@ class GzipDecompressor : public DecompressorBase {
         std::cout << "Launching kernels for run " << i << std::endl;
 
         auto producer_event =
-            SubmitProducer<ProducerId, InPipe, 1>(q, in_count, in);
+            SubmitProducer<ProducerId<0>, InPipe<0>, 1>(q, in_count, in);
         auto consumer_event =
-            SubmitConsumer<ConsumerId, OutPipe, literals_per_cycle>(
-                q, out_count_padded, out);
+            SubmitConsumer<ConsumerId<0>, OutPipe<0>, literals_per_cycle>(
+                q, out_alloc_count, out, consumer_result);
 
         auto gzip_decompress_events =
-            SubmitGzipDecompressKernels<InPipe, OutPipe, literals_per_cycle>(
-                q, in_count, hdr_data, crc, count);
+            SubmitGzipDecompressKernels<InPipe<0>, OutPipe<0>,
+                                        literals_per_cycle>(
+                q, in_count, hdr_data, footers, kGzipMaxMembers,
+                combined_footer, member_count);
 
         auto s = std::chrono::high_resolution_clock::now();
         producer_event.wait();
-        consumer_event.wait();
-        auto e = std::chrono::high_resolution_clock::now();
+
+        // drain the output until the engine is done. For a single member file,
+        // the first launch of the consumer reads all of it.
+        std::chrono::high_resolution_clock::time_point e;
+        ConsumerResult result;
+        out_bytes.clear();
+        do {
+          consumer_event.wait();
+          q.memcpy(&result, consumer_result, sizeof(ConsumerResult)).wait();
+          if (result.done) {
+            e = std::chrono::high_resolution_clock::now();
+          } else {
+            // copy the output out of the full buffer before reusing it
+            size_t prev_size = out_bytes.size();
+            out_bytes.resize(prev_size + result.count);
+            q.memcpy(out_bytes.data() + prev_size, out, result.count).wait();
+            consumer_event =
+                SubmitConsumer<ConsumerId<0>, OutPipe<0>, literals_per_cycle>(
+                    q, out_alloc_count, out, consumer_result);
+          }
+        } while (!result.done);
 
         // wait for the decompression kernels to finish
         for (auto &e : gzip_decompress_events) {
@@ -239,11 +426,19 @@ class GzipDecompressor : public DecompressorBase {
         time_ms[i] = std::chrono::duration<double, std::milli>(e - s).count();
 
         // Copy the output back from the device
-        q.memcpy(out_bytes.data(), out, out_count * sizeof(unsigned char))
+        size_t prev_size = out_bytes.size();
+        out_bytes.resize(prev_size + result.count);
+        q.memcpy(out_bytes.data() + prev_size, out,
+                 result.count * sizeof(unsigned char))
             .wait();
         q.memcpy(&hdr_data_h, hdr_data, sizeof(GzipHeaderData)).wait();
-        q.memcpy(&crc_h, crc, sizeof(int)).wait();
-        q.memcpy(&count_h, count, sizeof(int)).wait();
+        q.memcpy(&member_count_h, member_count, sizeof(unsigned)).wait();
+        footers_h.resize(std::min(member_count_h, kGzipMaxMembers));
+        q.memcpy(footers_h.data(), footers,
+                 footers_h.size() * sizeof(GzipFooterData))
+            .wait();
+        q.memcpy(&combined_footer_h, combined_footer, sizeof(GzipFooterData))
+            .wait();
 
         // validating the output
         // check the magic header we read
@@ -256,27 +451,15 @@ class GzipDecompressor : public DecompressorBase {
           passed = false;
         }
 
-        // check the number of bytes we read
-        if (count_h != out_count) {
-          std::cerr << "ERROR: Out counts do not match: " << count_h
-                    << " != " << out_count << "(count_h != out_count)\n";
-          passed = false;
-        }
-
-        // compute the CRC of the output data
-        auto crc32_out = SimpleCRC32(0, out_bytes.data(), out_count);
-
-        // check that the computed CRC matches the expectation (crc_h is the
-        // CRC-32 that is in the GZIP footer).
-        if (crc32_out != crc_h) {
-          auto save_flags = std::cout.flags();
-          std::cerr << std::hex << std::setw(4) << std::setfill('0');
-          std::cerr << "ERROR: output data CRC does not match the expected CRC "
-                    << "0x" << crc32_out << " != 0x" << crc_h
-                    << " (result != expected)\n";
-          std::cout.flags(save_flags);
+        // check the CRC-32 and size of each member (these are in the footer
+        // of each GZIP member)
+        if (member_count_h == 0) {
+          std::cerr << "ERROR: no complete GZIP member was found\n";
           passed = false;
         }
+        passed &= CheckGzipMembers(out_bytes.data(), out_bytes.size(),
+                                   footers_h, combined_footer_h,
+                                   member_count_h);
       }
     } catch (sycl::exception const &e) {
       std::cout << "Caught a synchronous SYCL exception: " << e.what() << "\n";
@@ -286,9 +469,11 @@ class GzipDecompressor : public DecompressorBase {
     // free the allocated device memory
     sycl::free(in, q);
     sycl::free(out, q);
+    sycl::free(consumer_result, q);
     sycl::free(hdr_data, q);
-    sycl::free(crc, q);
-    sycl::free(count, q);
+    sycl::free(footers, q);
+    sycl::free(combined_footer, q);
+    sycl::free(member_count, q);
 
     // print the performance results
     if (passed && print_stats) {
@@ -302,11 +487,15 @@ class GzipDecompressor : public DecompressorBase {
         avg_time_ms = time_ms[0];
       }
 
-      double compression_ratio = (double)(count_h) / (double)(in_count);
+      double compression_ratio =
+          (double)(out_bytes.size()) / (double)(in_count);
 
       // the number of input and output megabytes, respectively
-      size_t out_mb = count_h * sizeof(unsigned char) * 1e-6;
+      size_t out_mb = out_bytes.size() * sizeof(unsigned char) * 1e-6;
 
+      if (member_count_h > 1) {
+        std::cout << "GZIP members: " << member_count_h << "\n";
+      }
       std::cout << "Execution time: " << avg_time_ms << " ms\n";
       std::cout << "Output Throughput: " << (out_mb / (avg_time_ms * 1e-3))
                 << " MB/s\n";
@@ -320,6 +509,196 @@ class GzipDecompressor : public DecompressorBase {
       return {};
     }
   }
+
+  std::vector<sycl::event> SubmitStreamEngine(
+      sycl::queue &q, size_t in_count, const std::vector<unsigned char> &) {
+    stream_hdr_data_ = AllocateKernelMemory<GzipHeaderData>(q, 1, "hdr_data");
+    stream_combined_footer_ =
+        AllocateKernelMemory<GzipFooterData>(q, 1, "combined_footer");
+    stream_member_count_ = AllocateKernelMemory<unsigned>(q, 1, "member_count");
+    stream_crc32_ = 0;
+
+    // the output is not kept, so only the combined footer of the members is
+    // checked, and the footer of each member is not written
+    return SubmitGzipDecompressKernels<InPipe<0>, OutPipe<0>,
+                                       literals_per_cycle>(
+        q, in_count, stream_hdr_data_, nullptr, 0, stream_combined_footer_,
+        stream_member_count_);
+  }
+
+  sycl::event SubmitStreamProducer(sycl::queue &q, unsigned char *in_ptr,
+                                   unsigned count,
+                                   const std::vector<sycl::event> &depends_on) {
+    return SubmitProducer<ProducerId<0>, InPipe<0>, 1>(q, count, in_ptr,
+                                                       depends_on);
+  }
+
+  sycl::event SubmitStreamConsumer(sycl::queue &q, unsigned char *out_ptr,
+                                   unsigned max_count,
+                                   ConsumerResult *result) {
+    return SubmitConsumer<ConsumerId<0>, OutPipe<0>, literals_per_cycle>(
+        q, max_count, out_ptr, result);
+  }
+
+  // the CRC is computed one chunk at a time, since the output is not kept
+  void StreamOutput(const unsigned char *data, size_t count) {
+    stream_crc32_ = SimpleCRC32(stream_crc32_, data, count);
+  }
+
+  bool FinishStream(sycl::queue &q, size_t out_count) {
+    bool passed = true;
+    GzipHeaderData hdr_data_h;
+    unsigned member_count_h;
+    q.memcpy(&hdr_data_h, stream_hdr_data_, sizeof(GzipHeaderData)).wait();
+    q.memcpy(&member_count_h, stream_member_count_, sizeof(unsigned)).wait();
+    GzipFooterData combined_footer_h;
+    q.memcpy(&combined_footer_h, stream_combined_footer_,
+             sizeof(GzipFooterData))
+        .wait();
+
+    if (hdr_data_h.MagicNumber() != 0x1f8b) {
+      auto save_flags = std::cerr.flags();
+      std::cerr << "ERROR: Incorrect magic header value of 0x" << std::hex
+                << std::setw(4) << std::setfill('0')
+                << hdr_data_h.MagicNumber() << " (should be 0x1f8b)\n";
+      std::cerr.flags(save_flags);
+      passed = false;
+    }
+
+    // The output is not kept, so the members cannot be checked one at a time.
+    // Instead, the HuffmanDecoder combines the CRC-32 and size of all of the
+    // members, which are checked against the whole output.
+    if (member_count_h == 0) {
+      std::cerr << "ERROR: no complete GZIP member was found\n";
+      passed = false;
+    } else {
+      // the ISIZE field of a member is its size modulo 2^32, so the sizes
+      // can only be checked modulo 2^32 as well
+      if (combined_footer_h.size != (uint32_t)out_count) {
+        std::cerr << "ERROR: Out counts do not match: "
+                  << combined_footer_h.size << " != " << (uint32_t)out_count
+                  << " (mod 2^32) (count_h != out_count)\n";
+        passed = false;
+      }
+
+      if (stream_crc32_ != combined_footer_h.crc) {
+        auto save_flags = std::cerr.flags();
+        std::cerr << std::hex << std::setw(4) << std::setfill('0');
+        std::cerr << "ERROR: output data CRC does not match the expected CRC "
+                  << "0x" << stream_crc32_ << " != 0x" << combined_footer_h.crc
+                  << " (result != expected)\n";
+        std::cerr.flags(save_flags);
+        passed = false;
+      }
+    }
+
+    sycl::free(stream_hdr_data_, q);
+    sycl::free(stream_combined_footer_, q);
+    sycl::free(stream_member_count_, q);
+    return passed;
+  }
+
+  int NumEngines() const { return num_engines; }
+
+  // Only BGZF files can be split into members without decoding them, so other
+  // GZIP files are decompressed by DecompressBytes. The members are merged
+  // into one unit per engine, since an engine decodes back to back members
+  // in one launch.
+  std::vector<DecompressUnit> IndexUnits(
+      const std::vector<unsigned char> &in_bytes) {
+    if (num_engines == 1) return {};
+    auto members = IndexBgzfMembers(in_bytes);
+    if (members.size() < 2) return {};
+    return MergeUnits(members, num_engines);
+  }
+
+  void PrepareUnits(sycl::queue &q, size_t unit_count) {
+    units_hdr_data_ =
+        AllocateKernelMemory<GzipHeaderData>(q, unit_count, "hdr_data");
+    units_footers_ = AllocateKernelMemory<GzipFooterData>(
+        q, unit_count * kGzipMaxMembers, "footers");
+    units_combined_footers_ =
+        AllocateKernelMemory<GzipFooterData>(q, unit_count, "combined_footers");
+    units_member_count_ =
+        AllocateKernelMemory<unsigned>(q, unit_count, "member_count");
+  }
+
+  std::vector<sycl::event> SubmitUnit(sycl::queue &q, int engine,
+                                      size_t unit_idx,
+                                      const DecompressUnit &unit,
+                                      unsigned char *in_ptr,
+                                      unsigned char *out_ptr,
+                                      unsigned max_count,
+                                      ConsumerResult *result) {
+    std::vector<sycl::event> events;
+    fpga_tools::UnrolledLoop<int, 0, num_engines>([&](auto e) {
+      if (e == engine) {
+        events = SubmitGzipDecompressKernels<InPipe<e>, OutPipe<e>,
+                                             literals_per_cycle, e>(
+            q, unit.in_count, units_hdr_data_ + unit_idx,
+            units_footers_ + unit_idx * kGzipMaxMembers, kGzipMaxMembers,
+            units_combined_footers_ + unit_idx, units_member_count_ + unit_idx);
+        events.push_back(SubmitProducer<ProducerId<e>, InPipe<e>, 1>(
+            q, unit.in_count, in_ptr));
+        events.push_back(
+            SubmitConsumer<ConsumerId<e>, OutPipe<e>, literals_per_cycle>(
+                q, max_count, out_ptr, result));
+      }
+    });
+    return events;
+  }
+
+  bool CheckUnits(sycl::queue &q, const std::vector<DecompressUnit> &units,
+                  const std::vector<unsigned char> &out_bytes) {
+    bool passed = true;
+    for (size_t u = 0; u < units.size(); u++) {
+      GzipHeaderData hdr_data_h;
+      unsigned member_count_h;
+      q.memcpy(&hdr_data_h, units_hdr_data_ + u, sizeof(GzipHeaderData))
+          .wait();
+      q.memcpy(&member_count_h, units_member_count_ + u, sizeof(unsigned))
+          .wait();
+      std::vector<GzipFooterData> footers_h(
+          std::min(member_count_h, kGzipMaxMembers));
+      q.memcpy(footers_h.data(), units_footers_ + u * kGzipMaxMembers,
+               footers_h.size() * sizeof(GzipFooterData))
+          .wait();
+      GzipFooterData combined_footer_h;
+      q.memcpy(&combined_footer_h, units_combined_footers_ + u,
+               sizeof(GzipFooterData))
+          .wait();
+
+      if (hdr_data_h.MagicNumber() != 0x1f8b || member_count_h == 0) {
+        std::cerr << "ERROR: unit " << u << " is not a valid GZIP member\n";
+        passed = false;
+      } else {
+        passed &= CheckGzipMembers(out_bytes.data() + units[u].out_offset,
+                                   units[u].out_count, footers_h,
+                                   combined_footer_h, member_count_h);
+      }
+    }
+    return passed;
+  }
+
+  void FreeUnits(sycl::queue &q) {
+    sycl::free(units_hdr_data_, q);
+    sycl::free(units_footers_, q);
+    sycl::free(units_combined_footers_, q);
+    sycl::free(units_member_count_, q);
+  }
+
+ private:
+  // the GZIP metadata of the stream being decompressed by DecompressStream
+  GzipHeaderData *stream_hdr_data_;
+  GzipFooterData *stream_combined_footer_;
+  unsigned *stream_member_count_;
+  unsigned int stream_crc32_;
+
+  // the GZIP metadata of each unit decompressed by DecompressUnits
+  GzipHeaderData *units_hdr_data_;
+  GzipFooterData *units_footers_;
+  GzipFooterData *units_combined_footers_;
+  unsigned *units_member_count_;
 };
 
 #endif /* __GZIP_DECOMPRESSOR_HPP__ */
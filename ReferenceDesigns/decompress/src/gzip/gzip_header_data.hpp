@@ -1,6 +1,7 @@
 #ifndef __GZIP_HEADER_DATA_HPP__
 #define __GZIP_HEADER_DATA_HPP__
 
+#include <array>
 #include <iomanip>
 #include <iostream>
 #include <string>
@@ -151,4 +152,60 @@ std::ostream& operator<<(std::ostream& os, const GzipHeaderData& hdr_data) {
   return os;
 }
 
+//
+// Stores the GZIP footer data of one member
+//
+struct GzipFooterData {
+  unsigned int crc;   // the CRC-32 of the member's uncompressed data
+  unsigned int size;  // the member's uncompressed size, modulo 2^32
+};
+
+//
+// Multiplies a and b modulo the CRC-32 polynomial, in the reflected bit order
+// where the most significant bit is the coefficient of x^0
+//
+constexpr unsigned int Crc32MultModP(unsigned int a, unsigned int b) {
+  unsigned int p = 0;
+#pragma unroll
+  for (int i = 31; i >= 0; i--) {
+    if ((a >> i) & 1) p ^= b;
+    b = (b & 1) ? (b >> 1) ^ 0xEDB88320 : b >> 1;
+  }
+  return p;
+}
+
+//
+// Combines the footer of a member with the footer 'combined' of all of the
+// members before it, into the footer of all of them: the CRC-32 of their
+// back to back data, and their total size modulo 2^32. This lets the whole
+// output of a stream be checked without keeping the footer of every member.
+// A member of 4 GiB or more cannot be combined exactly, since its footer only
+// holds its size modulo 2^32.
+//
+inline GzipFooterData CombineGzipFooters(GzipFooterData combined,
+                                         GzipFooterData footer) {
+  // x^(8 * 2^k) modulo the CRC-32 polynomial, i.e. the shift of a CRC-32 over
+  // 2^k zero bytes
+  constexpr auto kZeroBytesShift = [] {
+    std::array<unsigned int, 32> a{};
+    unsigned int x_pow = 1u << 23;  // x^8
+    for (int k = 0; k < 32; k++) {
+      a[k] = x_pow;
+      x_pow = Crc32MultModP(x_pow, x_pow);
+    }
+    return a;
+  }();
+
+  // advance the combined CRC-32 over the member's size in zero bytes, then
+  // add the member's CRC-32
+  unsigned int shift = 1u << 31;  // x^0
+  for (int k = 0; k < 32; k++) {
+    if ((footer.size >> k) & 1) {
+      shift = Crc32MultModP(kZeroBytesShift[k], shift);
+    }
+  }
+  return GzipFooterData{Crc32MultModP(shift, combined.crc) ^ footer.crc,
+                        combined.size + footer.size};
+}
+
 #endif  // __GZIP_HEADER_DATA_HPP__
@@ -12,23 +12,23 @@
 
 //
 // A kernel that streams in bytes of the GZIP file, strips away (and parses) the
-// GZIP header and footer, and streams out the uncompressed data.
-// The output of this kernel is a stream of DEFLATE formatted blocks.
+// GZIP header of the first member, and streams out the rest of the file.
+// The output of this kernel starts with a stream of DEFLATE formatted blocks.
+// The footer of each member, and the header of each member that follows it,
+// are parsed by the Huffman decoder, since only it knows where each DEFLATE
+// stream ends (see huffman_decoder.hpp).
 //
 //  Template parameters:
 //    InPipe: a SYCL pipe that streams in compressed GZIP data, 1 byte at a time
 //    OutPipe: a SYCL pipe that streams out the compressed GZIP data, 1 byte at
-//      a time excluding the GZIP header and footer data
+//      a time excluding the first GZIP header
 //
 //  Arguments:
 //    in_count: the number of compressed bytes
-//    hdr_data: the parsed GZIP header
-//    crc: the parsed CRC from the GZIP footer
-//    out_count: the parsed uncompressed size from the GZIP footer
+//    hdr_data: the parsed GZIP header of the first member
 //
 template <typename InPipe, typename OutPipe>
-void GzipMetadataReader(int in_count, GzipHeaderData& hdr_data, int& crc,
-                        int& out_count) {
+void GzipMetadataReader(size_t in_count, GzipHeaderData& hdr_data) {
   // ensure the InPipe and OutPipe are SYCL pipes
   static_assert(fpga_tools::is_sycl_pipe_v<InPipe>);
   static_assert(fpga_tools::is_sycl_pipe_v<OutPipe>);
@@ -56,8 +56,8 @@ void GzipMetadataReader(int in_count, GzipHeaderData& hdr_data, int& crc,
       if flags & 0x04 != 0: Flag = Errata, read 2 bytes for 'length',
                                    read 'length' more bytes
       if flags & 0x08 != 0: Filename, read nullterminated string
-      if flags & 0x02 != 0: CRC-16, read 2 bytes
       if flags & 0x10 != 0: Comment, read nullterminated string
+      if flags & 0x02 != 0: CRC-16, read 2 bytes
 
   ===== DATA =====
     1 or more consecutive DEFLATE compressed blocks
@@ -65,13 +65,17 @@ void GzipMetadataReader(int in_count, GzipHeaderData& hdr_data, int& crc,
   ===== FOOTER =====
     4 bytes: CRC-32 Checksum
     4 bytes: Uncompressed data size in bytes
+
+  A file can hold several of these members back to back (e.g. files written
+  by 'cat a.gz b.gz').
   */
 
-  // This kernel reads the entire file (HEADER, DATA, and FOOTER) from the input
-  // SYCL pipe 'InPipe, strips away and parses the HEADER and FOOTER, and
-  // forwards the DATA to the next kernel through the SYCL pipe 'OutPipe'
+  // This kernel reads the entire file from the input SYCL pipe 'InPipe, strips
+  // away and parses the HEADER of the first member, and forwards the rest of
+  // the file to the next kernel through the SYCL pipe 'OutPipe'
 
-  int i = 0;
+  // 'in_count' is 64-bit so that a streamed input can be 2 GiB or more
+  size_t i = 0;
   bool i_in_range = 0 < in_count;
   bool i_next_in_range = 1 < in_count;
   short state_counter = 0;
@@ -137,75 +141,80 @@ void GzipMetadataReader(int in_count, GzipHeaderData& hdr_data, int& crc,
           state = GzipHeaderState::Errata;
         } else if (header_flags & 0x08) {
           state = GzipHeaderState::Filename;
-        } else if (header_flags & 0x02) {
-          state = GzipHeaderState::CRC;
         } else if (header_flags & 0x10) {
           state = GzipHeaderState::Comment;
+        } else if (header_flags & 0x02) {
+          state = GzipHeaderState::CRC;
         } else {
           state = GzipHeaderState::SteadyState;
         }
         break;
       }
       case GzipHeaderState::Errata: {
+        // the 2 byte length, followed by 'errata_len' bytes of data. The
+        // state changes on the last byte of the field, so that the next byte
+        // is parsed by the next state.
+        bool errata_done;
         if (state_counter == 0) {
           errata_len |= curr_byte;
-          state_counter++;
+          errata_done = false;
         } else if (state_counter == 1) {
           errata_len |= (curr_byte << 8);
-          state_counter++;
+          errata_done = (errata_len == 0);
         } else {
-          if ((state_counter - 2) == errata_len) {
-            if (header_flags & 0x08) {
-              state = GzipHeaderState::Filename;
-            } else if (header_flags & 0x02) {
-              state = GzipHeaderState::CRC;
-            } else if (header_flags & 0x10) {
-              state = GzipHeaderState::Comment;
-            } else {
-              state = GzipHeaderState::SteadyState;
-            }
-            state_counter = 0;
+          errata_done = ((state_counter - 1) == errata_len);
+        }
+
+        if (errata_done) {
+          if (header_flags & 0x08) {
+            state = GzipHeaderState::Filename;
+          } else if (header_flags & 0x10) {
+            state = GzipHeaderState::Comment;
+          } else if (header_flags & 0x02) {
+            state = GzipHeaderState::CRC;
           } else {
-            state_counter++;
+            state = GzipHeaderState::SteadyState;
           }
+          state_counter = 0;
+        } else {
+          state_counter++;
         }
         break;
       }
       case GzipHeaderState::Filename: {
         header_filename[state_counter] = curr_byte;
         if (curr_byte == '\0') {
-          if (header_flags & 0x02) {
-            state = GzipHeaderState::CRC;
-          } else if (header_flags & 0x10) {
+          if (header_flags & 0x10) {
             state = GzipHeaderState::Comment;
+          } else if (header_flags & 0x02) {
+            state = GzipHeaderState::CRC;
           } else {
             state = GzipHeaderState::SteadyState;
           }
           state_counter = 0;
-        } else {
+        } else if (state_counter < 255) {
+          // the name is truncated to fit 'header_filename'
           state_counter++;
         }
         break;
       }
-      case GzipHeaderState::CRC: {
-        if (state_counter == 0) {
-          header_crc[0] = curr_byte;
-          state_counter++;
-        } else if (state_counter == 1) {
-          header_crc[1] = curr_byte;
-          state_counter++;
-        } else {
-          if (header_flags & 0x10) {
-            state = GzipHeaderState::Comment;
+      case GzipHeaderState::Comment: {
+        if (curr_byte == '\0') {
+          if (header_flags & 0x02) {
+            state = GzipHeaderState::CRC;
           } else {
             state = GzipHeaderState::SteadyState;
           }
           state_counter = 0;
+        } else {
+          state_counter++;
         }
         break;
       }
-      case GzipHeaderState::Comment: {
-        if (curr_byte == '\0') {
+      case GzipHeaderState::CRC: {
+        // the header CRC is the last field of the header
+        header_crc[state_counter] = curr_byte;
+        if (state_counter == 1) {
           state = GzipHeaderState::SteadyState;
           state_counter = 0;
         } else {
@@ -219,51 +228,27 @@ void GzipMetadataReader(int in_count, GzipHeaderData& hdr_data, int& crc,
     }
 
     i_in_range = i_next_in_range;
-    i_next_in_range = i < (in_count - 2);
+    i_next_in_range = (i + 2) < in_count;
     i++;
   }
 
-  // the last 8 bytes of the stream are the CRC and size (in bytes) of the file
-  // this data will be sent back to the host to help validate the output
-  unsigned char crc_bytes[4];
-  unsigned char size_bytes[4];
-
   // finished reading the header, so now stream the bytes into the decompressor.
-  // keep track of the last 8 bytes, which are the crc and output size.
+  // The flag marks the last byte of the file.
   // NOTE: we DO care about the performance of this loop, because it will feed
   // the rest of the decompressor.
   while (i_in_range) {
     bool valid_pipe_read;
     auto pipe_data = InPipe::read(valid_pipe_read);
-    curr_byte = pipe_data[0];
 
     if (valid_pipe_read) {
-      // keep track of the last 8 bytes
-      int remaining_bytes = (in_count - i - 1);
-      if (remaining_bytes < 8) {
-        if (remaining_bytes < 4) {
-          size_bytes[3 - remaining_bytes] = curr_byte;
-        } else {
-          crc_bytes[7 - remaining_bytes] = curr_byte;
-        }
-      }
       OutPipe::write(OutPipeBundleT(pipe_data, (i == (in_count - 1))));
 
       i_in_range = i_next_in_range;
-      i_next_in_range = i < (in_count - 2);
+      i_next_in_range = (i + 2) < in_count;
       i++;
     }
   }
 
-  // parsing the GZIP footer
-  // construct the 32-bit CRC and size (out_count) from the last 8 bytes read
-  crc = 0;
-  out_count = 0;
-  for (int i = 0; i < 4; i++) {
-    crc |= (unsigned int)(crc_bytes[i]) << (i * 8);
-    out_count |= (unsigned int)(size_bytes[i]) << (i * 8);
-  }
-
   // construct the header data
   hdr_data.magic[0] = header_magic[0];
   hdr_data.magic[1] = header_magic[1];
@@ -280,9 +265,8 @@ void GzipMetadataReader(int in_count, GzipHeaderData& hdr_data, int& crc,
 // Creates a kernel from the GZIP metadata reader function
 //
 template <typename Id, typename InPipe, typename OutPipe>
-sycl::event SubmitGzipMetadataReader(sycl::queue& q, int in_count,
-                                     GzipHeaderData* hdr_data_ptr, int* crc_ptr,
-                                     int* out_count_ptr) {
+sycl::event SubmitGzipMetadataReader(sycl::queue& q, size_t in_count,
+                                     GzipHeaderData* hdr_data_ptr) {
   return q.single_task<Id>([=]() [[intel::kernel_args_restrict]] {
 
 #if defined (IS_BSP)
@@ -291,28 +275,19 @@ sycl::event SubmitGzipMetadataReader(sycl::queue& q, int in_count,
     // Knowing this, the compiler won't generate hardware to
     // potentially get data from the host.
     sycl::ext::intel::device_ptr<GzipHeaderData> hdr_data(hdr_data_ptr);
-    sycl::ext::intel::device_ptr<int> crc(crc_ptr);
-    sycl::ext::intel::device_ptr<int> out_count(out_count_ptr);
 #else
     // Device pointers are not supported when targeting an FPGA 
     // family/part
     GzipHeaderData* hdr_data(hdr_data_ptr);
-    int* crc(crc_ptr);
-    int* out_count(out_count_ptr);
 #endif    
 
-    // local copies of the output data
+    // local copy of the output data
     GzipHeaderData hdr_data_loc;
-    int crc_loc;
-    int out_count_loc;
 
-    GzipMetadataReader<InPipe, OutPipe>(in_count, hdr_data_loc, crc_loc,
-                                        out_count_loc);
+    GzipMetadataReader<InPipe, OutPipe>(in_count, hdr_data_loc);
 
-    // write back the local copies of the output data
+    // write back the local copy of the output data
     *hdr_data = hdr_data_loc;
-    *crc = crc_loc;
-    *out_count = out_count_loc;
   });
 }
 
@@ -8,6 +8,7 @@
 #include "../common/common.hpp"
 #include "byte_bit_stream.hpp"
 #include "constexpr_math.hpp"         // included from ../../../../include
+#include "gzip_header_data.hpp"
 #include "metaprogramming_utils.hpp"  // included from ../../../../include
 
 // the size of the ByteBitStream buffer can be set from the compile comand.
@@ -68,6 +69,18 @@ void ParseSecondTable(
     ac_uint<15> dist_map_first_code[15], ac_uint<15> dist_map_last_code[15],
     ac_uint<5> dist_map_base_idx[15], ac_uint<5> dist_map[32]);
 
+inline bool MoreInput(BitStreamT& bit_stream, bool done_reading);
+
+template <typename InPipe>
+unsigned char ReadAlignedByte(BitStreamT& bit_stream, bool& done_reading);
+
+template <typename InPipe>
+bool ReadGzipFooter(BitStreamT& bit_stream, bool& done_reading,
+                    GzipFooterData& footer);
+
+template <typename InPipe>
+bool SkipGzipHeader(BitStreamT& bit_stream, bool& done_reading);
+
 }  // namespace huffman_decoder_detail
 
 //
@@ -77,13 +90,30 @@ void ParseSecondTable(
 // For dynamically compressed blocks, the huffman tables are also built from the
 // input byte stream.
 //
+// The input can hold several GZIP members back to back. After the last block of
+// each member's DEFLATE stream, the kernel parses the member's footer and, if
+// more input follows, skips the header of the next member and keeps decoding.
+// The output is one continuous stream for all of the members. Any bytes after
+// the last member that do not start a GZIP header are ignored.
+//
 //  Template parameters:
 //    InPipe: a SYCL pipe that streams in compressed data, 1 byte at a time
 //    OutPipe: a SYCL pipe that streams out either literals or
 //      {length, distance} pairs.
+//    FooterPtrT: the pointer type for 'footers'
 //
-template <typename InPipe, typename OutPipe>
-void HuffmanDecoder() {
+//  Arguments:
+//    footers: where to write the footer of each member
+//    max_footers: the number of footers that fit in 'footers'. The members
+//      after that are decoded, but their footers are not written.
+//    combined_footer: set to the footers of all of the members combined (see
+//      CombineGzipFooters), however many members there are
+//
+//  Returns the number of members.
+//
+template <typename InPipe, typename OutPipe, typename FooterPtrT>
+unsigned HuffmanDecoder(FooterPtrT footers, unsigned max_footers,
+                        GzipFooterData& combined_footer) {
   // ensure the InPipe and OutPipe are SYCL pipes
   static_assert(fpga_tools::is_sycl_pipe_v<InPipe>);
   static_assert(fpga_tools::is_sycl_pipe_v<OutPipe>);
@@ -99,15 +129,18 @@ void HuffmanDecoder() {
   BitStreamT bit_stream;
   bool last_block = false;
   bool done_reading = false;
+  bool all_members_done = false;
+  unsigned member_count = 0;
+  combined_footer = GzipFooterData{0, 0};
 
-  // Processing consecutive DEFLATE blocks
+  // Processing consecutive DEFLATE blocks, of one or more GZIP members
   // Loop pipelining is disabled here because to reduce the amount of memory
   // utilization caused by replicating local variables. Since the inner
   // loop (the while(!block_done) loop) is the main processing loop, disabling
   // pipelining here does not have a significant affect on the throughput
   // of the design.
   [[intel::disable_loop_pipelining]]  // NO-FORMAT: Attribute
-  while (!last_block) {
+  while (!all_members_done) {
     ////////////////////////////////////////////////////////////////////////////
     // BEGIN: parse the first three bits of the block
     auto [last_block_tmp, block_type] =
@@ -249,6 +282,9 @@ void HuffmanDecoder() {
 
               // done parsing uncompressed length
               parsing_uncompressed_len = false;
+
+              // an empty block (e.g. from a sync or full flush) is done here
+              block_done = (uncompressed_bytes_remaining == 0);
             }
             uncompressed_len_bytes_read += 1;
           } else {
@@ -440,30 +476,86 @@ void HuffmanDecoder() {
         out_ready = false;
       }
     }  // while (!block_done)
-  }    // while (!last_block)
-  // END: decoding the bit stream (main computation loop)
-  ////////////////////////////////////////////////////////////////////////////
+    // END: decoding the bit stream (main computation loop)
+    ////////////////////////////////////////////////////////////////////////////
+
+    ////////////////////////////////////////////////////////////////////////////
+    // BEGIN: parsing the GZIP footer, and the header of the next member
+    if (last_block) {
+      GzipFooterData footer;
+      bool footer_valid = huffman_decoder_detail::ReadGzipFooter<InPipe>(
+          bit_stream, done_reading, footer);
+      if (footer_valid) {
+        if (member_count < max_footers) {
+          footers[member_count] = footer;
+        }
+        combined_footer = CombineGzipFooters(combined_footer, footer);
+        member_count++;
+      }
+
+      all_members_done =
+          !footer_valid ||
+          !huffman_decoder_detail::MoreInput(bit_stream, done_reading) ||
+          !huffman_decoder_detail::SkipGzipHeader<InPipe>(bit_stream,
+                                                          done_reading);
+    }
+    // END: parsing the GZIP footer, and the header of the next member
+    ////////////////////////////////////////////////////////////////////////////
+  }  // while (!all_members_done)
 
   // notify the downstream kernel that we are done
   OutPipe::write(OutPipeBundleT(true));
 
   // read out the remaining data from the pipe
-  // NOTE: don't really care about performance here since it reads out 8 bytes
-  // for CRC-32 and uncompressed size and maybe one more byte for padding.
+  // NOTE: don't really care about performance here since this only reads the
+  // bytes after the last member, if any.
   while (!done_reading) {
     bool read_valid;
     auto pd = InPipe::read(read_valid);
     done_reading = pd.flag && read_valid;
   }
+
+  return member_count;
 }
 
 //
 // Creates a kernel from the Huffman decoder function
 //
+//  Arguments:
+//    q: the SYCL queue
+//    footers_ptr: an output buffer for the footer of each GZIP member
+//    max_footers: the number of footers that fit in 'footers_ptr'
+//    combined_footer_ptr: an output buffer for the combined footer of all of
+//      the GZIP members
+//    member_count_ptr: an output buffer for the number of GZIP members
+//
 template <typename Id, typename InPipe, typename OutPipe>
-sycl::event SubmitHuffmanDecoder(sycl::queue& q) {
-  return q.single_task<Id>([=] {
-    HuffmanDecoder<InPipe, OutPipe>();
+sycl::event SubmitHuffmanDecoder(sycl::queue& q, GzipFooterData* footers_ptr,
+                                 unsigned max_footers,
+                                 GzipFooterData* combined_footer_ptr,
+                                 unsigned* member_count_ptr) {
+  return q.single_task<Id>([=]() [[intel::kernel_args_restrict]] {
+#if defined (IS_BSP)
+    // When targeting a BSP, we instruct the compiler that this pointer
+    // lives on the device.
+    // Knowing this, the compiler won't generate hardware to
+    // potentially get data from the host.
+    sycl::ext::intel::device_ptr<GzipFooterData> footers(footers_ptr);
+    sycl::ext::intel::device_ptr<GzipFooterData> combined_footer(
+        combined_footer_ptr);
+    sycl::ext::intel::device_ptr<unsigned> member_count(member_count_ptr);
+#else
+    // Device pointers are not supported when targeting an FPGA 
+    // family/part
+    GzipFooterData* footers(footers_ptr);
+    GzipFooterData* combined_footer(combined_footer_ptr);
+    unsigned* member_count(member_count_ptr);
+#endif
+
+    GzipFooterData combined;
+    *member_count =
+        HuffmanDecoder<InPipe, OutPipe>(footers, max_footers, combined);
+    *combined_footer = combined;
   });
 }
 
@@ -869,6 +961,128 @@ void ParseSecondTable(
   }
 }
 
+//
+// Returns whether there are more input bytes, either in the bit stream or still
+// to be read from the pipe. 'done_reading' is set when the last byte of the
+// input has been read from the pipe.
+//
+inline bool MoreInput(BitStreamT& bit_stream, bool done_reading) {
+  return !bit_stream.Empty() || !done_reading;
+}
+
+//
+// Reads the next byte of input, when the bit stream is aligned to a byte
+// boundary. The bytes already in the bit stream are used first.
+//
+template <typename InPipe>
+unsigned char ReadAlignedByte(BitStreamT& bit_stream, bool& done_reading) {
+  if (bit_stream.Empty()) {
+    auto pd = InPipe::read();
+    done_reading = pd.flag;
+    bit_stream.NewByte(pd.data[0]);
+  }
+  unsigned char b = bit_stream.ReadUInt<8>();
+  bit_stream.Shift(ac_uint<4>(8));
+  return b;
+}
+
+//
+// Parses the GZIP footer that follows the last DEFLATE block of a member:
+//    4 bytes: CRC-32 Checksum
+//    4 bytes: Uncompressed data size in bytes
+// Returns false if the input ends before the footer does.
+//
+template <typename InPipe>
+bool ReadGzipFooter(BitStreamT& bit_stream, bool& done_reading,
+                    GzipFooterData& footer) {
+  // the footer starts at the next byte boundary
+  bit_stream.AlignToByteBoundary();
+
+  footer.crc = 0;
+  footer.size = 0;
+  for (int i = 0; i < 8; i++) {
+    if (!MoreInput(bit_stream, done_reading)) {
+      return false;
+    }
+    unsigned int b = ReadAlignedByte<InPipe>(bit_stream, done_reading);
+    if (i < 4) {
+      footer.crc |= b << (i * 8);
+    } else {
+      footer.size |= b << ((i - 4) * 8);
+    }
+  }
+  return true;
+}
+
+//
+// Skips over the GZIP header of the next member (see the GZIP file format in
+// gzip_metadata_reader.hpp). The header data of the members after the first
+// one is not needed, so it is not kept.
+// Returns false if the input ends, or if the bytes are not a GZIP header with
+// the DEFLATE compression method, in which case the rest of the input should
+// be ignored.
+//
+template <typename InPipe>
+bool SkipGzipHeader(BitStreamT& bit_stream, bool& done_reading) {
+  // the fixed size part: magic number, compression method, flags, time,
+  // extra flags and OS
+  unsigned char fixed_header[10];
+  for (int i = 0; i < 10; i++) {
+    if (!MoreInput(bit_stream, done_reading)) {
+      return false;
+    }
+    fixed_header[i] = ReadAlignedByte<InPipe>(bit_stream, done_reading);
+  }
+  if (fixed_header[0] != 0x1f || fixed_header[1] != 0x8b ||
+      fixed_header[2] != 8) {
+    return false;
+  }
+  unsigned char flags = fixed_header[3];
+
+  // the optional fields, in the order they appear in the header
+  if (flags & 0x04) {
+    // extra field: 2 bytes of length, followed by 'length' bytes
+    unsigned short extra_len = 0;
+    for (int i = 0; i < 2; i++) {
+      if (!MoreInput(bit_stream, done_reading)) {
+        return false;
+      }
+      extra_len |= (unsigned short)(ReadAlignedByte<InPipe>(bit_stream,
+                                                            done_reading))
+                   << (i * 8);
+    }
+    for (unsigned short i = 0; i < extra_len; i++) {
+      if (!MoreInput(bit_stream, done_reading)) {
+        return false;
+      }
+      ReadAlignedByte<InPipe>(bit_stream, done_reading);
+    }
+  }
+  for (int field = 0; field < 2; field++) {
+    // file name and comment: null terminated strings
+    unsigned char string_flag = (field == 0) ? 0x08 : 0x10;
+    if (flags & string_flag) {
+      unsigned char b;
+      do {
+        if (!MoreInput(bit_stream, done_reading)) {
+          return false;
+        }
+        b = ReadAlignedByte<InPipe>(bit_stream, done_reading);
+      } while (b != '\0');
+    }
+  }
+  if (flags & 0x02) {
+    // CRC-16 of the header
+    for (int i = 0; i < 2; i++) {
+      if (!MoreInput(bit_stream, done_reading)) {
+        return false;
+      }
+      ReadAlignedByte<InPipe>(bit_stream, done_reading);
+    }
+  }
+  return true;
+}
+
 }  // namespace huffman_decoder_detail
 
 #endif /* __HUFFMAN_DECODER_HPP__ */
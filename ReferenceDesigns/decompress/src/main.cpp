@@ -48,6 +48,16 @@ constexpr unsigned kLiteralsPerCycle = LITERALS_PER_CYCLE;
 static_assert(kLiteralsPerCycle > 0);
 static_assert(fpga_tools::IsPow2(kLiteralsPerCycle));
 
+// the number of decompression engines can be set from the command line
+// use the macro -DNUM_ENGINES=<num_engines>
+// The independent units of a file (see DecompressorBase::DecompressUnits) are
+// decompressed in parallel on the engines.
+#if not defined(NUM_ENGINES)
+#define NUM_ENGINES 1
+#endif
+constexpr int kNumEngines = NUM_ENGINES;
+static_assert(kNumEngines > 0);
+
 // include files and aliases specific to GZIP and SNAPPY decompression
 #if defined(GZIP)
 #include "gzip/gzip_decompressor.hpp"
@@ -58,12 +68,12 @@ static_assert(fpga_tools::IsPow2(kLiteralsPerCycle));
 
 // aliases and testing functions specific to GZIP and SNAPPY decompression
 #if defined(GZIP)
-using GzipDecompressorT = GzipDecompressor<kLiteralsPerCycle>;
+using GzipDecompressorT = GzipDecompressor<kLiteralsPerCycle, kNumEngines>;
 bool RunGzipTest(sycl::queue& q, GzipDecompressorT decompressor,
                  const std::string test_dir);
 std::string decompressor_name = "GZIP";
 #else
-using SnappyDecompressorT = SnappyDecompressor<kLiteralsPerCycle>;
+using SnappyDecompressorT = SnappyDecompressor<kLiteralsPerCycle, kNumEngines>;
 bool RunSnappyTest(sycl::queue& q, SnappyDecompressorT decompressor,
                    const std::string test_dir);
 std::string decompressor_name = "SNAPPY";
@@ -73,6 +83,7 @@ std::string decompressor_name = "SNAPPY";
 void PrintUsage(std::string exe_name) {
   std::cerr << "USAGE: \n"
             << exe_name << " <input filename> <output filename> [runs]\n"
+            << exe_name << " --stream <input filename> <output filename>\n"
             << exe_name << " <test directory>" << std::endl;
 }
 
@@ -93,14 +104,26 @@ int main(int argc, char* argv[]) {
   int runs;
   bool default_test_mode = false;
 
-  if (argc == 1 || argc == 2) {
+  // in streaming mode, the file is decompressed in chunks and never held in
+  // memory in full (see DecompressorBase::DecompressStream)
+  bool stream_mode = argc > 1 && std::string(argv[1]) == "--stream";
+
+  if (stream_mode) {
+    if (argc != 4) {
+      PrintUsage(argv[0]);
+      return 1;
+    }
+  } else if (argc == 1 || argc == 2) {
     default_test_mode = true;
   } else if (argc > 4) {
     PrintUsage(argv[0]);
     return 1;
   }
 
-  if (default_test_mode) {
+  if (stream_mode) {
+    in_filename = argv[2];
+    out_filename = argv[3];
+  } else if (default_test_mode) {
     if (argc > 1) test_dir = argv[1];
   } else {
     // default the number of runs based on emulation, simulation, or hardware
@@ -156,6 +179,9 @@ int main(int argc, char* argv[]) {
 #else
     passed = RunSnappyTest(q, decompressor, test_dir);
 #endif
+  } else if (stream_mode) {
+    passed = decompressor.DecompressFileStreaming(q, in_filename, out_filename,
+                                                  true);
   } else {
     // decompress a specific file specified at the command line
     passed = decompressor.DecompressFile(q, in_filename, out_filename, runs,
@@ -203,6 +229,8 @@ bool RunGzipTest(sycl::queue& q, GzipDecompressorT decompressor,
   std::string static_compress_filename = test_dir + "/static_compressed.gz";
   std::string dynamic_compress_filename = test_dir + "/dynamic_compressed.gz";
   std::string tp_test_filename = test_dir + "/tp_test.gz";
+  std::string bgzf_filename = test_dir + "/bgzf_test.gz";
+  std::string many_members_filename = test_dir + "/bgzf_many_members.gz";
 
   std::cout << ">>>>> Uncompressed File Test <<<<<" << std::endl;
   bool uncompressed_test_pass = decompressor.DecompressFile(
@@ -222,6 +250,23 @@ bool RunGzipTest(sycl::queue& q, GzipDecompressorT decompressor,
   PrintTestResults("Dynamically Compressed File Test", dynamic_test_pass);
   std::cout << std::endl;
 
+  // a BGZF file is decompressed in parallel when the design has more than
+  // one engine
+  std::cout << ">>>>> BGZF File Test <<<<<" << std::endl;
+  bool bgzf_test_pass =
+      decompressor.DecompressFile(q, bgzf_filename, "", 1, false, false);
+  PrintTestResults("BGZF File Test", bgzf_test_pass);
+  std::cout << std::endl;
+
+  // a BGZF file with more members than the footers the host keeps for
+  // checking each member (kGzipMaxMembers), so the rest are checked with the
+  // combined footer of all of the members
+  std::cout << ">>>>> Many Members Test <<<<<" << std::endl;
+  bool many_members_test_pass = decompressor.DecompressFile(
+      q, many_members_filename, "", 1, false, false);
+  PrintTestResults("Many Members Test", many_members_test_pass);
+  std::cout << std::endl;
+
   std::cout << ">>>>> Throughput Test <<<<<" << std::endl;
   constexpr int kTPTestRuns = 5;
   bool tp_test_pass = decompressor.DecompressFile(q, tp_test_filename, "",
@@ -230,7 +275,7 @@ bool RunGzipTest(sycl::queue& q, GzipDecompressorT decompressor,
   std::cout << std::endl;
 
   return uncompressed_test_pass && static_test_pass && dynamic_test_pass &&
-         tp_test_pass;    
+         bgzf_test_pass && many_members_test_pass && tp_test_pass;
 #endif
 
 }
@@ -271,6 +316,44 @@ bool RunSnappyTest(sycl::queue& q, SnappyDecompressorT decompressor,
   PrintTestResults("Alice In Wonderland Test", alice_test_pass);
   std::cout << std::endl;
 
+  // the chunks of a framed stream are decompressed in parallel when the design
+  // has more than one engine
+  std::cout << ">>>>> Framed Alice In Wonderland Test <<<<<" << std::endl;
+  std::string alice_framed_in_file = test_dir + "/alice29.txt.framed.sz";
+  auto framed_in_bytes = ReadInputFile(alice_framed_in_file);
+  auto framed_result = decompressor.Decompress(q, framed_in_bytes, 1, false);
+  bool framed_test_pass =
+      (framed_result != std::nullopt) && (framed_result.value() == ref_bytes);
+  PrintTestResults("Framed Alice In Wonderland Test", framed_test_pass);
+  std::cout << std::endl;
+
+  std::cout << ">>>>> Framed Generated Data Test <<<<<" << std::endl;
+  // text, which is stored in compressed chunks, followed by pseudo-random
+  // bytes, which are stored in uncompressed chunks
+  std::vector<unsigned char> test_framed_ref = ref_bytes;
+  unsigned lcg_state = 1;
+  for (int i = 0; i < 100000; i++) {
+    lcg_state = lcg_state * 1103515245 + 12345;
+    test_framed_ref.push_back(lcg_state >> 24);
+  }
+  auto test_framed_bytes = GenerateSnappyFramedData(test_framed_ref);
+  auto test_framed_ret =
+      decompressor.Decompress(q, test_framed_bytes, 1, false);
+  bool test_framed_pass = (test_framed_ret != std::nullopt) &&
+                          (test_framed_ret.value() == test_framed_ref);
+  PrintTestResults("Framed Generated Data Test", test_framed_pass);
+  std::cout << std::endl;
+
+  std::cout << ">>>>> Framed CRC Mismatch Test <<<<<" << std::endl;
+  // corrupt the CRC of the first chunk, which follows the stream identifier
+  // and the chunk header. The decompression is expected to report an error.
+  auto bad_crc_bytes = test_framed_bytes;
+  bad_crc_bytes[sizeof(kSnappyStreamIdentifier) + kSnappyChunkHeaderBytes] ^= 1;
+  auto bad_crc_ret = decompressor.Decompress(q, bad_crc_bytes, 1, false);
+  bool bad_crc_pass = bad_crc_ret == std::nullopt;
+  PrintTestResults("Framed CRC Mismatch Test", bad_crc_pass);
+  std::cout << std::endl;
+
   std::cout << ">>>>> Only Literal Strings Test <<<<<" << std::endl;
   auto test1_bytes = GenerateSnappyCompressedData(333, 3, 0, 0, 3);
   auto test1_ret = decompressor.DecompressBytes(q, test1_bytes, 1, false);
@@ -305,7 +388,8 @@ bool RunSnappyTest(sycl::queue& q, SnappyDecompressorT decompressor,
   PrintTestResults("Throughput Test", test_tp_pass);
   std::cout << std::endl;
 
-  return alice_test_pass && test1_pass && test2_pass && test3_pass &&
+  return alice_test_pass && framed_test_pass && test_framed_pass &&
+         bad_crc_pass && test1_pass && test2_pass && test3_pass &&
          test_tp_pass;
 #endif
 
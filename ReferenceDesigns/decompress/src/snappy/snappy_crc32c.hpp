@@ -0,0 +1,209 @@
+#ifndef __SNAPPY_CRC32C_HPP__
+#define __SNAPPY_CRC32C_HPP__
+
+#include <sycl/sycl.hpp>
+#include <sycl/ext/intel/ac_types/ac_int.hpp>
+#include <sycl/ext/intel/fpga_extensions.hpp>
+
+#include "../common/common.hpp"
+#include "constexpr_math.hpp"         // included from ../../../../include
+#include "metaprogramming_utils.hpp"  // included from ../../../../include
+#include "snappy_frame_reader.hpp"
+
+// the reflected CRC-32C (Castagnoli) polynomial used by the Snappy framing
+// format
+constexpr unsigned kCrc32cPolynomial = 0x82F63B78;
+
+//
+// Updates the CRC-32C register 'crc' with one byte, one bit at a time. With a
+// constant polynomial, the unrolled loop is just a network of XOR gates.
+//
+inline unsigned Crc32cByte(unsigned crc, unsigned char b) {
+  crc ^= b;
+#pragma unroll
+  for (int i = 0; i < 8; i++) {
+    crc = (crc >> 1) ^ (kCrc32cPolynomial & (0U - (crc & 1)));
+  }
+  return crc;
+}
+
+//
+// The framing format stores the CRC-32C of each chunk 'masked', so that the
+// CRC of data that contains embedded CRCs is not degenerate.
+//
+inline unsigned MaskSnappyCrc(unsigned crc) {
+  return ((crc >> 15) | (crc << 17)) + 0xa282ead8;
+}
+
+//
+// Computes the CRC-32C of 'len' bytes in 'buf' on the host. This is used to
+// generate framed test data.
+//
+inline unsigned Crc32c(const unsigned char* buf, size_t len) {
+  unsigned crc = 0xFFFFFFFF;
+  for (size_t i = 0; i < len; i++) {
+    crc = Crc32cByte(crc, buf[i]);
+  }
+  return ~crc;
+}
+
+//
+// Updates the CRC-32C register 'crc' with the 'valid_count' valid bytes of
+// 'data' in one step.
+//
+// The CRC is linear, so the CRC of a message 'm' of 'k' bytes starting from
+// register 'crc' is the register advanced by 'k' zero bytes XOR'ed with the
+// CRC of 'm' starting from 0. Leading zeros do not change the latter, so it is
+// computed over the valid bytes shifted to the end of the array. Only the
+// first term depends on the previous register value, which keeps the
+// loop-carried path to a single XOR network and a multiplexer.
+//
+template <size_t num_bytes>
+unsigned Crc32cUpdate(unsigned crc, const BytePack<num_bytes>& data) {
+  // the register advanced by 0 to 'num_bytes' zero bytes
+  unsigned crc_advanced[num_bytes + 1];
+  crc_advanced[0] = crc;
+#pragma unroll
+  for (int i = 0; i < num_bytes; i++) {
+    crc_advanced[i + 1] = Crc32cByte(crc_advanced[i], 0);
+  }
+
+  // the CRC of the valid bytes, right-aligned with leading zeros
+  unsigned data_crc = 0;
+#pragma unroll
+  for (int i = 0; i < num_bytes; i++) {
+    int src_idx = i - (int)num_bytes + (int)data.valid_count;
+    unsigned char b = (src_idx >= 0) ? data.byte[src_idx] : 0;
+    data_crc = Crc32cByte(data_crc, b);
+  }
+
+  return crc_advanced[data.valid_count] ^ data_crc;
+}
+
+//
+// Streams the decompressed data from InPipe to OutPipe unchanged and checks
+// the masked CRC-32C of each chunk of a Snappy stream in the framing format.
+//
+// The SnappyReader sends the uncompressed size and the expected CRC of each
+// chunk on ChunkPipe before the chunk's data. The LZ77 decoder never packs
+// the data of two commands, and therefore two chunks, into one output, so a
+// chunk always ends on an element boundary of InPipe.
+//
+//  Template parameters:
+//    InPipe: a SYCL pipe that streams in an array of bytes and a
+//      'valid_count', which is in the range [0, literals_per_cycle]
+//    OutPipe: a SYCL pipe of the same type as InPipe
+//    ChunkPipe: a SYCL pipe that streams in a SnappyChunkInfo for each chunk
+//      and a last one with 'last' set
+//    literals_per_cycle: the maximum number of valid bytes in each element
+//
+// Returns the number of chunks whose CRC or size does not match.
+//
+template <typename InPipe, typename OutPipe, typename ChunkPipe,
+          unsigned literals_per_cycle>
+unsigned SnappyCrc32cChecker() {
+  // ensure the InPipe, OutPipe and ChunkPipe are SYCL pipes
+  static_assert(fpga_tools::is_sycl_pipe_v<InPipe>);
+  static_assert(fpga_tools::is_sycl_pipe_v<OutPipe>);
+  static_assert(fpga_tools::is_sycl_pipe_v<ChunkPipe>);
+
+  // the input and output pipe data types
+  using InPipeBundleT = decltype(InPipe::read());
+  using OutPipeBundleT = decltype(OutPipe::read());
+
+  // make sure the input and output types are correct
+  static_assert(std::is_same_v<InPipeBundleT,
+                               FlagBundle<BytePack<literals_per_cycle>>>);
+  static_assert(std::is_same_v<OutPipeBundleT, InPipeBundleT>);
+  static_assert(std::is_same_v<decltype(ChunkPipe::read()), SnappyChunkInfo>);
+
+  unsigned crc_errors = 0;
+
+  // the chunk whose data is streaming through
+  bool in_chunk = false;
+  bool last_chunk = false;
+  bool check_crc;
+  unsigned expected_crc;
+  unsigned chunk_left;
+  unsigned crc;
+
+  bool done = false;
+  while (!done) {
+    if (!in_chunk && !last_chunk) {
+      // start the next chunk
+      auto chunk = ChunkPipe::read();
+      last_chunk = chunk.last;
+      in_chunk = !chunk.last && chunk.count > 0;
+      check_crc = chunk.check_crc;
+      expected_crc = chunk.crc;
+      chunk_left = chunk.count;
+      crc = 0xFFFFFFFF;
+
+      // an empty chunk ends right away
+      if (!chunk.last && chunk.count == 0 && check_crc &&
+          MaskSnappyCrc(0) != expected_crc) {
+        crc_errors++;
+      }
+    } else {
+      auto pipe_data = InPipe::read();
+      done = pipe_data.flag;
+
+      if (!done) {
+        auto valid_count = pipe_data.data.valid_count;
+        crc = Crc32cUpdate(crc, pipe_data.data);
+
+        if (!in_chunk) {
+          // data past the end of the last chunk
+          crc_errors += (valid_count != 0);
+        } else if (valid_count >= chunk_left) {
+          // the end of the chunk
+          bool size_error = valid_count != chunk_left;
+          bool crc_error = check_crc && MaskSnappyCrc(~crc) != expected_crc;
+          crc_errors += (size_error || crc_error);
+          in_chunk = false;
+        }
+        chunk_left -= valid_count;
+
+        OutPipe::write(pipe_data);
+      }
+    }
+  }
+
+  // a chunk with less data than expected
+  if (in_chunk) crc_errors++;
+
+  // drain the chunks that never got any data, so that none are left in the
+  // pipe for the next launch
+  while (!last_chunk) {
+    last_chunk = ChunkPipe::read().last;
+    crc_errors += !last_chunk;
+  }
+
+  // notify downstream that we are done
+  OutPipe::write(OutPipeBundleT(true));
+
+  return crc_errors;
+}
+
+template <typename Id, typename InPipe, typename OutPipe, typename ChunkPipe,
+          unsigned literals_per_cycle>
+sycl::event SubmitSnappyCrc32cChecker(sycl::queue& q,
+                                      unsigned* crc_errors_ptr) {
+  return q.single_task<Id>([=] {
+#if defined (IS_BSP)
+    // When targeting a BSP, we instruct the compiler that this pointer
+    // lives on the device.
+    // Knowing this, the compiler won't generate hardware to
+    // potentially get data from the host.
+    sycl::ext::intel::device_ptr<unsigned> crc_errors(crc_errors_ptr);
+#else
+    // Device pointers are not supported when targeting an FPGA
+    // family/part
+    unsigned* crc_errors(crc_errors_ptr);
+#endif
+    *crc_errors =
+        SnappyCrc32cChecker<InPipe, OutPipe, ChunkPipe, literals_per_cycle>();
+  });
+}
+
+#endif /* __SNAPPY_CRC32C_HPP__ */
@@ -1,8 +1,13 @@
 #ifndef __SNAPPY_DATA_GEN_HPP__
 #define __SNAPPY_DATA_GEN_HPP__
 
+#include <algorithm>
+#include <cstring>
 #include <vector>
 
+#include "snappy_crc32c.hpp"
+#include "snappy_frame_reader.hpp"
+
 //
 // A function to generate compressed Snappy data for testing purposes.
 // Generates a file as follows:
@@ -156,4 +161,135 @@ std::vector<unsigned char> GenerateSnappyCompressedData(unsigned lit_str_len,
   return ret;
 }
 
+//
+// Compresses the 'count' bytes at 'data' into a raw Snappy stream. This is a
+// simple greedy compressor: it looks up the last position of each 4-byte
+// sequence in a hash table and emits a copy whenever it finds a match.
+//
+std::vector<unsigned char> SnappyCompressBlock(const unsigned char* data,
+                                               size_t count) {
+  std::vector<unsigned char> ret;
+
+  // the preamble: the uncompressed length varint
+  size_t preamble = count;
+  do {
+    unsigned char b = preamble & 0x7F;
+    preamble >>= 7;
+    ret.push_back(b | ((preamble != 0) ? 0x80 : 0x00));
+  } while (preamble != 0);
+
+  // writes 'len' literals starting at 'start', with 1 or 2 extra bytes for
+  // the length when it does not fit in the tag byte
+  auto write_literals = [&](size_t start, size_t len) {
+    while (len > 0) {
+      size_t n = std::min(len, (size_t)65536);
+      if (n <= 60) {
+        ret.push_back((n - 1) << 2);
+      } else if (n <= 256) {
+        ret.push_back(60 << 2);
+        ret.push_back(n - 1);
+      } else {
+        ret.push_back(61 << 2);
+        ret.push_back((n - 1) & 0xFF);
+        ret.push_back((n - 1) >> 8);
+      }
+      ret.insert(ret.end(), data + start, data + start + n);
+      start += n;
+      len -= n;
+    }
+  };
+
+  constexpr int kHashBits = 12;
+  constexpr size_t kMinCopyLen = 4;
+  constexpr size_t kMaxCopyLen = 64;
+  constexpr size_t kMaxCopyOffset = 65535;
+  std::vector<long> last_pos(1 << kHashBits, -1);
+
+  size_t literal_start = 0;
+  size_t i = 0;
+  while (i + kMinCopyLen <= count) {
+    unsigned word;
+    std::memcpy(&word, data + i, sizeof(word));
+    unsigned hash = (word * 0x1E35A7BDU) >> (32 - kHashBits);
+    long candidate = last_pos[hash];
+    last_pos[hash] = i;
+
+    if (candidate >= 0 && i - candidate <= kMaxCopyOffset &&
+        std::memcmp(data + candidate, data + i, kMinCopyLen) == 0) {
+      size_t len = kMinCopyLen;
+      while (i + len < count && len < kMaxCopyLen &&
+             data[candidate + len] == data[i + len]) {
+        len++;
+      }
+      write_literals(literal_start, i - literal_start);
+
+      // a copy with a 2 byte little-endian offset
+      constexpr unsigned char copy_tag_type = 2;
+      size_t offset = i - candidate;
+      ret.push_back(((len - 1) << 2) | copy_tag_type);
+      ret.push_back(offset & 0xFF);
+      ret.push_back(offset >> 8);
+
+      i += len;
+      literal_start = i;
+    } else {
+      i++;
+    }
+  }
+  write_literals(literal_start, count - literal_start);
+
+  return ret;
+}
+
+//
+// Generates a stream in the Snappy framing format that holds 'data'. The data
+// is split into chunks of 64 KB, which are stored compressed, unless that
+// saves less than 12.5%, like the reference implementation. A padding chunk
+// follows the first chunk to exercise the skippable chunks.
+//
+std::vector<unsigned char> GenerateSnappyFramedData(
+    const std::vector<unsigned char>& data) {
+  constexpr size_t kChunkBytes = 65536;
+  constexpr size_t kPaddingBytes = 3;
+
+  std::vector<unsigned char> ret(
+      kSnappyStreamIdentifier,
+      kSnappyStreamIdentifier + sizeof(kSnappyStreamIdentifier));
+
+  auto write_header = [&](unsigned char type, size_t len) {
+    ret.push_back(type);
+    for (int i = 0; i < 3; i++) {
+      ret.push_back((len >> (i * 8)) & 0xFF);
+    }
+  };
+
+  for (size_t offset = 0; offset < data.size(); offset += kChunkBytes) {
+    size_t count = std::min(kChunkBytes, data.size() - offset);
+    const unsigned char* chunk = data.data() + offset;
+    auto compressed = SnappyCompressBlock(chunk, count);
+    bool use_compressed = compressed.size() < count - count / 8;
+
+    size_t data_len = use_compressed ? compressed.size() : count;
+    write_header(use_compressed ? kSnappyChunkCompressed
+                                : kSnappyChunkUncompressed,
+                 kSnappyChunkCrcBytes + data_len);
+    unsigned crc = MaskSnappyCrc(Crc32c(chunk, count));
+    for (int i = 0; i < 4; i++) {
+      ret.push_back((crc >> (i * 8)) & 0xFF);
+    }
+    if (use_compressed) {
+      ret.insert(ret.end(), compressed.begin(), compressed.end());
+    } else {
+      ret.insert(ret.end(), chunk, chunk + count);
+    }
+
+    if (offset == 0) {
+      write_header(kSnappyChunkPadding, kPaddingBytes);
+      ret.insert(ret.end(), kPaddingBytes, 0);
+    }
+  }
+
+  return ret;
+}
+
 #endif /* __SNAPPY_DATA_GEN_HPP__ */
@@ -3,6 +3,7 @@
 
 #include <sycl/sycl.hpp>
 #include <chrono>
+#include <memory>
 #include <optional>
 #include <sycl/ext/intel/ac_types/ac_int.hpp>
 #include <sycl/ext/intel/fpga_extensions.hpp>
@@ -12,15 +13,128 @@
 #include "../common/lz77_decoder.hpp"
 #include "constexpr_math.hpp"         // included from ../../../../include
 #include "metaprogramming_utils.hpp"  // included from ../../../../include
+#include "snappy_crc32c.hpp"
+#include "snappy_frame_reader.hpp"
 #include "snappy_reader.hpp"
+#include "unrolled_loop.hpp"         // included from ../../../../include
 
-// declare the kernel and pipe names globally to reduce name mangling
+// declare the kernel and pipe names globally to reduce name mangling. They are
+// templated on the index of the engine, since the design can have several.
+template <int engine_id>
+class SnappyFrameReaderKernelID;
+template <int engine_id>
 class SnappyReaderKernelID;
+template <int engine_id>
 class LZ77DecoderKernelID;
+template <int engine_id>
+class SnappyCrc32cCheckerKernelID;
+template <int engine_id>
 class ByteStackerKernelID;
 
+template <int engine_id>
+class SnappyFrameReaderToSnappyReaderPipeID;
+template <int engine_id>
+class SnappyFrameReaderChunkPipeID;
+template <int engine_id>
 class SnappyReaderToLZ77PipeID;
-class LZ77ToByteStackerPipeID;
+template <int engine_id>
+class SnappyReaderChunkPipeID;
+template <int engine_id>
+class LZ77ToCrc32cCheckerPipeID;
+template <int engine_id>
+class Crc32cCheckerToByteStackerPipeID;
+
+//
+// Returns whether 'in_bytes' starts with the stream identifier of the Snappy
+// framing format. Otherwise, it is a raw Snappy stream.
+//
+template <typename ByteContainerT>
+bool IsSnappyFramed(const ByteContainerT& in_bytes) {
+  constexpr size_t kStreamIdentifierBytes = sizeof(kSnappyStreamIdentifier);
+  return in_bytes.size() >= kStreamIdentifierBytes &&
+         std::equal(kSnappyStreamIdentifier,
+                    kSnappyStreamIdentifier + kStreamIdentifierBytes,
+                    in_bytes.begin());
+}
+
+//
+// Finds the compressed and uncompressed chunks of a stream in the Snappy
+// framing format. Each chunk holds a complete raw Snappy stream, or the data
+// as is, so the chunks are independent of one another. Each unit spans the
+// whole chunk, including its header and CRC, along with the skippable chunks
+// that follow it, so that the units cover the stream without gaps. This is
+// used to size the output buffer and to split the stream between the engines.
+// Returns an empty list if 'in_bytes' is not in the framing format.
+//
+std::vector<DecompressUnit> IndexSnappyFrames(
+    const std::vector<unsigned char>& in_bytes) {
+  size_t in_count = in_bytes.size();
+  if (!IsSnappyFramed(in_bytes)) {
+    return {};
+  }
+
+  std::vector<DecompressUnit> chunks;
+  size_t offset = 0;
+  size_t out_offset = 0;
+  while (offset < in_count) {
+    // every chunk starts with a 1 byte type and a 3 byte length
+    if (in_count - offset < 4) {
+      std::cerr << "ERROR: truncated Snappy chunk header\n";
+      std::terminate();
+    }
+    unsigned char type = in_bytes[offset];
+    size_t len = in_bytes[offset + 1] | (in_bytes[offset + 2] << 8) |
+                 (in_bytes[offset + 3] << 16);
+    size_t data = offset + 4;
+    if (len > in_count - data) {
+      std::cerr << "ERROR: truncated Snappy chunk at offset " << offset
+                << "\n";
+      std::terminate();
+    }
+
+    if (type == kSnappyChunkCompressed || type == kSnappyChunkUncompressed) {
+      // the data follows the 4 byte masked CRC-32C
+      if (len < kSnappyChunkCrcBytes) {
+        std::cerr << "ERROR: Snappy chunk at offset " << offset
+                  << " is too short\n";
+        std::terminate();
+      }
+      size_t data_len = len - kSnappyChunkCrcBytes;
+      size_t out_count = data_len;
+      if (type == kSnappyChunkCompressed) {
+        // the uncompressed size is the preamble of the raw Snappy stream
+        out_count = 0;
+        size_t idx = data + kSnappyChunkCrcBytes;
+        bool keep_reading_preamble = true;
+        for (int i = 0; keep_reading_preamble; i++) {
+          if (i > 4 || idx >= data + len) {
+            std::cerr << "ERROR: invalid preamble in Snappy chunk at offset "
+                      << offset << "\n";
+            std::terminate();
+          }
+          keep_reading_preamble = (in_bytes[idx] >> 7) & 0x1;
+          out_count |= (size_t)(in_bytes[idx] & 0x7F) << (i * 7);
+          idx++;
+        }
+      }
+      // the first unit also spans the stream identifier
+      size_t unit_offset = chunks.empty() ? 0 : offset;
+      chunks.push_back({unit_offset, 0, out_offset, out_count});
+      out_offset += out_count;
+    } else if (type < kSnappyChunkFirstSkippable) {
+      std::cerr << "ERROR: reserved unskippable Snappy chunk type 0x"
+                << std::hex << (int)type << std::dec << "\n";
+      std::terminate();
+    }
+    // stream identifiers (e.g. of concatenated streams), padding and other
+    // skippable chunks are left to the engine
+    offset = data + len;
+    if (!chunks.empty()) {
+      chunks.back().in_count = offset - chunks.back().in_offset;
+    }
+  }
+  return chunks;
+}
 
 //
 // Submits the kernels for the Snappy decompression engine and returns a list of
@@ -35,16 +149,24 @@ class LZ77ToByteStackerPipeID;
 //      This sets how many literals can be read from the input stream at once,
 //      as well as the number that can be read at once from the history buffer
 //      in the LZ77 decoder.
+//    engine_id: the index of the engine, which sets the kernel and pipe names
 //
 //  Arguments:
 //    q: the SYCL queue
 //    in_count: the number of compressed bytes
-//    preamble_count: an output buffer for the uncompressed size read in the
-//      Snappy preamble
+//    framed: whether the input is in the Snappy framing format, or else a raw
+//      Snappy stream
+//    preamble_count: an output buffer for the total uncompressed size read in
+//      the Snappy preamble of each chunk (or the size of uncompressed chunks)
+//    frame_valid: an output buffer for whether the framing was valid
+//    crc_errors: an output buffer for the number of chunks that failed the
+//      CRC-32C check
 //
-template <typename InPipe, typename OutPipe, unsigned literals_per_cycle>
+template <typename InPipe, typename OutPipe, unsigned literals_per_cycle,
+          int engine_id = 0>
 std::vector<sycl::event> SubmitSnappyDecompressKernels(
-    sycl::queue& q, unsigned in_count, unsigned* preamble_count) {
+    sycl::queue& q, size_t in_count, bool framed, size_t* preamble_count,
+    bool* frame_valid, unsigned* crc_errors) {
   // check that the input and output pipe types are actually pipes
   static_assert(fpga_tools::is_sycl_pipe_v<InPipe>);
   static_assert(fpga_tools::is_sycl_pipe_v<OutPipe>);
@@ -54,71 +176,123 @@ std::vector<sycl::event> SubmitSnappyDecompressKernels(
   static_assert(fpga_tools::IsPow2(literals_per_cycle));
 
   // the inter-kernel pipes for the snappy decompression engine
+  constexpr int SnappyFrameReaderToSnappyReaderPipeDepth = 16;
+  using SnappyFrameReaderToSnappyReaderPipe = sycl::ext::intel::pipe<
+      SnappyFrameReaderToSnappyReaderPipeID<engine_id>,
+      ByteSet<literals_per_cycle>, SnappyFrameReaderToSnappyReaderPipeDepth>;
+
   constexpr int SnappyReaderToLZ77PipeDepth = 16;
   using SnappyReaderToLZ77Pipe = sycl::ext::intel::pipe<
-      SnappyReaderToLZ77PipeID,
+      SnappyReaderToLZ77PipeID<engine_id>,
       FlagBundle<SnappyLZ77InputData<literals_per_cycle>>,
       SnappyReaderToLZ77PipeDepth>;
 
+  using LZ77ToCrc32cCheckerPipe =
+      sycl::ext::intel::pipe<LZ77ToCrc32cCheckerPipeID<engine_id>,
+                             FlagBundle<BytePack<literals_per_cycle>>>;
+
+  // the chunk information runs ahead of the data of each chunk
+  constexpr int ChunkPipeDepth = 8;
+  using SnappyFrameReaderChunkPipe =
+      sycl::ext::intel::pipe<SnappyFrameReaderChunkPipeID<engine_id>,
+                             SnappyChunkInfo, ChunkPipeDepth>;
+  using SnappyReaderChunkPipe =
+      sycl::ext::intel::pipe<SnappyReaderChunkPipeID<engine_id>,
+                             SnappyChunkInfo, ChunkPipeDepth>;
+
+  auto snappy_frame_reader_event = SubmitSnappyFrameReader<
+      SnappyFrameReaderKernelID<engine_id>, InPipe,
+      SnappyFrameReaderToSnappyReaderPipe, SnappyFrameReaderChunkPipe,
+      literals_per_cycle>(q, in_count, framed, frame_valid);
+
   auto snappy_reader_event =
-      SubmitSnappyReader<SnappyReaderKernelID, InPipe, SnappyReaderToLZ77Pipe,
-                         literals_per_cycle>(q, in_count, preamble_count);
+      SubmitSnappyReader<SnappyReaderKernelID<engine_id>,
+                         SnappyFrameReaderToSnappyReaderPipe,
+                         SnappyFrameReaderChunkPipe, SnappyReaderToLZ77Pipe,
+                         SnappyReaderChunkPipe, literals_per_cycle>(
+          q, preamble_count);
+
+  auto lz77_event =
+      SubmitLZ77Decoder<LZ77DecoderKernelID<engine_id>, SnappyReaderToLZ77Pipe,
+                        LZ77ToCrc32cCheckerPipe, literals_per_cycle,
+                        kSnappyMaxLZ77Distance, kSnappyMaxLZ77Length>(q);
 
   // the design only needs a ByteStacker kernel when literals_per_cycle > 1
   if constexpr (literals_per_cycle > 1) {
-    using LZ77ToByteStackerPipe =
-        sycl::ext::intel::pipe<LZ77ToByteStackerPipeID,
+    using Crc32cCheckerToByteStackerPipe =
+        sycl::ext::intel::pipe<Crc32cCheckerToByteStackerPipeID<engine_id>,
                                FlagBundle<BytePack<literals_per_cycle>>>;
 
-    auto lz77_event =
-        SubmitLZ77Decoder<LZ77DecoderKernelID, SnappyReaderToLZ77Pipe,
-                          LZ77ToByteStackerPipe, literals_per_cycle,
-                          kSnappyMaxLZ77Distance, kSnappyMaxLZ77Length>(q);
+    auto crc32c_checker_event = SubmitSnappyCrc32cChecker<
+        SnappyCrc32cCheckerKernelID<engine_id>, LZ77ToCrc32cCheckerPipe,
+        Crc32cCheckerToByteStackerPipe, SnappyReaderChunkPipe,
+        literals_per_cycle>(q, crc_errors);
     auto byte_stacker_event =
-        SubmitByteStacker<ByteStackerKernelID, LZ77ToByteStackerPipe, OutPipe,
+        SubmitByteStacker<ByteStackerKernelID<engine_id>,
+                          Crc32cCheckerToByteStackerPipe, OutPipe,
                           literals_per_cycle>(q);
 
-    return {snappy_reader_event, lz77_event, byte_stacker_event};
+    return {snappy_frame_reader_event, snappy_reader_event, lz77_event,
+            crc32c_checker_event, byte_stacker_event};
   } else {
-    auto lz77_event =
-        SubmitLZ77Decoder<LZ77DecoderKernelID, SnappyReaderToLZ77Pipe, OutPipe,
-                          literals_per_cycle, kSnappyMaxLZ77Distance,
-                          kSnappyMaxLZ77Length>(q);
-    return {snappy_reader_event, lz77_event};
+    auto crc32c_checker_event = SubmitSnappyCrc32cChecker<
+        SnappyCrc32cCheckerKernelID<engine_id>, LZ77ToCrc32cCheckerPipe,
+        OutPipe, SnappyReaderChunkPipe, literals_per_cycle>(q, crc_errors);
+    return {snappy_frame_reader_event, snappy_reader_event, lz77_event,
+            crc32c_checker_event};
   }
 }
 
 // declare kernel and pipe names at the global scope to reduce name mangling
+template <int engine_id>
 class ProducerId;
+template <int engine_id>
 class ConsumerId;
+template <int engine_id>
 class InPipeId;
+template <int engine_id>
 class OutPipeId;
 
-// the input and output pipe
-using InPipe = sycl::ext::intel::pipe<InPipeId, ByteSet<kLiteralsPerCycle>>;
-using OutPipe =
-    sycl::ext::intel::pipe<OutPipeId, FlagBundle<BytePack<kLiteralsPerCycle>>>;
+// the input and output pipe of each engine
+template <int engine_id>
+using InPipe =
+    sycl::ext::intel::pipe<InPipeId<engine_id>, ByteSet<kLiteralsPerCycle>>;
+template <int engine_id>
+using OutPipe = sycl::ext::intel::pipe<OutPipeId<engine_id>,
+                                       FlagBundle<BytePack<kLiteralsPerCycle>>>;
 
 //
 // The SNAPPY decompressor. See ../common/common.hpp for more information.
+// 'num_engines' is the number of decompression engines used by
+// DecompressUnits. DecompressBytes and DecompressStream use the first one.
 //
-template <unsigned literals_per_cycle>
+template <unsigned literals_per_cycle, int num_engines>
 class SnappyDecompressor : public DecompressorBase {
+  static_assert(num_engines > 0);
+  static_assert(kUnitSlotAlignment % literals_per_cycle == 0);
+
  public:
   std::optional<std::vector<unsigned char>> DecompressBytes(
       sycl::queue& q, std::vector<unsigned char>& in_bytes, int runs,
       bool print_stats) {
     bool passed = true;
-    unsigned in_count = in_bytes.size();
-    int in_count_padded =
-        fpga_tools::RoundUpToMultiple(in_count, kLiteralsPerCycle);
-
-    // read the expected output size from the start of the file
-    // this is used to size the output buffer
-    unsigned out_count = 0;
+    size_t in_count = in_bytes.size();
+    size_t in_count_padded =
+        fpga_tools::RoundUpToMultiple(in_count, (size_t)kLiteralsPerCycle);
+
+    // read the expected output size from the start of the file, or from the
+    // chunks of a framed stream. This is used to size the output buffer.
+    bool framed = IsSnappyFramed(in_bytes);
+    size_t out_count = 0;
     unsigned byte_idx = 0;
     unsigned shift = 0;
-    bool keep_reading_preamble = true;
+    bool keep_reading_preamble = !framed;
+    if (framed) {
+      auto chunks = IndexSnappyFrames(in_bytes);
+      if (!chunks.empty()) {
+        out_count = chunks.back().out_offset + chunks.back().out_count;
+      }
+    }
     while (keep_reading_preamble) {
       if (byte_idx > 4) {
         std::cerr << "ERROR: uncompressed length should not span more than 5"
@@ -127,7 +301,7 @@ class SnappyDecompressor : public DecompressorBase {
       }
       auto b = in_bytes[byte_idx];
       keep_reading_preamble = (b >> 7) & 0x1;
-      out_count |= (b & 0x7F) << shift;
+      out_count |= (size_t)(b & 0x7F) << shift;
       shift += 7;
       byte_idx += 1;
     }
@@ -136,18 +310,38 @@ class SnappyDecompressor : public DecompressorBase {
 
     // round up the output count to the nearest multiple of kLiteralsPerCycle
     // this allows to ignore predicating the last writes to the output
-    int out_count_padded =
-        fpga_tools::RoundUpToMultiple(out_count, kLiteralsPerCycle);
+    // The consumer needs room for one more element to read the 'done' signal
+    // from the engine in the same launch.
+    size_t out_count_padded =
+        fpga_tools::RoundUpToMultiple(out_count, (size_t)kLiteralsPerCycle);
+    size_t out_alloc_count = out_count_padded + kLiteralsPerCycle;
+
+    // the producer and consumer kernels count the bytes they transfer with 32
+    // bits, so larger files must be decompressed with DecompressStream
+    if (in_count_padded > std::numeric_limits<unsigned>::max() ||
+        out_alloc_count > std::numeric_limits<unsigned>::max()) {
+      std::cerr << "ERROR: the input or output is too large to decompress in "
+                << "memory (" << in_count << " and " << out_count
+                << " bytes), use --stream\n";
+      return {};
+    }
 
     // host variables for output from device
-    unsigned preamble_count_host;
+    size_t preamble_count_host;
+    bool frame_valid_host;
+    unsigned crc_errors_host;
 
     // track timing information in ms
     std::vector<double> time(runs);
 
     // input and output data pointers on the device using USM device allocations
     unsigned char *in, *out;
-    unsigned* preamble_count;
+    size_t* preamble_count;
+    bool* frame_valid;
+    unsigned* crc_errors;
+
+    // the number of bytes written by the consumer kernel
+    ConsumerResult* consumer_result;
 
     try {
 #if defined (IS_BSP)
@@ -157,12 +351,12 @@ class SnappyDecompressor : public DecompressorBase {
         std::cerr << "ERROR: could not allocate space for 'in'\n";
         std::terminate();
       }
-      if ((out = sycl::malloc_device<unsigned char>(out_count_padded, q)) ==
+      if ((out = sycl::malloc_device<unsigned char>(out_alloc_count, q)) ==
           nullptr) {
         std::cerr << "ERROR: could not allocate space for 'out'\n";
         std::terminate();
       }
-      if ((preamble_count = sycl::malloc_device<unsigned>(1, q)) == nullptr) {
+      if ((preamble_count = sycl::malloc_device<size_t>(1, q)) == nullptr) {
         std::cerr << "ERROR: could not allocate space for 'preamble_count'\n";
         std::terminate();
       }
@@ -173,16 +367,20 @@ class SnappyDecompressor : public DecompressorBase {
         std::cerr << "ERROR: could not allocate space for 'in'\n";
         std::terminate();
       }
-      if ((out = sycl::malloc_shared<unsigned char>(out_count_padded, q)) ==
+      if ((out = sycl::malloc_shared<unsigned char>(out_alloc_count, q)) ==
           nullptr) {
         std::cerr << "ERROR: could not allocate space for 'out'\n";
         std::terminate();
       }
-      if ((preamble_count = sycl::malloc_shared<unsigned>(1, q)) == nullptr) {
+      if ((preamble_count = sycl::malloc_shared<size_t>(1, q)) == nullptr) {
         std::cerr << "ERROR: could not allocate space for 'preamble_count'\n";
         std::terminate();
       }
 #endif
+      frame_valid = AllocateKernelMemory<bool>(q, 1, "frame_valid");
+      crc_errors = AllocateKernelMemory<unsigned>(q, 1, "crc_errors");
+      consumer_result =
+          AllocateKernelMemory<ConsumerResult>(q, 1, "consumer_result");
 
       // copy the input data to the device memory and wait for the copy to
       // finish
@@ -194,16 +392,17 @@ class SnappyDecompressor : public DecompressorBase {
 
         // run the producer and consumer kernels
         auto producer_event =
-            SubmitProducer<ProducerId, InPipe, literals_per_cycle>(
+            SubmitProducer<ProducerId<0>, InPipe<0>, literals_per_cycle>(
                 q, in_count_padded, in);
         auto consumer_event =
-            SubmitConsumer<ConsumerId, OutPipe, literals_per_cycle>(
-                q, out_count_padded, out);
+            SubmitConsumer<ConsumerId<0>, OutPipe<0>, literals_per_cycle>(
+                q, out_alloc_count, out, consumer_result);
 
         // run the decompression kernels
         auto snappy_decompress_events =
-            SubmitSnappyDecompressKernels<InPipe, OutPipe, kLiteralsPerCycle>(
-                q, in_count, preamble_count);
+            SubmitSnappyDecompressKernels<InPipe<0>, OutPipe<0>,
+                                          kLiteralsPerCycle>(
+                q, in_count, framed, preamble_count, frame_valid, crc_errors);
 
         // wait for the producer and consumer to finish
         auto s = std::chrono::high_resolution_clock::now();
@@ -224,7 +423,9 @@ class SnappyDecompressor : public DecompressorBase {
         // Copy the output back from the device
         q.memcpy(out_bytes.data(), out, out_count * sizeof(unsigned char))
             .wait();
-        q.memcpy(&preamble_count_host, preamble_count, sizeof(int)).wait();
+        q.memcpy(&preamble_count_host, preamble_count, sizeof(size_t)).wait();
+        q.memcpy(&frame_valid_host, frame_valid, sizeof(bool)).wait();
+        q.memcpy(&crc_errors_host, crc_errors, sizeof(unsigned)).wait();
 
         // validating the output
         // check the number of bytes we read
@@ -234,6 +435,9 @@ class SnappyDecompressor : public DecompressorBase {
                     << " (preamble_count_host != out_count)\n";
           passed = false;
         }
+
+        // check the framing and the CRC of each chunk
+        passed &= CheckFrames(frame_valid_host, crc_errors_host);
       }
     } catch (sycl::exception const& e) {
       std::cout << "Caught a synchronous SYCL exception: " << e.what() << "\n";
@@ -243,7 +447,10 @@ class SnappyDecompressor : public DecompressorBase {
     // free the allocated device memory
     sycl::free(in, q);
     sycl::free(out, q);
+    sycl::free(consumer_result, q);
     sycl::free(preamble_count, q);
+    sycl::free(frame_valid, q);
+    sycl::free(crc_errors, q);
 
     // print the performance results
     if (passed && print_stats) {
@@ -276,6 +483,173 @@ class SnappyDecompressor : public DecompressorBase {
       return {};
     }
   }
+
+  std::vector<sycl::event> SubmitStreamEngine(
+      sycl::queue& q, size_t in_count,
+      const std::vector<unsigned char>& head) {
+    stream_preamble_count_ =
+        AllocateKernelMemory<size_t>(q, 1, "preamble_count");
+    stream_frame_valid_ = AllocateKernelMemory<bool>(q, 1, "frame_valid");
+    stream_crc_errors_ = AllocateKernelMemory<unsigned>(q, 1, "crc_errors");
+    return SubmitSnappyDecompressKernels<InPipe<0>, OutPipe<0>,
+                                         kLiteralsPerCycle>(
+        q, in_count, IsSnappyFramed(head), stream_preamble_count_,
+        stream_frame_valid_, stream_crc_errors_);
+  }
+
+  sycl::event SubmitStreamProducer(sycl::queue& q, unsigned char* in_ptr,
+                                   unsigned count,
+                                   const std::vector<sycl::event>& depends_on) {
+    // the bytes past 'count' are zero, so the last chunk can be padded
+    unsigned count_padded =
+        fpga_tools::RoundUpToMultiple(count, literals_per_cycle);
+    return SubmitProducer<ProducerId<0>, InPipe<0>, literals_per_cycle>(
+        q, count_padded, in_ptr, depends_on);
+  }
+
+  sycl::event SubmitStreamConsumer(sycl::queue& q, unsigned char* out_ptr,
+                                   unsigned max_count,
+                                   ConsumerResult* result) {
+    return SubmitConsumer<ConsumerId<0>, OutPipe<0>, literals_per_cycle>(
+        q, max_count, out_ptr, result);
+  }
+
+  bool FinishStream(sycl::queue& q, size_t out_count) {
+    bool passed = true;
+    size_t preamble_count_host;
+    bool frame_valid_host;
+    unsigned crc_errors_host;
+    q.memcpy(&preamble_count_host, stream_preamble_count_, sizeof(size_t))
+        .wait();
+    q.memcpy(&frame_valid_host, stream_frame_valid_, sizeof(bool)).wait();
+    q.memcpy(&crc_errors_host, stream_crc_errors_, sizeof(unsigned)).wait();
+    if (preamble_count_host != out_count) {
+      std::cerr << "ERROR: Out counts do not match: " << preamble_count_host
+                << " != " << out_count
+                << " (preamble_count_host != out_count)\n";
+      passed = false;
+    }
+    passed &= CheckFrames(frame_valid_host, crc_errors_host);
+    sycl::free(stream_preamble_count_, q);
+    sycl::free(stream_frame_valid_, q);
+    sycl::free(stream_crc_errors_, q);
+    return passed;
+  }
+
+  int NumEngines() const { return num_engines; }
+
+  // A raw Snappy stream cannot be split, so only streams in the framing
+  // format are decompressed by DecompressUnits. Each engine parses the chunks
+  // of its unit, so consecutive chunks are merged into one unit per engine.
+  std::vector<DecompressUnit> IndexUnits(
+      const std::vector<unsigned char>& in_bytes) {
+    if constexpr (num_engines == 1) {
+      return {};
+    } else {
+      auto chunks = IndexSnappyFrames(in_bytes);
+      if (chunks.size() < 2) return {};
+      return MergeUnits(chunks, num_engines);
+    }
+  }
+
+  void PrepareUnits(sycl::queue& q, size_t unit_count) {
+    units_preamble_count_ =
+        AllocateKernelMemory<size_t>(q, unit_count, "preamble_count");
+    units_frame_valid_ =
+        AllocateKernelMemory<bool>(q, unit_count, "frame_valid");
+    units_crc_errors_ =
+        AllocateKernelMemory<unsigned>(q, unit_count, "crc_errors");
+  }
+
+  std::vector<sycl::event> SubmitUnit(sycl::queue& q, int engine,
+                                      size_t unit_idx,
+                                      const DecompressUnit& unit,
+                                      unsigned char* in_ptr,
+                                      unsigned char* out_ptr,
+                                      unsigned max_count,
+                                      ConsumerResult* result) {
+    // the producer reads whole elements, so it may read a few bytes of the
+    // next unit, which the frame reader ignores
+    size_t in_count = unit.in_count;
+    unsigned in_count_padded = fpga_tools::RoundUpToMultiple(
+        in_count, (size_t)literals_per_cycle);
+    std::vector<sycl::event> events;
+    fpga_tools::UnrolledLoop<int, 0, num_engines>([&](auto e) {
+      if (e == engine) {
+        events = SubmitSnappyDecompressKernels<InPipe<e>, OutPipe<e>,
+                                               literals_per_cycle, e>(
+            q, in_count, true, units_preamble_count_ + unit_idx,
+            units_frame_valid_ + unit_idx, units_crc_errors_ + unit_idx);
+        events.push_back(
+            SubmitProducer<ProducerId<e>, InPipe<e>, literals_per_cycle>(
+                q, in_count_padded, in_ptr));
+        events.push_back(
+            SubmitConsumer<ConsumerId<e>, OutPipe<e>, literals_per_cycle>(
+                q, max_count, out_ptr, result));
+      }
+    });
+    return events;
+  }
+
+  bool CheckUnits(sycl::queue& q, const std::vector<DecompressUnit>& units,
+                  const std::vector<unsigned char>&) {
+    bool passed = true;
+    std::vector<size_t> preamble_count_host(units.size());
+    std::unique_ptr<bool[]> frame_valid_host(new bool[units.size()]);
+    std::vector<unsigned> crc_errors_host(units.size());
+    q.memcpy(preamble_count_host.data(), units_preamble_count_,
+             units.size() * sizeof(size_t))
+        .wait();
+    q.memcpy(frame_valid_host.get(), units_frame_valid_,
+             units.size() * sizeof(bool))
+        .wait();
+    q.memcpy(crc_errors_host.data(), units_crc_errors_,
+             units.size() * sizeof(unsigned))
+        .wait();
+    for (size_t u = 0; u < units.size(); u++) {
+      if (preamble_count_host[u] != units[u].out_count) {
+        std::cerr << "ERROR: Out counts do not match for unit " << u << ": "
+                  << preamble_count_host[u] << " != " << units[u].out_count
+                  << " (preamble_count_host != out_count)\n";
+        passed = false;
+      }
+      passed &= CheckFrames(frame_valid_host[u], crc_errors_host[u]);
+    }
+    return passed;
+  }
+
+  void FreeUnits(sycl::queue& q) {
+    sycl::free(units_preamble_count_, q);
+    sycl::free(units_frame_valid_, q);
+    sycl::free(units_crc_errors_, q);
+  }
+
+ private:
+  // checks the status the SnappyFrameReader and SnappyCrc32cChecker kernels
+  // wrote
+  static bool CheckFrames(bool frame_valid, unsigned crc_errors) {
+    bool passed = true;
+    if (!frame_valid) {
+      std::cerr << "ERROR: invalid Snappy stream framing\n";
+      passed = false;
+    }
+    if (crc_errors != 0) {
+      std::cerr << "ERROR: " << crc_errors
+                << " Snappy chunk(s) failed the CRC-32C check\n";
+      passed = false;
+    }
+    return passed;
+  }
+
+  // the results of the stream being decompressed by DecompressStream
+  size_t* stream_preamble_count_;
+  bool* stream_frame_valid_;
+  unsigned* stream_crc_errors_;
+
+  // the results of each unit decompressed by DecompressUnits
+  size_t* units_preamble_count_;
+  bool* units_frame_valid_;
+  unsigned* units_crc_errors_;
 };
 
 #endif /* __SNAPPY_DECOMPRESSOR_HPP__ */
@@ -0,0 +1,241 @@
+#ifndef __SNAPPY_FRAME_READER_HPP__
+#define __SNAPPY_FRAME_READER_HPP__
+
+#include <sycl/sycl.hpp>
+#include <sycl/ext/intel/ac_types/ac_int.hpp>
+#include <sycl/ext/intel/fpga_extensions.hpp>
+
+#include "byte_stream.hpp"
+#include "constexpr_math.hpp"         // included from ../../../../include
+#include "metaprogramming_utils.hpp"  // included from ../../../../include
+
+// the chunk types of the Snappy framing format (see the README)
+constexpr unsigned char kSnappyChunkCompressed = 0x00;
+constexpr unsigned char kSnappyChunkUncompressed = 0x01;
+constexpr unsigned char kSnappyChunkPadding = 0xfe;
+constexpr unsigned char kSnappyChunkStreamIdentifier = 0xff;
+constexpr unsigned char kSnappyStreamIdentifier[] = {
+    0xff, 0x06, 0x00, 0x00, 's', 'N', 'a', 'P', 'p', 'Y'};
+
+// chunk types in the range [0x80, 0xfe] can be skipped, the stream identifier
+// (0xff) may repeat and is skipped as well
+constexpr unsigned char kSnappyChunkFirstSkippable = 0x80;
+
+// the bytes of a chunk header: a 1 byte type and a 3 byte length
+constexpr unsigned kSnappyChunkHeaderBytes = 4;
+
+// the bytes of the masked CRC-32C that starts the data of the compressed and
+// uncompressed chunks
+constexpr unsigned kSnappyChunkCrcBytes = 4;
+
+// the largest raw Snappy stream, which is decompressed as a single chunk
+constexpr size_t kSnappyMaxRawBytes = 0xFFFFFFFF;
+
+//
+// Describes a chunk of Snappy data. The SnappyFrameReader sends one to the
+// SnappyReader ahead of the chunk's data, and the SnappyReader forwards it to
+// the SnappyCrc32cChecker with 'count' set to the number of uncompressed
+// bytes.
+//
+struct SnappyChunkInfo {
+  unsigned count;   // the number of bytes in the chunk
+  unsigned crc;     // the masked CRC-32C of the uncompressed data
+  bool compressed;  // whether the chunk is a raw Snappy stream
+  bool check_crc;   // whether 'crc' is valid, which it is for framed streams
+  bool last;        // there are no more chunks, the other fields are invalid
+};
+
+//
+// Streams in bytes from InPipe 'literals_per_cycle' at a time, parses the
+// chunks of the Snappy framing format, and streams the data of each
+// compressed and uncompressed chunk to OutPipe for the SnappyReader kernel.
+// The headers and CRCs are stripped, and the stream identifier, padding and
+// other skippable chunks are dropped.
+//
+// The data of each chunk starts on a new element of OutPipe, so the last
+// element of a chunk is padded. Before the data, the SnappyChunkInfo of the
+// chunk is written to ChunkPipe. A last SnappyChunkInfo, with 'last' set,
+// follows the final chunk.
+//
+// When 'framed' is false, the input is a raw Snappy stream, which is passed
+// on as a single compressed chunk without a CRC.
+//
+//  Template parameters:
+//    InPipe: a SYCL pipe that streams in the compressed data,
+//      'literals_per_cycle' bytes at a time.
+//    OutPipe: a SYCL pipe that streams out the data of the chunks,
+//      'literals_per_cycle' bytes at a time.
+//    ChunkPipe: a SYCL pipe that streams out a SnappyChunkInfo per chunk.
+//    literals_per_cycle: the number of bytes read from the input (and written
+//      to the output) at once.
+//
+//  Arguments:
+//    in_count: the number of compressed bytes
+//    framed: whether the input is in the framing format
+//
+// Returns whether the framing was valid. After an invalid chunk header, the
+// rest of the input is dropped. A framed stream can be 4 GiB or more, but a
+// raw stream is a single chunk and must be smaller than 4 GiB.
+//
+template <typename InPipe, typename OutPipe, typename ChunkPipe,
+          unsigned literals_per_cycle>
+bool SnappyFrameReader(size_t in_count, bool framed) {
+  // ensure the InPipe, OutPipe and ChunkPipe are SYCL pipes
+  static_assert(fpga_tools::is_sycl_pipe_v<InPipe>);
+  static_assert(fpga_tools::is_sycl_pipe_v<OutPipe>);
+  static_assert(fpga_tools::is_sycl_pipe_v<ChunkPipe>);
+
+  // make sure the pipe types are correct
+  static_assert(std::is_same_v<decltype(InPipe::read()),
+                               ByteSet<literals_per_cycle>>);
+  static_assert(std::is_same_v<decltype(OutPipe::read()),
+                               ByteSet<literals_per_cycle>>);
+  static_assert(std::is_same_v<decltype(ChunkPipe::read()), SnappyChunkInfo>);
+
+  // the maximum number of bytes to read at once is the header and CRC of a
+  // chunk, or 'literals_per_cycle' bytes of its data
+  constexpr unsigned kHeaderAndCrcBytes =
+      kSnappyChunkHeaderBytes + kSnappyChunkCrcBytes;
+  constexpr unsigned kMaxReadBytes =
+      fpga_tools::Max(literals_per_cycle, kHeaderAndCrcBytes);
+
+  // the stream size should be double the maximum bytes we will need on each
+  // iteration so that we always have bytes ready
+  constexpr unsigned kByteStreamSize = kMaxReadBytes * 2;
+  using ByteStreamT = ByteStream<kByteStreamSize, kMaxReadBytes>;
+  ByteStreamT byte_stream;
+
+  // the number of bytes read from InPipe, and the number not yet consumed
+  size_t data_read = 0;
+  size_t in_left = in_count;
+
+  // whether we are reading a chunk header, or else forwarding or skipping the
+  // 'chunk_left' remaining bytes of a chunk
+  bool reading_header = framed;
+  bool forwarding = !framed;
+  size_t chunk_left = framed ? 0 : in_count;
+  bool error = false;
+
+  // a raw stream is a single compressed chunk, which needs at least one byte
+  // of preamble and whose size must fit in SnappyChunkInfo::count. Otherwise,
+  // drop the input.
+  if (!framed) {
+    if (in_count > 0 && in_count <= kSnappyMaxRawBytes) {
+      ChunkPipe::write(
+          SnappyChunkInfo{(unsigned)in_count, 0, true, false, false});
+    } else {
+      forwarding = false;
+      error = true;
+    }
+  }
+
+  bool done = false;
+  while (!done) {
+    // grab new bytes if there is space. The producer sends exactly enough
+    // elements for 'in_count' bytes.
+    if (data_read < in_count && byte_stream.Space() >= literals_per_cycle) {
+      bool valid_read;
+      auto pipe_data = InPipe::read(valid_read);
+      if (valid_read) {
+        byte_stream.template Write<>(pipe_data);
+        data_read += literals_per_cycle;
+      }
+    }
+
+    if (reading_header) {
+      if (in_left == 0) {
+        done = true;
+      } else if (byte_stream.Count() >= kHeaderAndCrcBytes ||
+                 data_read >= in_count) {
+        // the header and, for compressed and uncompressed chunks, the CRC
+        auto header = byte_stream.template Read<kHeaderAndCrcBytes>();
+        unsigned char type = header.byte[0];
+        unsigned len = 0;
+        unsigned crc = 0;
+#pragma unroll
+        for (int i = 0; i < 3; i++) {
+          len |= (unsigned)(header.byte[i + 1]) << (i * 8);
+        }
+#pragma unroll
+        for (int i = 0; i < 4; i++) {
+          crc |= (unsigned)(header.byte[i + kSnappyChunkHeaderBytes])
+                 << (i * 8);
+        }
+
+        bool len_in_range = in_left >= kSnappyChunkHeaderBytes &&
+                            len <= in_left - kSnappyChunkHeaderBytes;
+
+        // a compressed chunk needs at least one byte of preamble
+        bool is_data_chunk =
+            (type == kSnappyChunkCompressed &&
+             len > kSnappyChunkCrcBytes) ||
+            (type == kSnappyChunkUncompressed && len >= kSnappyChunkCrcBytes);
+        bool is_skippable = type >= kSnappyChunkFirstSkippable;
+
+        if (len_in_range && is_data_chunk) {
+          unsigned data_len = len - kSnappyChunkCrcBytes;
+          ChunkPipe::write(SnappyChunkInfo{
+              data_len, crc, type == kSnappyChunkCompressed, true, false});
+          byte_stream.Shift(kHeaderAndCrcBytes);
+          in_left -= kHeaderAndCrcBytes;
+          chunk_left = data_len;
+          forwarding = true;
+        } else if (len_in_range && is_skippable) {
+          byte_stream.Shift(kSnappyChunkHeaderBytes);
+          in_left -= kSnappyChunkHeaderBytes;
+          chunk_left = len;
+          forwarding = false;
+        } else {
+          // a reserved chunk type or a truncated chunk, drop the rest of the
+          // input
+          chunk_left = in_left;
+          forwarding = false;
+          error = true;
+        }
+        reading_header = chunk_left == 0;
+      }
+    } else {
+      // forward or skip the next bytes of the chunk
+      unsigned amount =
+          fpga_tools::Min(chunk_left, (size_t)literals_per_cycle);
+      if (byte_stream.Count() >= amount) {
+        if (forwarding) {
+          OutPipe::write(byte_stream.template Read<literals_per_cycle>());
+        }
+        byte_stream.Shift(amount);
+        in_left -= amount;
+        chunk_left -= amount;
+        reading_header = chunk_left == 0;
+      }
+    }
+  }
+
+  // notify downstream that there are no more chunks
+  ChunkPipe::write(SnappyChunkInfo{0, 0, false, false, true});
+
+  return !error;
+}
+
+template <typename Id, typename InPipe, typename OutPipe, typename ChunkPipe,
+          unsigned literals_per_cycle>
+sycl::event SubmitSnappyFrameReader(sycl::queue& q, size_t in_count,
+                                    bool framed, bool* frame_valid_ptr) {
+  return q.single_task<Id>([=] {
+#if defined (IS_BSP)
+    // When targeting a BSP, we instruct the compiler that this pointer
+    // lives on the device.
+    // Knowing this, the compiler won't generate hardware to
+    // potentially get data from the host.
+    sycl::ext::intel::device_ptr<bool> frame_valid(frame_valid_ptr);
+#else
+    // Device pointers are not supported when targeting an FPGA
+    // family/part
+    bool* frame_valid(frame_valid_ptr);
+#endif
+    *frame_valid =
+        SnappyFrameReader<InPipe, OutPipe, ChunkPipe, literals_per_cycle>(
+            in_count, framed);
+  });
+}
+
+#endif /* __SNAPPY_FRAME_READER_HPP__ */
@@ -8,40 +8,25 @@
 #include "byte_stream.hpp"
 #include "constexpr_math.hpp"         // included from ../../../../include
 #include "metaprogramming_utils.hpp"  // included from ../../../../include
+#include "snappy_frame_reader.hpp"
 
 //
-// Streams in bytes from InPipe 'literals_per_cycle' at a time and
-// generates LZ77InputData (see ../common/common.hpp) to the OutPipe for the
-// LZ77Decoder kernel.
+// Reads one chunk of 'chunk.count' bytes from InPipe 'literals_per_cycle' at a
+// time and generates LZ77InputData (see ../common/common.hpp) to the OutPipe
+// for the LZ77Decoder kernel. A compressed chunk is a raw Snappy stream, and
+// an uncompressed chunk is sent on as a single literal string.
 //
-//  Template parameters:
-//    InPipe: a SYCL pipe that streams in compressed Snappy data,
-//      'literals_per_cycle' bytes at a time.
-//    OutPipe: a SYCL pipe that streams out either an array of literals with
-//      a valid count (when reading a literal string) or a {length, distance}
-//      pair (when doing a copy), in the form of LZ77InputData data.
-//      This is the input the LZ77 decoder.
-//    literals_per_cycle: the maximum number of literals read from the input
-//      (and written to the output) at once.
+// Before any of the chunk's output, 'chunk' is written to CrcChunkPipe with
+// its 'count' set to the number of uncompressed bytes.
 //
-//  Arguments:
-//    in_count: the number of compressed bytes
+// The chunk is read in whole elements of InPipe, and the padding in the last
+// one is dropped. Returns the number of uncompressed bytes in the chunk.
 //
-template <typename InPipe, typename OutPipe, unsigned literals_per_cycle>
-unsigned SnappyReader(unsigned in_count) {
-  // ensure the InPipe and OutPipe are SYCL pipes
-  static_assert(fpga_tools::is_sycl_pipe_v<InPipe>);
-  static_assert(fpga_tools::is_sycl_pipe_v<OutPipe>);
-
-  // the input and output pipe data types
-  using InPipeBundleT = decltype(InPipe::read());
+template <typename InPipe, typename OutPipe, typename CrcChunkPipe,
+          unsigned literals_per_cycle>
+unsigned SnappyReadChunk(SnappyChunkInfo chunk) {
   using OutPipeBundleT = decltype(OutPipe::read());
-
-  // make sure the input and output types are correct
-  static_assert(std::is_same_v<InPipeBundleT, ByteSet<literals_per_cycle>>);
-  static_assert(
-      std::is_same_v<OutPipeBundleT,
-                     FlagBundle<SnappyLZ77InputData<literals_per_cycle>>>);
+  unsigned in_count = chunk.count;
 
   // the number of bits to count to 'literals_per_cycle'
   constexpr unsigned literals_per_cycle_bits =
@@ -67,10 +52,11 @@ unsigned SnappyReader(unsigned in_count) {
 
   unsigned data_read_in_preamble = 0;
 
-  // the first 1...5 bytes indicate the number of bytes in the stream
-  bool reading_preamble = true;
-  unsigned preamble_count_local = 0;
-  ac_uint<3> bytes_processed_in_preamble;
+  // the first 1...5 bytes of a compressed chunk indicate the number of bytes
+  // in the stream
+  bool reading_preamble = chunk.compressed;
+  unsigned preamble_count_local = in_count;
+  ac_uint<3> bytes_processed_in_preamble = 0;
 
   // NOTE: this loop is expected to have a trip count of ~1-5 iterations and
   // therefore is not a performance critical loop. However, the compiler doesn't
@@ -78,7 +64,8 @@ unsigned SnappyReader(unsigned in_count) {
   // this loop to be our Fmax bottleneck, so increase the II.
   [[intel::initiation_interval(3)]]  // NO-FORMAT: Attribute
   while (reading_preamble) {
-    if (byte_stream.Space() >= literals_per_cycle) {
+    if (data_read_in_preamble < in_count &&
+        byte_stream.Space() >= literals_per_cycle) {
       bool valid_read;
       auto pipe_data = InPipe::read(valid_read);
       if (valid_read) {
@@ -87,7 +74,7 @@ unsigned SnappyReader(unsigned in_count) {
       }
     }
 
-    if (byte_stream.Count() >= 5) {
+    if (byte_stream.Count() >= 5 || data_read_in_preamble >= in_count) {
       // grab the 5 bytes
       auto first_five_bytes = byte_stream.template Read<5>();
 
@@ -145,20 +132,25 @@ unsigned SnappyReader(unsigned in_count) {
     }
   }
 
+  // send the uncompressed size of the chunk to the CRC checker ahead of the
+  // output
+  chunk.count = preamble_count_local;
+  CrcChunkPipe::write(chunk);
+
   // are we reading a literal and how many more literals do we have to read
-  bool reading_literal = false;
-  unsigned literal_len_counter;
+  // an uncompressed chunk is one long literal string
+  bool reading_literal = !chunk.compressed;
+  unsigned literal_len_counter = in_count;
 
   unsigned data_read = data_read_in_preamble;
   bool all_data_read = data_read >= in_count;
-  bool all_data_read_next = data_read >= (in_count - literals_per_cycle);
-
+  bool all_data_read_next = data_read + literals_per_cycle >= in_count;
 
   // keep track of the number of bytes processed
   constexpr unsigned max_bytes_processed_inc =
       fpga_tools::Max((unsigned)5, literals_per_cycle);
   unsigned bytes_processed_next[max_bytes_processed_inc + 1];
-  bool bytes_processed_in_range = true;
+  bool bytes_processed_in_range = bytes_processed_in_preamble < in_count;
   bool bytes_processed_in_range_next[max_bytes_processed_inc + 1];
 #pragma unroll
   for (int i = 0; i < max_bytes_processed_inc + 1; i++) {
@@ -174,8 +166,9 @@ unsigned SnappyReader(unsigned in_count) {
   // main processing loop
   // keep going while there is input to read, or data to read from byte_stream
   while (bytes_processed_in_range) {
-    // grab new bytes if there is space
-    if (byte_stream.Space() >= literals_per_cycle) {
+    // grab new bytes if there is space and the chunk has more. The next
+    // element of InPipe belongs to the next chunk.
+    if (!all_data_read && byte_stream.Space() >= literals_per_cycle) {
 
       bool valid_read;
       auto pipe_data = InPipe::read(valid_read);
@@ -183,8 +176,7 @@ unsigned SnappyReader(unsigned in_count) {
         byte_stream.template Write<>(pipe_data);
         data_read += literals_per_cycle;
         all_data_read = all_data_read_next;
-        all_data_read_next = data_read >= (in_count - literals_per_cycle);
-
+        all_data_read_next = data_read + literals_per_cycle >= in_count;
       }
     }
 
@@ -373,31 +365,91 @@ unsigned SnappyReader(unsigned in_count) {
     }
   }
 
+  // return the number of uncompressed bytes
+  return preamble_count_local;
+}
+
+//
+// Streams in the chunks of a Snappy stream from InPipe, as split by the
+// SnappyFrameReader kernel, and generates LZ77InputData (see
+// ../common/common.hpp) to the OutPipe for the LZ77Decoder kernel.
+//
+//  Template parameters:
+//    InPipe: a SYCL pipe that streams in the data of the chunks,
+//      'literals_per_cycle' bytes at a time. Each chunk starts on a new
+//      element.
+//    ChunkPipe: a SYCL pipe that streams in the SnappyChunkInfo of each chunk,
+//      followed by one with 'last' set.
+//    OutPipe: a SYCL pipe that streams out either an array of literals with
+//      a valid count (when reading a literal string) or a {length, distance}
+//      pair (when doing a copy), in the form of LZ77InputData data.
+//      This is the input the LZ77 decoder.
+//    CrcChunkPipe: a SYCL pipe that streams out the SnappyChunkInfo of each
+//      chunk, with the number of uncompressed bytes, to the CRC checker.
+//    literals_per_cycle: the maximum number of literals read from the input
+//      (and written to the output) at once.
+//
+// Returns the total number of uncompressed bytes, from the preamble of each
+// compressed chunk and the size of each uncompressed chunk. The total is
+// 64-bit, since a framed stream can hold 4 GiB or more.
+//
+template <typename InPipe, typename ChunkPipe, typename OutPipe,
+          typename CrcChunkPipe, unsigned literals_per_cycle>
+size_t SnappyReader() {
+  // ensure the pipes are SYCL pipes
+  static_assert(fpga_tools::is_sycl_pipe_v<InPipe>);
+  static_assert(fpga_tools::is_sycl_pipe_v<ChunkPipe>);
+  static_assert(fpga_tools::is_sycl_pipe_v<OutPipe>);
+  static_assert(fpga_tools::is_sycl_pipe_v<CrcChunkPipe>);
+
+  // the input and output pipe data types
+  using InPipeBundleT = decltype(InPipe::read());
+  using OutPipeBundleT = decltype(OutPipe::read());
+
+  // make sure the input and output types are correct
+  static_assert(std::is_same_v<InPipeBundleT, ByteSet<literals_per_cycle>>);
+  static_assert(
+      std::is_same_v<OutPipeBundleT,
+                     FlagBundle<SnappyLZ77InputData<literals_per_cycle>>>);
+  static_assert(std::is_same_v<decltype(ChunkPipe::read()), SnappyChunkInfo>);
+  static_assert(
+      std::is_same_v<decltype(CrcChunkPipe::read()), SnappyChunkInfo>);
+
+  size_t out_count = 0;
+  bool last_chunk = false;
+  while (!last_chunk) {
+    auto chunk = ChunkPipe::read();
+    last_chunk = chunk.last;
+    if (!last_chunk) {
+      out_count += SnappyReadChunk<InPipe, OutPipe, CrcChunkPipe,
+                                   literals_per_cycle>(chunk);
+    }
+  }
+
   // notify downstream that we are done
+  CrcChunkPipe::write(SnappyChunkInfo{0, 0, false, false, true});
   OutPipe::write(OutPipeBundleT(true));
 
-  // return the preamble count
-  return preamble_count_local;
+  return out_count;
 }
 
-template <typename Id, typename InPipe, typename OutPipe,
-          unsigned literals_per_cycle>
-sycl::event SubmitSnappyReader(sycl::queue& q, unsigned in_count,
-                               unsigned* preamble_count_ptr) {
+template <typename Id, typename InPipe, typename ChunkPipe, typename OutPipe,
+          typename CrcChunkPipe, unsigned literals_per_cycle>
+sycl::event SubmitSnappyReader(sycl::queue& q, size_t* preamble_count_ptr) {
   return q.single_task<Id>([=] {
 #if defined (IS_BSP)
     // When targeting a BSP, we instruct the compiler that this pointer
     // lives on the device.
     // Knowing this, the compiler won't generate hardware to
     // potentially get data from the host.
-    sycl::ext::intel::device_ptr<unsigned> preamble_count(preamble_count_ptr);
+    sycl::ext::intel::device_ptr<size_t> preamble_count(preamble_count_ptr);
 #else
     // Device pointers are not supported when targeting an FPGA 
     // family/part
-    unsigned* preamble_count(preamble_count_ptr);
+    size_t* preamble_count(preamble_count_ptr);
 #endif
-    *preamble_count =
-        SnappyReader<InPipe, OutPipe, literals_per_cycle>(in_count);
+    *preamble_count = SnappyReader<InPipe, ChunkPipe, OutPipe, CrcChunkPipe,
+                                   literals_per_cycle>();
   });
 }
 
@@ -8,17 +8,23 @@
 #include <sycl/ext/intel/fpga_extensions.hpp>
 #include <sycl/sycl.hpp>
 
+// Number formats of the datapath
+#include "fft2d_format.hpp"
 // Large twiddle factors tables
 #include "twiddle_factors.hpp"
 
-// Complex single-precision floating-point feedforward FFT / iFFT engine
-// Configurable in 4 or 8-parallel versions.
+// Complex feedforward FFT / iFFT engine
+// Configurable in 4 or 8-parallel versions, with a single-precision
+// floating-point or a fixed-point datapath (see fft2d_format.hpp).
 //
 // See Mario Garrido, Jesús Grajal, M. A. Sanchez, Oscar Gustafsson:
 // Pipeline Radix-2k Feedforward FFT Architectures.
 // IEEE Trans. VLSI Syst. 21(1): 23-32 (2013))
 //
-// The log(points) of the transform must be a compile-time constant argument.
+// The engine is sized at compile time for transforms of up to 2^max_logn
+// points, and the log(points) of each transform is a runtime argument, so the
+// same hardware computes any power of two size up to that maximum. The stages
+// that only larger transforms need are bypassed.
 // This FFT engine processes 4 or 8 points for each invocation.
 //
 // The entry point of the engine is the 'FFTStep' function. This function
@@ -32,16 +38,28 @@
 // function. A new instance can start processing every clock cycle
 
 // FFT butterfly building block
-template <size_t points, typename T>
+// The fixed-point formats halve the outputs, so that the samples do not grow
+// through the stages
+template <typename Format, size_t points, typename T>
 std::array<ac_complex<T>, points> Butterfly(
     std::array<ac_complex<T>, points> data) {
   std::array<ac_complex<T>, points> res;
 #pragma unroll
   for (int k = 0; k < points; k++) {
-    if (k % 2 == 0) {
-      res[k] = data[k] + data[k + 1];
+    if constexpr (Format::kFixedPoint) {
+      if (k % 2 == 0) {
+        res[k].r() = Format::Halve(data[k].r() + data[k + 1].r());
+        res[k].i() = Format::Halve(data[k].i() + data[k + 1].i());
+      } else {
+        res[k].r() = Format::Halve(data[k - 1].r() - data[k].r());
+        res[k].i() = Format::Halve(data[k - 1].i() - data[k].i());
+      }
     } else {
-      res[k] = data[k - 1] - data[k];
+      if (k % 2 == 0) {
+        res[k] = data[k] + data[k + 1];
+      } else {
+        res[k] = data[k - 1] - data[k];
+      }
     }
   }
   return res;
@@ -113,18 +131,20 @@ ac_complex<T> Delay(ac_complex<T> data, int depth, ac_complex<T> *shift_reg) {
 // Invocation count: 0123...          01234567...
 // data[0]         : GECA...   ---->      DBCA...
 // data[1]         : HFDB...   ---->      HFGE...
+// 'max_depth' is the depth of this stage in the largest transform, which sets
+// the size of the delay segments
 template <size_t points, typename T>
 std::array<ac_complex<T>, points> ReorderData(
-    std::array<ac_complex<T>, points> data, int depth, ac_complex<T> *shift_reg,
-    bool toggle) {
-  // Use disconnected segments of length 'depth + 1' elements starting at
+    std::array<ac_complex<T>, points> data, int depth, int max_depth,
+    ac_complex<T> *shift_reg, bool toggle) {
+  // Use disconnected segments of length 'max_depth + 1' elements starting at
   // 'shift_reg' to implement the delay elements. At the end of each FFT step,
   // the contents of the entire buffer is shifted by 1 element
 
 #pragma unroll
   for (int k = 0; k < points / 2; k++) {
     data[k * 2 + 1] = Delay(data[k * 2 + 1], depth,
-                            shift_reg + (k * 2 + 1 - 1) / 2 * (depth + 1));
+                            shift_reg + (k * 2 + 1 - 1) / 2 * (max_depth + 1));
   }
 
   if (toggle) {
@@ -138,57 +158,52 @@ std::array<ac_complex<T>, points> ReorderData(
 
 #pragma unroll
   for (int k = 0; k < points; k += 2) {
-    data[k] = Delay(data[k], depth, shift_reg + (points + k) / 2 * (depth + 1));
+    data[k] = Delay(data[k], depth,
+                    shift_reg + (points + k) / 2 * (max_depth + 1));
   }
 
   return data;
 }
 
 // Produces the twiddle factor associated with a processing stream 'stream',
-// at a specified 'stage' during a step 'index' of the computation
+// at a specified 'stage' during a step 'index' of a transform of 2^logn points
 //
-// If there are precomputed twiddle factors for the given FFT size, uses them
-// This saves hardware resources, because it avoids evaluating 'cos' and 'sin'
-// functions
-template <int size, size_t points, typename T>
-ac_complex<T> Twiddle(int index, int stage, int stream) {
+// If there are precomputed twiddle factors for the largest FFT size
+// 'max_size', uses them for every size. This saves hardware resources, because
+// it avoids evaluating 'cos' and 'sin' functions
+// The tables are single-precision floating-point, and are converted to the
+// sample type 'T' of the datapath
+template <int max_size, size_t points, typename T>
+ac_complex<T> Twiddle(int index, int stage, int stream, int logn) {
   ac_complex<T> twid;
 
   constexpr int kTwiddleStages = 5;
 
   // Coalesces the twiddle tables for indexed access
   // Macros defined in twiddle_factors.hpp
-  constexpr T twiddles_cos_8_points[kTwiddleStages][6][512] = COS8;
-  constexpr T twiddles_sin_8_points[kTwiddleStages][6][512] = SIN8;
-  constexpr T twiddles_cos_4_points[kTwiddleStages][3][1024] = COS4;
-  constexpr T twiddles_sin_4_points[kTwiddleStages][3][1024] = SIN4;
+  constexpr float twiddles_cos_8_points[kTwiddleStages][6][512] = COS8;
+  constexpr float twiddles_sin_8_points[kTwiddleStages][6][512] = SIN8;
+  constexpr float twiddles_cos_4_points[kTwiddleStages][3][1024] = COS4;
+  constexpr float twiddles_sin_4_points[kTwiddleStages][3][1024] = SIN4;
 
   // Use the precomputed twiddle factors, if available - otherwise, compute them
   int twid_stage = stage >> 1;
-  if constexpr (size <= (1 << (kTwiddleStages * 2 + 2))) {
+  if constexpr (max_size <= (1 << (kTwiddleStages * 2 + 2))) {
+    // The tables hold the twiddle factors of the largest supported transform,
+    // the smaller transforms use every 2^(12 - logn)th entry
+    int twid_index = index << (kTwiddleStages * 2 + 2 - logn);
     if constexpr (points == 8) {
-      twid.r() =
-          twiddles_cos_8_points[twid_stage][stream]
-                               [index *
-                                ((1 << (kTwiddleStages * 2 + 2)) / size)];
-      twid.i() =
-          twiddles_sin_8_points[twid_stage][stream]
-                               [index *
-                                ((1 << (kTwiddleStages * 2 + 2)) / size)];
+      twid.r() = twiddles_cos_8_points[twid_stage][stream][twid_index];
+      twid.i() = twiddles_sin_8_points[twid_stage][stream][twid_index];
     } else {
-      twid.r() =
-          twiddles_cos_4_points[twid_stage][stream]
-                               [index *
-                                ((1 << (kTwiddleStages * 2 + 2)) / size)];
-      twid.i() =
-          twiddles_sin_4_points[twid_stage][stream]
-                               [index *
-                                ((1 << (kTwiddleStages * 2 + 2)) / size)];
+      twid.r() = twiddles_cos_4_points[twid_stage][stream][twid_index];
+      twid.i() = twiddles_sin_4_points[twid_stage][stream][twid_index];
     }
   } else {
     // This would generate hardware consuming a large number of resources
     // Instantiated only if precomputed twiddle factors are unavailable
     constexpr double kTwoPi = 2.0f * M_PI;
+    int size = 1 << logn;
     int multiplier;
 
     // The latter 3 streams will generate the second half of the elements
@@ -223,15 +238,16 @@ ac_complex<T> Twiddle(int index, int stage, int stream) {
 }
 
 // FFT complex rotation building block
-template <int size, size_t points, typename T>
+template <int max_size, size_t points, typename T>
 std::array<ac_complex<T>, points> ComplexRotate(
-    std::array<ac_complex<T>, points> data, int index, int stage) {
+    std::array<ac_complex<T>, points> data, int index, int stage, int logn) {
 #pragma unroll
   for (int group = 0; group < points / 4; group++) {
 #pragma unroll
     for (int k = 1; k < 4; k++) {
       int stream = group * 3 + k - 1;
-      data[k + group * 4] *= Twiddle<size, points, T>(index, stage, stream);
+      data[k + group * 4] *=
+          Twiddle<max_size, points, T>(index, stage, stream, logn);
     }
   }
   return data;
@@ -243,16 +259,19 @@ std::array<ac_complex<T>, points> ComplexRotate(
 // starting with invocation N /points - 1 (outputs are delayed). Multiple
 // back-to-back transforms can be executed
 //
-// 'data' encapsulates points complex single-precision floating-point input
-// points 'step' specifies the index of the current invocation
+// 'data' encapsulates points complex input points of the datapath 'Format'
+// 'step' specifies the index of the current invocation
 // 'fft_delay_elements' is an array representing a sliding window of size
-// N+points*(log(N)-2) 'inverse' toggles between the direct and inverse
-// transform
-template <int logn, size_t points, typename T>
+// MAX_N+points*(log(MAX_N)-2) 'inverse' toggles between the direct and inverse
+// transform. 'logn' is the log of the size N of the transform, which may be
+// smaller than the largest supported size MAX_N = 2^max_logn
+// With a fixed-point 'Format', the outputs are scaled by 1/N
+template <int max_logn, typename Format, size_t points, typename T>
 std::array<ac_complex<T>, points> FFTStep(
     std::array<ac_complex<T>, points> data, int step,
-    ac_complex<T> *fft_delay_elements, bool inverse) {
-  constexpr int size = 1 << logn;
+    ac_complex<T> *fft_delay_elements, bool inverse, int logn) {
+  constexpr int kMaxSize = 1 << max_logn;
+  int size = 1 << logn;
 
   // Swap real and imaginary components if doing an inverse transform
   if (inverse) {
@@ -260,7 +279,7 @@ std::array<ac_complex<T>, points> FFTStep(
   }
 
   // Stage 0 of feed-forward FFT
-  data = Butterfly(data);
+  data = Butterfly<Format>(data);
   data = TrivialRotate(data);
   data = TrivialSwap(data);
 
@@ -268,8 +287,8 @@ std::array<ac_complex<T>, points> FFTStep(
   constexpr int kInitStages = points == 8 ? 2 : 1;
   if constexpr (points == 8) {
     // Stage 1
-    data = Butterfly(data);
-    data = ComplexRotate<size>(data, step & (size / points - 1), 1);
+    data = Butterfly<Format>(data);
+    data = ComplexRotate<kMaxSize>(data, step & (size / points - 1), 1, logn);
     data = Swap(data);
 
     stage = 2;
@@ -283,7 +302,12 @@ std::array<ac_complex<T>, points> FFTStep(
   // forward execution
 
 #pragma unroll
-  for (; stage < logn - 1; stage++) {
+  for (; stage < max_logn - 1; stage++) {
+    // The data bypasses the stages that only larger transforms need
+    if (stage >= logn - 1) {
+      continue;
+    }
+
     bool complex_stage = stage & 1;  // stages 3, 5, ...
 
     // Figure out the index of the element processed at this stage
@@ -291,27 +315,28 @@ std::array<ac_complex<T>, points> FFTStep(
     // from one stage to the next
     int data_index = (step + (1 << (logn - 1 - stage))) & (size / points - 1);
 
-    data = Butterfly(data);
+    data = Butterfly<Format>(data);
 
     if (complex_stage) {
-      data = ComplexRotate<size>(data, data_index, stage);
+      data = ComplexRotate<kMaxSize>(data, data_index, stage, logn);
     }
 
     data = Swap(data);
 
-    // Compute the delay of this stage
+    // Compute the delay of this stage, and its delay in the largest transform
     int delay = 1 << (logn - 2 - stage);
+    int max_delay = 1 << (max_logn - 2 - stage);
 
     // Reordering multiplexers must toggle every 'delay' steps
     bool toggle = data_index & delay;
 
     // Assign unique sections of the buffer for the set of delay elements at
-    // each stage
-    ac_complex<T> *head_buffer = fft_delay_elements + size -
-                                 (1 << (logn - stage + kInitStages)) +
+    // each stage, sized for the largest transform
+    ac_complex<T> *head_buffer = fft_delay_elements + kMaxSize -
+                                 (1 << (max_logn - stage + kInitStages)) +
                                  points * (stage - kInitStages);
 
-    data = ReorderData(data, delay, head_buffer, toggle);
+    data = ReorderData(data, delay, max_delay, head_buffer, toggle);
 
     if (!complex_stage) {
       data = TrivialRotate(data);
@@ -319,14 +344,14 @@ std::array<ac_complex<T>, points> FFTStep(
   }
 
   // Stage logn - 1
-  data = Butterfly(data);
+  data = Butterfly<Format>(data);
 
 // Shift the contents of the sliding window. The hardware is capable of
 // shifting the entire contents in parallel if the loop is unrolled. More
 // important, when unrolling this loop each transfer maps to a trivial
 // loop-carried dependency
 #pragma unroll
-  for (int ii = 0; ii < size + points * (logn - 2) - 1; ii++) {
+  for (int ii = 0; ii < kMaxSize + points * (max_logn - 2) - 1; ii++) {
     fft_delay_elements[ii] = fft_delay_elements[ii + 1];
   }
 
@@ -337,6 +362,49 @@ std::array<ac_complex<T>, points> FFTStep(
   return data;
 }
 
+// The twiddle factor exp(-2 * pi * i * index / 2^logn) of the conversion
+// between the spectra of complex and real matrices, for
+// 0 <= index <= 2^logn / 2 and 2^logn <= max_size
+template <int max_size, typename T>
+ac_complex<T> RealTwiddle(int index, int logn) {
+  constexpr int kTwiddleStages = 5;
+  constexpr int kTableLogN = kTwiddleStages * 2 + 2;
+  ac_complex<T> twid;
+
+  if constexpr (max_size <= (1 << kTableLogN)) {
+    // The second stream of the first stage of the 4-parallel twiddle tables
+    // holds the first quarter of the unit circle of the largest transform
+    // Macros defined in twiddle_factors.hpp
+    constexpr T twiddles_cos_4_points[kTwiddleStages][3][1024] = COS4;
+    constexpr T twiddles_sin_4_points[kTwiddleStages][3][1024] = SIN4;
+
+    int table_index = index << (kTableLogN - logn);
+    int quarter = table_index >> (kTableLogN - 2);
+    int offset = table_index & ((1 << (kTableLogN - 2)) - 1);
+    T c = twiddles_cos_4_points[0][1][offset];
+    T s = twiddles_sin_4_points[0][1][offset];
+
+    // Each quarter of the circle rotates the factor by -pi/2
+    if (quarter == 0) {
+      twid.r() = c;
+      twid.i() = s;
+    } else if (quarter == 1) {
+      twid.r() = s;
+      twid.i() = -c;
+    } else {
+      twid.r() = -c;
+      twid.i() = -s;
+    }
+  } else {
+    // Instantiated only if precomputed twiddle factors are unavailable
+    constexpr double kTwoPi = 2.0f * M_PI;
+    double theta = -1.0f * kTwoPi / (1 << logn) * index;
+    twid.r() = cos(theta);
+    twid.i() = sin(theta);
+  }
+  return twid;
+}
+
 // This utility function bit-reverses an integer 'x' of width 'bits'.
 template <int bits>
 int BitReversed(int x) {
@@ -357,49 +425,78 @@ int BitReversed(int x) {
  * This function provides the mapping for an alternative memory layout. This
  * layout preserves some amount of linearity when accessing elements from the
  * same matrix row, while bringing closer locations from the same matrix
- * column. The matrix offsets are represented using 2 * log(N) bits. This
- * function swaps bits log(N) - 1 ... log(N) / 2 with bits
- * log(N) + log(N) / 2 - 1 ... log(N).
+ * column. The matrix offsets are represented using log(N) + log(rows) bits,
+ * where N is the length of the matrix rows. This function swaps bits
+ * log(N) - 1 ... log(N) / 2 with bits log(N) + log(N) / 2 - 1 ... log(N).
  *
  * The end result is that 2^(N/2) locations from the same row would still be
  * consecutive in memory, while the distance between locations from the same
  * column would be only 2^(N/2)
  */
-template <int logn>
-int MangleBits(int x) {
-  constexpr int kNB = logn / 2;
-  int a95 = x & (((1 << kNB) - 1) << kNB);
-  int a1410 = x & (((1 << kNB) - 1) << (2 * kNB));
-  constexpr int mask = ((1 << (2 * kNB)) - 1) << kNB;
-  a95 = a95 << kNB;
-  a1410 = a1410 >> kNB;
+inline int MangleBits(int x, int logn) {
+  int nb = logn / 2;
+  int a95 = x & (((1 << nb) - 1) << nb);
+  int a1410 = x & (((1 << nb) - 1) << (2 * nb));
+  int mask = ((1 << (2 * nb)) - 1) << nb;
+  a95 = a95 << nb;
+  a1410 = a1410 >> nb;
   return (x & ~mask) | a95 | a1410;
 }
 
+// Whether a matrix of 2^log_rows rows of 2^logn points can be stored in the
+// alternative memory layout: the bits that 'MangleBits' swaps must fit in
+// the offsets of the matrix
+inline bool CanMangle(int logn, int log_rows) {
+  return 3 * (logn / 2) <= logn + log_rows;
+}
+
 /* This kernel reads the matrix data and provides "1<<log_points" data to the
- * FFT engine.
+ * FFT engine. The matrix has 2^log_rows rows of 2^logn points, with
+ * logn <= max_logn.
+ * The points are converted to the samples of the datapath 'Format'. With a
+ * fixed-point format, the points of each block of "1<<log_points" rows are
+ * scaled by 2^-shift, where 'shift' is 'input_shift', or is computed from the
+ * largest component of the block for a block exponent; the shift of each
+ * block is written to 'ExponentPipe', and the components out of range are
+ * added to '*overflows'.
  */
-template <int logn, size_t log_points, typename PipeOut, typename T>
+template <int max_logn, size_t log_points, typename PipeOut, typename T,
+          typename Format = FloatFormat, typename ExponentPipe = void>
 struct Fetch {
   ac_complex<T> *src;
   int mangle;
+  int logn;
+  int log_rows;
+  int input_shift;
+  unsigned *overflows;
 
-  Fetch(ac_complex<T> *src_, int mangle_) : src(src_), mangle(mangle_) {}
+  Fetch(ac_complex<T> *src_, int mangle_, int logn_, int log_rows_,
+        int input_shift_ = 0, unsigned *overflows_ = nullptr)
+      : src(src_), mangle(mangle_), logn(logn_), log_rows(log_rows_),
+        input_shift(input_shift_), overflows(overflows_) {}
 
   [[intel::kernel_args_restrict]]  // NO-FORMAT: Attribute
   void operator()() const {
-    constexpr int kN = (1 << logn);
+    constexpr int kMaxN = (1 << max_logn);
     constexpr int kPoints = (1 << log_points);
 
-    constexpr int kWorkGroupSize = kN;
-    constexpr int kIterations = kN * kN / kPoints / kWorkGroupSize;
+    using Sample = typename Format::Sample;
 
-    for (int i = 0; i < kIterations; i++) {
+    int n = (1 << logn);
+    int work_group_size = n;
+    int iterations = (1 << log_rows) / kPoints;
+    unsigned overflow_count = 0;
+
+    for (int i = 0; i < iterations; i++) {
       // Local memory for storing 8 rows
-      ac_complex<T> buf[kPoints * kN];
-      for (int work_item = 0; work_item < kWorkGroupSize; work_item++) {
+      ac_complex<T> buf[kPoints * kMaxN];
+
+      // The largest biased exponent of the components of the block
+      int exponent = 0;
+
+      for (int work_item = 0; work_item < work_group_size; work_item++) {
         // Each read fetches 8 matrix points
-        int x = (i * kN + work_item) << log_points;
+        int x = (i * n + work_item) << log_points;
 
         /* When using the alternative memory layout, each row consists of a set
          * of segments placed far apart in memory. Instead of reading all
@@ -410,57 +507,87 @@ struct Fetch {
 
         int where, where_global;
         if (mangle) {
-          constexpr int kNB = logn / 2;
-          int a1210 = x & ((kPoints - 1) << (2 * kNB));
-          int a75 = x & ((kPoints - 1) << kNB);
-          int mask = ((kPoints - 1) << kNB) | ((kPoints - 1) << (2 * kNB));
-          a1210 >>= kNB;
-          a75 <<= kNB;
+          int nb = logn / 2;
+          int a1210 = x & ((kPoints - 1) << (2 * nb));
+          int a75 = x & ((kPoints - 1) << nb);
+          int mask = ((kPoints - 1) << nb) | ((kPoints - 1) << (2 * nb));
+          a1210 >>= nb;
+          a75 <<= nb;
           where = (x & ~mask) | a1210 | a75;
-          where_global = MangleBits<logn>(where);
+          where_global = MangleBits(where, logn);
         } else {
           where = x;
           where_global = where;
         }
 
+        int read_exponent = 0;
 #pragma unroll
         for (int k = 0; k < kPoints; k++) {
-          buf[(where & ((1 << (logn + log_points)) - 1)) + k] =
-              src[where_global + k];
+          ac_complex<T> point = src[where_global + k];
+          buf[(where & ((1 << (logn + log_points)) - 1)) + k] = point;
+          if constexpr (Format::kBlockExponent) {
+            int exponent_r = FloatExponent(point.r());
+            int exponent_i = FloatExponent(point.i());
+            if (exponent_r > read_exponent) read_exponent = exponent_r;
+            if (exponent_i > read_exponent) read_exponent = exponent_i;
+          }
         }
+        if (read_exponent > exponent) exponent = read_exponent;
       }
 
-      for (int work_item = 0; work_item < kWorkGroupSize; work_item++) {
+      // Scale the components of the block into [-1, 1), or by the static
+      // scaling of the pass
+      int shift = Format::kBlockExponent ? exponent - 126 : input_shift;
+      if constexpr (Format::kFixedPoint) {
+        ExponentPipe::write(shift);
+      }
+
+      for (int work_item = 0; work_item < work_group_size; work_item++) {
         int row = work_item >> (logn - log_points);
-        int col = work_item & (kN / kPoints - 1);
+        int col = work_item & (n / kPoints - 1);
 
         // Stream fetched data over 8 channels to the FFT engine
 
-        std::array<ac_complex<T>, kPoints> to_pipe;
+        std::array<ac_complex<Sample>, kPoints> to_pipe;
 #pragma unroll
         for (int k = 0; k < kPoints; k++) {
-          to_pipe[k] =
-              buf[row * kN + BitReversed<log_points>(k) * kN / kPoints + col];
+          to_pipe[k] = Format::FromFloat(
+              buf[row * n + BitReversed<log_points>(k) * n / kPoints + col],
+              shift, overflow_count);
         }
         PipeOut::write(to_pipe);
       }
     }
+
+    if constexpr (Format::kFixedPoint) {
+      *overflows += overflow_count;
+    }
   }
 };
 
 /* The FFT engine
  * 'inverse' toggles between the direct and the inverse transform
+ * Transforms the 2^log_rows rows of 2^logn points that are read from 'PipeIn',
+ * in the samples of the datapath 'Format'
  */
-template <int logn, size_t log_points, typename PipeIn, typename PipeOut,
-          typename T>
+template <int max_logn, size_t log_points, typename PipeIn, typename PipeOut,
+          typename T, typename Format = FloatFormat>
 struct FFT {
   int inverse;
+  int logn;
+  int log_rows;
 
-  FFT(int inverse_) : inverse(inverse_) {}
+  FFT(int inverse_, int logn_, int log_rows_)
+      : inverse(inverse_), logn(logn_), log_rows(log_rows_) {}
 
   void operator()() const {
-    constexpr int kN = (1 << logn);
+    constexpr int kMaxN = (1 << max_logn);
     constexpr int kPoints = (1 << log_points);
+    using Sample = typename Format::Sample;
+
+    int n = (1 << logn);
+    unsigned steps = n / kPoints;
+    unsigned total_steps = (1 << log_rows) * steps;
 
     /* The FFT engine requires a sliding window for data reordering; data stored
      * in this array is carried across loop iterations and shifted by 1 element
@@ -468,31 +595,31 @@ struct FFT {
      * array are simple transfers between adjacent array elements
      */
 
-    ac_complex<T> fft_delay_elements[kN + kPoints * (logn - 2)];
+    ac_complex<Sample> fft_delay_elements[kMaxN + kPoints * (max_logn - 2)];
 
 #pragma unroll
-    for (unsigned i = 0; i < kN + kPoints * (logn - 2); i++) {
+    for (unsigned i = 0; i < kMaxN + kPoints * (max_logn - 2); i++) {
       fft_delay_elements[i] = {0.0f, 0.0f};
     }
 
-    // needs to run "kN / kPoints - 1" additional iterations to drain the last
+    // needs to run "steps - 1" additional iterations to drain the last
     // outputs
-    for (unsigned i = 0; i < kN * (kN / kPoints) + kN / kPoints - 1; i++) {
-      std::array<ac_complex<T>, kPoints> data;
+    for (unsigned i = 0; i < total_steps + steps - 1; i++) {
+      std::array<ac_complex<Sample>, kPoints> data;
 
       // Read data from channels
-      if (i < kN * (kN / kPoints)) {
+      if (i < total_steps) {
         data = PipeIn::read();
       } else {
-        data = std::array<ac_complex<T>, kPoints>{0};
+        data = std::array<ac_complex<Sample>, kPoints>{Sample(0)};
       }
 
       // Perform one FFT step
-      data =
-          FFTStep<logn>(data, i % (kN / kPoints), fft_delay_elements, inverse);
+      data = FFTStep<max_logn, Format>(data, i & (steps - 1),
+                                       fft_delay_elements, inverse, logn);
 
       // Write result to channels
-      if (i >= kN / kPoints - 1) {
+      if (i >= steps - 1) {
         PipeOut::write(data);
       }
     }
@@ -505,8 +632,16 @@ struct FFT {
  * each transposed row. This provides some degree of locality. In addition, when
  * using the alternative matrix format, consecutive rows are closer in memory,
  * and this is also beneficial for higher memory access efficiency
+ * The 2^log_rows transformed rows of 2^logn points are written as a matrix of
+ * 2^logn rows of 2^log_rows points.
+ * The samples of the datapath 'Format' are converted back to floating-point.
+ * With a fixed-point format, each block of "1<<log_points" rows is scaled by
+ * 2^(shift + logn), which reverts the scaling of the block by the fetch
+ * kernel, whose 'shift' is read from 'ExponentPipe', and the 1/N scaling of
+ * the FFT engine.
  */
-template <int logn, size_t log_points, typename PipeIn, typename T>
+template <int max_logn, size_t log_points, typename PipeIn, typename T,
+          typename Format = FloatFormat, typename ExponentPipe = void>
 struct Transpose {
 #if defined IS_BSP
   ac_complex<T> *dest;
@@ -525,37 +660,142 @@ struct Transpose {
 #endif
 
   int mangle;
+  int logn;
+  int log_rows;
 
-  Transpose(ac_complex<T> *dest_, int mangle_) : dest(dest_), mangle(mangle_) {}
+  Transpose(ac_complex<T> *dest_, int mangle_, int logn_, int log_rows_)
+      : dest(dest_), mangle(mangle_), logn(logn_), log_rows(log_rows_) {}
 
   [[intel::kernel_args_restrict]]  // NO-FORMAT: Attribute
   void operator()() const {
-    constexpr int kN = (1 << logn);
-    constexpr int kWorkGroupSize = kN;
+    constexpr int kMaxN = (1 << max_logn);
     constexpr int kPoints = (1 << log_points);
-    constexpr int kIterations = kN * kN / kPoints / kWorkGroupSize;
 
-    for (int t = 0; t < kIterations; t++) {
-      ac_complex<T> buf[kPoints * kN];
-      for (int work_item = 0; work_item < kWorkGroupSize; work_item++) {
-        std::array<ac_complex<T>, kPoints> from_pipe = PipeIn::read();
+    int n = (1 << logn);
+    int work_group_size = n;
+    int iterations = (1 << log_rows) / kPoints;
+
+    for (int t = 0; t < iterations; t++) {
+      int shift = logn;
+      if constexpr (Format::kFixedPoint) {
+        shift += ExponentPipe::read();
+      }
+
+      ac_complex<T> buf[kPoints * kMaxN];
+      for (int work_item = 0; work_item < work_group_size; work_item++) {
+        std::array<ac_complex<typename Format::Sample>, kPoints> from_pipe =
+            PipeIn::read();
 
 #pragma unroll
         for (int k = 0; k < kPoints; k++) {
-          buf[kPoints * work_item + k] = from_pipe[k];
+          buf[kPoints * work_item + k] = Format::ToFloat(from_pipe[k], shift);
         }
       }
 
-      for (int work_item = 0; work_item < kWorkGroupSize; work_item++) {
+      for (int work_item = 0; work_item < work_group_size; work_item++) {
         int colt = work_item;
-        int revcolt = BitReversed<logn>(colt);
-        int i = (t * kN + work_item) >> logn;
-        int where = colt * kN + i * kPoints;
-        if (mangle) where = MangleBits<logn>(where);
+        int revcolt = BitReversed<max_logn>(colt) >> (max_logn - logn);
+        int i = (t * n + work_item) >> logn;
+        int where = (colt << log_rows) + i * kPoints;
+        if (mangle) where = MangleBits(where, log_rows);
 
 #pragma unroll
         for (int k = 0; k < kPoints; k++) {
-          dest[where + k] = buf[k * kN + revcolt];
+          dest[where + k] = buf[k * n + revcolt];
+        }
+      }
+    }
+  }
+};
+
+/* This kernel converts between the spectrum of a real matrix of 2^log_rows
+ * rows of N = 2^log_cols points, of which it keeps the N/2 + 1 non-redundant
+ * columns, and the spectrum Z of the complex matrix of 2^log_rows rows of N/2
+ * points that holds the even columns of the real matrix in its real parts and
+ * the odd columns in its imaginary parts. Transforming the real matrix then
+ * only takes a 2D FFT of half its size.
+ *
+ * With W = exp(-2 * pi * i / N), and indices taken modulo the matrix sizes:
+ * - the direct conversion (R2C) computes, for k = 0 ... N/2,
+ *   X[m][k] = (A + B) / 2 - i * W^k * (A - B) / 2,
+ *   with A = Z[m][k] and B = conj(Z[-m][N/2 - k]),
+ * - the inverse conversion (C2R) computes, for k = 0 ... N/2 - 1,
+ *   Z[m][k] = (A + B) + i * W^-k * (A - B),
+ *   with A = X[m][k] and B = conj(X[-m][N/2 - k]).
+ * The rows m and -m of the input are buffered together, and both output rows
+ * are computed from the buffers.
+ * The real matrix holds at most 2^(max_logn + 1) points per row.
+ */
+template <int max_logn, size_t log_points, typename T>
+struct RealSpectrum {
+  ac_complex<T> *src;
+  ac_complex<T> *dest;
+  int inverse;
+  int log_rows;
+  int log_cols;
+
+  RealSpectrum(ac_complex<T> *src_, ac_complex<T> *dest_, int inverse_,
+               int log_rows_, int log_cols_)
+      : src(src_),
+        dest(dest_),
+        inverse(inverse_),
+        log_rows(log_rows_),
+        log_cols(log_cols_) {}
+
+  [[intel::kernel_args_restrict]]  // NO-FORMAT: Attribute
+  void operator()() const {
+    constexpr int kMaxHalfN = (1 << max_logn);
+    constexpr int kPoints = (1 << log_points);
+
+    int rows = 1 << log_rows;
+    int half_n = 1 << (log_cols - 1);
+    int in_cols = inverse ? half_n + 1 : half_n;
+    int out_cols = inverse ? half_n : half_n + 1;
+    T scale = inverse ? 1.0f : 0.5f;
+
+    for (int m = 0; m <= rows / 2; m++) {
+      int mirror = (rows - m) & (rows - 1);
+
+      // Local memory for the rows m and -m, rounded up to whole bursts
+      ac_complex<T> buf[2][kMaxHalfN + kPoints];
+      for (int col = 0; col < in_cols; col += kPoints) {
+#pragma unroll
+        for (int k = 0; k < kPoints; k++) {
+          if (col + k < in_cols) {
+            buf[0][col + k] = src[m * in_cols + col + k];
+            buf[1][col + k] = src[mirror * in_cols + col + k];
+          }
+        }
+      }
+
+      // The rows 0 and rows / 2 are their own mirror, and written once
+      int outputs = mirror == m ? 1 : 2;
+      for (int out = 0; out < outputs; out++) {
+        int row = out == 0 ? m : mirror;
+        for (int col = 0; col < out_cols; col += kPoints) {
+#pragma unroll
+          for (int k = 0; k < kPoints; k++) {
+            int c = col + k;
+            int c_mirror = inverse ? half_n - c : (half_n - c) & (half_n - 1);
+
+            ac_complex<T> a = buf[out][c & (half_n - 1)];
+            ac_complex<T> b = buf[1 - out][c_mirror];
+            b.i() = -b.i();
+
+            // -i * W^k for the direct conversion, i * W^-k for the inverse
+            ac_complex<T> w = RealTwiddle<2 * kMaxHalfN, T>(c, log_cols);
+            ac_complex<T> rotation;
+            rotation.r() = w.i();
+            rotation.i() = inverse ? w.r() : -w.r();
+
+            ac_complex<T> value = (a + b) + rotation * (a - b);
+            value.r() *= scale;
+            value.i() *= scale;
+
+            if (c < out_cols) {
+              dest[row * out_cols + c] = value;
+            }
+          }
         }
       }
     }
@@ -3,39 +3,219 @@
 #define _USE_MATH_DEFINES
 #include <cmath>
 
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <string>
+#include <vector>
+
 #include <sycl/ext/intel/ac_types/ac_complex.hpp>
 #include <sycl/ext/intel/fpga_extensions.hpp>
 #include <sycl/sycl.hpp>
 
 #include "exception_handler.hpp"
 #include "fft2d.hpp"
+#include "fft2d_engine.hpp"
+#include "fft2d_format.hpp"
+#include "host_fft2d.hpp"
+
+// Define the log of the largest FFT size on each dimension and the level of
+// parallelism to implement
+#if FPGA_SIMULATOR
+// Force small sizes in simulation mode to reduce simulation time
+constexpr int kLogN = 4;
+constexpr int kParallelism = 4;
+#else
+constexpr int kLogN = LOGN;
+constexpr int kParallelism = PARALLELISM;
+#endif
+
+static_assert(kParallelism == 4 || kParallelism == 8,
+              "The FFT kernel implementation only supports 4-parallel and "
+              "8-parallel FFTs.");
+
+constexpr int kLogParallelism = kParallelism == 8 ? 3 : 2;
+
+// The number of FFT engines: with two engines, the column pass of a frame
+// overlaps the row pass of the next one
+constexpr int kEngines = FFT_ENGINES;
+
+// The default number of frames of the batched mode
+constexpr int kBatchFrames = 16;
+
+// The number format of the datapath of the FFT engines, and the width of the
+// fixed-point samples
+constexpr int kSampleWidth = SAMPLE_WIDTH;
+#if defined(FORMAT_FIXED)
+using DatapathFormat = FixedFormat<kSampleWidth>;
+#elif defined(FORMAT_BFP)
+using DatapathFormat = BlockFloatFormat<kSampleWidth>;
+#else
+using DatapathFormat = FloatFormat;
+#endif
+
+// The 2D FFT kernels, compiled for frames of up to 2^kLogN x 2^kLogN points
+using FFT2D =
+    FFT2DEngine<kLogN, kLogParallelism, float, kEngines, DatapathFormat>;
+
+// The signal to noise ratio (dB) an output frame of 2^log_rows x 2^log_cols
+// points must reach with the datapath 'Format'. The fixed-point datapaths
+// trade precision for resources: each bit of the samples is worth about 6 dB,
+// and each stage of the transforms costs about 3 dB with the static scaling,
+// or 1.5 dB with block exponents. The thresholds are 10 dB below these
+// estimates.
+template <typename Format>
+double MinSNR(int log_rows, int log_cols) {
+  if (!Format::kFixedPoint) {
+    return 120;
+  }
+  double stage_cost = Format::kBlockExponent ? 1.5 : 3;
+  double offset = Format::kBlockExponent ? 25 : 20;
+  return 6 * kSampleWidth - stage_cost * (log_rows + log_cols) - offset - 10;
+}
+
+// A frame of the demo: the input data and the golden result on the host, and
+// the USM memory the kernels use. The points of a real frame are stored by
+// pairs in complex values, and its spectrum only holds the 2^(log_cols - 1) + 1
+// non-redundant columns.
+struct Frame {
+  int log_rows;
+  int log_cols;
+  bool inverse;
+  bool mangle;
+  bool real = false;
+
+  std::vector<ac_complex<float>> host_input_data;
+  std::vector<ac_complex<float>> host_output_data;
+  std::vector<ac_complex<double>> host_verify;
+
+  ac_complex<float> *input_data = nullptr;
+  ac_complex<float> *output_data = nullptr;
+  ac_complex<float> *temp_data = nullptr;
+  ac_complex<float> *work_data = nullptr;
+
+  size_t Points() const { return size_t(1) << (log_rows + log_cols); }
+
+  // The number of complex values of the frame and of its spectrum
+  size_t SignalSize() const { return real ? Points() / 2 : Points(); }
+  size_t SpectrumSize() const {
+    return real ? (size_t(1) << log_rows) * ((size_t(1) << (log_cols - 1)) + 1)
+                : Points();
+  }
+
+  size_t InputSize() const { return inverse ? SpectrumSize() : SignalSize(); }
+  size_t OutputSize() const {
+    return inverse ? SignalSize() : SpectrumSize();
+  }
+};
 
 // Forward declarations
-void TestFFT(bool mangle, bool inverse);
-template <int n>
-int Coordinates(int iteration, int i);
-template <int lognr_points>
-void FourierTransformGold(ac_complex<double> *data, bool inverse);
-template <int lognr_points>
-void FourierStage(ac_complex<double> *data);
+void TestFFT(bool mangle, bool inverse, int log_rows, int log_cols);
+void TestMixedFFT();
+void TestRealFFT(bool inverse, int log_rows, int log_cols);
+void TestBatchedFFT(int log_rows, int log_cols, int frame_count, bool real);
+void TestFormats(int log_rows, int log_cols, int frame_count);
+sycl::queue CreateQueue();
+void AllocateFrame(sycl::queue &q, Frame &frame);
+void FreeFrame(sycl::queue &q, Frame &frame);
+void InitFrame(Frame &frame);
+void InitRealFrame(Frame &frame);
+void GoldFrame(Frame &frame);
+double FrameSNR(const Frame &frame, const ac_complex<float> *output);
+double CheckFrame(Frame &frame);
+int Coordinates(int n, int iteration, int i);
+void FourierTransformGold(ac_complex<double> *data, int lognr_points,
+                          bool inverse);
+void FourierStage(ac_complex<double> *data, int lognr_points);
+
+// Parses a matrix dimension, which must be a power of two, into its log
+bool ParseDimension(const char *arg, int &log_size) {
+  long size = std::strtol(arg, nullptr, 10);
+  if (size <= 0 || (size & (size - 1)) != 0) {
+    return false;
+  }
+  log_size = 0;
+  while ((1L << log_size) < size) {
+    log_size++;
+  }
+  return true;
+}
 
 int main(int argc, char **argv) {
+  std::string mode = argc == 1 ? "all" : argv[1];
+  bool real_mode =
+      mode == "real" || mode == "inverse-real" || mode == "batch-real";
+
+  // The matrix is square and of the largest supported size, unless the rows
+  // and columns are given on the command line. The real frames are
+  // transformed as complex frames of half as many columns, so they need at
+  // least twice as many columns as the smallest complex frames
+  int log_rows = kLogN;
+  int log_cols = kLogN;
+  int real_log_cols =
+      FFT2D::SupportsReal(kLogN, kLogN) ? kLogN : FFT2D::kMinLogN + 1;
+  if (argc > 2) {
+    if (!ParseDimension(argv[2], log_rows) ||
+        !ParseDimension(argc > 3 ? argv[3] : argv[2], log_cols)) {
+      std::cerr << "The number of rows and columns must be powers of 2"
+                << std::endl;
+      std::terminate();
+    }
+    real_log_cols = log_cols;
+    if (real_mode ? !FFT2D::SupportsReal(log_rows, log_cols)
+                  : !FFT2D::Supports(log_rows, log_cols, false)) {
+      std::cerr << "The number of rows must be between "
+                << (1 << FFT2D::kMinLogN) << " and " << (1 << kLogN)
+                << ", and the number of columns between "
+                << (1 << (FFT2D::kMinLogN + real_mode)) << " and "
+                << (1 << (kLogN + real_mode)) << std::endl;
+      std::terminate();
+    }
+  }
+
   if (argc == 1) {
     std::cout << "No program argument was passed, running all fft2d variants"
               << std::endl;
+  }
 
+  int frame_count = argc > 4 ? std::atoi(argv[4]) : kBatchFrames;
+  if (frame_count <= 0) {
+    std::cerr << "The number of frames must be positive" << std::endl;
+    std::terminate();
+  }
+
+  if (mode == "all") {
     // test FFT transform with ordered memory layout
-    TestFFT(false, false);
+    TestFFT(false, false, log_rows, log_cols);
     // test inverse FFT transform with ordered memory layout
-    TestFFT(false, true);
+    TestFFT(false, true, log_rows, log_cols);
     // test FFT transform with alternative memory layout
-    TestFFT(true, false);
+    TestFFT(true, false, log_rows, log_cols);
     // test inverse FFT transform with alternative memory layout
-    TestFFT(true, true);
+    TestFFT(true, true, log_rows, log_cols);
+    // test real to complex FFT transform
+    TestRealFFT(false, log_rows, real_log_cols);
+    // test complex to real inverse FFT transform
+    TestRealFFT(true, log_rows, real_log_cols);
 
-  } else {
-    std::string mode = argv[1];
+  } else if (mode == "mixed") {
+    // test a sequence of frames of different sizes
+    TestMixedFFT();
+
+  } else if (mode == "batch" || mode == "batch-real") {
+    // stream a batch of frames of the same size
+    TestBatchedFFT(log_rows, real_mode ? real_log_cols : log_cols,
+                   frame_count, real_mode);
+
+  } else if (mode == "formats") {
+    // compare the precision and the throughput of the datapath formats
+    TestFormats(log_rows, log_cols, frame_count);
 
+  } else if (mode == "real" || mode == "inverse-real") {
+    // test a real to complex or complex to real FFT transform
+    TestRealFFT(mode == "inverse-real", log_rows, real_log_cols);
+
+  } else {
     bool mangle{};
     bool inverse{};
 
@@ -52,133 +232,49 @@ int main(int argc, char **argv) {
       mangle = true;
       inverse = true;
     } else {
-      std::cerr << "Usage: fft2d <mode>" << std::endl;
-      std::cerr << "Where mode can be normal|inverse|mangle|inverse-mangle|all"
+      std::cerr << "Usage: fft2d <mode> [<rows> [<columns> [<frames>]]]"
+                << std::endl;
+      std::cerr << "Where mode can be "
+                   "normal|inverse|mangle|inverse-mangle|real|inverse-real|"
+                   "all|mixed|batch|batch-real|formats"
                 << std::endl;
       std::terminate();
     }
 
-    TestFFT(mangle, inverse);
+    TestFFT(mangle, inverse, log_rows, log_cols);
   }
   return 0;
 }
 
-void TestFFT(bool mangle, bool inverse) {
+void TestFFT(bool mangle, bool inverse, int log_rows, int log_cols) {
   try {
-    // Device selector selection
-#if FPGA_SIMULATOR
-    auto selector = sycl::ext::intel::fpga_simulator_selector_v;
-#elif FPGA_HARDWARE
-    auto selector = sycl::ext::intel::fpga_selector_v;
-#else
-    auto selector = sycl::ext::intel::fpga_emulator_selector_v;
-#endif
-
-    // Enable the queue profiling to time the execution
-    sycl::property_list queue_properties{
-        sycl::property::queue::enable_profiling()};
-    sycl::queue q =
-        sycl::queue(selector, fpga_tools::exception_handler, queue_properties);
+    sycl::queue q = CreateQueue();
 
-    sycl::device device = q.get_device();
-
-    // Print out the device information.
-    std::cout << "Running on device: "
-              << device.get_info<sycl::info::device::name>() << std::endl;
-
-    // Define the log of the FFT size on each dimension and the level of
-    // parallelism to implement
-#if FPGA_SIMULATOR
-    // Force small sizes in simulation mode to reduce simulation time
-    constexpr int kLogN = 4;
-    constexpr int kParallelism = 4;
-#else
-    constexpr int kLogN = LOGN;
-    constexpr int kParallelism = PARALLELISM;
-#endif
-
-    static_assert(kParallelism == 4 || kParallelism == 8,
-                  "The FFT kernel implementation only supports 4-parallel and "
-                  "8-parallel FFTs.");
-
-    constexpr int kN = 1 << kLogN;
-    constexpr int kLogParallelism = kParallelism == 8 ? 3 : 2;
-
-    // Host memory
-    ac_complex<float> *host_input_data =
-        (ac_complex<float> *)std::malloc(sizeof(ac_complex<float>) * kN * kN);
-    ac_complex<float> *host_output_data =
-        (ac_complex<float> *)std::malloc(sizeof(ac_complex<float>) * kN * kN);
-    ac_complex<double> *host_verify =
-        (ac_complex<double> *)std::malloc(sizeof(ac_complex<double>) * kN * kN);
-    ac_complex<double> *host_verify_tmp =
-        (ac_complex<double> *)std::malloc(sizeof(ac_complex<double>) * kN * kN);
-
-    if ((host_input_data == nullptr) || (host_output_data == nullptr) ||
-        (host_verify == nullptr) || (host_verify_tmp == nullptr)) {
-      std::cerr << "Failed to allocate host memory with malloc." << std::endl;
-      std::terminate();
-    }
-
-    // Initialize input and produce verification data
-    for (int i = 0; i < kN; i++) {
-      for (int j = 0; j < kN; j++) {
-        int where = mangle ? MangleBits<kLogN>(Coordinates<kN>(i, j))
-                           : Coordinates<kN>(i, j);
-        host_verify[Coordinates<kN>(i, j)].r() = host_input_data[where].r() =
-            (float)((double)rand() / (double)RAND_MAX);
-        host_verify[Coordinates<kN>(i, j)].i() = host_input_data[where].i() =
-            (float)((double)rand() / (double)RAND_MAX);
-      }
-    }
-
-    // Device memory
-    ac_complex<float> *input_data;
-    ac_complex<float> *output_data;
-    ac_complex<float> *temp_data;
-
-    if (q.get_device().has(sycl::aspect::usm_device_allocations)) {
-      std::cout << "Using USM device allocations" << std::endl;
-      // Allocate FPGA DDR memory.
-      input_data = sycl::malloc_device<ac_complex<float>>(kN * kN, q);
-      output_data = sycl::malloc_device<ac_complex<float>>(kN * kN, q);
-      temp_data = sycl::malloc_device<ac_complex<float>>(kN * kN, q);
-    } else if (q.get_device().has(sycl::aspect::usm_host_allocations)) {
-      std::cout << "Using USM host allocations" << std::endl;
-      // No device allocations means that we are probably in a SYCL HLS
-      // flow
-
-#if defined IS_BSP
-      auto prop_list = sycl::property_list{};
-#else
-      // In the SYCL HLS flow, we need to define the memory interface.
-      // For, that we need to assign a location to the memory being accessed.
-      auto prop_list = sycl::property_list{
-          sycl::ext::intel::experimental::property::usm::buffer_location(1)};
-#endif
-
-      input_data = sycl::malloc_host<ac_complex<float>>(kN * kN, q);
-      output_data = sycl::malloc_host<ac_complex<float>>(kN * kN, q, prop_list);
-      temp_data = sycl::malloc_host<ac_complex<float>>(kN * kN, q, prop_list);
-    } else {
-      std::cerr << "USM device allocations or USM host allocations must be "
-                   "supported to run this sample."
+    if (!FFT2D::Supports(log_rows, log_cols, mangle)) {
+      std::cout << "Skipping the " << (1 << log_rows) << " x "
+                << (1 << log_cols)
+                << " transform: the alternative data layout needs each "
+                   "dimension to be at least the square root of the other"
                 << std::endl;
-      std::terminate();
+      return;
     }
 
-    if (input_data == nullptr || output_data == nullptr ||
-        temp_data == nullptr) {
-      std::cerr << "Failed to allocate USM memory." << std::endl;
-      std::terminate();
-    }
+    Frame frame{log_rows, log_cols, inverse, mangle};
+
+    // Initialize input and produce verification data
+    InitFrame(frame);
+    AllocateFrame(q, frame);
 
     // Copy the input data from host DDR to USM memory
-    q.memcpy(input_data, host_input_data, sizeof(ac_complex<float>) * kN * kN)
+    q.memcpy(frame.input_data, frame.host_input_data.data(),
+             sizeof(ac_complex<float>) * frame.Points())
         .wait();
 
-    std::cout << "Launching a " << kN * kN << " points " << kParallelism
-              << "-parallel " << (inverse ? "inverse " : "")
+    std::cout << "Launching a " << frame.Points() << " points ";
+    if (log_rows != log_cols) {
+      std::cout << "(" << (1 << log_rows) << " x " << (1 << log_cols) << ") ";
+    }
+    std::cout << kParallelism << "-parallel " << (inverse ? "inverse " : "")
               << "FFT transform (" << (mangle ? "alternative" : "ordered")
               << " data layout)" << std::endl;
 
@@ -202,7 +298,9 @@ void TestFFT(bool mangle, bool inverse) {
      *
      * This sequence of kernels does back-to-back row processing followed by a
      * data transposition and writes the results back to memory. The host code
-     * runs these kernels twice to produce the overall 2D FFT transform
+     * runs these kernels twice to produce the overall 2D FFT transform. When
+     * the design has two FFT engines, the second run uses a second sequence of
+     * kernels, so that consecutive frames overlap (see 'TestBatchedFFT').
      *
      *
      * These kernels transfer data through pipes.
@@ -215,122 +313,504 @@ void TestFFT(bool mangle, bool inverse) {
      * an alternative memory layout can improve performance. The host switches
      * between the two memory layouts using a kernel argument. See the
      * 'MangleBits' function for additional details.
+     *
+     * The size of the transform is also a kernel argument, so the same kernels
+     * process frames of any size up to the size they are compiled for (see
+     * 'FFT2DEngine').
      */
 
-    double start_time;
-    double end_time;
+    FFT2D fft2d(q);
+    auto events = fft2d.Submit(frame.input_data, frame.temp_data,
+                               frame.output_data, log_rows, log_cols, inverse,
+                               mangle);
+    fft2d.Wait();
 
-    // This is a limitation of the design
-    static_assert(kN / kParallelism >= kParallelism);
+    double start_time = events.first.template get_profiling_info<
+        sycl::info::event_profiling::command_start>();
+    double end_time = events.second.template get_profiling_info<
+        sycl::info::event_profiling::command_end>();
+    double kernel_runtime = (end_time - start_time) / 1.0e9;
 
-    // Kernel to kernel pipes
-    using FetchToFFT =
-        sycl::ext::intel::pipe<class FetchToFFTPipe,
-                               std::array<ac_complex<float>, kParallelism>, 0>;
-    using FFTToTranspose =
-        sycl::ext::intel::pipe<class FFTToTransposePipe,
-                               std::array<ac_complex<float>, kParallelism>, 0>;
+    // Copy the output data from the USM memory to the host DDR
+    q.memcpy(frame.host_output_data.data(), frame.output_data,
+             sizeof(ac_complex<float>) * frame.Points())
+        .wait();
 
-    for (int i = 0; i < 2; i++) {
-      ac_complex<float> *to_read = i == 0 ? input_data : temp_data;
-      ac_complex<float> *to_write = i == 0 ? temp_data : output_data;
+    std::cout << "Processing time = " << kernel_runtime << "s" << std::endl;
 
-      // Start a 1D FFT on the matrix rows/columns
-      auto fetch_event = q.single_task<class FetchKernel>(
-          Fetch<kLogN, kLogParallelism, FetchToFFT, float>{to_read, mangle});
+    double gpoints_per_sec = ((double)frame.Points() / kernel_runtime) * 1e-9;
+    double gflops = 5 * (double)frame.Points() * (log_rows + log_cols) /
+                    (kernel_runtime * 1e9);
 
-      auto fft_event = q.single_task<class FFTKernel>(
-          FFT<kLogN, kLogParallelism, FetchToFFT, FFTToTranspose, float>{
-              inverse});
+    std::cout << "Throughput = " << gpoints_per_sec << " Gpoints / sec ("
+              << gflops << " Gflops)" << std::endl;
 
-      auto transpose_event = q.single_task<class TransposeKernel>(
-          Transpose<kLogN, kLogParallelism, FFTToTranspose, float>{to_write,
-                                                                   mangle});
+    // Check signal to noise ratio
+    double db = CheckFrame(frame);
 
-      fft_event.wait();
-      transpose_event.wait();
+    std::cout << "Signal to noise ratio on output sample: " << db << std::endl;
+    if (DatapathFormat::kFixedPoint) {
+      std::cout << "Overflows in the " << DatapathFormat::Name()
+                << " datapath: " << fft2d.Overflows() << std::endl;
+    }
+    bool passed = db > MinSNR<DatapathFormat>(log_rows, log_cols);
+    std::cout << " --> " << (passed ? "PASSED" : "FAILED") << std::endl;
 
-      if (i == 0) {
-        start_time = fetch_event.template get_profiling_info<
-            sycl::info::event_profiling::command_start>();
-      } else {
-        end_time = transpose_event.template get_profiling_info<
-            sycl::info::event_profiling::command_end>();
-      }
+    FreeFrame(q, frame);
+
+  } catch (sycl::exception const &e) {
+    std::cerr << "Caught a synchronous SYCL exception: " << e.what()
+              << std::endl;
+    std::terminate();
+  }
+}
+
+// Queues frames of different sizes and directions back to back to the same
+// kernels, then checks each of them
+void TestMixedFFT() {
+  try {
+    sycl::queue q = CreateQueue();
+
+    // A mix of square and rectangular frames, bounded by the supported sizes
+    constexpr int kMin = FFT2D::kMinLogN;
+    auto clamp = [](int log_size) {
+      return log_size < kMin ? kMin : (log_size > kLogN ? kLogN : log_size);
+    };
+    const std::vector<std::pair<int, int>> sizes = {
+        {kLogN, kLogN},         {kLogN - 1, kLogN},
+        {kLogN, kLogN - 3},     {kLogN - 3, kLogN},
+        {kLogN - 2, kLogN - 1}, {kMin, kMin}};
+
+    std::vector<Frame> frames;
+    for (size_t i = 0; i < sizes.size(); i++) {
+      frames.push_back(Frame{clamp(sizes[i].first), clamp(sizes[i].second),
+                             i % 2 == 1, false});
+    }
+
+    for (auto &frame : frames) {
+      InitFrame(frame);
+      AllocateFrame(q, frame);
+      q.memcpy(frame.input_data, frame.host_input_data.data(),
+               sizeof(ac_complex<float>) * frame.Points())
+          .wait();
+    }
+
+    std::cout << "Launching " << frames.size() << " frames of mixed sizes "
+              << "back to back" << std::endl;
+
+    // Queue all the frames before waiting for any of them
+    FFT2D fft2d(q);
+    std::vector<std::pair<sycl::event, sycl::event>> events;
+    for (auto &frame : frames) {
+      events.push_back(fft2d.Submit(frame.input_data, frame.temp_data,
+                                    frame.output_data, frame.log_rows,
+                                    frame.log_cols, frame.inverse, false));
+    }
+    fft2d.Wait();
+
+    bool passed = true;
+    double total_points = 0;
+    double total_flops = 0;
+    for (size_t i = 0; i < frames.size(); i++) {
+      Frame &frame = frames[i];
+      q.memcpy(frame.host_output_data.data(), frame.output_data,
+               sizeof(ac_complex<float>) * frame.Points())
+          .wait();
+
+      double start_time = events[i].first.template get_profiling_info<
+          sycl::info::event_profiling::command_start>();
+      double end_time = events[i].second.template get_profiling_info<
+          sycl::info::event_profiling::command_end>();
+      double db = CheckFrame(frame);
+      passed &= db > MinSNR<DatapathFormat>(frame.log_rows, frame.log_cols);
+      total_points += frame.Points();
+      total_flops += 5 * (double)frame.Points() *
+                     (frame.log_rows + frame.log_cols);
+
+      std::cout << "  " << (1 << frame.log_rows) << " x "
+                << (1 << frame.log_cols) << (frame.inverse ? " inverse" : "")
+                << ": " << (end_time - start_time) / 1.0e9
+                << "s, signal to noise ratio " << db << std::endl;
+    }
+
+    double start_time = events.front().first.template get_profiling_info<
+        sycl::info::event_profiling::command_start>();
+    double end_time = events.back().second.template get_profiling_info<
+        sycl::info::event_profiling::command_end>();
+    double kernel_runtime = (end_time - start_time) / 1.0e9;
+
+    std::cout << "Processing time = " << kernel_runtime << "s" << std::endl;
+    std::cout << "Throughput = " << (total_points / kernel_runtime) * 1e-9
+              << " Gpoints / sec (" << total_flops / (kernel_runtime * 1e9)
+              << " Gflops)" << std::endl;
+    std::cout << " --> " << (passed ? "PASSED" : "FAILED") << std::endl;
+
+    for (auto &frame : frames) {
+      FreeFrame(q, frame);
+    }
+
+  } catch (sycl::exception const &e) {
+    std::cerr << "Caught a synchronous SYCL exception: " << e.what()
+              << std::endl;
+    std::terminate();
+  }
+}
+
+// Transforms a real frame into the non-redundant half of its spectrum (R2C),
+// or the half spectrum of a real frame back into the frame (C2R)
+void TestRealFFT(bool inverse, int log_rows, int log_cols) {
+  try {
+    sycl::queue q = CreateQueue();
+
+    if (!FFT2D::SupportsReal(log_rows, log_cols)) {
+      std::cout << "Skipping the " << (1 << log_rows) << " x "
+                << (1 << log_cols)
+                << " real transform: the real frames need at least "
+                << (1 << (FFT2D::kMinLogN + 1)) << " columns" << std::endl;
+      return;
+    }
+
+    // The spectrum of a real frame concentrates its energy in its first
+    // points: scaled by its bound, the number of points, the other points of
+    // the spectrum keep too few bits in the static fixed-point format
+    if (inverse && DatapathFormat::kFixedPoint &&
+        !DatapathFormat::kBlockExponent) {
+      std::cout << "Skipping the real inverse transform (C2R): the "
+                << DatapathFormat::Name()
+                << " datapath lacks the dynamic range of the spectrum"
+                << std::endl;
+      return;
+    }
+
+    Frame frame{log_rows, log_cols, inverse, false, true};
+
+    // Initialize input and produce verification data
+    InitFrame(frame);
+    AllocateFrame(q, frame);
+
+    // Copy the input data from host DDR to USM memory
+    q.memcpy(frame.input_data, frame.host_input_data.data(),
+             sizeof(ac_complex<float>) * frame.InputSize())
+        .wait();
+
+    std::cout << "Launching a " << frame.Points() << " points ";
+    if (log_rows != log_cols) {
+      std::cout << "(" << (1 << log_rows) << " x " << (1 << log_cols) << ") ";
     }
+    std::cout << kParallelism << "-parallel real "
+              << (inverse ? "inverse FFT transform (C2R)"
+                          : "FFT transform (R2C)")
+              << std::endl;
 
+    // The real frame is transformed as a complex frame of half as many
+    // columns, and the RealSpectrum kernel converts between the spectra of
+    // the complex and the real frames
+    FFT2D fft2d(q);
+    auto events =
+        inverse
+            ? fft2d.SubmitC2R(frame.input_data, frame.temp_data,
+                              frame.work_data,
+                              reinterpret_cast<float *>(frame.output_data),
+                              log_rows, log_cols)
+            : fft2d.SubmitR2C(reinterpret_cast<float *>(frame.input_data),
+                              frame.temp_data, frame.work_data,
+                              frame.output_data, log_rows, log_cols);
+    fft2d.Wait();
+
+    double start_time = events.first.template get_profiling_info<
+        sycl::info::event_profiling::command_start>();
+    double end_time = events.second.template get_profiling_info<
+        sycl::info::event_profiling::command_end>();
     double kernel_runtime = (end_time - start_time) / 1.0e9;
 
     // Copy the output data from the USM memory to the host DDR
-    q.memcpy(host_output_data, output_data, sizeof(ac_complex<float>) * kN * kN)
+    q.memcpy(frame.host_output_data.data(), frame.output_data,
+             sizeof(ac_complex<float>) * frame.OutputSize())
         .wait();
 
     std::cout << "Processing time = " << kernel_runtime << "s" << std::endl;
 
-    double gpoints_per_sec = ((double)kN * kN / kernel_runtime) * 1e-9;
-    double gflops = 2 * 5 * kN * kN * (log((float)kN) / log((float)2)) /
+    // A real transform takes half the operations of a complex one
+    double gpoints_per_sec = ((double)frame.Points() / kernel_runtime) * 1e-9;
+    double gflops = 2.5 * (double)frame.Points() * (log_rows + log_cols) /
                     (kernel_runtime * 1e9);
 
     std::cout << "Throughput = " << gpoints_per_sec << " Gpoints / sec ("
               << gflops << " Gflops)" << std::endl;
 
     // Check signal to noise ratio
+    double db = CheckFrame(frame);
 
-    // Run reference code
-    for (int i = 0; i < kN; i++) {
-      FourierTransformGold<kLogN>(host_verify + Coordinates<kN>(i, 0), inverse);
+    std::cout << "Signal to noise ratio on output sample: " << db << std::endl;
+    if (DatapathFormat::kFixedPoint) {
+      std::cout << "Overflows in the " << DatapathFormat::Name()
+                << " datapath: " << fft2d.Overflows() << std::endl;
     }
+    // The block exponents only recover part of the precision of the spectrum,
+    // in the blocks away from its first rows: hold the C2R transform to the
+    // precision of the static scaling
+    double min_db = inverse && DatapathFormat::kFixedPoint
+                        ? MinSNR<FixedFormat<kSampleWidth>>(log_rows, log_cols)
+                        : MinSNR<DatapathFormat>(log_rows, log_cols);
+    std::cout << " --> " << (db > min_db ? "PASSED" : "FAILED") << std::endl;
 
-    for (int i = 0; i < kN; i++) {
-      for (int j = 0; j < kN; j++) {
-        host_verify_tmp[Coordinates<kN>(j, i)] =
-            host_verify[Coordinates<kN>(i, j)];
-      }
-    }
+    FreeFrame(q, frame);
+
+  } catch (sycl::exception const &e) {
+    std::cerr << "Caught a synchronous SYCL exception: " << e.what()
+              << std::endl;
+    std::terminate();
+  }
+}
 
-    for (int i = 0; i < kN; i++) {
-      FourierTransformGold<kLogN>(host_verify_tmp + Coordinates<kN>(i, 0),
-                                  inverse);
+// Streams a batch of frames of the same size through the kernels, and
+// compares the throughput with a 2D FFT on the host. The real frames are
+// transformed into the non-redundant half of their spectrum (R2C)
+void TestBatchedFFT(int log_rows, int log_cols, int frame_count, bool real) {
+  try {
+    sycl::queue q = CreateQueue();
+
+    // The frames cycle through a few inputs, whose golden results are only
+    // computed once
+    constexpr int kInputs = 2;
+    std::vector<Frame> inputs;
+    for (int i = 0; i < kInputs; i++) {
+      inputs.push_back(Frame{log_rows, log_cols, false, false, real});
+      InitFrame(inputs.back());
+      GoldFrame(inputs.back());
+    }
+    const size_t points = inputs[0].Points();
+    const size_t input_bytes = sizeof(ac_complex<float>) * inputs[0].InputSize();
+    const size_t output_bytes =
+        sizeof(ac_complex<float>) * inputs[0].OutputSize();
+
+    // The device memory is double-buffered: the transfers of a frame overlap
+    // the processing of the previous one
+    constexpr int kSlots = 2;
+    std::vector<Frame> slots(kSlots,
+                             Frame{log_rows, log_cols, false, false, real});
+    for (auto &slot : slots) {
+      slot.host_output_data.resize(slot.OutputSize());
+      AllocateFrame(q, slot);
     }
 
-    for (int i = 0; i < kN; i++) {
-      for (int j = 0; j < kN; j++) {
-        host_verify[Coordinates<kN>(j, i)] =
-            host_verify_tmp[Coordinates<kN>(i, j)];
+    std::cout << "Launching " << frame_count << " frames of "
+              << (1 << log_rows) << " x " << (1 << log_cols)
+              << (real ? " real" : "") << " points on "
+              << kEngines << " " << kParallelism << "-parallel "
+              << DatapathFormat::Name() << " FFT engine"
+              << (kEngines > 1 ? "s" : "") << std::endl;
+
+    FFT2D fft2d(q);
+    std::vector<sycl::event> copied_out(kSlots);
+    sycl::event first_kernel;
+    sycl::event last_kernel;
+    double min_db = 1e9;
+
+    // Waits for the output of frame 'k' and checks it
+    auto check = [&](int k) {
+      copied_out[k % kSlots].wait();
+      double db = FrameSNR(inputs[k % kInputs],
+                           slots[k % kSlots].host_output_data.data());
+      min_db = db < min_db ? db : min_db;
+    };
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int k = 0; k < frame_count; k++) {
+      Frame &slot = slots[k % kSlots];
+
+      // The slot is free once the output of its previous frame is back on the
+      // host
+      if (k >= kSlots) {
+        check(k - kSlots);
+      }
+
+      sycl::event copied_in =
+          q.memcpy(slot.input_data, inputs[k % kInputs].host_input_data.data(),
+                   input_bytes);
+      auto events =
+          real ? fft2d.SubmitR2C(reinterpret_cast<float *>(slot.input_data),
+                                 slot.temp_data, slot.work_data,
+                                 slot.output_data, log_rows, log_cols,
+                                 {copied_in})
+               : fft2d.Submit(slot.input_data, slot.temp_data,
+                              slot.output_data, log_rows, log_cols, false,
+                              false, {copied_in});
+      copied_out[k % kSlots] =
+          q.memcpy(slot.host_output_data.data(), slot.output_data,
+                   output_bytes, events.second);
+
+      if (k == 0) {
+        first_kernel = events.first;
       }
+      last_kernel = events.second;
     }
+    for (int k = frame_count > kSlots ? frame_count - kSlots : 0;
+         k < frame_count; k++) {
+      check(k);
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> total_time = end - start;
+
+    double start_time = first_kernel.template get_profiling_info<
+        sycl::info::event_profiling::command_start>();
+    double end_time = last_kernel.template get_profiling_info<
+        sycl::info::event_profiling::command_end>();
+    double kernel_runtime = (end_time - start_time) / 1.0e9;
 
-    double magnitude_sum = 0;
-    double noise_sum = 0;
-    for (int i = 0; i < kN; i++) {
-      for (int j = 0; j < kN; j++) {
-        int where = mangle ? MangleBits<kLogN>(Coordinates<kN>(i, j))
-                           : Coordinates<kN>(i, j);
-        double magnitude = (double)host_verify[Coordinates<kN>(i, j)].r() *
-                               (double)host_verify[Coordinates<kN>(i, j)].r() +
-                           (double)host_verify[Coordinates<kN>(i, j)].i() *
-                               (double)host_verify[Coordinates<kN>(i, j)].i();
-        double noise = (host_verify[Coordinates<kN>(i, j)].r() -
-                        (double)host_output_data[where].r()) *
-                           (host_verify[Coordinates<kN>(i, j)].r() -
-                            (double)host_output_data[where].r()) +
-                       (host_verify[Coordinates<kN>(i, j)].i() -
-                        (double)host_output_data[where].i()) *
-                           (host_verify[Coordinates<kN>(i, j)].i() -
-                            (double)host_output_data[where].i());
-
-        magnitude_sum += magnitude;
-        noise_sum += noise;
+    // The host baseline, on the same frames
+    HostFFT2D host_fft2d(log_rows, real ? log_cols - 1 : log_cols);
+    std::vector<ac_complex<float>> host_output(inputs[0].OutputSize());
+    auto host_start = std::chrono::high_resolution_clock::now();
+    for (int k = 0; k < frame_count; k++) {
+      if (real) {
+        host_fft2d.ExecuteR2C(inputs[k % kInputs].host_input_data.data(),
+                              host_output.data());
+      } else {
+        host_fft2d.Execute(inputs[k % kInputs].host_input_data.data(),
+                           host_output.data(), false);
       }
     }
-    double db = 10 * log(magnitude_sum / noise_sum) / log(10.0);
+    auto host_end = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> host_time = host_end - host_start;
+    double host_db = FrameSNR(inputs[(frame_count - 1) % kInputs],
+                              host_output.data());
+
+    // A real transform takes half the operations of a complex one
+    double flops_per_frame =
+        (real ? 2.5 : 5) * (double)points * (log_rows + log_cols);
+    std::cout << "Processing time = " << kernel_runtime << "s ("
+              << total_time.count() << "s including transfers)" << std::endl;
+    std::cout << "Throughput = " << frame_count / kernel_runtime
+              << " frames / sec ("
+              << flops_per_frame * frame_count / (kernel_runtime * 1e9)
+              << " Gflops), " << frame_count / total_time.count()
+              << " frames / sec including transfers" << std::endl;
+    std::cout << "Host baseline = " << frame_count / host_time.count()
+              << " frames / sec ("
+              << flops_per_frame * frame_count / (host_time.count() * 1e9)
+              << " Gflops), signal to noise ratio " << host_db << std::endl;
+    std::cout << "Speedup over the host = "
+              << host_time.count() / total_time.count()
+              << "x including transfers" << std::endl;
+
+    std::cout << "Lowest signal to noise ratio on output frames: " << min_db
+              << std::endl;
+    if (DatapathFormat::kFixedPoint) {
+      std::cout << "Overflows in the " << DatapathFormat::Name()
+                << " datapath: " << fft2d.Overflows() << std::endl;
+    }
+    bool passed = min_db > MinSNR<DatapathFormat>(log_rows, log_cols);
+    std::cout << " --> " << (passed ? "PASSED" : "FAILED") << std::endl;
 
-    std::cout << "Signal to noise ratio on output sample: " << db << std::endl;
-    std::cout << " --> " << (db > 120 ? "PASSED" : "FAILED") << std::endl;
+    for (auto &slot : slots) {
+      FreeFrame(q, slot);
+    }
 
-    sycl::free(input_data, q);
-    free(output_data, q);
-    free(temp_data, q);
+  } catch (sycl::exception const &e) {
+    std::cerr << "Caught a synchronous SYCL exception: " << e.what()
+              << std::endl;
+    std::terminate();
+  }
+}
+
+// Streams a batch of frames through the FFT engines of the datapath 'Format',
+// and prints the row of the format in the report of 'TestFormats': the lowest
+// signal to noise ratio of the output frames, the throughput and the number
+// of overflows. Returns whether the output frames are accurate enough for the
+// format
+template <typename Format>
+bool ReportFormat(sycl::queue &q, std::vector<Frame> &slots,
+                  int frame_count) {
+  const int log_rows = slots[0].log_rows;
+  const int log_cols = slots[0].log_cols;
+  FFT2DEngine<kLogN, kLogParallelism, float, kEngines, Format> fft2d(q);
+
+  // Each slot holds its own input, and a frame waits for the previous frame
+  // of its slot, which uses the same intermediate and output matrices
+  std::vector<sycl::event> done(slots.size());
+  sycl::event first_kernel;
+  for (int k = 0; k < frame_count; k++) {
+    Frame &slot = slots[k % slots.size()];
+    auto events = fft2d.Submit(slot.input_data, slot.temp_data,
+                               slot.output_data, log_rows, log_cols, false,
+                               false, {done[k % slots.size()]});
+    done[k % slots.size()] = events.second;
+    if (k == 0) {
+      first_kernel = events.first;
+    }
+  }
+  fft2d.Wait();
+
+  double start_time = first_kernel.template get_profiling_info<
+      sycl::info::event_profiling::command_start>();
+  double end_time = done[(frame_count - 1) % slots.size()]
+                        .template get_profiling_info<
+                            sycl::info::event_profiling::command_end>();
+  double kernel_runtime = (end_time - start_time) / 1.0e9;
+
+  double min_db = 1e9;
+  for (auto &slot : slots) {
+    q.memcpy(slot.host_output_data.data(), slot.output_data,
+             sizeof(ac_complex<float>) * slot.Points())
+        .wait();
+    double db = FrameSNR(slot, slot.host_output_data.data());
+    min_db = db < min_db ? db : min_db;
+  }
+
+  double gflops = 5 * (double)slots[0].Points() * (log_rows + log_cols) *
+                  frame_count / (kernel_runtime * 1e9);
+  std::cout << std::left << std::setw(12) << Format::Name() << std::right
+            << std::setw(12) << min_db << std::setw(16)
+            << frame_count / kernel_runtime << std::setw(12) << gflops
+            << std::setw(12) << fft2d.Overflows() << std::endl;
+
+  return min_db > MinSNR<Format>(log_rows, log_cols);
+}
+
+// Compares the datapath formats on a batch of frames: the signal to noise
+// ratio of their output against the double-precision golden model, and their
+// throughput. The emulator compiles the FFT engines of every format, a device
+// build only the ones of its format, to save the area of the others; compare
+// the formats on the device with a build of each format.
+void TestFormats(int log_rows, int log_cols, int frame_count) {
+  try {
+    sycl::queue q = CreateQueue();
+
+    constexpr int kSlots = 2;
+    std::vector<Frame> slots(kSlots, Frame{log_rows, log_cols, false, false});
+    for (auto &slot : slots) {
+      InitFrame(slot);
+      GoldFrame(slot);
+      AllocateFrame(q, slot);
+      q.memcpy(slot.input_data, slot.host_input_data.data(),
+               sizeof(ac_complex<float>) * slot.Points())
+          .wait();
+    }
+
+    std::cout << "Launching " << frame_count << " frames of "
+              << (1 << log_rows) << " x " << (1 << log_cols) << " points on "
+              << kEngines << " " << kParallelism << "-parallel FFT engine"
+              << (kEngines > 1 ? "s" : "") << " of each format" << std::endl;
+    std::cout << std::left << std::setw(12) << "Format" << std::right
+              << std::setw(12) << "SNR (dB)" << std::setw(16)
+              << "Frames / sec" << std::setw(12) << "Gflops" << std::setw(12)
+              << "Overflows" << std::endl;
+
+    bool passed = true;
+#if FPGA_SIMULATOR || FPGA_HARDWARE
+    passed &= ReportFormat<DatapathFormat>(q, slots, frame_count);
+#else
+    passed &= ReportFormat<FloatFormat>(q, slots, frame_count);
+    passed &= ReportFormat<FixedFormat<kSampleWidth>>(q, slots, frame_count);
+    passed &=
+        ReportFormat<BlockFloatFormat<kSampleWidth>>(q, slots, frame_count);
+#endif
+    std::cout << " --> " << (passed ? "PASSED" : "FAILED") << std::endl;
+
+    for (auto &slot : slots) {
+      FreeFrame(q, slot);
+    }
 
   } catch (sycl::exception const &e) {
     std::cerr << "Caught a synchronous SYCL exception: " << e.what()
@@ -341,20 +821,297 @@ void TestFFT(bool mangle, bool inverse) {
 
 /////// HELPER FUNCTIONS ///////
 
+sycl::queue CreateQueue() {
+  // Device selector selection
+#if FPGA_SIMULATOR
+  auto selector = sycl::ext::intel::fpga_simulator_selector_v;
+#elif FPGA_HARDWARE
+  auto selector = sycl::ext::intel::fpga_selector_v;
+#else
+  auto selector = sycl::ext::intel::fpga_emulator_selector_v;
+#endif
+
+  // Enable the queue profiling to time the execution
+  sycl::property_list queue_properties{
+      sycl::property::queue::enable_profiling()};
+  sycl::queue q =
+      sycl::queue(selector, fpga_tools::exception_handler, queue_properties);
+
+  sycl::device device = q.get_device();
+
+  // Print out the device information.
+  std::cout << "Running on device: "
+            << device.get_info<sycl::info::device::name>() << std::endl;
+
+  if (q.get_device().has(sycl::aspect::usm_device_allocations)) {
+    std::cout << "Using USM device allocations" << std::endl;
+  } else if (q.get_device().has(sycl::aspect::usm_host_allocations)) {
+    std::cout << "Using USM host allocations" << std::endl;
+  } else {
+    std::cerr << "USM device allocations or USM host allocations must be "
+                 "supported to run this sample."
+              << std::endl;
+    std::terminate();
+  }
+
+  return q;
+}
+
+// Allocates the device memory of a frame
+void AllocateFrame(sycl::queue &q, Frame &frame) {
+  size_t input_size = frame.InputSize();
+  size_t output_size = frame.OutputSize();
+  size_t points = frame.SignalSize();
+
+  if (q.get_device().has(sycl::aspect::usm_device_allocations)) {
+    // Allocate FPGA DDR memory.
+    frame.input_data = sycl::malloc_device<ac_complex<float>>(input_size, q);
+    frame.output_data = sycl::malloc_device<ac_complex<float>>(output_size, q);
+    if (frame.real) {
+      frame.work_data = sycl::malloc_device<ac_complex<float>>(points, q);
+    }
+
+    // With two FFT engines, the intermediate matrix goes to a second DDR bank
+    // if the board has one: the row pass then reads the first bank and writes
+    // the second, while the column pass of the previous frame reads the
+    // second bank and writes the first
+    if (kEngines == 2) {
+      auto bank_prop_list = sycl::property_list{
+          sycl::ext::intel::experimental::property::usm::buffer_location(1)};
+      frame.temp_data =
+          sycl::malloc_device<ac_complex<float>>(points, q, bank_prop_list);
+    }
+    if (frame.temp_data == nullptr) {
+      frame.temp_data = sycl::malloc_device<ac_complex<float>>(points, q);
+    }
+  } else {
+    // No device allocations means that we are probably in a SYCL HLS
+    // flow
+
+#if defined IS_BSP
+    auto prop_list = sycl::property_list{};
+#else
+    // In the SYCL HLS flow, we need to define the memory interface.
+    // For, that we need to assign a location to the memory being accessed.
+    auto prop_list = sycl::property_list{
+        sycl::ext::intel::experimental::property::usm::buffer_location(1)};
+#endif
+
+    frame.input_data = sycl::malloc_host<ac_complex<float>>(input_size, q);
+    frame.output_data =
+        sycl::malloc_host<ac_complex<float>>(output_size, q, prop_list);
+    frame.temp_data =
+        sycl::malloc_host<ac_complex<float>>(points, q, prop_list);
+    if (frame.real) {
+      frame.work_data =
+          sycl::malloc_host<ac_complex<float>>(points, q, prop_list);
+    }
+  }
+
+  if (frame.input_data == nullptr || frame.output_data == nullptr ||
+      frame.temp_data == nullptr ||
+      (frame.real && frame.work_data == nullptr)) {
+    std::cerr << "Failed to allocate USM memory." << std::endl;
+    std::terminate();
+  }
+}
+
+void FreeFrame(sycl::queue &q, Frame &frame) {
+  sycl::free(frame.input_data, q);
+  sycl::free(frame.output_data, q);
+  sycl::free(frame.temp_data, q);
+  if (frame.real) {
+    sycl::free(frame.work_data, q);
+  }
+}
+
+// Initialize the input of a frame and its verification data
+void InitFrame(Frame &frame) {
+  if (frame.real) {
+    InitRealFrame(frame);
+    return;
+  }
+
+  int rows = 1 << frame.log_rows;
+  int cols = 1 << frame.log_cols;
+
+  frame.host_input_data.resize(frame.Points());
+  frame.host_output_data.resize(frame.Points());
+  frame.host_verify.resize(frame.Points());
+
+  for (int i = 0; i < rows; i++) {
+    for (int j = 0; j < cols; j++) {
+      int where = frame.mangle
+                      ? MangleBits(Coordinates(cols, i, j), frame.log_cols)
+                      : Coordinates(cols, i, j);
+      frame.host_verify[Coordinates(cols, i, j)].r() =
+          frame.host_input_data[where].r() =
+              (float)((double)rand() / (double)RAND_MAX);
+      frame.host_verify[Coordinates(cols, i, j)].i() =
+          frame.host_input_data[where].i() =
+              (float)((double)rand() / (double)RAND_MAX);
+    }
+  }
+}
+
+// Initialize the input of a real frame and its verification data. The input
+// of an inverse (C2R) frame is the half spectrum of a random real frame,
+// computed by the reference code, and its verification data is the real
+// frame, scaled by the number of points as the inverse is not normalized
+void InitRealFrame(Frame &frame) {
+  int rows = 1 << frame.log_rows;
+  int cols = 1 << frame.log_cols;
+  int half_cols = cols / 2;
+
+  frame.host_input_data.resize(frame.InputSize());
+  frame.host_output_data.resize(frame.OutputSize());
+  frame.host_verify.resize(frame.Points());
+
+  std::vector<float> real_data(frame.Points());
+  for (size_t i = 0; i < frame.Points(); i++) {
+    real_data[i] = (float)((double)rand() / (double)RAND_MAX);
+    frame.host_verify[i].r() = real_data[i];
+    frame.host_verify[i].i() = 0;
+  }
+
+  if (!frame.inverse) {
+    // Consecutive points are stored by pairs in complex values
+    for (size_t i = 0; i < frame.SignalSize(); i++) {
+      frame.host_input_data[i].r() = real_data[2 * i];
+      frame.host_input_data[i].i() = real_data[2 * i + 1];
+    }
+    return;
+  }
+
+  Frame spectrum = frame;
+  spectrum.inverse = false;
+  GoldFrame(spectrum);
+  for (int i = 0; i < rows; i++) {
+    for (int j = 0; j <= half_cols; j++) {
+      const ac_complex<double> &value =
+          spectrum.host_verify[Coordinates(cols, i, j)];
+      frame.host_input_data[Coordinates(half_cols + 1, i, j)].r() =
+          (float)value.r();
+      frame.host_input_data[Coordinates(half_cols + 1, i, j)].i() =
+          (float)value.i();
+    }
+  }
+
+  for (size_t i = 0; i < frame.Points(); i++) {
+    frame.host_verify[i].r() = (double)real_data[i] * frame.Points();
+  }
+}
+
+// Runs the reference code on the verification data of a frame, and returns
+// the signal to noise ratio of the frame output
+double CheckFrame(Frame &frame) {
+  GoldFrame(frame);
+  return FrameSNR(frame, frame.host_output_data.data());
+}
+
+// Runs the reference code on the verification data of a frame, in place. The
+// verification data of an inverse real frame is set by 'InitRealFrame'
+void GoldFrame(Frame &frame) {
+  if (frame.real && frame.inverse) {
+    return;
+  }
+
+  int rows = 1 << frame.log_rows;
+  int cols = 1 << frame.log_cols;
+  ac_complex<double> *host_verify = frame.host_verify.data();
+  std::vector<ac_complex<double>> host_verify_tmp(frame.Points());
+
+  // Run reference code
+  for (int i = 0; i < rows; i++) {
+    FourierTransformGold(host_verify + Coordinates(cols, i, 0),
+                         frame.log_cols, frame.inverse);
+  }
+
+  for (int i = 0; i < rows; i++) {
+    for (int j = 0; j < cols; j++) {
+      host_verify_tmp[Coordinates(rows, j, i)] =
+          host_verify[Coordinates(cols, i, j)];
+    }
+  }
+
+  for (int i = 0; i < cols; i++) {
+    FourierTransformGold(host_verify_tmp.data() + Coordinates(rows, i, 0),
+                         frame.log_rows, frame.inverse);
+  }
+
+  for (int i = 0; i < cols; i++) {
+    for (int j = 0; j < rows; j++) {
+      host_verify[Coordinates(cols, j, i)] =
+          host_verify_tmp[Coordinates(rows, i, j)];
+    }
+  }
+}
+
+// Returns the signal to noise ratio of 'output' against the golden result of
+// a frame
+double FrameSNR(const Frame &frame, const ac_complex<float> *output) {
+  int rows = 1 << frame.log_rows;
+  int cols = 1 << frame.log_cols;
+
+  int half_cols = cols / 2;
+
+  double magnitude_sum = 0;
+  double noise_sum = 0;
+  auto accumulate = [&](const ac_complex<double> &gold,
+                        const ac_complex<float> &out) {
+    double magnitude = (double)gold.r() * (double)gold.r() +
+                       (double)gold.i() * (double)gold.i();
+    double noise = (gold.r() - (double)out.r()) * (gold.r() - (double)out.r()) +
+                   (gold.i() - (double)out.i()) * (gold.i() - (double)out.i());
+
+    magnitude_sum += magnitude;
+    noise_sum += noise;
+  };
+
+  if (frame.real && !frame.inverse) {
+    // The non-redundant columns of the spectrum of a real frame
+    for (int i = 0; i < rows; i++) {
+      for (int j = 0; j <= half_cols; j++) {
+        accumulate(frame.host_verify[Coordinates(cols, i, j)],
+                   output[Coordinates(half_cols + 1, i, j)]);
+      }
+    }
+  } else if (frame.real) {
+    // The pairs of consecutive points of a real frame
+    for (int i = 0; i < rows; i++) {
+      for (int j = 0; j < half_cols; j++) {
+        ac_complex<double> gold;
+        gold.r() = frame.host_verify[Coordinates(cols, i, 2 * j)].r();
+        gold.i() = frame.host_verify[Coordinates(cols, i, 2 * j + 1)].r();
+        accumulate(gold, output[Coordinates(half_cols, i, j)]);
+      }
+    }
+  } else {
+    for (int i = 0; i < rows; i++) {
+      for (int j = 0; j < cols; j++) {
+        int where = frame.mangle
+                        ? MangleBits(Coordinates(cols, i, j), frame.log_cols)
+                        : Coordinates(cols, i, j);
+        accumulate(frame.host_verify[Coordinates(cols, i, j)], output[where]);
+      }
+    }
+  }
+  return 10 * log(magnitude_sum / noise_sum) / log(10.0);
+}
+
 // provides a linear offset in the input array
-template <int n>
-int Coordinates(int iteration, int i) {
+int Coordinates(int n, int iteration, int i) {
   return iteration * n + i;
 }
 
 // Reference Fourier transform
-template <int lognr_points>
-void FourierTransformGold(ac_complex<double> *data, bool inverse) {
-  constexpr int kNrPoints = 1 << lognr_points;
+void FourierTransformGold(ac_complex<double> *data, int lognr_points,
+                          bool inverse) {
+  int nr_points = 1 << lognr_points;
 
   // The inverse requires swapping the real and imaginary component
   if (inverse) {
-    for (int i = 0; i < kNrPoints; i++) {
+    for (int i = 0; i < nr_points; i++) {
       double tmp = data[i].r();
       data[i].r() = data[i].i();
       data[i].i() = tmp;
@@ -362,11 +1119,11 @@ void FourierTransformGold(ac_complex<double> *data, bool inverse) {
   }
 
   // Do a FT recursively
-  FourierStage<lognr_points>(data);
+  FourierStage(data, lognr_points);
 
   // The inverse requires swapping the real and imaginary component
   if (inverse) {
-    for (int i = 0; i < kNrPoints; i++) {
+    for (int i = 0; i < nr_points; i++) {
       double tmp = data[i].r();
       data[i].r() = data[i].i();
       data[i].i() = tmp;
@@ -374,15 +1131,14 @@ void FourierTransformGold(ac_complex<double> *data, bool inverse) {
   }
 }
 
-template <int lognr_points>
-void FourierStage(ac_complex<double> *data) {
-  if constexpr (lognr_points > 0) {
-    constexpr int kNrPoints = 1 << lognr_points;
+void FourierStage(ac_complex<double> *data, int lognr_points) {
+  if (lognr_points > 0) {
+    int nr_points = 1 << lognr_points;
 
     ac_complex<double> *half1 = (ac_complex<double> *)malloc(
-        sizeof(ac_complex<double>) * kNrPoints / 2);
+        sizeof(ac_complex<double>) * nr_points / 2);
     ac_complex<double> *half2 = (ac_complex<double> *)malloc(
-        sizeof(ac_complex<double>) * kNrPoints / 2);
+        sizeof(ac_complex<double>) * nr_points / 2);
 
     if (half1 == nullptr || half2 == nullptr) {
       std::cerr << "Failed to allocate memory in validation function."
@@ -390,27 +1146,27 @@ void FourierStage(ac_complex<double> *data) {
       std::terminate();
     }
 
-    for (int i = 0; i < kNrPoints / 2; i++) {
+    for (int i = 0; i < nr_points / 2; i++) {
       half1[i] = data[2 * i];
       half2[i] = data[2 * i + 1];
     }
 
-    FourierStage<lognr_points - 1>(half1);
-    FourierStage<lognr_points - 1>(half2);
+    FourierStage(half1, lognr_points - 1);
+    FourierStage(half2, lognr_points - 1);
 
-    for (int i = 0; i < kNrPoints / 2; i++) {
+    for (int i = 0; i < nr_points / 2; i++) {
       data[i].r() = half1[i].r() +
-                    cos(2 * M_PI * i / kNrPoints) * half2[i].r() +
-                    sin(2 * M_PI * i / kNrPoints) * half2[i].i();
+                    cos(2 * M_PI * i / nr_points) * half2[i].r() +
+                    sin(2 * M_PI * i / nr_points) * half2[i].i();
       data[i].i() = half1[i].i() -
-                    sin(2 * M_PI * i / kNrPoints) * half2[i].r() +
-                    cos(2 * M_PI * i / kNrPoints) * half2[i].i();
-      data[i + kNrPoints / 2].r() =
-          half1[i].r() - cos(2 * M_PI * i / kNrPoints) * half2[i].r() -
-          sin(2 * M_PI * i / kNrPoints) * half2[i].i();
-      data[i + kNrPoints / 2].i() =
-          half1[i].i() + sin(2 * M_PI * i / kNrPoints) * half2[i].r() -
-          cos(2 * M_PI * i / kNrPoints) * half2[i].i();
+                    sin(2 * M_PI * i / nr_points) * half2[i].r() +
+                    cos(2 * M_PI * i / nr_points) * half2[i].i();
+      data[i + nr_points / 2].r() =
+          half1[i].r() - cos(2 * M_PI * i / nr_points) * half2[i].r() -
+          sin(2 * M_PI * i / nr_points) * half2[i].i();
+      data[i + nr_points / 2].i() =
+          half1[i].i() + sin(2 * M_PI * i / nr_points) * half2[i].r() -
+          cos(2 * M_PI * i / nr_points) * half2[i].i();
     }
 
     free(half1);
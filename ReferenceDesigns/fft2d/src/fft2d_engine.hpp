@@ -0,0 +1,303 @@
+#ifndef __FFT2D_ENGINE_HPP__
+#define __FFT2D_ENGINE_HPP__
+
+#include <array>
+#include <stdexcept>
+#include <vector>
+
+#include <sycl/ext/intel/ac_types/ac_complex.hpp>
+#include <sycl/ext/intel/fpga_extensions.hpp>
+#include <sycl/sycl.hpp>
+
+#include "fft2d.hpp"
+
+// Forward declare the kernel and pipe names to reduce name mangling. Each
+// chain of kernels is identified by 'id' and its datapath 'Format'
+template <int id, typename Format>
+class FetchKernel;
+template <int id, typename Format>
+class FFTKernel;
+template <int id, typename Format>
+class TransposeKernel;
+template <int id, typename Format>
+class FetchToFFTPipe;
+template <int id, typename Format>
+class FFTToTransposePipe;
+template <int id, typename Format>
+class FetchToTransposePipe;
+template <typename Format>
+class RealSpectrumKernel;
+
+// One chain of the Fetch, FFT and Transpose kernels, which applies a 1D FFT
+// to the rows of a matrix and writes the transposed result
+template <int id, int max_logn, size_t log_points, typename T,
+          typename Format = FloatFormat>
+class FFTChain {
+ public:
+  static constexpr int kPoints = 1 << log_points;
+
+  // Start a 1D FFT on the 2^log_rows rows of 2^logn points of 'to_read', and
+  // write the transposed result to 'to_write'. The fetch kernel waits for
+  // 'fetch_deps'. Returns the event of the fetch kernel.
+  // With a fixed-point format, the input is scaled by 2^-input_shift, and
+  // the components out of range are added to '*overflows'.
+  sycl::event Submit(sycl::queue &q, ac_complex<T> *to_read,
+                     ac_complex<T> *to_write, int logn, int log_rows,
+                     bool inverse, bool mangle,
+                     std::vector<sycl::event> fetch_deps, int input_shift = 0,
+                     unsigned *overflows = nullptr) {
+    fetch_deps.push_back(last_fetch_);
+    last_fetch_ = q.submit([&](sycl::handler &h) {
+      h.depends_on(fetch_deps);
+      h.single_task<FetchKernel<id, Format>>(
+          Fetch<max_logn, log_points, FetchToFFT, T, Format,
+                FetchToTranspose>{to_read, mangle, logn, log_rows,
+                                  input_shift, overflows});
+    });
+
+    std::vector<sycl::event> fft_deps{last_fft_};
+    last_fft_ = q.submit([&](sycl::handler &h) {
+      h.depends_on(fft_deps);
+      h.single_task<FFTKernel<id, Format>>(
+          FFT<max_logn, log_points, FetchToFFT, FFTToTranspose, T, Format>{
+              inverse, logn, log_rows});
+    });
+
+    std::vector<sycl::event> transpose_deps{last_transpose_};
+    last_transpose_ = q.submit([&](sycl::handler &h) {
+      h.depends_on(transpose_deps);
+      h.single_task<TransposeKernel<id, Format>>(
+          Transpose<max_logn, log_points, FFTToTranspose, T, Format,
+                    FetchToTranspose>{to_write, mangle, logn, log_rows});
+    });
+
+    return last_fetch_;
+  }
+
+  // The event of the last transposition, which completes the last pass
+  sycl::event LastTranspose() const { return last_transpose_; }
+
+  void Wait() {
+    last_fetch_.wait();
+    last_fft_.wait();
+    last_transpose_.wait();
+  }
+
+ private:
+  using Sample = typename Format::Sample;
+
+  // Kernel to kernel pipes
+  using FetchToFFT =
+      sycl::ext::intel::pipe<FetchToFFTPipe<id, Format>,
+                             std::array<ac_complex<Sample>, kPoints>, 0>;
+  using FFTToTranspose =
+      sycl::ext::intel::pipe<FFTToTransposePipe<id, Format>,
+                             std::array<ac_complex<Sample>, kPoints>, 0>;
+  // The shift of each block of rows, in the fixed-point formats. The fetch
+  // kernel runs at most a couple of blocks ahead of the transpose kernel.
+  using FetchToTranspose =
+      sycl::ext::intel::pipe<FetchToTransposePipe<id, Format>, int, 4>;
+
+  sycl::event last_fetch_;
+  sycl::event last_fft_;
+  sycl::event last_transpose_;
+};
+
+// Host interface of the 2D FFT kernels.
+//
+// The kernels are compiled for frames of up to 2^max_logn x 2^max_logn
+// points, and each frame selects its own size at runtime: any power of two
+// number of rows and columns from 2^(2 * log_points) up to 2^max_logn. A frame
+// of R rows and C columns is transformed in two passes of the Fetch, FFT and
+// Transpose kernels: the first pass applies C-point FFTs to the R rows and
+// writes the transposed C x R matrix to a temporary buffer, and the second
+// pass applies R-point FFTs to its C rows, which transposes the result back
+// to R x C.
+//
+// With one engine, both passes run on the same chain of kernels. With two
+// engines, the row passes run on a first chain and the column passes on a
+// second one, so that the column pass of a frame overlaps the row pass of the
+// next frame, at the cost of a second FFT engine on the device.
+//
+// Real frames of R rows and C columns are transformed as complex frames of R
+// rows and C/2 columns, whose spectrum the RealSpectrum kernel converts to
+// the C/2 + 1 non-redundant columns of the spectrum of the real frame (R2C),
+// or back (C2R).
+//
+// Frames of different sizes are queued back to back: every kernel launch
+// waits for the previous launch of the same kernel, and the column pass of a
+// frame for its row pass, so the host never waits between the passes or the
+// frames.
+//
+// The FFT engines compute in the datapath 'Format' (see fft2d_format.hpp).
+// With 'FixedFormat', the components of the input frames must be in
+// [-2^input_log_bound, 2^input_log_bound): the row pass scales them by
+// 2^-input_log_bound, and the column pass scales the results of the row pass
+// by 2^-(input_log_bound + log_cols + 1), the bound of their components.
+// 'BlockFloatFormat' scales the blocks of rows by their own exponents and
+// ignores the bound. The fixed-point formats count the input components that
+// overflow the datapath, see 'Overflows'.
+template <int max_logn, size_t log_points, typename T = float,
+          int engines = 1, typename Format = FloatFormat>
+class FFT2DEngine {
+ public:
+  using DatapathFormat = Format;
+  static constexpr int kPoints = 1 << log_points;
+
+  // The FFT engine needs at least 'kPoints' steps per transform
+  static constexpr int kMinLogN = 2 * log_points;
+  static constexpr int kMaxLogN = max_logn;
+  static constexpr int kEngines = engines;
+
+  static_assert(max_logn >= kMinLogN,
+                "The largest transform must have at least kPoints * kPoints "
+                "points");
+  static_assert(engines == 1 || engines == 2,
+                "The 2D FFT uses one or two FFT engines");
+
+  explicit FFT2DEngine(sycl::queue &q) : q_(q) {
+    if constexpr (Format::kFixedPoint) {
+      // One counter per chain, as the two chains may run concurrently
+      overflows_ = sycl::malloc_host<unsigned>(2, q_);
+      if (overflows_ == nullptr) {
+        throw std::runtime_error("Failed to allocate the overflow counters");
+      }
+      ResetOverflows();
+    }
+  }
+
+  ~FFT2DEngine() {
+    if (overflows_ != nullptr) {
+      sycl::free(overflows_, q_);
+    }
+  }
+
+  FFT2DEngine(const FFT2DEngine &) = delete;
+  FFT2DEngine &operator=(const FFT2DEngine &) = delete;
+
+  // Whether the engine can transform a frame of 2^log_rows rows of 2^log_cols
+  // points, in the alternative memory layout if 'mangle' is set
+  static bool Supports(int log_rows, int log_cols, bool mangle) {
+    bool size_ok = log_rows >= kMinLogN && log_rows <= max_logn &&
+                   log_cols >= kMinLogN && log_cols <= max_logn;
+    bool layout_ok = !mangle || (CanMangle(log_cols, log_rows) &&
+                                 CanMangle(log_rows, log_cols));
+    return size_ok && layout_ok;
+  }
+
+  // Whether the engine can transform a real frame of 2^log_rows rows of
+  // 2^log_cols points
+  static bool SupportsReal(int log_rows, int log_cols) {
+    return Supports(log_rows, log_cols - 1, false);
+  }
+
+  // Queues the 2D FFT of the frame 'src' of 2^log_rows rows of 2^log_cols
+  // points into 'dest', once the events 'deps' complete. 'temp' holds the
+  // transposed intermediate matrix and must not be used by another frame
+  // until this frame completes. Returns the events of the first and the last
+  // kernel of the frame: 'src' can be reused once the first one completes.
+  std::pair<sycl::event, sycl::event> Submit(
+      ac_complex<T> *src, ac_complex<T> *temp, ac_complex<T> *dest,
+      int log_rows, int log_cols, bool inverse, bool mangle,
+      const std::vector<sycl::event> &deps = {}, int input_log_bound = 0) {
+    // the row pass: 2^log_rows transforms of 2^log_cols points
+    sycl::event first =
+        rows_.Submit(q_, src, temp, log_cols, log_rows, inverse, mangle, deps,
+                     input_log_bound, overflows_);
+
+    // the column pass, on the transposed rows
+    std::vector<sycl::event> column_deps{rows_.LastTranspose()};
+    int column_shift = input_log_bound + log_cols + 1;
+    if constexpr (engines == 2) {
+      columns_.Submit(q_, temp, dest, log_rows, log_cols, inverse, mangle,
+                      column_deps, column_shift, overflows_ + 1);
+      return {first, columns_.LastTranspose()};
+    } else {
+      rows_.Submit(q_, temp, dest, log_rows, log_cols, inverse, mangle,
+                   column_deps, column_shift, overflows_);
+      return {first, rows_.LastTranspose()};
+    }
+  }
+
+  // Queues the 2D FFT of the real frame 'src' of 2^log_rows rows of
+  // 2^log_cols points, once the events 'deps' complete. 'dest' receives the
+  // 2^log_rows rows of 2^(log_cols - 1) + 1 points of the non-redundant half
+  // of the spectrum. 'temp' and 'work' hold 2^(log_rows + log_cols - 1)
+  // points each and must not be used by another frame until this frame
+  // completes. Returns the events of the first and the last kernel of the
+  // frame.
+  std::pair<sycl::event, sycl::event> SubmitR2C(
+      T *src, ac_complex<T> *temp, ac_complex<T> *work, ac_complex<T> *dest,
+      int log_rows, int log_cols, const std::vector<sycl::event> &deps = {}) {
+    // the spectrum of the complex frame of the even and odd columns
+    auto events = Submit(reinterpret_cast<ac_complex<T> *>(src), temp, work,
+                         log_rows, log_cols - 1, false, false, deps);
+
+    std::vector<sycl::event> real_deps{events.second, last_real_};
+    last_real_ = q_.submit([&](sycl::handler &h) {
+      h.depends_on(real_deps);
+      h.single_task<RealSpectrumKernel<Format>>(
+          RealSpectrum<max_logn, log_points, T>{work, dest, false, log_rows,
+                                                log_cols});
+    });
+
+    return {events.first, last_real_};
+  }
+
+  // Queues the inverse 2D FFT of the 2^log_rows rows of 2^(log_cols - 1) + 1
+  // points of the non-redundant half of the spectrum 'src' into the real
+  // frame 'dest' of 2^log_rows rows of 2^log_cols points, once the events
+  // 'deps' complete. The spectrum must be the one of a real frame. 'temp' and
+  // 'work' are as in 'SubmitR2C'. Returns the events of the first and the
+  // last kernel of the frame.
+  std::pair<sycl::event, sycl::event> SubmitC2R(
+      ac_complex<T> *src, ac_complex<T> *temp, ac_complex<T> *work, T *dest,
+      int log_rows, int log_cols, const std::vector<sycl::event> &deps = {}) {
+    std::vector<sycl::event> real_deps(deps);
+    real_deps.push_back(last_real_);
+    last_real_ = q_.submit([&](sycl::handler &h) {
+      h.depends_on(real_deps);
+      h.single_task<RealSpectrumKernel<Format>>(
+          RealSpectrum<max_logn, log_points, T>{src, work, true, log_rows,
+                                                log_cols});
+    });
+
+    // the inverse of the spectrum of the complex frame of the even and odd
+    // columns. The components of the spectrum of a real frame in [-1, 1) are
+    // bounded by the number of points, and the conversion quadruples them.
+    auto events = Submit(work, temp, reinterpret_cast<ac_complex<T> *>(dest),
+                         log_rows, log_cols - 1, true, false, {last_real_},
+                         log_rows + log_cols + 2);
+
+    return {last_real_, events.second};
+  }
+
+  // Waits for all the queued frames to complete
+  void Wait() {
+    rows_.Wait();
+    columns_.Wait();
+    last_real_.wait();
+  }
+
+  // The number of input components that overflowed the fixed-point datapath
+  // since the last reset, in the completed frames. Always 0 in floating-point.
+  unsigned Overflows() const {
+    return overflows_ == nullptr ? 0 : overflows_[0] + overflows_[1];
+  }
+
+  void ResetOverflows() {
+    if (overflows_ != nullptr) {
+      overflows_[0] = 0;
+      overflows_[1] = 0;
+    }
+  }
+
+ private:
+  sycl::queue q_;
+  FFTChain<0, max_logn, log_points, T, Format> rows_;
+  FFTChain<1, max_logn, log_points, T, Format> columns_;
+  sycl::event last_real_;
+  unsigned *overflows_ = nullptr;
+};
+
+#endif /* __FFT2D_ENGINE_HPP__ */
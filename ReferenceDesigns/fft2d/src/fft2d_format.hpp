@@ -0,0 +1,109 @@
+#ifndef __FFT2D_FORMAT_HPP__
+#define __FFT2D_FORMAT_HPP__
+
+#include <string>
+
+#include <sycl/ext/intel/ac_types/ac_complex.hpp>
+#include <sycl/ext/intel/ac_types/ac_fixed.hpp>
+#include <sycl/sycl.hpp>
+
+// Number formats of the datapath of the FFT engine.
+//
+// The frames are stored in memory as complex single-precision floating-point
+// values in every format. The fetch kernel converts the points it reads to
+// the samples of the format, and the transpose kernel converts the
+// transformed samples back before writing them:
+// - 'FloatFormat' computes in single-precision floating-point, the original
+//   datapath of the engine.
+// - 'FixedFormat<width>' computes in signed fixed-point samples of 'width'
+//   bits in [-2, 2). Every radix-2 stage halves its outputs, so a transform of
+//   N points is scaled by 1/N and its samples never grow out of range; the
+//   transpose kernel scales the results back by N. The input of each pass is
+//   scaled by a static power of two, chosen by the host for the range of the
+//   values of the pass.
+// - 'BlockFloatFormat<width>' uses the same fixed-point samples, with an
+//   exponent shared by the rows that the fetch kernel buffers together. The
+//   fetch kernel picks the exponent that scales the largest component of the
+//   block into [-1, 1), and passes it to the transpose kernel, which applies
+//   it back. Unlike 'FixedFormat', the precision of a block does not depend
+//   on the range of the other blocks of the frame.
+//
+// The fixed-point samples have one integer bit of headroom: the components of
+// the scaled input must be in [-1, 1) for the complex magnitudes to fit in the
+// samples through all the stages. The fetch kernel counts the components out
+// of that range as overflows; they saturate, or may saturate later in the
+// datapath.
+
+// Single-precision floating-point datapath
+struct FloatFormat {
+  using Sample = float;
+  static constexpr bool kFixedPoint = false;
+  static constexpr bool kBlockExponent = false;
+
+  static std::string Name() { return "float"; }
+
+  static ac_complex<Sample> FromFloat(ac_complex<float> value, int shift,
+                                      unsigned &overflows) {
+    return value;
+  }
+
+  static ac_complex<float> ToFloat(ac_complex<Sample> sample, int shift) {
+    return sample;
+  }
+};
+
+// Fixed-point datapath of 'width' bit samples, with a static scaling of the
+// input of each pass, or with a block exponent if 'block_exponent' is set
+template <int width, bool block_exponent>
+struct FixedPointFormat {
+  using Sample = ac_fixed<width, 2, true, AC_RND, AC_SAT>;
+  static constexpr bool kFixedPoint = true;
+  static constexpr bool kBlockExponent = block_exponent;
+
+  static_assert(width > 2, "The samples need fractional bits");
+
+  static std::string Name() {
+    return std::string(block_exponent ? "bfp<" : "fixed<") +
+           std::to_string(width) + ">";
+  }
+
+  // Scales 'value' by 2^-shift and rounds it to a sample, counting the
+  // components out of [-1, 1) in 'overflows'
+  static ac_complex<Sample> FromFloat(ac_complex<float> value, int shift,
+                                      unsigned &overflows) {
+    float r = sycl::ldexp(value.r(), -shift);
+    float i = sycl::ldexp(value.i(), -shift);
+    overflows += (r < -1.0f || r >= 1.0f) + (i < -1.0f || i >= 1.0f);
+    return ac_complex<Sample>(Sample(r), Sample(i));
+  }
+
+  // Converts 'sample' to floating-point, scaled by 2^shift
+  static ac_complex<float> ToFloat(ac_complex<Sample> sample, int shift) {
+    return ac_complex<float>(
+        sycl::ldexp((float)sample.r().to_double(), shift),
+        sycl::ldexp((float)sample.i().to_double(), shift));
+  }
+
+  // Halves 'x', the sum or the difference of two samples, rounded to the
+  // nearest sample. 'x' is first widened by one fractional bit, which makes
+  // the halving exact.
+  template <typename Sum>
+  static Sample Halve(const Sum &x) {
+    ac_fixed<width + 2, 3, true> wide = x;
+    return Sample(wide >> 1);
+  }
+};
+
+template <int width>
+using FixedFormat = FixedPointFormat<width, false>;
+
+template <int width>
+using BlockFloatFormat = FixedPointFormat<width, true>;
+
+// The biased exponent of the single-precision floating-point 'value': the
+// magnitude of 'value' is below 2^(exponent - 126)
+inline int FloatExponent(float value) {
+  return (sycl::bit_cast<unsigned>(value) >> 23) & 0xff;
+}
+
+#endif /* __FFT2D_FORMAT_HPP__ */
@@ -0,0 +1,155 @@
+#ifndef __HOST_FFT2D_HPP__
+#define __HOST_FFT2D_HPP__
+
+#define _USE_MATH_DEFINES
+#include <cmath>
+
+#include <complex>
+#include <vector>
+
+#include <sycl/ext/intel/ac_types/ac_complex.hpp>
+
+// A single-threaded 2D FFT on the host, used as the CPU baseline of the
+// batched demo. Like an FFTW plan, the bit-reversal permutations and the
+// twiddle factors of a frame size are computed once, when the plan is
+// created, and every transform of that size reuses them. The rows are
+// transformed with an iterative radix-2 FFT, then the columns, through a
+// transposed copy of the frame so that both passes access contiguous data.
+// The result has the same scaling as the FPGA kernels: the inverse transform
+// is not normalized.
+// Real frames of twice as many columns are transformed as complex frames of
+// the plan size, like the R2C transform of the FPGA kernels.
+class HostFFT2D {
+ public:
+  HostFFT2D(int log_rows, int log_cols)
+      : log_rows_(log_rows), log_cols_(log_cols),
+        row_plan_(log_cols), column_plan_(log_rows),
+        scratch_(size_t(1) << (log_rows + log_cols)),
+        real_twiddles_((size_t(1) << log_cols) + 1) {
+    // exp(-2 * pi * i * k / N) for the real frames of N = 2^(log_cols + 1)
+    // columns
+    const size_t cols = size_t(1) << log_cols;
+    for (size_t k = 0; k <= cols; k++) {
+      real_twiddles_[k] = {(float)cos(M_PI * k / cols),
+                           (float)-sin(M_PI * k / cols)};
+    }
+  }
+
+  // Transform the frame 'in' into 'out', which can be the same frame
+  void Execute(const ac_complex<float> *in, ac_complex<float> *out,
+               bool inverse) {
+    const size_t rows = size_t(1) << log_rows_;
+    const size_t cols = size_t(1) << log_cols_;
+
+    // transform the rows, and transpose them into the scratch frame
+    std::vector<std::complex<float>> row(cols);
+    for (size_t i = 0; i < rows; i++) {
+      for (size_t j = 0; j < cols; j++) {
+        row[j] = {in[i * cols + j].r(), in[i * cols + j].i()};
+      }
+      row_plan_.Execute(row.data(), inverse);
+      for (size_t j = 0; j < cols; j++) {
+        scratch_[j * rows + i] = row[j];
+      }
+    }
+
+    // transform the columns, and transpose them back into the output
+    for (size_t j = 0; j < cols; j++) {
+      std::complex<float> *column = scratch_.data() + j * rows;
+      column_plan_.Execute(column, inverse);
+      for (size_t i = 0; i < rows; i++) {
+        out[i * cols + j].r() = column[i].real();
+        out[i * cols + j].i() = column[i].imag();
+      }
+    }
+  }
+
+  // Transform the real frame of 2^log_rows rows of 2^(log_cols + 1) points
+  // 'in', whose consecutive points are stored by pairs in complex values,
+  // into the 2^log_cols + 1 non-redundant columns of its spectrum 'out'
+  void ExecuteR2C(const ac_complex<float> *in, ac_complex<float> *out) {
+    const size_t rows = size_t(1) << log_rows_;
+    const size_t cols = size_t(1) << log_cols_;
+
+    half_spectrum_.resize(rows * cols);
+    Execute(in, half_spectrum_.data(), false);
+
+    // X[m][k] = (A + B) / 2 - i * W^k * (A - B) / 2, with A = Z[m][k] and
+    // B = conj(Z[-m][N/2 - k])
+    for (size_t m = 0; m < rows; m++) {
+      const size_t mirror = (rows - m) & (rows - 1);
+      for (size_t k = 0; k <= cols; k++) {
+        const ac_complex<float> &z =
+            half_spectrum_[m * cols + (k & (cols - 1))];
+        const ac_complex<float> &z_mirror =
+            half_spectrum_[mirror * cols + ((cols - k) & (cols - 1))];
+        std::complex<float> a(z.r(), z.i());
+        std::complex<float> b(z_mirror.r(), -z_mirror.i());
+        std::complex<float> x =
+            0.5f * (a + b) +
+            std::complex<float>(0, -0.5f) * real_twiddles_[k] * (a - b);
+        out[m * (cols + 1) + k].r() = x.real();
+        out[m * (cols + 1) + k].i() = x.imag();
+      }
+    }
+  }
+
+ private:
+  // The plan of a 1D FFT of 2^logn points
+  class Plan {
+   public:
+    explicit Plan(int logn)
+        : n_(size_t(1) << logn), reversed_(n_), twiddles_(n_ / 2) {
+      for (size_t i = 0; i < n_; i++) {
+        size_t r = 0;
+        for (int b = 0; b < logn; b++) {
+          r |= ((i >> b) & 1) << (logn - 1 - b);
+        }
+        reversed_[i] = r;
+      }
+      for (size_t k = 0; k < n_ / 2; k++) {
+        twiddles_[k] = {(float)cos(2 * M_PI * k / n_),
+                        (float)-sin(2 * M_PI * k / n_)};
+      }
+    }
+
+    void Execute(std::complex<float> *data, bool inverse) const {
+      for (size_t i = 0; i < n_; i++) {
+        if (i < reversed_[i]) {
+          std::swap(data[i], data[reversed_[i]]);
+        }
+      }
+
+      for (size_t half = 1; half < n_; half *= 2) {
+        const size_t stride = n_ / (2 * half);
+        for (size_t start = 0; start < n_; start += 2 * half) {
+          for (size_t k = 0; k < half; k++) {
+            std::complex<float> w = twiddles_[k * stride];
+            if (inverse) {
+              w = std::conj(w);
+            }
+            std::complex<float> even = data[start + k];
+            std::complex<float> odd = w * data[start + k + half];
+            data[start + k] = even + odd;
+            data[start + k + half] = even - odd;
+          }
+        }
+      }
+    }
+
+   private:
+    size_t n_;
+    std::vector<size_t> reversed_;
+    std::vector<std::complex<float>> twiddles_;
+  };
+
+  int log_rows_;
+  int log_cols_;
+  Plan row_plan_;
+  Plan column_plan_;
+  std::vector<std::complex<float>> scratch_;
+  std::vector<std::complex<float>> real_twiddles_;
+  std::vector<ac_complex<float>> half_spectrum_;
+};
+
+#endif /* __HOST_FFT2D_HPP__ */
@@ -48,14 +48,10 @@ inline static void PutUlong(uint8_t *pc, unsigned long l) {
   pc[3] = (l >> 24) & 0xff;
 }
 
+// Writes the gzip member header to an already open file.
 // returns 0 on success, otherwise failure
-int WriteBlockGzip(
-    std::string &original_filename,  // Original file name being compressed
-    std::string &out_filename,       // gzip filename
-    char *obuf,                      // pointer to compressed data block
-    size_t blen,                     // length of compressed data block
-    size_t ilen,                     // original block length
-    uint32_t buffer_crc)             // the block's crc
+int WriteGzipHeader(FILE *fo,
+                    std::string &original_filename)  // Original file name
 {
   //------------------------------------------------------------------
   // Setup the gzip output file header.
@@ -102,33 +98,66 @@ int WriteBlockGzip(
 
   int header_bytes = ondx;
 
+  fwrite(pgziphdr, 1, header_bytes, fo);
+  free(pgziphdr);
+
+  if (ferror(fo)) {
+    std::cout << "gzip output file write failure.\n";
+    return 1;
+  }
+  return 0;
+}
+
+// Writes the gzip member trailer (CRC and input size) to an already open file.
+// returns 0 on success, otherwise failure
+int WriteGzipTrailer(FILE *fo,
+                     size_t ilen,          // total uncompressed length
+                     uint32_t buffer_crc)  // crc of the uncompressed data
+{
   unsigned char prolog[8];
 
   PutUlong(((unsigned char *)prolog), buffer_crc);
   PutUlong(((unsigned char *)&prolog[4]), ilen);
 
-  FILE *fo = fopen(out_filename.c_str(), "w+");
+  fwrite(prolog, 1, 8, fo);
+
   if (ferror(fo)) {
+    std::cout << "gzip output file write failure.\n";
+    return 1;
+  }
+  return 0;
+}
+
+// returns 0 on success, otherwise failure
+int WriteBlockGzip(
+    std::string &original_filename,  // Original file name being compressed
+    std::string &out_filename,       // gzip filename
+    char *obuf,                      // pointer to compressed data block
+    size_t blen,                     // length of compressed data block
+    size_t ilen,                     // original block length
+    uint32_t buffer_crc)             // the block's crc
+{
+  FILE *fo = fopen(out_filename.c_str(), "w+");
+  if (fo == NULL) {
     std::cout << "Cannot open file for output: " << out_filename << "\n";
-    free(pgziphdr);
     return 1;
   }
 
-  fwrite(pgziphdr, 1, header_bytes, fo);
+  if (WriteGzipHeader(fo, original_filename)) {
+    fclose(fo);
+    return 1;
+  }
+
   fwrite(obuf, 1, blen, fo);
-  fwrite(prolog, 1, 8, fo);
 
-  if (ferror(fo)) {
-    std::cout << "gzip output file write failure.\n";
-    free(pgziphdr);
+  if (WriteGzipTrailer(fo, ilen, buffer_crc)) {
+    fclose(fo);
     return 1;
   }
 
   if (fclose(fo)) {
     perror("close");
-    free(pgziphdr);
     return 1;
   }
-  free(pgziphdr);
   return 0;
 }
@@ -5,6 +5,7 @@
 #include <iostream>
 #include <string>
 #include <stdint.h>
+#include <stdio.h>
 
 // returns 0 on success, otherwise failure
 int WriteBlockGzip(
@@ -15,4 +16,15 @@ int WriteBlockGzip(
     size_t ilen,                     // original block length
     uint32_t buffer_crc);            // the block's crc
 
+// Writes the gzip member header to an already open file. Used together with
+// WriteGzipTrailer() when the compressed data is written in several pieces.
+// returns 0 on success, otherwise failure
+int WriteGzipHeader(FILE *fo,
+                    std::string &original_filename);  // Original file name
+
+// returns 0 on success, otherwise failure
+int WriteGzipTrailer(FILE *fo,
+                     size_t ilen,           // total uncompressed length
+                     uint32_t buffer_crc);  // crc of the uncompressed data
+
 #endif  //__WRITEGZIP_H__
@@ -1,5 +1,22 @@
 #include "crc32.hpp"
 
+#include <array>
+
+// The carry-less multiply path is only built for x86-64 hosts. Whether the CPU
+// supports it is checked at runtime.
+#if (defined(__x86_64__) || defined(_M_X64)) && \
+    (defined(__GNUC__) || defined(__clang__))
+#define CRC32_HAS_PCLMUL 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#else
+#define CRC32_HAS_PCLMUL 0
+#endif
+
 // This table is CRC32s for all single byte values created by using the
 // makecrc.c utility from gzip for compatibility with gzip. makecrc.c can be
 // found in the gzip source code project found at
@@ -64,10 +81,9 @@ const unsigned int crc32_table[] = {
 
 //
 // This routine creates a Crc32 from a memory buffer (address, and length), and
-// a previous crc. This routine can be called iteratively on different portions
-// of the same buffer, using a previously returned crc value. The
-// value 0xffffffff is used for the first buffer invocation.
-unsigned int Crc32Host(
+// a previous crc, one byte at a time. It is kept as the reference for the
+// faster routines below.
+unsigned int Crc32HostBytewise(
     const char *pbuf,           // pointer to the buffer to crc
     size_t sz,                  // number of bytes
     unsigned int previous_crc)  // previous CRC, allows combining.
@@ -80,6 +96,192 @@ unsigned int Crc32Host(
   return curr_crc ^ 0xffffffffL;
 }
 
+// Number of bytes processed per iteration of the table-driven routine
+constexpr int kSliceBytes = 16;
+
+// crc32_slice_table[k][b] is the CRC state after byte b followed by k zero
+// bytes, so that kSliceBytes independent table lookups replace kSliceBytes
+// dependent ones. crc32_slice_table[0] is crc32_table.
+static const auto crc32_slice_table = [] {
+  std::array<std::array<uint32_t, 256>, kSliceBytes> table;
+  for (int b = 0; b < 256; b++) {
+    table[0][b] = crc32_table[b];
+  }
+  for (int k = 1; k < kSliceBytes; k++) {
+    for (int b = 0; b < 256; b++) {
+      uint32_t prev = table[k - 1][b];
+      table[k][b] = (prev >> 8) ^ crc32_table[prev & 0xff];
+    }
+  }
+  return table;
+}();
+
+static inline uint32_t LoadLittleEndian32(const unsigned char *p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) |
+         ((uint32_t)p[3] << 24);
+}
+
+// Slice-by-16: advances the (inverted) CRC state over sz bytes, 16 bytes per
+// iteration.
+static uint32_t Crc32SliceBy16(const unsigned char *p, size_t sz,
+                               uint32_t state) {
+  const auto &t = crc32_slice_table;
+  while (sz >= kSliceBytes) {
+    uint32_t w0 = LoadLittleEndian32(p) ^ state;
+    uint32_t w1 = LoadLittleEndian32(p + 4);
+    uint32_t w2 = LoadLittleEndian32(p + 8);
+    uint32_t w3 = LoadLittleEndian32(p + 12);
+    state = t[15][w0 & 0xff] ^ t[14][(w0 >> 8) & 0xff] ^
+            t[13][(w0 >> 16) & 0xff] ^ t[12][w0 >> 24] ^
+            t[11][w1 & 0xff] ^ t[10][(w1 >> 8) & 0xff] ^
+            t[9][(w1 >> 16) & 0xff] ^ t[8][w1 >> 24] ^
+            t[7][w2 & 0xff] ^ t[6][(w2 >> 8) & 0xff] ^
+            t[5][(w2 >> 16) & 0xff] ^ t[4][w2 >> 24] ^
+            t[3][w3 & 0xff] ^ t[2][(w3 >> 8) & 0xff] ^
+            t[1][(w3 >> 16) & 0xff] ^ t[0][w3 >> 24];
+    p += kSliceBytes;
+    sz -= kSliceBytes;
+  }
+  while (sz--) {
+    state = crc32_table[(state ^ *p++) & 0xff] ^ (state >> 8);
+  }
+  return state;
+}
+
+#if CRC32_HAS_PCLMUL
+// Minimum number of bytes for the carry-less multiply path, which folds four
+// 128-bit lanes at a time.
+constexpr size_t kPclmulMinBytes = 64;
+
+static bool CpuSupportsPclmul() {
+  unsigned int ecx;
+#if defined(_MSC_VER)
+  int regs[4];
+  __cpuid(regs, 1);
+  ecx = (unsigned int)regs[2];
+#else
+  unsigned int eax, ebx, edx;
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) return false;
+#endif
+  // bit 1: PCLMULQDQ, bit 19: SSE4.1
+  return (ecx & (1u << 1)) && (ecx & (1u << 19));
+}
+
+// Advances the (inverted) CRC state over sz bytes by folding with carry-less
+// multiplications, then reduces the result with a Barrett reduction. sz must
+// be a multiple of 16 and at least kPclmulMinBytes. The folding constants are
+// the powers of x modulo the gzip polynomial from "Fast CRC Computation for
+// Generic Polynomials Using PCLMULQDQ Instruction" (Intel, 2009).
+__attribute__((target("pclmul,sse4.1"))) static uint32_t Crc32Pclmul(
+    const unsigned char *p, size_t sz, uint32_t state) {
+  const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596, 0x0154442bd4);
+  const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009e, 0x01751997d0);
+  const __m128i k5k0 = _mm_set_epi64x(0x0000000000, 0x0163cd6124);
+  const __m128i poly = _mm_set_epi64x(0x01f7011641, 0x01db710641);
+  const __m128i mask32 = _mm_setr_epi32(~0, 0, ~0, 0);
+
+  __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8;
+
+  x1 = _mm_loadu_si128((const __m128i *)(p + 0x00));
+  x2 = _mm_loadu_si128((const __m128i *)(p + 0x10));
+  x3 = _mm_loadu_si128((const __m128i *)(p + 0x20));
+  x4 = _mm_loadu_si128((const __m128i *)(p + 0x30));
+  x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int)state));
+  p += 64;
+  sz -= 64;
+
+  // fold four lanes by 512 bits
+  x0 = k1k2;
+  while (sz >= 64) {
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+    x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+    x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+    x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x5),
+                       _mm_loadu_si128((const __m128i *)(p + 0x00)));
+    x2 = _mm_xor_si128(_mm_xor_si128(x2, x6),
+                       _mm_loadu_si128((const __m128i *)(p + 0x10)));
+    x3 = _mm_xor_si128(_mm_xor_si128(x3, x7),
+                       _mm_loadu_si128((const __m128i *)(p + 0x20)));
+    x4 = _mm_xor_si128(_mm_xor_si128(x4, x8),
+                       _mm_loadu_si128((const __m128i *)(p + 0x30)));
+    p += 64;
+    sz -= 64;
+  }
+
+  // fold the four lanes into one
+  x0 = k3k4;
+  x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+  x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+  x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+  x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+  x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+  x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+  x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+  x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+  x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+  // fold the remaining 16-byte blocks
+  while (sz >= 16) {
+    x2 = _mm_loadu_si128((const __m128i *)p);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+    p += 16;
+    sz -= 16;
+  }
+
+  // fold 128 bits to 64 bits
+  x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+  x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+  x0 = k5k0;
+  x2 = _mm_srli_si128(x1, 4);
+  x1 = _mm_and_si128(x1, mask32);
+  x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+  x1 = _mm_xor_si128(x1, x2);
+
+  // Barrett reduction to 32 bits
+  x0 = poly;
+  x2 = _mm_and_si128(x1, mask32);
+  x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+  x2 = _mm_and_si128(x2, mask32);
+  x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+  x1 = _mm_xor_si128(x1, x2);
+
+  return (uint32_t)_mm_extract_epi32(x1, 1);
+}
+#endif  // CRC32_HAS_PCLMUL
+
+//
+// This routine creates a Crc32 from a memory buffer (address, and length), and
+// a previous crc. This routine can be called iteratively on different portions
+// of the same buffer, using a previously returned crc value. The
+// value 0xffffffff is used for the first buffer invocation.
+// The bulk of the buffer is processed with carry-less multiplications when the
+// CPU supports them (checked once at runtime), otherwise with slice-by-16.
+unsigned int Crc32Host(
+    const char *pbuf,           // pointer to the buffer to crc
+    size_t sz,                  // number of bytes
+    unsigned int previous_crc)  // previous CRC, allows combining.
+{
+  const unsigned char *p = (const unsigned char *)pbuf;
+  uint32_t state = ~previous_crc;
+#if CRC32_HAS_PCLMUL
+  static const bool has_pclmul = CpuSupportsPclmul();
+  if (has_pclmul && sz >= kPclmulMinBytes) {
+    size_t bulk = sz & ~(size_t)15;
+    state = Crc32Pclmul(p, bulk, state);
+    p += bulk;
+    sz -= bulk;
+  }
+#endif
+  return ~Crc32SliceBy16(p, sz, state);
+}
+
 unsigned int Crc32(const char *in, size_t buffer_sz,
                    unsigned int previous_crc) {
   const int num_nibbles_parallel = 64;
@@ -91,3 +293,54 @@ unsigned int Crc32(const char *in, size_t buffer_sz,
   int remaining_bytes = buffer_sz % (num_nibbles_parallel / 2);
   return Crc32Host(remaining_data, remaining_bytes, previous_crc);
 }
+
+// The gzip CRC polynomial, in reflected bit order.
+constexpr uint32_t kCrc32Polynomial = 0xedb88320;
+
+// Multiplies a and b modulo the CRC polynomial. In the reflected bit order
+// used by gzip, the most significant bit is the coefficient of x^0.
+static uint32_t MultModP(uint32_t a, uint32_t b) {
+  uint32_t m = 1u << 31;
+  uint32_t p = 0;
+  for (;;) {
+    if (a & m) {
+      p ^= b;
+      if ((a & (m - 1)) == 0) break;
+    }
+    m >>= 1;
+    b = (b & 1) ? (b >> 1) ^ kCrc32Polynomial : b >> 1;
+  }
+  return p;
+}
+
+// Returns x^(8 * len) modulo the CRC polynomial, i.e. the operator that
+// advances a CRC over len zero bytes. Uses the table of x^(2^k), so it takes
+// O(log(len)) multiplications.
+static uint32_t ShiftBytesModP(size_t len) {
+  static const auto x2n_table = [] {
+    std::array<uint32_t, 32> table;
+    uint32_t p = 1u << 30;  // x^1
+    table[0] = p;
+    for (int k = 1; k < 32; k++) {
+      p = MultModP(p, p);
+      table[k] = p;
+    }
+    return table;
+  }();
+
+  uint32_t p = 1u << 31;  // x^0
+  int k = 3;              // len is in bytes, start from x^(2^3)
+  while (len) {
+    if (len & 1) p = MultModP(x2n_table[k & 31], p);
+    len >>= 1;
+    k++;
+  }
+  return p;
+}
+
+//
+// Combines the CRCs of two adjacent buffers A and B into the CRC of A followed
+// by B, without touching the data. len_b is the length of B in bytes.
+uint32_t Crc32Combine(uint32_t crc_a, uint32_t crc_b, size_t len_b) {
+  return MultModP(ShiftBytesModP(len_b), crc_a) ^ crc_b;
+}
@@ -10,9 +10,20 @@ uint32_t Crc32Host(
     size_t sz,               // number of bytes
     uint32_t previous_crc);  // previous CRC, allows combining. First invocation
                              // would use 0xffffffff.
+// Same as Crc32Host(), one byte at a time. Reference for Crc32Host().
+uint32_t Crc32HostBytewise(
+    const char *pbuf,        // pointer to the buffer to crc
+    size_t sz,               // number of bytes
+    uint32_t previous_crc);  // previous CRC
 uint32_t Crc32(const char *pbuf,        // pointer to the buffer to crc
                size_t sz,               // number of bytes
                uint32_t previous_crc);  // previous CRC, allows combining. First
                                         // invocation would use 0xffffffff.
 
+// Returns the CRC of the concatenation of two buffers A and B from their
+// separate CRCs, e.g. to join segments that were compressed independently.
+uint32_t Crc32Combine(uint32_t crc_a,  // CRC of the first buffer
+                      uint32_t crc_b,  // CRC of the second buffer
+                      size_t len_b);   // number of bytes in the second buffer
+
 #endif  //__CRC32_H__
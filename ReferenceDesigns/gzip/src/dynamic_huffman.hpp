@@ -0,0 +1,738 @@
+#ifndef __DYNAMIC_HUFFMAN_H__
+#define __DYNAMIC_HUFFMAN_H__
+#pragma once
+
+#include "kernels.hpp"
+
+// This file contains the building blocks of the dynamic Huffman (BTYPE=10)
+// encoder, which is used instead of the static Huffman encoder when the design
+// is compiled with -DDYNAMIC_HUFFMAN=1. It is shared by the high bandwidth and
+// the low latency variants of the design.
+//
+// The encoder buffers kDynamicBlockVecs DistLen vectors from the LZ reduction
+// kernel on-chip while gathering the literal/length and distance histograms.
+// It then builds length-limited Huffman codes for the block, emits the
+// code-length header (RFC 1951, section 3.2.7) and finally replays the
+// buffered vectors through the code tables. Small blocks, for which the
+// header costs more than it saves, are sent with the static trees instead.
+
+// The frequencies are packed together with the symbol index into a single
+// sort key, so they must stay below 2^(32 - kSymbolKeyBits).
+constexpr int kSymbolKeyBits = 9;
+static_assert(kLCodes <= (1 << kSymbolKeyBits));
+static_assert(kDynamicBlockVecs * kVec < (1 << (32 - kSymbolKeyBits)));
+
+// Upper bound on the number of items in a dynamic block header: the
+// BFINAL/BTYPE/HLIT/HDIST/HCLEN item, the bit length code lengths, and at most
+// one run-length coded item per literal/length and distance code length.
+// Rounded up so that the encoder can always read kVec items at a time.
+constexpr int kMaxHeaderItems =
+    ((1 + kBLCodes + kLCodes + kDCodes + kVec - 1) / kVec) * kVec;
+
+// Code length codes that carry repeat counts (RFC 1951, section 3.2.7)
+constexpr int kRepeatPrevious = 16;  // 3-6 copies of the previous length
+constexpr int kRepeatZero3 = 17;     // 3-10 zero lengths
+constexpr int kRepeatZero11 = 18;    // 11-138 zero lengths
+
+// Computes the length symbol (0..kLengthCodes-1, to be added to
+// kLiterals + 1) and the extra bits for a match length.
+inline void GetLengthSymbol(int len, int &sym, unsigned int &extra,
+                            int &extra_bits) {
+  const int base_length[kLengthCodes] = {
+      0,  1,  2,  3,  4,  5,  6,  7,  8,   10,  12,  14,  16,  20, 24,
+      28, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 0,
+  };
+
+  const int extra_lbits[kLengthCodes]  // extra bits for each length code
+      = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+         2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+
+  // length code for each normalized match length (0 == kMinMatch). The LZ
+  // reduction kernel never produces matches longer than kLen, so only the
+  // start of the table from GetHuffRunLen() is needed.
+  const unsigned char length_code[kLen - kMinMatch + 1] = {
+      0, 1, 2, 3, 4, 5, 6, 7, 8, 8, 9, 9, 10, 10,
+  };
+
+  int lc = len - kMinMatch;
+  sym = length_code[lc];
+  extra = lc - base_length[sym];
+  extra_bits = extra_lbits[sym];
+}
+
+// Computes the distance symbol and the extra bits for a match distance.
+inline void GetDistSymbol(int initial_dist, int &sym, unsigned int &extra,
+                          int &extra_bits) {
+  const int extra_dbits[kDCodes]  // extra bits for each distance code
+      = {0, 0, 0, 0, 1, 1, 2, 2,  3,  3,  4,  4,  5,  5,  6,
+         6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+  const int base_dist[kDCodes] = {
+      0,    1,    2,    3,    4,    6,    8,    12,    16,    24,
+      32,   48,   64,   96,   128,  192,  256,  384,   512,   768,
+      1024, 1536, 2048, 3072, 4096, 6144, 8192, 12288, 16384, 24576,
+  };
+
+  int dist = initial_dist - 1;
+
+  // Equivalent to the d_code() lookup: the distance code is found from the
+  // position of the leading one and the bit below it.
+  int msb = 0;
+#pragma unroll
+  for (int b = 0; b < 15; b++) {
+    if ((dist >> b) & 1) msb = b;
+  }
+  sym = dist < 4 ? dist : (msb << 1) | ((dist >> (msb - 1)) & 1);
+  extra = dist - base_dist[sym];
+  extra_bits = extra_dbits[sym];
+}
+
+// Code lengths of the static Huffman trees (RFC 1951, section 3.2.6).
+inline unsigned char GetStaticLitLen(int sym) {
+  return sym < 144 ? 8 : (sym < 256 ? 9 : (sym < 280 ? 7 : 8));
+}
+constexpr unsigned char kStaticDistLen = 5;
+
+// Builds a length-limited Huffman code for kNumSymbols symbols with the given
+// frequencies. The code lengths are written to code_len; symbols that do not
+// occur get a length of 0.
+//
+// The code lengths are computed with the in-place algorithm of Moffat and
+// Katajainen on the symbols sorted by frequency. Codes longer than
+// kMaxCodeLen are then clamped and the resulting over-subscription of the
+// code space is repaid by lengthening the longest codes that are still below
+// the limit (similar to what zlib does). Finally, the lengths are
+// handed out to the symbols in frequency order, so that the most frequent
+// symbols get the shortest codes.
+template <int kNumSymbols, int kMaxCodeLen>
+void BuildCodeLengths(unsigned int freq[kNumSymbols],
+                      unsigned char code_len[kNumSymbols]) {
+  // Inflate implementations reject incomplete codes, and a single symbol
+  // would get a zero length code, so make sure at least two symbols are used.
+  int used = 0;
+  for (int s = 0; s < kNumSymbols; s++) {
+    used += freq[s] != 0;
+  }
+  if (used < 2 && freq[0] == 0) {
+    freq[0] = 1;
+    used++;
+  }
+  if (used < 2 && freq[1] == 0) {
+    freq[1] = 1;
+    used++;
+  }
+
+  // Sort the symbols by (frequency, symbol). Since the keys are unique, the
+  // rank of a key is its position in the sorted order. All of the comparisons
+  // for one symbol are done in parallel, so this takes kNumSymbols iterations.
+  unsigned int key[kNumSymbols];
+  for (int s = 0; s < kNumSymbols; s++) {
+    key[s] = (freq[s] << kSymbolKeyBits) | s;
+  }
+
+  unsigned short sorted[kNumSymbols];
+  for (int s = 0; s < kNumSymbols; s++) {
+    unsigned short rank = 0;
+#pragma unroll
+    for (int t = 0; t < kNumSymbols; t++) {
+      rank += key[t] < key[s];
+    }
+    sorted[rank] = s;
+  }
+
+  // the symbols that do not occur are sorted to the front, skip them
+  const int first = kNumSymbols - used;
+  const int n = used;
+
+  unsigned int a[kNumSymbols];
+  for (int i = 0; i < n; i++) {
+    a[i] = freq[sorted[first + i]];
+  }
+
+  // First pass, left to right, setting parent pointers.
+  a[0] += a[1];
+  int root = 0;
+  int leaf = 2;
+  for (int next = 1; next < n - 1; next++) {
+    // select first item for a pairing
+    if (leaf >= n || a[root] < a[leaf]) {
+      a[next] = a[root];
+      a[root++] = next;
+    } else {
+      a[next] = a[leaf++];
+    }
+
+    // add on the second item
+    if (leaf >= n || (root < next && a[root] < a[leaf])) {
+      a[next] += a[root];
+      a[root++] = next;
+    } else {
+      a[next] += a[leaf++];
+    }
+  }
+
+  // Second pass, right to left, setting internal depths.
+  a[n - 2] = 0;
+  for (int next = n - 3; next >= 0; next--) {
+    a[next] = a[a[next]] + 1;
+  }
+
+  // Third pass, right to left, setting leaf depths.
+  int avbl = 1;
+  int used_nodes = 0;
+  unsigned int depth = 0;
+  root = n - 2;
+  int next = n - 1;
+  while (avbl > 0) {
+    while (root >= 0 && a[root] == depth) {
+      used_nodes++;
+      root--;
+    }
+    while (avbl > used_nodes) {
+      a[next--] = depth;
+      avbl--;
+    }
+    avbl = 2 * used_nodes;
+    depth++;
+    used_nodes = 0;
+  }
+
+  // Count the codes of each length, clamping the ones that are too long.
+  unsigned short bl_count[kMaxCodeLen + 1];
+  for (int b = 0; b <= kMaxCodeLen; b++) {
+    bl_count[b] = 0;
+  }
+  for (int i = 0; i < n; i++) {
+    bl_count[a[i] > kMaxCodeLen ? kMaxCodeLen : a[i]]++;
+  }
+
+  // The Kraft sum, in units of 2^-kMaxCodeLen. A complete code sums to 1.
+  constexpr unsigned int kKraftOne = 1u << kMaxCodeLen;
+  unsigned int kraft = 0;
+  for (int b = 1; b <= kMaxCodeLen; b++) {
+    kraft += (unsigned int)bl_count[b] << (kMaxCodeLen - b);
+  }
+
+  // Clamping over-subscribes the code space. Push the longest codes that are
+  // below the limit one level down until everything fits.
+  while (kraft > kKraftOne) {
+    int b = kMaxCodeLen - 1;
+    while (bl_count[b] == 0) b--;
+    bl_count[b]--;
+    bl_count[b + 1]++;
+    kraft -= 1u << (kMaxCodeLen - b - 1);
+  }
+
+  // That may overshoot and leave the code incomplete. Pull the longest codes
+  // back up until the code space is exactly used.
+  while (kraft < kKraftOne) {
+    int b = kMaxCodeLen;
+    while (bl_count[b] == 0) b--;
+    bl_count[b]--;
+    bl_count[b - 1]++;
+    kraft += 1u << (kMaxCodeLen - b);
+  }
+
+  // Hand out the lengths, longest first, starting with the least frequent
+  // symbol.
+  for (int s = 0; s < kNumSymbols; s++) {
+    code_len[s] = 0;
+  }
+  int bits = kMaxCodeLen;
+  unsigned short remaining = bl_count[kMaxCodeLen];
+  for (int i = 0; i < n; i++) {
+    while (remaining == 0) {
+      bits--;
+      remaining = bl_count[bits];
+    }
+    code_len[sorted[first + i]] = bits;
+    remaining--;
+  }
+}
+
+// Assigns canonical Huffman codes (RFC 1951, section 3.2.2) to the given code
+// lengths. Deflate sends Huffman codes starting with their most significant
+// bit, while the bit packer fills the output starting with the least
+// significant bit, so the codes are returned bit reversed, like the codes in
+// the static trees.
+template <int kNumSymbols, int kMaxCodeLen>
+void BuildCanonicalCodes(const unsigned char code_len[kNumSymbols],
+                         unsigned short code[kNumSymbols]) {
+  unsigned short bl_count[kMaxCodeLen + 1];
+  for (int b = 0; b <= kMaxCodeLen; b++) {
+    bl_count[b] = 0;
+  }
+  for (int s = 0; s < kNumSymbols; s++) {
+    bl_count[code_len[s]]++;
+  }
+  bl_count[0] = 0;
+
+  unsigned short next_code[kMaxCodeLen + 1];
+  unsigned short c = 0;
+  next_code[0] = 0;
+  for (int b = 1; b <= kMaxCodeLen; b++) {
+    c = (c + bl_count[b - 1]) << 1;
+    next_code[b] = c;
+  }
+
+  for (int s = 0; s < kNumSymbols; s++) {
+    unsigned char len = code_len[s];
+    unsigned short value = next_code[len];
+    next_code[len] = value + 1;
+
+    unsigned short reversed = 0;
+#pragma unroll
+    for (int b = 0; b < kMaxCodeLen; b++) {
+      if (b < len) {
+        reversed |= ((value >> b) & 1) << (len - 1 - b);
+      }
+    }
+    code[s] = len ? reversed : 0;
+  }
+}
+
+// Assembles kVec codes of arbitrary length (up to 64 bits, including the
+// shift into the current 32-bit word) into the output. This is the
+// counterpart of HufEnc() for the dynamic encoder, where a match (length code,
+// length extra bits, distance code and distance extra bits) can be up to
+// 15 + 5 + 15 + 13 = 48 bits long and so may span three output words instead
+// of two.
+//
+// Returns true when kVec full words of output are ready in outdata.
+inline bool PackBits(const unsigned long long code[kVec],
+                     const unsigned char code_len[kVec], unsigned int *outdata,
+                     unsigned int *leftover, unsigned short *leftover_size) {
+  // array that contains the bit position of each code
+  unsigned short bitpos[kVec + 1];
+  bitpos[0] = *leftover_size;
+#pragma unroll
+  for (int i = 0; i < kVec; i++) {
+    bitpos[i + 1] = bitpos[i] + code_len[i];
+  }
+
+  // we'll write this cycle if we have collected enough data (kVec words or
+  // more). At most a vector of 6 matches (288 bits) is added to less than
+  // kVec words of leftover data, so there is no second overflow.
+  unsigned short total = bitpos[kVec];
+  bool write = total & (kVec * (kMaxHuffcodeBits * 2));
+  *leftover_size = total & ~(kVec * (kMaxHuffcodeBits * 2));
+
+  // Iterate over all destination words and gather the pieces of the codes
+  // that land in them. Words past kVec carry over into the next cycle.
+  unsigned int new_leftover[kVec];
+#pragma unroll
+  for (int i = 0; i < kVec; i++) {
+    outdata[i] = 0;
+    new_leftover[i] = 0;
+  }
+
+#pragma unroll
+  for (int j = 0; j < kVec; j++) {
+    unsigned char word = bitpos[j] >> 5;
+    unsigned char shift = bitpos[j] & 0x1F;
+    unsigned long long lo = code[j] << shift;
+    unsigned long long hi = shift ? code[j] >> (64 - shift) : 0;
+    unsigned int part[3] = {(unsigned int)lo, (unsigned int)(lo >> 32),
+                            (unsigned int)hi};
+
+#pragma unroll
+    for (int i = 0; i < kVec; i++) {
+#pragma unroll
+      for (int p = 0; p < 3; p++) {
+        outdata[i] |= (word + p == i) ? part[p] : 0;
+        new_leftover[i] |= (word + p == i + kVec) ? part[p] : 0;
+      }
+    }
+  }
+
+  // Apply previous leftover on the outdata
+  // Also, if didn't write, apply prev leftover onto newleftover
+#pragma unroll
+  for (int i = 0; i < kVec; i++) {
+    outdata[i] |= leftover[i];
+    leftover[i] = write ? new_leftover[i] : outdata[i];
+  }
+
+  return write;
+}
+
+// The dynamic Huffman encoder. Reads the isz / kVec DistLen vectors produced
+// by the LZ reduction kernel from InPipe, followed by the last (partial)
+// vector from InLastPipe, and writes the deflate stream to out. Returns the
+// number of compressed bytes.
+template <typename InPipe, typename InLastPipe, typename OutPtr>
+size_t DynamicHuffmanEncode(size_t isz, bool eof, OutPtr out) {
+  const int num_vecs = isz / kVec + 1;
+  const int num_blocks = (num_vecs + kDynamicBlockVecs - 1) / kDynamicBlockVecs;
+
+  // order in which the bit length code lengths are sent
+  const unsigned char bl_order[kBLCodes] = {16, 17, 18, 0, 8,  7, 9,  6, 10, 5,
+                                            11, 4,  12, 3, 13, 2, 14, 1, 15};
+
+  // the block being encoded
+  DistLen block_buf[kDynamicBlockVecs];
+
+  unsigned int leftover[kVec];
+#pragma unroll
+  for (int i = 0; i < kVec; i++) {
+    leftover[i] = 0;
+  }
+  unsigned short leftover_size = 0;
+  unsigned int outpos_huffman = 0;
+  size_t odx = 0;
+  int vec_idx = 0;
+
+  // Depth of the forwarding caches that hide the read-modify-write latency of
+  // the histogram memories.
+  constexpr int kHistCacheDepth = 4;
+
+  [[intel::disable_loop_pipelining]]  // NO-FORMAT: Attribute
+  for (int blk = 0; blk < num_blocks; blk++) {
+    const bool last_blk = blk == num_blocks - 1;
+    const int block_vecs =
+        last_blk ? num_vecs - blk * kDynamicBlockVecs : kDynamicBlockVecs;
+
+    //-----------------------------
+    // Pass 1: buffer the block and gather the histograms
+    //-----------------------------
+
+    // One histogram per lane, so that each memory is only updated once per
+    // cycle. The extra entry absorbs the lanes that carry no symbol.
+    unsigned int lit_hist[kVec][kLCodes + 1];
+    unsigned int dist_hist[kVec][kDCodes + 1];
+    for (int s = 0; s < kLCodes + 1; s++) {
+#pragma unroll
+      for (int l = 0; l < kVec; l++) {
+        lit_hist[l][s] = 0;
+        if (s < kDCodes + 1) dist_hist[l][s] = 0;
+      }
+    }
+
+    short lit_cache_sym[kVec][kHistCacheDepth];
+    unsigned int lit_cache_val[kVec][kHistCacheDepth];
+    short dist_cache_sym[kVec][kHistCacheDepth];
+    unsigned int dist_cache_val[kVec][kHistCacheDepth];
+#pragma unroll
+    for (int l = 0; l < kVec; l++) {
+#pragma unroll
+      for (int c = 0; c < kHistCacheDepth; c++) {
+        lit_cache_sym[l][c] = -1;
+        dist_cache_sym[l][c] = -1;
+      }
+    }
+
+    [[intel::ivdep(lit_hist, kHistCacheDepth)]]   // NO-FORMAT: Attribute
+    [[intel::ivdep(dist_hist, kHistCacheDepth)]]  // NO-FORMAT: Attribute
+    for (int v = 0; v < block_vecs; v++) {
+      struct DistLen in =
+          vec_idx < num_vecs - 1 ? InPipe::read() : InLastPipe::read();
+      vec_idx++;
+      block_buf[v] = in;
+
+#pragma unroll
+      for (int l = 0; l < kVec; l++) {
+        int len = in.len[l];
+        int lsym, dsym;
+        unsigned int extra;
+        int extra_bits;
+        GetLengthSymbol(len < kMinMatch ? kMinMatch : len, lsym, extra,
+                        extra_bits);
+        GetDistSymbol(in.dist[l] < 1 ? 1 : in.dist[l], dsym, extra,
+                      extra_bits);
+
+        short lit_sym = len == 0 ? in.data[l]
+                                 : (len >= kMinMatch ? kLiterals + 1 + lsym
+                                                     : kLCodes);
+        short dist_sym = len >= kMinMatch ? dsym : kDCodes;
+
+        // read, checking the cache for in-flight updates (newest last)
+        unsigned int lit_count = lit_hist[l][lit_sym];
+        unsigned int dist_count = dist_hist[l][dist_sym];
+#pragma unroll
+        for (int c = 0; c < kHistCacheDepth; c++) {
+          if (lit_cache_sym[l][c] == lit_sym) lit_count = lit_cache_val[l][c];
+          if (dist_cache_sym[l][c] == dist_sym) {
+            dist_count = dist_cache_val[l][c];
+          }
+        }
+        lit_count++;
+        dist_count++;
+        lit_hist[l][lit_sym] = lit_count;
+        dist_hist[l][dist_sym] = dist_count;
+
+        // shift the caches
+#pragma unroll
+        for (int c = 0; c < kHistCacheDepth - 1; c++) {
+          lit_cache_sym[l][c] = lit_cache_sym[l][c + 1];
+          lit_cache_val[l][c] = lit_cache_val[l][c + 1];
+          dist_cache_sym[l][c] = dist_cache_sym[l][c + 1];
+          dist_cache_val[l][c] = dist_cache_val[l][c + 1];
+        }
+        lit_cache_sym[l][kHistCacheDepth - 1] = lit_sym;
+        lit_cache_val[l][kHistCacheDepth - 1] = lit_count;
+        dist_cache_sym[l][kHistCacheDepth - 1] = dist_sym;
+        dist_cache_val[l][kHistCacheDepth - 1] = dist_count;
+      }
+    }
+
+    // merge the per-lane histograms
+    unsigned int lit_freq[kLCodes];
+    unsigned int dist_freq[kDCodes];
+    for (int s = 0; s < kLCodes; s++) {
+      unsigned int lit_sum = 0;
+      unsigned int dist_sum = 0;
+#pragma unroll
+      for (int l = 0; l < kVec; l++) {
+        lit_sum += lit_hist[l][s];
+        if (s < kDCodes) dist_sum += dist_hist[l][s];
+      }
+      lit_freq[s] = lit_sum;
+      if (s < kDCodes) dist_freq[s] = dist_sum;
+    }
+    lit_freq[kEndBlock] = 1;
+
+    //-----------------------------
+    // Build the code tables
+    //-----------------------------
+
+    unsigned char lit_len[kLCodes];
+    unsigned char dist_len[kDCodes];
+    BuildCodeLengths<kLCodes, kMaxBits>(lit_freq, lit_len);
+    BuildCodeLengths<kDCodes, kMaxBits>(dist_freq, dist_len);
+
+    int hlit = kLiterals + 1;
+    for (int s = kLiterals + 1; s < kLCodes; s++) {
+      if (lit_len[s]) hlit = s + 1;
+    }
+    int hdist = 1;
+    for (int s = 1; s < kDCodes; s++) {
+      if (dist_len[s]) hdist = s + 1;
+    }
+
+    // Run-length code the literal/length and distance code lengths, which are
+    // sent as a single sequence. A run is flushed as up to three items.
+    unsigned char rle_sym[kLCodes + kDCodes];
+    unsigned char rle_extra[kLCodes + kDCodes];
+    int num_rle = 0;
+    const int num_lens = hlit + hdist;
+    unsigned char run_val = lit_len[0];
+    int run_len = 1;
+    for (int p = 1; p <= num_lens; p++) {
+      bool end = p == num_lens;
+      unsigned char val =
+          end ? 0 : (p < hlit ? lit_len[p] : dist_len[p - hlit]);
+      int max_run = run_val == 0 ? 138 : 7;
+
+      if (!end && val == run_val && run_len < max_run) {
+        run_len++;
+      } else {
+        unsigned char sym[3];
+        unsigned char extra[3] = {0, 0, 0};
+        int count;
+        if (run_val == 0 && run_len >= 11) {
+          sym[0] = kRepeatZero11;
+          extra[0] = run_len - 11;
+          count = 1;
+        } else if (run_val == 0 && run_len >= 3) {
+          sym[0] = kRepeatZero3;
+          extra[0] = run_len - 3;
+          count = 1;
+        } else if (run_val != 0 && run_len >= 4) {
+          sym[0] = run_val;
+          sym[1] = kRepeatPrevious;
+          extra[1] = run_len - 4;
+          count = 2;
+        } else {
+          sym[0] = sym[1] = sym[2] = run_val;
+          count = run_len;
+        }
+#pragma unroll
+        for (int k = 0; k < 3; k++) {
+          if (k < count) {
+            rle_sym[num_rle + k] = sym[k];
+            rle_extra[num_rle + k] = extra[k];
+          }
+        }
+        num_rle += count;
+        run_val = val;
+        run_len = 1;
+      }
+    }
+
+    unsigned int bl_freq[kBLCodes];
+    for (int s = 0; s < kBLCodes; s++) {
+      bl_freq[s] = 0;
+    }
+    for (int i = 0; i < num_rle; i++) {
+      bl_freq[rle_sym[i]]++;
+    }
+
+    unsigned char bl_len[kBLCodes];
+    unsigned short bl_code[kBLCodes];
+    BuildCodeLengths<kBLCodes, kMaxBLBits>(bl_freq, bl_len);
+    BuildCanonicalCodes<kBLCodes, kMaxBLBits>(bl_len, bl_code);
+
+    int hclen = 4;
+    for (int i = 4; i < kBLCodes; i++) {
+      if (bl_len[bl_order[i]]) hclen = i + 1;
+    }
+
+    // Compare the size of the block with the dynamic trees against the size
+    // with the static trees. The extra bits are the same either way.
+    unsigned int dynamic_bits = 14 + 3 * hclen;
+    unsigned int static_bits = 0;
+    for (int i = 0; i < num_rle; i++) {
+      unsigned char s = rle_sym[i];
+      dynamic_bits += bl_len[s] + (s == kRepeatPrevious
+                                       ? 2
+                                       : (s == kRepeatZero3
+                                              ? 3
+                                              : (s == kRepeatZero11 ? 7 : 0)));
+    }
+    for (int s = 0; s < kLCodes; s++) {
+      dynamic_bits += lit_freq[s] * lit_len[s];
+      static_bits += lit_freq[s] * GetStaticLitLen(s);
+      if (s < kDCodes) {
+        dynamic_bits += dist_freq[s] * dist_len[s];
+        static_bits += dist_freq[s] * kStaticDistLen;
+      }
+    }
+    const bool use_static = static_bits <= dynamic_bits;
+
+    if (use_static) {
+      for (int s = 0; s < kLCodes; s++) {
+        lit_len[s] = GetStaticLitLen(s);
+        if (s < kDCodes) dist_len[s] = kStaticDistLen;
+      }
+    }
+
+    unsigned short lit_code[kLCodes];
+    unsigned short dist_code[kDCodes];
+    BuildCanonicalCodes<kLCodes, kMaxBits>(lit_len, lit_code);
+    BuildCanonicalCodes<kDCodes, kMaxBits>(dist_len, dist_code);
+
+    // Assemble the block header as a list of items, which the encoding loop
+    // below sends kVec at a time, ahead of the block data.
+    unsigned int hdr_code[kMaxHeaderItems];
+    unsigned char hdr_len[kMaxHeaderItems];
+    const unsigned int bfinal = (eof && last_blk) ? 1 : 0;
+    if (use_static) {
+      hdr_code[0] = bfinal | (kStaticTrees << 1);
+      hdr_len[0] = 3;
+    } else {
+      hdr_code[0] = bfinal | (kDynamicTrees << 1) | ((hlit - 257) << 3) |
+                    ((hdist - 1) << 8) | ((hclen - 4) << 13);
+      hdr_len[0] = 17;
+    }
+    int num_hdr = 1;
+    if (!use_static) {
+      for (int i = 0; i < hclen; i++) {
+        hdr_code[1 + i] = bl_len[bl_order[i]];
+        hdr_len[1 + i] = 3;
+      }
+      for (int i = 0; i < num_rle; i++) {
+        unsigned char s = rle_sym[i];
+        unsigned char extra_bits =
+            s == kRepeatPrevious
+                ? 2
+                : (s == kRepeatZero3 ? 3 : (s == kRepeatZero11 ? 7 : 0));
+        hdr_code[1 + hclen + i] =
+            bl_code[s] | ((unsigned int)rle_extra[i] << bl_len[s]);
+        hdr_len[1 + hclen + i] = bl_len[s] + extra_bits;
+      }
+      num_hdr += hclen + num_rle;
+    }
+
+    //-----------------------------
+    // Pass 2: send the header, the block data and the end of block code
+    //-----------------------------
+
+    const int hdr_cycles = (num_hdr + kVec - 1) / kVec;
+    const int data_end = hdr_cycles + block_vecs;
+
+    // the last block gets one more iteration to flush the leftover bits
+    const int total_cycles = data_end + (last_blk ? 2 : 1);
+
+    for (int c = 0; c < total_cycles; c++) {
+      const bool in_hdr = c < hdr_cycles;
+      const bool in_data = !in_hdr && c < data_end;
+      const bool in_eob = c == data_end;
+      const bool flush = c == data_end + 1;
+
+      struct DistLen in = block_buf[in_data ? c - hdr_cycles : 0];
+
+      unsigned long long code[kVec];
+      unsigned char code_len[kVec];
+#pragma unroll
+      for (int i = 0; i < kVec; i++) {
+        int h = c * kVec + i;
+        int len = in.len[i];
+
+        int lsym, dsym;
+        unsigned int lextra, dextra;
+        int lextra_bits, dextra_bits;
+        GetLengthSymbol(len < kMinMatch ? kMinMatch : len, lsym, lextra,
+                        lextra_bits);
+        GetDistSymbol(in.dist[i] < 1 ? 1 : in.dist[i], dsym, dextra,
+                      dextra_bits);
+
+        int sym = len == 0 ? in.data[i] : kLiterals + 1 + lsym;
+        unsigned long long sym_code = lit_code[sym];
+        unsigned char sym_len = lit_len[sym];
+        unsigned long long match_code =
+            sym_code | ((unsigned long long)lextra << sym_len) |
+            ((unsigned long long)dist_code[dsym] << (sym_len + lextra_bits)) |
+            ((unsigned long long)dextra
+             << (sym_len + lextra_bits + dist_len[dsym]));
+        unsigned char match_len =
+            sym_len + lextra_bits + dist_len[dsym] + dextra_bits;
+
+        if (in_hdr) {
+          code[i] = h < num_hdr ? hdr_code[h] : 0;
+          code_len[i] = h < num_hdr ? hdr_len[h] : 0;
+        } else if (in_data && len == 0) {
+          code[i] = sym_code;
+          code_len[i] = sym_len;
+        } else if (in_data && len >= kMinMatch) {
+          code[i] = match_code;
+          code_len[i] = match_len;
+        } else if (in_eob && i == 0) {
+          code[i] = lit_code[kEndBlock];
+          code_len[i] = lit_len[kEndBlock];
+        } else if (in_eob && i == 1 && last_blk && !eof) {
+          // More blocks follow in a separate invocation, start an empty
+          // stored block (BFINAL=0, BTYPE=00), see the Static Huffman kernel.
+          code[i] = 0;
+          code_len[i] = 3;
+        } else {
+          code[i] = 0;
+          code_len[i] = 0;
+        }
+      }
+
+      struct HuffmanOutput outdata;
+      outdata.write =
+          PackBits(code, code_len, outdata.data, leftover, &leftover_size);
+
+      // prevent out of bounds write
+      if ((flush || outdata.write) && (odx < isz)) {
+#pragma unroll
+        for (int i = 0; i < kVec * (int)sizeof(unsigned int); i++) {
+          out[odx + i] =
+              flush ? (unsigned char)(leftover[(i >> 2) & 0xf] >>
+                                      ((i & 3) << 3))
+                    : (unsigned char)(outdata.data[(i >> 2) & 0xf] >>
+                                      ((i & 3) << 3));
+        }
+      }
+
+      outpos_huffman = outdata.write ? outpos_huffman + 1 : outpos_huffman;
+      odx += outdata.write ? (sizeof(unsigned int) << kVecPow) : 0;
+    }
+  }
+
+  return (outpos_huffman * sizeof(unsigned int) * kVec) +
+         (leftover_size + 7) / 8;
+}
+
+#endif  //__DYNAMIC_HUFFMAN_H__
@@ -1,8 +1,10 @@
 #include <sycl/sycl.hpp>
 #include <sycl/ext/intel/fpga_extensions.hpp>
 #include <chrono>
+#include <algorithm>
 #include <fstream>
 #include <string>
+#include <vector>
 
 #include "CompareGzip.hpp"
 #include "WriteGzip.hpp"
@@ -19,10 +21,21 @@ using namespace sycl;
 // Any filesize less than this results in an error.
 constexpr int minimum_filesize = kVec + 1;
 
+// Bytes the host appends after every non-final block. The kernel ends such a
+// block with the 3-bit header of an empty stored block and pads it to a byte
+// boundary; these are the LEN and NLEN fields of that stored block (i.e. a
+// deflate sync flush).
+constexpr unsigned char kSyncFlushMarker[4] = {0x00, 0x00, 0xFF, 0xFF};
+
 bool help = false;
 
 int CompressFile(queue &q, std::string &input_file, std::vector<std::string> outfilenames,
-                 int iterations, bool report);
+                 int iterations, bool report, bool parallel);
+
+int CompressFileStreaming(queue &q, std::string &input_file,
+                          std::string &outfilename, size_t block_size);
+
+int Crc32Benchmark(std::string &input_file);
 
 void Help(void) {
   // Command line arguments.
@@ -37,6 +50,15 @@ void Help(void) {
   std::cout << "  -h,--help                                : this help text\n";
   std::cout
       << "  -o=<filename>,--output-file=<filename>   : specify output file\n";
+  std::cout
+      << "  -s=<KB>,--stream=<KB>                    : compress the file in "
+         "blocks of <KB> kilobytes\n";
+  std::cout
+      << "  -p,--parallel                            : split the file across "
+         "all engines\n";
+  std::cout
+      << "  --crc-benchmark                          : time the host CRC32 "
+         "routines on the file\n";
 }
 
 bool FindGetArg(std::string &arg, const char *str, int defaultval, int *val) {
@@ -90,10 +112,21 @@ int main(int argc, char *argv[]) {
 
   char str_buffer[kMaxStringLen] = {0};
 
+  // Block size, in KB, of the streaming mode. 0 compresses the whole file in
+  // one block.
+  int stream_block_kb = 0;
+
+  // If set, the file is split into one segment per engine instead of being
+  // fed to every engine.
+  bool parallel = false;
+
+  // If set, only the host CRC32 routines are timed, the FPGA is not used.
+  bool crc_benchmark = false;
+
   // Check the number of arguments specified
-  if (argc != 3) {
+  if (argc < 3 || argc > 4) {
     std::cerr << "Incorrect number of arguments. Correct usage: " << argv[0]
-              << " <input-file> -o=<output-file>\n";
+              << " <input-file> -o=<output-file> [-s=<block-size-KB> | -p]\n";
     return 1;
   }
 
@@ -106,9 +139,18 @@ int main(int argc, char *argv[]) {
       if (std::string(argv[i]) == "--help") {
         help = true;
       }
+      if (std::string(argv[i]) == "-p" ||
+          std::string(argv[i]) == "--parallel") {
+        parallel = true;
+      }
+      if (std::string(argv[i]) == "--crc-benchmark") {
+        crc_benchmark = true;
+      }
 
       FindGetArgString(sarg, "-o=", str_buffer, kMaxStringLen);
       FindGetArgString(sarg, "--output-file=", str_buffer, kMaxStringLen);
+      FindGetArg(sarg, "-s=", 0, &stream_block_kb);
+      FindGetArg(sarg, "--stream=", 0, &stream_block_kb);
     } else {
       infilename = std::string(argv[i]);
     }
@@ -119,6 +161,10 @@ int main(int argc, char *argv[]) {
     return 1;
   }
 
+  if (crc_benchmark) {
+    return Crc32Benchmark(infilename);
+  }
+
   try {
 
 #if FPGA_SIMULATOR
@@ -144,6 +190,18 @@ int main(int argc, char *argv[]) {
       return 1;
     }
 
+    if (parallel && stream_block_kb > 0) {
+      std::cout << "The streaming and parallel modes cannot be combined\n\n";
+      Help();
+      return 1;
+    }
+
+    if (stream_block_kb < 0) {
+      std::cout << "Streaming block size must be a positive number of KB\n\n";
+      Help();
+      return 1;
+    }
+
     // next, check valid and acceptable parameter ranges.
     // if output filename not set, use the default
     // name, else use the name specified by the user
@@ -156,21 +214,41 @@ int main(int argc, char *argv[]) {
       outfilenames[i] = outfilenames[0] + std::to_string(i+1);
     }
 
+    if (stream_block_kb > 0) {
+      // Streaming mode, the file is read, compressed and written one block
+      // at a time on engine 0, so it may be larger than the device memory.
+      std::cout << "Launching High-Bandwidth DMA GZIP application in "
+                   "streaming mode with "
+                << stream_block_kb << " KB blocks\n";
+      if (CompressFileStreaming(q, infilename, outfilenames[0],
+                                (size_t)stream_block_kb * 1024)) {
+        return 1;
+      }
+      return 0;
+    }
+
     std::cout << "Launching High-Bandwidth DMA GZIP application with " << kNumEngines
               << " engines\n";
+    if (parallel) {
+      std::cout << "Splitting the input file across the engines\n";
+    }
 
 #ifdef FPGA_EMULATOR
-    CompressFile(q, infilename, outfilenames, 1, true);
+    CompressFile(q, infilename, outfilenames, 1, true,
+                 parallel);
 #elif FPGA_SIMULATOR
-    CompressFile(q, infilename, outfilenames, 2, true);
+    CompressFile(q, infilename, outfilenames, 2, true,
+                 parallel);
 #else
     // warmup run - use this run to warmup accelerator. There are some steps in
     // the runtime that are only executed on the first kernel invocation but not
     // on subsequent invocations. So execute all that stuff here before we
     // measure performance (in the next call to CompressFile().
-    CompressFile(q, infilename, outfilenames, 1, false);
+    CompressFile(q, infilename, outfilenames, 1, false,
+                 parallel);
     // profile performance
-    CompressFile(q, infilename, outfilenames, 200, true);
+    CompressFile(q, infilename, outfilenames, 200, true,
+                 parallel);
 #endif
   } catch (sycl::exception const &e) {
     // Catches exceptions in the host code
@@ -210,7 +288,7 @@ struct KernelInfo {
 
 // returns 0 on success, otherwise a non-zero failure code.
 int CompressFile(queue &q, std::string &input_file, std::vector<std::string> outfilenames,
-                 int iterations, bool report) {
+                 int iterations, bool report, bool parallel) {
   size_t isz;
   char *pinbuf;
 
@@ -257,6 +335,19 @@ int CompressFile(queue &q, std::string &input_file, std::vector<std::string> out
     return 1;
   }
 
+  // In parallel mode, each engine compresses its own segment of the file. The
+  // segments are a multiple of 32 bytes, except the last one, which also
+  // holds the remainder.
+  size_t segment_size = isz;
+  if (parallel && kNumEngines > 1) {
+    segment_size = (isz / kNumEngines) & ~(size_t)31;
+    if (segment_size < minimum_filesize) {
+      std::cout << "Minimum filesize for parallel compression is "
+                << kNumEngines * 32 * ((minimum_filesize + 31) / 32) << "\n";
+      return 1;
+    }
+  }
+
   int buffers_count = iterations;
 
   // Create an array of kernel info structures and create buffers for kernel
@@ -271,13 +362,19 @@ int CompressFile(queue &q, std::string &input_file, std::vector<std::string> out
       return 1;
     }
     for (int i = 0; i < buffers_count; i++) {
-      kinfo[eng][i].file_size = isz;
+      // Without the parallel mode, every engine gets the whole file.
+      bool last_segment = !parallel || eng == kNumEngines - 1;
+      size_t segment_offset = parallel ? eng * segment_size : 0;
+      size_t file_size =
+          last_segment ? isz - segment_offset : segment_size;
+      kinfo[eng][i].file_size = file_size;
       // Allocating slightly larger buffers (+ 16 * kVec) to account for
       // granularity of kernel writes
       int outputSize =
-          ((isz + kInOutPadding) < kMinBufferSize) ? kMinBufferSize
-                                                   : (isz + kInOutPadding);
-      const size_t input_alloc_size = isz + kInOutPadding;
+          ((file_size + kInOutPadding) < kMinBufferSize)
+              ? kMinBufferSize
+              : (file_size + kInOutPadding);
+      const size_t input_alloc_size = file_size + kInOutPadding;
 
       // Pre-pin buffer using malloc_host() to improve DMA bandwidth.
       if (i >= 3) {
@@ -303,9 +400,11 @@ int CompressFile(queue &q, std::string &input_file, std::vector<std::string> out
         memset(kinfo[eng][i].poutput_buffer, 0, outputSize);
       }
 
-      kinfo[eng][i].last_block = true;
+      // In parallel mode, only the last segment is marked BFINAL. The other
+      // segments end with an empty stored block so that they can be joined.
+      kinfo[eng][i].last_block = last_segment;
       kinfo[eng][i].iteration = i;
-      kinfo[eng][i].pref_buffer = pinbuf;
+      kinfo[eng][i].pref_buffer = pinbuf + segment_offset;
 
       kinfo[eng][i].gzip_out_buf =
           i >= 3 ? kinfo[eng][i - 3].gzip_out_buf
@@ -368,7 +467,7 @@ int CompressFile(queue &q, std::string &input_file, std::vector<std::string> out
       /************************************/
       SubmitGzipTasks(q, kinfo[eng][i].file_size, kinfo[eng][i].pibuf,
                       kinfo[eng][i].pobuf, kinfo[eng][i].gzip_out_buf,
-                      kinfo[eng][i].current_crc, kinfo[eng][i].last_block,
+                      kinfo[eng][i].current_crc, true, kinfo[eng][i].last_block,
                       e_k_crc[eng], e_k_lz[eng], e_k_huff[eng], eng, i);
 
       // Transfer the output (compressed) data from device to host.
@@ -444,8 +543,50 @@ int CompressFile(queue &q, std::string &input_file, std::vector<std::string> out
     delete pinbuf;
   }
 
+  // In parallel mode, join the segments from the first iteration into a
+  // single gzip member. The CRCs of the segments are combined on the host.
+  if (parallel) {
+    uint32_t crc = kinfo[0][0].buffer_crc[0];
+    for (int eng = 1; eng < kNumEngines; eng++) {
+      crc = Crc32Combine(crc, kinfo[eng][0].buffer_crc[0],
+                         kinfo[eng][0].file_size);
+    }
+
+    FILE *fo = report ? fopen(outfilenames[0].c_str(), "wb") : NULL;
+    if (report && fo == NULL) {
+      std::cout << "Cannot open file for output: " << outfilenames[0] << "\n";
+      std::cout << "FAILED\n";
+      return 1;
+    }
+    bool write_error = report && WriteGzipHeader(fo, input_file);
+    for (int eng = 0; report && !write_error && eng < kNumEngines; eng++) {
+      fwrite(kinfo[eng][0].poutput_buffer, 1,
+             kinfo[eng][0].out_info[0].compression_sz, fo);
+      if (!kinfo[eng][0].last_block) {
+        fwrite(kSyncFlushMarker, 1, sizeof(kSyncFlushMarker), fo);
+      }
+    }
+    if (report && !write_error) {
+      write_error = WriteGzipTrailer(fo, isz, crc);
+    }
+    if (fo != NULL && fclose(fo)) {
+      perror("close");
+      write_error = true;
+    }
+    if (write_error) {
+      std::cout << "FAILED\n";
+      return 1;
+    }
+
+    // Report the ratio of the joined output
+    compressed_sz[0] += (kNumEngines - 1) * sizeof(kSyncFlushMarker) * iterations;
+    for (int eng = 1; eng < kNumEngines; eng++) {
+      compressed_sz[0] += compressed_sz[eng];
+    }
+  }
+
   // Write the output compressed data from the first iteration of each engine, to a file.
-  for (int eng = 0; eng < kNumEngines; eng++) {
+  for (int eng = 0; eng < kNumEngines && !parallel; eng++) {
     // WriteBlockGzip() returns 1 on failure
     if (report && WriteBlockGzip(input_file, outfilenames[eng], kinfo[eng][0].poutput_buffer,
                         kinfo[eng][0].out_info[0].compression_sz,
@@ -493,19 +634,22 @@ int CompressFile(queue &q, std::string &input_file, std::vector<std::string> out
 #ifdef FPGA_EMULATOR
 #elif FPGA_SIMULATOR
 #else
-    std::cout << "Throughput: " << kNumEngines * gbps << " GB/s\n\n";
+    // Without the parallel mode, every engine compresses the whole file.
+    std::cout << "Throughput: " << (parallel ? 1 : kNumEngines) * gbps
+              << " GB/s\n\n";
     for (int eng = 0; eng < kNumEngines; eng++) {
+      // In parallel mode, each engine only compresses its segment.
       std::cout << "TP breakdown for engine #" << eng << " (GB/s)\n";
-      std::cout << "CRC = " << iterations * isz / (double)time_k_crc[eng]
+      std::cout << "CRC = " << iterations * kinfo[eng][0].file_size / (double)time_k_crc[eng]
                 << "\n";
-      std::cout << "LZ77 = " << iterations * isz / (double)time_k_lz[eng]
+      std::cout << "LZ77 = " << iterations * kinfo[eng][0].file_size / (double)time_k_lz[eng]
                 << "\n";
       std::cout << "Huffman Encoding = "
-                << iterations * isz / (double)time_k_huff[eng] << "\n";
+                << iterations * kinfo[eng][0].file_size / (double)time_k_huff[eng] << "\n";
       std::cout << "DMA host-to-device = "
-                << iterations * isz / (double)time_input_dma[eng] << "\n";
+                << iterations * kinfo[eng][0].file_size / (double)time_input_dma[eng] << "\n";
       std::cout << "DMA device-to-host = "
-                << iterations * isz / (double)time_output_dma[eng] << "\n\n";
+                << iterations * kinfo[eng][0].file_size / (double)time_output_dma[eng] << "\n\n";
     }
 #endif
     std::cout << "Compression Ratio " << compression_ratio * 100 << "%\n";
@@ -532,3 +676,327 @@ int CompressFile(queue &q, std::string &input_file, std::vector<std::string> out
   if (report) std::cout << "PASSED\n";
   return 0;
 }
+
+// Number of blocks in flight in the streaming mode. While one block is being
+// compressed on the FPGA, the next one is read from the input file and the
+// previous one is written to the output file.
+constexpr int kStreamSlots = 3;
+
+struct StreamSlot {
+  buffer<struct GzipOutInfo, 1> *gzip_out_buf;
+  buffer<char, 1> *pobuf;
+  buffer<char, 1> *pibuf;
+
+  char *pinput_buffer;
+  char *poutput_buffer;
+  size_t block_size;
+  struct GzipOutInfo out_info[1];
+};
+
+// Compresses input_file into a single gzip member, block_size bytes at a time.
+// Only kStreamSlots blocks are resident in host and device memory at any time,
+// so the file may be larger than the device memory. The blocks are compressed
+// independently (the LZ77 dictionary is not carried across blocks), but the
+// CRC is carried from block to block by the CRC kernel.
+// returns 0 on success, otherwise a non-zero failure code.
+int CompressFileStreaming(queue &q, std::string &input_file,
+                          std::string &outfilename, size_t block_size) {
+#ifdef FPGA_SIMULATOR
+  bool prepin = false;
+#else
+  bool prepin = q.get_device().has(aspect::usm_host_allocations);
+#endif
+
+  // padding for the input and output buffers to deal with granularity of
+  // kernel reads and writes
+  constexpr size_t kInOutPadding = 16 * kVec;
+
+  // The CRC kernel only processes whole 32-byte sections, the remainder is
+  // added on the host. So all blocks but the last must be a multiple of 32
+  // bytes for the CRC to be carried on the FPGA.
+  if (block_size % 32 != 0) {
+    std::cout << "Streaming block size must be a multiple of 32 bytes\n";
+    return 1;
+  }
+
+  std::ifstream file(input_file, std::ios::in | std::ios::binary | std::ios::ate);
+  if (!file.is_open()) {
+    std::cout << "Error: cannot read specified input file\n";
+    return 1;
+  }
+  size_t isz = file.tellg();
+  file.seekg(0, std::ios::beg);
+
+  if (isz < minimum_filesize) {
+    std::cout << "Minimum filesize for compression is " << minimum_filesize
+              << "\n";
+    return 1;
+  }
+
+  // A trailing block smaller than the minimum file size is folded into the
+  // previous block, so the last block may be slightly larger than block_size.
+  size_t num_blocks = (isz + block_size - 1) / block_size;
+  if (num_blocks > 1 && isz - (num_blocks - 1) * block_size < minimum_filesize) {
+    num_blocks--;
+  }
+
+  const size_t input_alloc_size = block_size + minimum_filesize + kInOutPadding;
+  const size_t output_alloc_size = input_alloc_size;
+
+  FILE *fo = fopen(outfilename.c_str(), "wb");
+  if (fo == NULL) {
+    std::cout << "Cannot open file for output: " << outfilename << "\n";
+    return 1;
+  }
+  if (WriteGzipHeader(fo, input_file)) {
+    fclose(fo);
+    return 1;
+  }
+
+  StreamSlot slots[kStreamSlots];
+  for (int s = 0; s < kStreamSlots; s++) {
+    if (prepin) {
+      slots[s].pinput_buffer =
+          (char *)malloc_host(input_alloc_size, q.get_context());
+      slots[s].poutput_buffer =
+          (char *)malloc_host(output_alloc_size, q.get_context());
+    } else {
+      slots[s].pinput_buffer = (char *)malloc(input_alloc_size);
+      slots[s].poutput_buffer = (char *)malloc(output_alloc_size);
+    }
+    if (slots[s].pinput_buffer == NULL || slots[s].poutput_buffer == NULL) {
+      std::cout << "Cannot allocate streaming buffers.\n";
+      fclose(fo);
+      return 1;
+    }
+    // zero pages to fully allocate them
+    memset(slots[s].pinput_buffer, 0, input_alloc_size);
+    memset(slots[s].poutput_buffer, 0, output_alloc_size);
+
+    slots[s].gzip_out_buf = new buffer<struct GzipOutInfo, 1>(1);
+    slots[s].pibuf = new buffer<char, 1>(input_alloc_size);
+    slots[s].pobuf = new buffer<char, 1>(output_alloc_size);
+  }
+
+  // The CRC is carried across blocks in this buffer, so it is shared by all
+  // blocks. The runtime orders the CRC kernels through it.
+  buffer<unsigned, 1> current_crc(1);
+
+  std::vector<event> e_input_dma(num_blocks);
+  std::vector<event> e_output_dma(num_blocks);
+  std::vector<event> e_size_dma(num_blocks);
+  std::vector<event> e_k_crc(num_blocks);
+  std::vector<event> e_k_lz(num_blocks);
+  std::vector<event> e_k_huff(num_blocks);
+
+  size_t compressed_sz = 0;
+  bool write_error = false;
+
+  // Waits for block b to complete and appends its compressed data to the
+  // output file.
+  auto drain_block = [&](size_t b) {
+    StreamSlot &slot = slots[b % kStreamSlots];
+    e_output_dma[b].wait();
+    e_size_dma[b].wait();
+    size_t sz = slot.out_info[0].compression_sz;
+    if (sz > slot.block_size) {
+      std::cerr << "Unsupported: compressed block larger than input block( "
+                << sz << " )\n";
+      write_error = true;
+      return;
+    }
+    fwrite(slot.poutput_buffer, 1, sz, fo);
+    compressed_sz += sz;
+    if (b != num_blocks - 1) {
+      fwrite(kSyncFlushMarker, 1, sizeof(kSyncFlushMarker), fo);
+      compressed_sz += sizeof(kSyncFlushMarker);
+    }
+  };
+
+#ifdef FPGA_EMULATOR
+#elif FPGA_SIMULATOR
+#else
+  auto start = std::chrono::steady_clock::now();
+#endif
+
+  for (size_t b = 0; b < num_blocks && !write_error; b++) {
+    StreamSlot &slot = slots[b % kStreamSlots];
+
+    // Retire the block that last used this slot before reusing its buffers.
+    if (b >= kStreamSlots) drain_block(b - kStreamSlots);
+
+    bool last_block = (b == num_blocks - 1);
+    slot.block_size = last_block ? isz - b * block_size : block_size;
+    file.read(slot.pinput_buffer, slot.block_size);
+    if (!file) {
+      std::cout << "Error: cannot read specified input file\n";
+      write_error = true;
+      break;
+    }
+
+    e_input_dma[b] = q.submit([&](handler &h) {
+      auto in_data = slot.pibuf->get_access<access::mode::discard_write>(h);
+      h.copy(slot.pinput_buffer, in_data);
+    });
+
+    SubmitGzipTasks(q, slot.block_size, slot.pibuf, slot.pobuf,
+                    slot.gzip_out_buf, &current_crc, b == 0, last_block,
+                    e_k_crc, e_k_lz, e_k_huff, 0, b);
+
+    e_output_dma[b] = q.submit([&](handler &h) {
+      auto out_data = slot.pobuf->get_access<access::mode::read>(h);
+      h.copy(out_data, slot.poutput_buffer);
+    });
+
+    e_size_dma[b] = q.submit([&](handler &h) {
+      auto out_data = slot.gzip_out_buf->get_access<access::mode::read>(h);
+      h.copy(out_data, slot.out_info);
+    });
+  }
+
+  // Retire the blocks still in flight.
+  size_t first_pending = num_blocks > kStreamSlots ? num_blocks - kStreamSlots : 0;
+  for (size_t b = first_pending; b < num_blocks && !write_error; b++) {
+    drain_block(b);
+  }
+
+  if (!write_error) {
+    // Add the bytes of the last block that fall outside the CRC kernel's
+    // 32-byte sections.
+    uint32_t crc;
+    {
+      host_accessor crc_acc(current_crc, read_only);
+      crc = crc_acc[0];
+    }
+    StreamSlot &last = slots[(num_blocks - 1) % kStreamSlots];
+    crc = Crc32(last.pinput_buffer, last.block_size, crc);
+
+    write_error = WriteGzipTrailer(fo, isz, crc) != 0;
+  }
+
+#ifdef FPGA_EMULATOR
+#elif FPGA_SIMULATOR
+#else
+  auto end = std::chrono::steady_clock::now();
+  double diff_total =
+      std::chrono::duration_cast<std::chrono::duration<double>>(end - start)
+          .count();
+#endif
+
+  if (fclose(fo)) {
+    perror("close");
+    write_error = true;
+  }
+  file.close();
+
+  // Make sure no transfer is still using the buffers before freeing them.
+  q.wait();
+  for (int s = 0; s < kStreamSlots; s++) {
+    delete slots[s].gzip_out_buf;
+    delete slots[s].pibuf;
+    delete slots[s].pobuf;
+    if (prepin) {
+      free(slots[s].pinput_buffer, q.get_context());
+      free(slots[s].poutput_buffer, q.get_context());
+    } else {
+      free(slots[s].pinput_buffer);
+      free(slots[s].poutput_buffer);
+    }
+  }
+
+  if (write_error || CompareGzipFiles(input_file, outfilename)) {
+    std::cout << "FAILED\n";
+    return 1;
+  }
+
+#ifdef FPGA_EMULATOR
+#elif FPGA_SIMULATOR
+#else
+  size_t time_k_crc = 0, time_k_lz = 0, time_k_huff = 0;
+  for (size_t b = 0; b < num_blocks; b++) {
+    time_k_crc += SyclGetExecTimeNs(e_k_crc[b]);
+    time_k_lz += SyclGetExecTimeNs(e_k_lz[b]);
+    time_k_huff += SyclGetExecTimeNs(e_k_huff[b]);
+  }
+  std::cout << "Throughput (including file I/O): "
+            << isz / diff_total / 1000000000.0 << " GB/s\n\n";
+  std::cout << "TP breakdown for engine #0 (GB/s)\n";
+  std::cout << "CRC = " << isz / (double)time_k_crc << "\n";
+  std::cout << "LZ77 = " << isz / (double)time_k_lz << "\n";
+  std::cout << "Huffman Encoding = " << isz / (double)time_k_huff << "\n\n";
+#endif
+  std::cout << "Blocks: " << num_blocks << "\n";
+  std::cout << "Compression Ratio " << (double)compressed_sz / isz * 100
+            << "%\n";
+
+  std::cout << "PASSED\n";
+  return 0;
+}
+
+// Times the host CRC32 routines on the input file and checks that they agree:
+// the byte-at-a-time reference, the dispatched Crc32Host() (carry-less
+// multiply or slice-by-16) and Crc32Combine() on independently computed
+// chunks.
+// returns 0 on success, otherwise a non-zero failure code.
+int Crc32Benchmark(std::string &input_file) {
+  std::ifstream file(input_file, std::ios::in | std::ios::binary | std::ios::ate);
+  if (!file.is_open()) {
+    std::cout << "Error: cannot read specified input file\n";
+    return 1;
+  }
+  size_t isz = file.tellg();
+  std::vector<char> data(isz);
+  file.seekg(0, std::ios::beg);
+  file.read(data.data(), isz);
+  file.close();
+
+  // Repeat the measurements on small files so that they take a measurable
+  // amount of time.
+  constexpr size_t kMinBenchmarkBytes = 256 * 1024 * 1024;
+  const int repetitions =
+      isz == 0 ? 1 : (int)std::max<size_t>(1, kMinBenchmarkBytes / isz);
+  constexpr int kNumChunks = 64;
+
+  auto time_gbps = [&](auto fn, uint32_t &crc) {
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < repetitions; r++) crc = fn();
+    auto end = std::chrono::steady_clock::now();
+    double diff =
+        std::chrono::duration_cast<std::chrono::duration<double>>(end - start)
+            .count();
+    return (double)isz * repetitions / diff / 1000000000.0;
+  };
+
+  uint32_t crc_ref, crc_fast, crc_combined;
+  double gbps_ref = time_gbps(
+      [&] { return Crc32HostBytewise(data.data(), isz, 0); }, crc_ref);
+  double gbps_fast =
+      time_gbps([&] { return Crc32Host(data.data(), isz, 0); }, crc_fast);
+  double gbps_combined = time_gbps(
+      [&] {
+        size_t chunk = (isz + kNumChunks - 1) / kNumChunks;
+        uint32_t crc = 0;
+        for (size_t pos = 0; pos < isz; pos += chunk) {
+          size_t len = std::min(chunk, isz - pos);
+          crc = Crc32Combine(crc, Crc32Host(&data[pos], len, 0), len);
+        }
+        return crc;
+      },
+      crc_combined);
+
+  std::cout << "CRC32 of " << isz << " bytes, " << repetitions
+            << " repetitions (GB/s)\n";
+  std::cout << "Crc32HostBytewise = " << gbps_ref << "\n";
+  std::cout << "Crc32Host = " << gbps_fast << "\n";
+  std::cout << "Crc32Host + Crc32Combine (" << kNumChunks
+            << " chunks) = " << gbps_combined << "\n";
+
+  if (crc_fast != crc_ref || crc_combined != crc_ref) {
+    std::cout << "CRC mismatch: " << std::hex << crc_ref << " " << crc_fast
+              << " " << crc_combined << std::dec << "\n";
+    std::cout << "FAILED\n";
+    return 1;
+  }
+  std::cout << "PASSED\n";
+  return 0;
+}
@@ -0,0 +1,275 @@
+#include "gzip_batch_compressor.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include "crc32.hpp"
+#include "gzipkernel_ll.hpp"
+
+using namespace sycl;
+
+// padding for the input and output buffers to deal with granularity of
+// kernel reads and writes
+constexpr size_t kInOutPadding = 16 * kVec;
+
+// Largest payload of a deflate stored block
+constexpr size_t kMaxStoredBlock = 65535;
+
+// Appends a gzip member header without a file name: magic, deflate, no flags,
+// no timestamp, Unix OS code.
+static void AppendGzipHeader(std::vector<char> &out) {
+  const unsigned char header[10] = {0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 3};
+  out.insert(out.end(), (const char *)header, (const char *)header + 10);
+}
+
+static void AppendUlong(std::vector<char> &out, uint32_t l) {
+  out.push_back(l & 0xff);
+  out.push_back((l >> 8) & 0xff);
+  out.push_back((l >> 16) & 0xff);
+  out.push_back((l >> 24) & 0xff);
+}
+
+// Appends data as a sequence of deflate stored blocks, the last one marked
+// BFINAL.
+static void AppendStoredBlocks(std::vector<char> &out, const char *data,
+                               size_t size) {
+  do {
+    size_t len = std::min(size, kMaxStoredBlock);
+    out.push_back(len == size ? 1 : 0);  // BFINAL, BTYPE=00
+    out.push_back(len & 0xff);
+    out.push_back((len >> 8) & 0xff);
+    out.push_back(~len & 0xff);
+    out.push_back((~len >> 8) & 0xff);
+    out.insert(out.end(), data, data + len);
+    data += len;
+    size -= len;
+  } while (size);
+}
+
+GzipBatchCompressor::GzipBatchCompressor(
+    queue &q, size_t max_request_size,
+    std::chrono::microseconds max_batch_delay)
+    : q_(q),
+      max_request_size_(max_request_size),
+      max_batch_delay_(max_batch_delay) {
+  const size_t input_alloc_size =
+      std::max(max_request_size, kMinRequestSize) + kInOutPadding;
+  const size_t output_alloc_size =
+      std::max(input_alloc_size, (size_t)kMinBufferSize);
+
+  // Consecutive sets belong to different engines, so that taking the sets in
+  // order hands the batches to the engines in round-robin order.
+  sets_.resize(kBuffering * kNumEngines);
+  for (size_t s = 0; s < sets_.size(); s++) {
+    BufferSet &set = sets_[s];
+    set.engine = s % kNumEngines;
+    set.gzip_out_buf = malloc_host<GzipOutInfo>(BATCH_SIZE, q_);
+    set.crc = malloc_host<uint32_t>(BATCH_SIZE, q_);
+    for (int b = 0; b < BATCH_SIZE; b++) {
+      set.in_ptrs[b] = malloc_host<char>(input_alloc_size, q_);
+      set.out_ptrs[b] = malloc_host<char>(output_alloc_size, q_);
+      if (set.in_ptrs[b] == nullptr || set.out_ptrs[b] == nullptr) {
+        throw std::runtime_error("Cannot allocate USM host buffers");
+      }
+      memset(set.in_ptrs[b], 0, input_alloc_size);
+      memset(set.out_ptrs[b], 0, output_alloc_size);
+    }
+    set.busy = false;
+  }
+
+  dispatcher_ = std::thread(&GzipBatchCompressor::DispatchLoop, this);
+  completer_ = std::thread(&GzipBatchCompressor::CompleteLoop, this);
+}
+
+GzipBatchCompressor::~GzipBatchCompressor() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+  dispatcher_.join();
+  completer_.join();
+
+  for (auto &set : sets_) {
+    free(set.gzip_out_buf, q_);
+    free(set.crc, q_);
+    for (int b = 0; b < BATCH_SIZE; b++) {
+      free(set.in_ptrs[b], q_);
+      free(set.out_ptrs[b], q_);
+    }
+  }
+}
+
+std::future<std::vector<char>> GzipBatchCompressor::Submit(const char *data,
+                                                           size_t size) {
+  if (size > max_request_size_) {
+    throw std::invalid_argument("Request larger than max_request_size");
+  }
+
+  Request req{data, size, {}, Clock::now()};
+  auto result = req.result.get_future();
+
+  // Too small for the engine, so not worth compressing.
+  if (size < kMinRequestSize) {
+    std::vector<char> out;
+    AppendGzipHeader(out);
+    AppendStoredBlocks(out, data, size);
+    AppendUlong(out, Crc32Host(data, size, 0));
+    AppendUlong(out, size);
+    req.result.set_value(std::move(out));
+    RecordLatency(req.submit_time);
+    return result;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_.push_back(std::move(req));
+    outstanding_++;
+  }
+  cv_.notify_all();
+  return result;
+}
+
+void GzipBatchCompressor::Flush() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  flush_ = true;
+  cv_.notify_all();
+  cv_.wait(lock, [&] { return outstanding_ == 0; });
+  flush_ = false;
+}
+
+GzipLatencyReport GzipBatchCompressor::LatencyReport() {
+  std::vector<double> sorted;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    sorted = latencies_us_;
+  }
+  std::sort(sorted.begin(), sorted.end());
+
+  GzipLatencyReport report{sorted.size(), 0, 0, 0, 0};
+  if (sorted.empty()) return report;
+  // nearest-rank percentile
+  auto percentile = [&](double p) {
+    size_t rank = (size_t)(p / 100.0 * sorted.size() + 0.5);
+    return sorted[std::min(std::max(rank, (size_t)1), sorted.size()) - 1];
+  };
+  report.p50_us = percentile(50);
+  report.p90_us = percentile(90);
+  report.p99_us = percentile(99);
+  report.max_us = sorted.back();
+  return report;
+}
+
+void GzipBatchCompressor::RecordLatency(Clock::time_point submit_time) {
+  double us = std::chrono::duration_cast<std::chrono::duration<double>>(
+                  Clock::now() - submit_time)
+                  .count() *
+              1000000;
+  std::lock_guard<std::mutex> lock(mutex_);
+  latencies_us_.push_back(us);
+}
+
+// Forms the batches and launches them on the engines.
+void GzipBatchCompressor::DispatchLoop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    cv_.wait(lock, [&] { return stop_ || !pending_.empty(); });
+    if (pending_.empty()) break;
+
+    // Coalesce the requests into a full batch, unless the oldest one has
+    // already waited for max_batch_delay.
+    auto deadline = pending_.front().submit_time + max_batch_delay_;
+    cv_.wait_until(lock, deadline, [&] {
+      return stop_ || flush_ || pending_.size() >= (size_t)BATCH_SIZE;
+    });
+
+    // Reuse the next buffer set once its previous batch has completed.
+    BufferSet &set = sets_[next_set_];
+    next_set_ = (next_set_ + 1) % sets_.size();
+    cv_.wait(lock, [&] { return !set.busy; });
+
+    size_t count = std::min(pending_.size(), (size_t)BATCH_SIZE);
+    for (size_t i = 0; i < count; i++) {
+      set.requests.push_back(std::move(pending_.front()));
+      pending_.pop_front();
+    }
+    set.busy = true;
+
+    // Copy the data and launch without holding the lock, so that Submit()
+    // is not blocked.
+    lock.unlock();
+    Launch(set);
+    lock.lock();
+
+    inflight_.push_back(&set);
+    cv_.notify_all();
+  }
+  dispatcher_done_ = true;
+  cv_.notify_all();
+}
+
+void GzipBatchCompressor::Launch(BufferSet &set) {
+  for (int b = 0; b < BATCH_SIZE; b++) {
+    if (b < (int)set.requests.size()) {
+      memcpy(set.in_ptrs[b], set.requests[b].data, set.requests[b].size);
+      set.sizes[b] = set.requests[b].size;
+    } else {
+      // The engine always processes BATCH_SIZE files. Fill the unused
+      // entries with the smallest size it supports; the results are ignored.
+      set.sizes[b] = kMinRequestSize;
+    }
+  }
+
+  set.events = SubmitGzipTasks(q_, set.sizes, set.gzip_out_buf, set.crc, true,
+                               {}, set.in_ptrs, set.out_ptrs, set.engine);
+}
+
+// Waits for the batches in launch order and fulfills their requests.
+void GzipBatchCompressor::CompleteLoop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    cv_.wait(lock, [&] { return !inflight_.empty() || dispatcher_done_; });
+    if (inflight_.empty()) break;
+    BufferSet &set = *inflight_.front();
+
+    lock.unlock();
+    Finish(set);
+    lock.lock();
+
+    inflight_.pop_front();
+    outstanding_ -= set.requests.size();
+    set.requests.clear();
+    set.busy = false;
+    cv_.notify_all();
+  }
+}
+
+void GzipBatchCompressor::Finish(BufferSet &set) {
+  for (auto &e : set.events) {
+    e.wait();
+  }
+
+  for (size_t b = 0; b < set.requests.size(); b++) {
+    Request &req = set.requests[b];
+    size_t compressed_sz = set.gzip_out_buf[b].compression_sz;
+
+    std::vector<char> out;
+    out.reserve(std::min(compressed_sz, req.size) + 32);
+    AppendGzipHeader(out);
+    if (compressed_sz <= req.size) {
+      out.insert(out.end(), set.out_ptrs[b], set.out_ptrs[b] + compressed_sz);
+    } else {
+      // The engine stops writing once the output reaches the input size, so
+      // the result is incomplete. Store the data instead.
+      AppendStoredBlocks(out, set.in_ptrs[b], req.size);
+    }
+    // The CRC kernel leaves the bytes beyond its 32-byte sections to the
+    // host.
+    AppendUlong(out, Crc32(set.in_ptrs[b], req.size, set.crc[b]));
+    AppendUlong(out, req.size);
+
+    req.result.set_value(std::move(out));
+    RecordLatency(req.submit_time);
+  }
+}
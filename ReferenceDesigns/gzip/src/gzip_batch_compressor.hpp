@@ -0,0 +1,124 @@
+#ifndef __GZIP_BATCH_COMPRESSOR_H__
+#define __GZIP_BATCH_COMPRESSOR_H__
+#pragma once
+
+#include <sycl/sycl.hpp>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+#if __cplusplus >= 202002L
+#include <span>
+#endif
+
+#include "kernels.hpp"
+
+// Per-request latency, from Submit() until the result is ready, of all the
+// requests completed so far.
+struct GzipLatencyReport {
+  size_t num_requests;
+  double p50_us;
+  double p90_us;
+  double p99_us;
+  double max_us;
+};
+
+// Compresses many small, unrelated buffers (e.g. RPC payloads) with the
+// low-latency gzip engines.
+//
+// Requests are coalesced into batches of up to BATCH_SIZE buffers. A batch is
+// launched as soon as it is full, or once its oldest request has waited for
+// max_batch_delay. Batches are handed to the engines in round-robin order, and
+// each engine has N_BUFFERING sets of USM input/output buffers, so that a
+// batch can be prepared while the previous one is being compressed.
+//
+// Each result is a complete gzip member. Requests smaller than the minimum
+// size supported by the engine, or that the engine cannot compress, are
+// stored uncompressed (deflate stored blocks).
+class GzipBatchCompressor {
+ public:
+  GzipBatchCompressor(sycl::queue &q, size_t max_request_size,
+                      std::chrono::microseconds max_batch_delay);
+  ~GzipBatchCompressor();
+
+  GzipBatchCompressor(const GzipBatchCompressor &) = delete;
+  GzipBatchCompressor &operator=(const GzipBatchCompressor &) = delete;
+
+  // Queues size bytes at data for compression. data must stay valid until
+  // the returned future is ready. Throws std::invalid_argument if size is
+  // larger than max_request_size.
+  std::future<std::vector<char>> Submit(const char *data, size_t size);
+#if __cplusplus >= 202002L
+  std::future<std::vector<char>> Submit(std::span<const char> data) {
+    return Submit(data.data(), data.size());
+  }
+#endif
+
+  // Launches the pending requests without waiting for a full batch, and waits
+  // until all the submitted requests are complete.
+  void Flush();
+
+  GzipLatencyReport LatencyReport();
+
+ private:
+  // Number of sets of I/O buffers per engine
+  static constexpr int kBuffering = 2;
+
+  // Smallest request the engine can compress
+  static constexpr size_t kMinRequestSize = kVec + 1;
+
+  using Clock = std::chrono::steady_clock;
+
+  struct Request {
+    const char *data;
+    size_t size;
+    std::promise<std::vector<char>> result;
+    Clock::time_point submit_time;
+  };
+
+  // One set of USM buffers, holding one batch
+  struct BufferSet {
+    size_t engine;
+    GzipOutInfo *gzip_out_buf;
+    uint32_t *crc;
+    std::array<char *, BATCH_SIZE> in_ptrs;
+    std::array<char *, BATCH_SIZE> out_ptrs;
+    std::array<size_t, BATCH_SIZE> sizes;
+    std::vector<Request> requests;
+    std::vector<sycl::event> events;
+    bool busy;
+  };
+
+  void DispatchLoop();
+  void CompleteLoop();
+  void Launch(BufferSet &set);
+  void Finish(BufferSet &set);
+  void RecordLatency(Clock::time_point submit_time);
+
+  sycl::queue &q_;
+  size_t max_request_size_;
+  std::chrono::microseconds max_batch_delay_;
+
+  std::vector<BufferSet> sets_;
+  size_t next_set_ = 0;
+
+  // Guards everything below
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<Request> pending_;
+  std::deque<BufferSet *> inflight_;
+  size_t outstanding_ = 0;  // submitted requests that are not complete yet
+  bool flush_ = false;
+  bool stop_ = false;
+  bool dispatcher_done_ = false;
+  std::vector<double> latencies_us_;
+
+  std::thread dispatcher_;
+  std::thread completer_;
+};
+
+#endif  //__GZIP_BATCH_COMPRESSOR_H__
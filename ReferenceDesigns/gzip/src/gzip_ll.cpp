@@ -1,12 +1,16 @@
 #include <sycl/sycl.hpp>
 #include <sycl/ext/intel/fpga_extensions.hpp>
+#include <algorithm>
 #include <chrono>
 #include <fstream>
+#include <future>
 #include <string>
+#include <vector>
 
 #include "CompareGzip.hpp"
 #include "WriteGzip.hpp"
 #include "crc32.hpp"
+#include "gzip_batch_compressor.hpp"
 #include "gzipkernel_ll.hpp"
 #include "kernels.hpp"
 
@@ -30,6 +34,9 @@ int CompressFile(queue &q, std::string &input_file,
                  std::vector<std::string> outfilenames, int iterations,
                  bool report);
 
+int CompressFileService(queue &q, std::string &input_file,
+                        std::string &outfilename);
+
 void Help(void) {
   // Command line arguments.
   // gzip [options] filetozip [options]
@@ -43,6 +50,9 @@ void Help(void) {
   std::cout << "  -h,--help                                : this help text\n";
   std::cout
       << "  -o=<filename>,--output-file=<filename>   : specify output file\n";
+  std::cout
+      << "  --service                                : compress the file as "
+         "many small requests\n";
 }
 
 bool FindGetArg(std::string &arg, const char *str, int defaultval, int *val) {
@@ -95,10 +105,14 @@ int main(int argc, char *argv[]) {
 
   char str_buffer[kMaxStringLen] = {0};
 
+  // If set, the file is compressed through GzipBatchCompressor as a stream of
+  // small, independent requests.
+  bool service = false;
+
   // Check the number of arguments specified
-  if (argc != 3) {
+  if (argc < 3 || argc > 4) {
     std::cerr << "Incorrect number of arguments. Correct usage: " << argv[0]
-              << " <input-file> -o=<output-file>\n";
+              << " <input-file> -o=<output-file> [--service]\n";
     return 1;
   }
 
@@ -111,6 +125,9 @@ int main(int argc, char *argv[]) {
       if (std::string(argv[i]) == "--help") {
         help = true;
       }
+      if (std::string(argv[i]) == "--service") {
+        service = true;
+      }
 
       FindGetArgString(sarg, "-o=", str_buffer, kMaxStringLen);
       FindGetArgString(sarg, "--output-file=", str_buffer, kMaxStringLen);
@@ -162,6 +179,12 @@ int main(int argc, char *argv[]) {
       outfilenames[i] = outfilenames[0] + std::to_string(i + 1);
     }
 
+    if (service) {
+      std::cout << "Launching Low-Latency GZIP batch compression service with "
+                << kNumEngines << " engines\n";
+      return CompressFileService(q, infilename, outfilenames[0]);
+    }
+
     std::cout << "Launching Low-Latency GZIP application with " << kNumEngines
               << " engines\n";
 
@@ -598,3 +621,100 @@ int CompressFile(queue &q, std::string &input_file,
   if (report) std::cout << "PASSED\n";
   return 0;
 }
+
+// Sizes of the requests that CompressFileService() cuts the input file into,
+// used in turn. They mimic a mix of RPC payloads, including one that is too
+// small for the engine.
+constexpr size_t kServiceRequestSizes[] = {4096, 1000, 16384, 10, 8192, 2500};
+constexpr size_t kServiceMaxRequestSize = 16384;
+
+// Longest time a request waits for its batch to fill up
+constexpr std::chrono::microseconds kServiceMaxBatchDelay(200);
+
+// Compresses the input file as a stream of small, independent requests through
+// GzipBatchCompressor, and writes the results, in order, as consecutive gzip
+// members of the output file. gunzip decompresses consecutive members into the
+// concatenation of their data, i.e. the input file, which is how the results
+// are verified.
+// returns 0 on success, otherwise a non-zero failure code.
+int CompressFileService(queue &q, std::string &input_file,
+                        std::string &outfilename) {
+  std::ifstream file(input_file, std::ios::in | std::ios::binary | std::ios::ate);
+  if (!file.is_open()) {
+    std::cout << "Error: cannot read specified input file\n";
+    return 1;
+  }
+  size_t isz = file.tellg();
+  std::vector<char> data(isz);
+  file.seekg(0, std::ios::beg);
+  file.read(data.data(), isz);
+  file.close();
+
+  std::vector<std::future<std::vector<char>>> results;
+  GzipLatencyReport latency;
+  size_t compressed_sz = 0;
+
+#ifdef FPGA_EMULATOR
+#elif FPGA_SIMULATOR
+#else
+  auto start = std::chrono::steady_clock::now();
+#endif
+  {
+    GzipBatchCompressor compressor(q, kServiceMaxRequestSize,
+                                   kServiceMaxBatchDelay);
+
+    size_t num_sizes = sizeof(kServiceRequestSizes) / sizeof(size_t);
+    for (size_t pos = 0, r = 0; pos < isz; r++) {
+      size_t size = std::min(kServiceRequestSizes[r % num_sizes], isz - pos);
+      results.push_back(compressor.Submit(&data[pos], size));
+      pos += size;
+    }
+    compressor.Flush();
+    latency = compressor.LatencyReport();
+  }
+#ifdef FPGA_EMULATOR
+#elif FPGA_SIMULATOR
+#else
+  auto end = std::chrono::steady_clock::now();
+  double diff_total =
+      std::chrono::duration_cast<std::chrono::duration<double>>(end - start)
+          .count();
+#endif
+
+  FILE *fo = fopen(outfilename.c_str(), "wb");
+  if (fo == NULL) {
+    std::cout << "Cannot open file for output: " << outfilename << "\n";
+    return 1;
+  }
+  for (auto &result : results) {
+    std::vector<char> member = result.get();
+    fwrite(member.data(), 1, member.size(), fo);
+    compressed_sz += member.size();
+  }
+  bool write_error = ferror(fo);
+  if (fclose(fo) || write_error) {
+    std::cout << "gzip output file write failure.\n";
+    std::cout << "FAILED\n";
+    return 1;
+  }
+
+  if (CompareGzipFiles(input_file, outfilename)) {
+    std::cout << "FAILED\n";
+    return 1;
+  }
+
+  std::cout << "Requests: " << latency.num_requests << "\n";
+#ifdef FPGA_EMULATOR
+#elif FPGA_SIMULATOR
+#else
+  std::cout << "Throughput: " << isz / diff_total / 1000000000.0 << " GB/s, "
+            << latency.num_requests / diff_total << " requests/s\n";
+#endif
+  std::cout << "Request latency (us): p50 = " << latency.p50_us
+            << ", p90 = " << latency.p90_us << ", p99 = " << latency.p99_us
+            << ", max = " << latency.max_us << "\n";
+  std::cout << "Compression Ratio " << (double)compressed_sz / isz * 100
+            << "%\n";
+  std::cout << "PASSED\n";
+  return 0;
+}
@@ -2,6 +2,7 @@
 
 #include "gzipkernel.hpp"
 #include "kernels.hpp"
+#include "dynamic_huffman.hpp"
 
 
 using namespace sycl;
@@ -708,12 +709,15 @@ class LZReduction;
 template <int engineID>
 class StaticHuffman;
 template <int engineID>
+class DynamicHuffman;
+template <int engineID>
 void SubmitGzipTasksSingleEngine(
     queue &q,
     size_t block_size,  // size of block to compress.
     buffer<char, 1> *pibuf, buffer<char, 1> *pobuf,
     buffer<struct GzipOutInfo, 1> *gzip_out_buf,
-    buffer<unsigned, 1> *result_crc, bool last_block, std::vector<event> &e_crc, std::vector<event> &e_lz,
+    buffer<unsigned, 1> *result_crc, bool first_block, bool last_block,
+    std::vector<event> &e_crc, std::vector<event> &e_lz,
     std::vector<event> &e_huff, int buffer_index) {
   using acc_dist_channel = ext::intel::pipe<class some_pipe, struct DistLen>;
   using acc_dist_channel_last = ext::intel::pipe<class some_pipe2, struct DistLen>;
@@ -721,7 +725,8 @@ void SubmitGzipTasksSingleEngine(
   e_crc[buffer_index] = q.submit([&](handler &h) {
     auto accessor_isz = block_size;
     auto acc_pibuf = pibuf->get_access<access::mode::read>(h);
-    auto accresult_crc = result_crc->get_access<access::mode::discard_write>(h);
+    auto accresult_crc = result_crc->get_access<access::mode::read_write>(h);
+    auto acc_first_block = first_block;
     h.single_task<CRC<engineID>>([=]() [[intel::kernel_args_restrict]] {
       const unsigned int table64[64][16] = {
           {
@@ -1945,7 +1950,9 @@ void SubmitGzipTasksSingleEngine(
 
       const int num_sections = accessor_isz / (num_nibbles_parallel /
                                                2);  // how many loop iterations
-      unsigned int result = ~0;
+      // When compressing a file in multiple blocks, continue from the CRC
+      // that the previous block left in the buffer.
+      unsigned int result = acc_first_block ? ~0 : ~accresult_crc[0];
 
       for (int i = 0; i < num_sections; i++) {
         unsigned int result_update_odd = 0;
@@ -2282,6 +2289,23 @@ void SubmitGzipTasksSingleEngine(
     });
   });
 
+#if DYNAMIC_HUFFMAN
+  e_huff[buffer_index] = q.submit([&](handler &h) {
+    auto accessor_isz = block_size;
+    auto acc_gzip_out =
+        gzip_out_buf->get_access<access::mode::discard_write>(h);
+    auto accessor_output = pobuf->get_access<access::mode::discard_write>(h);
+    auto acc_eof = last_block;
+    h.single_task<DynamicHuffman<engineID>>([=
+    ]() [[intel::kernel_args_restrict]] {
+      // Builds per-block Huffman trees from the LZ output, see
+      // dynamic_huffman.hpp.
+      acc_gzip_out[0].compression_sz =
+          DynamicHuffmanEncode<acc_dist_channel, acc_dist_channel_last>(
+              accessor_isz, acc_eof, accessor_output);
+    });
+  });
+#else
   e_huff[buffer_index] = q.submit([&](handler &h) {
     auto accessor_isz = block_size;
     auto acc_gzip_out =
@@ -2316,6 +2340,13 @@ void SubmitGzipTasksSingleEngine(
         in.len[0] = ctr == 1 ? -3 : -1;
         in.data[0] = 0;
 
+        // If more blocks follow, start an empty stored block (BFINAL=0,
+        // BTYPE=00) after the end block marker. The host pads it to a byte
+        // boundary and appends its LEN/NLEN, so that the next block starts
+        // on a byte boundary.
+        in.len[1] = (ctr == 1 && !acc_eof) ? -2 : -1;
+        in.data[1] = 0;
+
         in = ctr > 2 ? acc_dist_channel::read()
                      : (ctr == 2 ? acc_dist_channel_last::read() : in);
 
@@ -2345,27 +2376,31 @@ void SubmitGzipTasksSingleEngine(
           (leftover_size + 7) / 8;
     });
   });
+#endif
 }
 
 void SubmitGzipTasks(queue &q,
                      size_t block_size,  // size of block to compress.
                      buffer<char, 1> *pibuf, buffer<char, 1> *pobuf,
                      buffer<struct GzipOutInfo, 1> *gzip_out_buf,
-                     buffer<unsigned, 1> *result_crc, bool last_block,
-                     std::vector<event> &e_crc, std::vector<event> &e_lz, std::vector<event> &e_huff,
+                     buffer<unsigned, 1> *result_crc, bool first_block,
+                     bool last_block, std::vector<event> &e_crc,
+                     std::vector<event> &e_lz, std::vector<event> &e_huff,
                      size_t engineID, int buffer_index) {
   // Statically declare the engines so that the hardware is created for them.
   // But at run time, the host can dynamically select which engine(s) to use via
   // engineID.
   if (engineID == 0) {
     SubmitGzipTasksSingleEngine<0>(q, block_size, pibuf, pobuf, gzip_out_buf,
-                                   result_crc, last_block, e_crc, e_lz, e_huff, buffer_index);
+                                   result_crc, first_block, last_block, e_crc,
+                                   e_lz, e_huff, buffer_index);
   }
 
   #if NUM_ENGINES > 1
     if (engineID == 1) {
       SubmitGzipTasksSingleEngine<1>(q, block_size, pibuf, pobuf, gzip_out_buf,
-                                     result_crc, last_block, e_crc, e_lz, e_huff, buffer_index);
+                                     result_crc, first_block, last_block, e_crc,
+                                     e_lz, e_huff, buffer_index);
     }
   #endif
 
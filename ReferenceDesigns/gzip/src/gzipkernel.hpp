@@ -11,7 +11,10 @@ extern "C" void SubmitGzipTasks(
     size_t block_size,  // size of block to compress.
     buffer<char, 1> *pibuf, buffer<char, 1> *pobuf,
     buffer<struct GzipOutInfo, 1> *gzip_out_buf,
-    buffer<unsigned, 1> *current_crc, bool last_block, std::vector<event> &e_crc,
-    std::vector<event> &e_lz, std::vector<event> &e_huff, size_t engineID, int buffer_index);
+    buffer<unsigned, 1> *current_crc,
+    bool first_block,  // if false, the CRC continues from current_crc[0]
+    bool last_block,   // if false, the block is not marked BFINAL
+    std::vector<event> &e_crc, std::vector<event> &e_lz,
+    std::vector<event> &e_huff, size_t engineID, int buffer_index);
 
 #endif  //__GZIPKERNEL_H__
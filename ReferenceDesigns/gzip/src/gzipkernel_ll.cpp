@@ -47,6 +47,7 @@
 
 #include "gzipkernel_ll.hpp"
 #include "kernels.hpp"
+#include "dynamic_huffman.hpp"
 #include "pipe_utils.hpp" // Included from include/
 
 
@@ -780,8 +781,8 @@ auto get(CurrentAccessor &accessor, AccessorTys &... Args) {
 template <int engineID>
 class CRC;
 template <int engineID, int BatchSize>
-event SubmitCRC(queue &q, size_t block_size, uint32_t *result_crc,
-                std::vector<event> &depend_on) {
+event SubmitCRC(queue &q, std::array<size_t, BatchSize> block_sizes,
+                uint32_t *result_crc, std::vector<event> &depend_on) {
   event e = q.submit([&](handler &h) {
     // Temporarily remove event dependences to work around a bug in 2024.2
     // This is safe on FPGA because invocations of the same kernel are 
@@ -792,13 +793,14 @@ event SubmitCRC(queue &q, size_t block_size, uint32_t *result_crc,
     //}
 
     h.single_task<CRC<engineID>>([=]() [[intel::kernel_args_restrict]] {
-      auto accessor_isz = block_size;
-
       sycl::ext::intel::host_ptr<uint32_t> accresult_crc(result_crc);
 
       // See comments at top of file, regarding batching.
       [[intel::disable_loop_pipelining]]
       for (int iter=0;iter<BatchSize;iter++) {
+        // Each file in the batch may have a different size.
+        auto accessor_isz = block_sizes[iter % BatchSize];
+
         const unsigned int table64[64][16] = {
             {
                 0x0,
@@ -2071,11 +2073,10 @@ event SubmitCRC(queue &q, size_t block_size, uint32_t *result_crc,
 template <int engineID>
 class LZReduction;
 template <int engineID, int BatchSize, typename... PtrTypes>
-event SubmitLZReduction(queue &q, size_t block_size, bool last_block,
-                        std::vector<event> &depend_on,
+event SubmitLZReduction(queue &q, std::array<size_t, BatchSize> block_sizes,
+                        bool last_block, std::vector<event> &depend_on,
                         PtrTypes... ptrs) {
   event e = q.submit([&](handler &h) {
-    auto accessor_isz = block_size;
 
     // Temporarily remove event dependences to work around a bug in 2024.2
     // This is safe on FPGA because invocations of the same kernel are 
@@ -2107,6 +2108,7 @@ event SubmitLZReduction(queue &q, size_t block_size, bool last_block,
         sycl::ext::intel::host_ptr<char> acc_pibuf =
             host_pibuf[iter_masked];  // Grab new host pointer on each iteration
                                       // of the batch loop
+        auto accessor_isz = block_sizes[iter_masked];
 
         //-------------------------------------
         //   Hash Table(s)
@@ -2448,7 +2450,7 @@ event SubmitLZReduction(queue &q, size_t block_size, bool last_block,
 template <int engineID>
 class StaticHuffman;
 template <int engineID, int BatchSize, typename... PtrTypes>
-event SubmitStaticHuffman(queue &q, size_t block_size,
+event SubmitStaticHuffman(queue &q, std::array<size_t, BatchSize> block_sizes,
                           struct GzipOutInfo *gzip_out_buf, bool last_block,
                           std::vector<event> &depend_on,
                           PtrTypes... ptrs) {
@@ -2469,8 +2471,6 @@ event SubmitStaticHuffman(queue &q, size_t block_size,
       Unroller<0, BatchSize>::step(
           [&](auto i) { host_pobuf[i] = sycl::ext::intel::host_ptr<char>(get<i>(ptrs...)); });
 
-      auto accessor_isz = block_size;
-
       sycl::ext::intel::host_ptr<GzipOutInfo> acc_gzip_out(gzip_out_buf);
 
       auto acc_eof = last_block ? 1 : 0;
@@ -2479,6 +2479,7 @@ event SubmitStaticHuffman(queue &q, size_t block_size,
       [[intel::disable_loop_pipelining]]
       for (int iter=0; iter < BatchSize; iter++) {
         sycl::ext::intel::host_ptr<char> accessor_output = host_pobuf[iter % BatchSize];
+        auto accessor_isz = block_sizes[iter % BatchSize];
 
         unsigned int leftover[kVec] = {0};
         Unroller<0, kVec>::step([&](int i) { leftover[i] = 0; });
@@ -2544,13 +2545,52 @@ event SubmitStaticHuffman(queue &q, size_t block_size,
   return e;
 }
 
+template <int engineID>
+class DynamicHuffman;
+template <int engineID, int BatchSize, typename... PtrTypes>
+event SubmitDynamicHuffman(queue &q, std::array<size_t, BatchSize> block_sizes,
+                           struct GzipOutInfo *gzip_out_buf, bool last_block,
+                           std::vector<event> &depend_on,
+                           PtrTypes... ptrs) {
+  event e = q.submit([&](handler &h) {
+    // See the comments in SubmitStaticHuffman regarding event dependences.
+    h.single_task<DynamicHuffman<engineID>>([=]() [[intel::kernel_args_restrict]] {
+
+      // See comments in SubmitLZReduction, where the same parameter unpacking
+      // is done.
+      sycl::ext::intel::host_ptr<char> host_pobuf[BatchSize];
+      Unroller<0, BatchSize>::step(
+          [&](auto i) { host_pobuf[i] = sycl::ext::intel::host_ptr<char>(get<i>(ptrs...)); });
+
+      sycl::ext::intel::host_ptr<GzipOutInfo> acc_gzip_out(gzip_out_buf);
+
+      // See comments at top of file regarding batching.
+      [[intel::disable_loop_pipelining]]
+      for (int iter=0; iter < BatchSize; iter++) {
+        sycl::ext::intel::host_ptr<char> accessor_output = host_pobuf[iter % BatchSize];
+        auto accessor_isz = block_sizes[iter % BatchSize];
+
+        // Builds per-block Huffman trees from the LZ output, see
+        // dynamic_huffman.hpp.
+        acc_gzip_out[iter].compression_sz = DynamicHuffmanEncode<
+            acc_dist_channel_array::PipeAt<engineID>,
+            acc_dist_channel_last_array::PipeAt<engineID>>(
+            accessor_isz, last_block, accessor_output);
+      }
+    });
+  });
+
+  return e;
+}
+
 // Helper function to launch the individual kernels that comprise the gzip
 // engine. Templated on engineID to allow creation of multiple engines.
 // Templated on BatchSize to specify, at compile time, the batch size for which
 // hardware should be built.
 // And templated on a pack of PtrTypes (which we know will be char*).
 template <int engineID, int BatchSize, std::size_t... Indices>
-std::vector<event> SubmitGzipTasksHelper(queue &q, size_t block_size,
+std::vector<event> SubmitGzipTasksHelper(queue &q,
+                                         std::array<size_t, BatchSize> block_sizes,
                                          struct GzipOutInfo *gzip_out_buf,
                                          uint32_t *result_crc, bool last_block,
                                          std::vector<event> &depend_on,
@@ -2567,31 +2607,41 @@ std::vector<event> SubmitGzipTasksHelper(queue &q, size_t block_size,
   // This means the call quite literally expands to:
   //    SubmitLZReduction<BatchSize>(<other args>, in_ptrs[0], in_ptrs[1], ...);
   event e_LZReduction = SubmitLZReduction<engineID,BatchSize>(q,
-                                                     block_size,
+                                                     block_sizes,
                                                      last_block,
                                                      depend_on,
                                                      in_ptrs[Indices]...
                                                      );
 
   event e_CRC = SubmitCRC<engineID,BatchSize>(q,
-                                    block_size,
+                                    block_sizes,
                                     result_crc,
                                     depend_on);
 
-  
-  event e_StaticHuffman = SubmitStaticHuffman<engineID,BatchSize>(q,
-                                                         block_size,
-                                                         gzip_out_buf,
-                                                         last_block,
-                                                         depend_on,
-                                                         out_ptrs[Indices]...
-                                                         );
+#if DYNAMIC_HUFFMAN
+  event e_Huffman = SubmitDynamicHuffman<engineID,BatchSize>(q,
+                                                    block_sizes,
+                                                    gzip_out_buf,
+                                                    last_block,
+                                                    depend_on,
+                                                    out_ptrs[Indices]...
+                                                    );
+#else
+  event e_Huffman = SubmitStaticHuffman<engineID,BatchSize>(q,
+                                                   block_sizes,
+                                                   gzip_out_buf,
+                                                   last_block,
+                                                   depend_on,
+                                                   out_ptrs[Indices]...
+                                                   );
+#endif
 
-  return {e_CRC, e_LZReduction, e_StaticHuffman};
+  return {e_CRC, e_LZReduction, e_Huffman};
 }
 
 //template <int BatchSize>
-std::vector<event> SubmitGzipTasks(queue &q, size_t block_size,
+std::vector<event> SubmitGzipTasks(queue &q,
+                                   std::array<size_t, BATCH_SIZE> block_sizes,
                                    struct GzipOutInfo *gzip_out_buf,
                                    uint32_t *result_crc, bool last_block,
                                    std::vector<event> depend_on,
@@ -2613,20 +2663,33 @@ std::vector<event> SubmitGzipTasks(queue &q, size_t block_size,
 
   if (engineID == 0) {
     return SubmitGzipTasksHelper<0, BATCH_SIZE>(
-        q, block_size, gzip_out_buf, result_crc, last_block, depend_on, in_ptrs,
+        q, block_sizes, gzip_out_buf, result_crc, last_block, depend_on, in_ptrs,
         out_ptrs, std::make_index_sequence<BATCH_SIZE>{});
   }
 #if NUM_ENGINES > 1
   if (engineID == 1) {
     return SubmitGzipTasksHelper<1, BATCH_SIZE>(
-        q, block_size, gzip_out_buf, result_crc, last_block, depend_on, in_ptrs,
+        q, block_sizes, gzip_out_buf, result_crc, last_block, depend_on, in_ptrs,
         out_ptrs, std::make_index_sequence<BATCH_SIZE>{});
   }
 #endif
 
   // Default
   return SubmitGzipTasksHelper<0, BATCH_SIZE>(
-      q, block_size, gzip_out_buf, result_crc, last_block, depend_on, in_ptrs,
+      q, block_sizes, gzip_out_buf, result_crc, last_block, depend_on, in_ptrs,
       out_ptrs, std::make_index_sequence<BATCH_SIZE>{});
 }
 
+std::vector<event> SubmitGzipTasks(queue &q, size_t block_size,
+                                   struct GzipOutInfo *gzip_out_buf,
+                                   uint32_t *result_crc, bool last_block,
+                                   std::vector<event> depend_on,
+                                   std::array<char *, BATCH_SIZE> in_ptrs,
+                                   std::array<char *, BATCH_SIZE> out_ptrs,
+                                   size_t engineID) {
+  // All files in the batch have the same size.
+  std::array<size_t, BATCH_SIZE> block_sizes;
+  block_sizes.fill(block_size);
+  return SubmitGzipTasks(q, block_sizes, gzip_out_buf, result_crc, last_block,
+                         depend_on, in_ptrs, out_ptrs, engineID);
+}
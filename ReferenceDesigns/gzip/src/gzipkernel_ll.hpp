@@ -3,11 +3,23 @@
 #pragma once
 
 #include <sycl/sycl.hpp>
+#include <array>
 #include "kernels.hpp"
 
 using namespace sycl;
 
-//extern "C" 
+// Launches the gzip engine engineID on a batch of BATCH_SIZE files. Each file
+// in the batch has its own size in block_sizes.
+std::vector<event> SubmitGzipTasks(queue &q,
+                                   std::array<size_t, BATCH_SIZE> block_sizes,
+                                   struct GzipOutInfo *gzip_out_buf,
+                                   uint32_t *result_crc, bool last_block,
+                                   std::vector<event> depend_on,
+                                   std::array<char *, BATCH_SIZE> in_ptrs,
+                                   std::array<char *, BATCH_SIZE> out_ptrs,
+                                   size_t engineID);
+
+// Same as above, for a batch of files that all have block_size bytes.
 std::vector<event> SubmitGzipTasks(queue &q, size_t block_size,
                                    struct GzipOutInfo *gzip_out_buf,
                                    uint32_t *result_crc, bool last_block,
@@ -93,6 +93,14 @@ constexpr int kDebug = 1;
   } while (0)
 
 constexpr int kStaticTrees = 1;
+constexpr int kDynamicTrees = 2;
+
+// Number of DistLen vectors (i.e. kVec input bytes each) that make up one
+// dynamic Huffman block. Each block gets its own code tables, so smaller
+// blocks adapt faster to changing data but pay for the code-length header
+// more often. The block is buffered on-chip between the histogram and the
+// encoding pass, so this also sets the size of that buffer.
+constexpr int kDynamicBlockVecs = 2048;
 
 typedef struct CtData {
   unsigned short code;
@@ -125,6 +133,9 @@ constexpr int kDCodes = 30;
 // number of codes used to transfer the bit lengths
 constexpr int kBLCodes = 19;
 
+// All bit length codes must not exceed kMaxBLBits
+constexpr int kMaxBLBits = 7;
+
 constexpr int kMaxDistance = ((32 * 1024));
 
 constexpr int kMinBufferSize = 16384;
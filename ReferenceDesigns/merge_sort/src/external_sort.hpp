@@ -0,0 +1,316 @@
+#ifndef __EXTERNALSORT_HPP__
+#define __EXTERNALSORT_HPP__
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+//
+// The host side of an external sort: the input file is sorted in runs by the
+// FPGA (see ExternalSort in main.cpp), which are written to a runs file, and
+// the sorted runs are then merged into the output file on the host by the
+// functions below.
+//
+
+// a range [first, second) of elements of a file
+using FileRange = std::pair<uint64_t, uint64_t>;
+
+//
+// Read or write 'count' elements at element 'offset' of a binary file
+//
+template <typename T>
+bool ReadElements(std::istream &file, uint64_t offset, T *data,
+                  uint64_t count) {
+  file.seekg(std::streamoff(offset * sizeof(T)));
+  file.read(reinterpret_cast<char *>(data), std::streamsize(count * sizeof(T)));
+  return bool(file);
+}
+
+template <typename T>
+bool WriteElements(std::ostream &file, uint64_t offset, const T *data,
+                   uint64_t count) {
+  file.seekp(std::streamoff(offset * sizeof(T)));
+  file.write(reinterpret_cast<const char *>(data),
+             std::streamsize(count * sizeof(T)));
+  return bool(file);
+}
+
+//
+// Streams the elements of a sorted run, a range of a file, through a buffer of
+// 'block_count' elements. The readers of a merge share a file, so each refill
+// seeks to the position of its run.
+//
+template <typename ValueT>
+class RunReader {
+ public:
+  RunReader(std::istream &file, FileRange range, size_t block_count)
+      : file_(&file), next_(range.first), end_(range.second),
+        block_count_(block_count) {
+    Refill();
+  }
+
+  bool Done() const { return pos_ == buffer_.size(); }
+  const ValueT &Peek() const { return buffer_[pos_]; }
+
+  ValueT Next() {
+    ValueT v = buffer_[pos_++];
+    if (pos_ == buffer_.size()) {
+      Refill();
+    }
+    return v;
+  }
+
+  bool Failed() const { return failed_; }
+
+ private:
+  void Refill() {
+    const uint64_t count = std::min<uint64_t>(block_count_, end_ - next_);
+    buffer_.resize(count);
+    pos_ = 0;
+    if (count > 0 && !ReadElements(*file_, next_, buffer_.data(), count)) {
+      failed_ = true;
+      buffer_.clear();
+      next_ = end_;
+      return;
+    }
+    next_ += count;
+  }
+
+  std::istream *file_;
+  uint64_t next_, end_;
+  size_t block_count_;
+  std::vector<ValueT> buffer_;
+  size_t pos_ = 0;
+  bool failed_ = false;
+};
+
+//
+// A loser tree (tournament tree) that merges k sorted runs. Each internal node
+// holds the run that lost the match at that node, and node 0 holds the
+// overall winner, so popping an element only replays the matches on the path
+// from the winner's leaf to the root: log2(k) compares per element, against
+// the 2*log2(k) of a binary heap.
+// For more info see: https://en.wikipedia.org/wiki/K-way_merge_algorithm
+//
+template <typename ValueT, class Compare>
+class LoserTree {
+ public:
+  LoserTree(std::vector<RunReader<ValueT>> &runs, Compare comp)
+      : runs_(runs), comp_(comp), k_(runs.size()), losers_(runs.size(), 0) {
+    if (k_ == 0) {
+      return;
+    }
+
+    // play the initial tournament bottom-up: leaf i is node k + i
+    std::vector<size_t> winners(2 * k_);
+    for (size_t i = 0; i < k_; i++) {
+      winners[k_ + i] = i;
+    }
+    for (size_t n = k_ - 1; n > 0; n--) {
+      const size_t l = winners[2 * n];
+      const size_t r = winners[2 * n + 1];
+      const bool r_wins = Beats(r, l);
+      winners[n] = r_wins ? r : l;
+      losers_[n] = r_wins ? l : r;
+    }
+    losers_[0] = (k_ == 1) ? 0 : winners[1];
+  }
+
+  bool Empty() const { return k_ == 0 || runs_[losers_[0]].Done(); }
+
+  // remove and return the smallest element of the runs
+  ValueT Pop() {
+    size_t winner = losers_[0];
+    ValueT v = runs_[winner].Next();
+
+    // replay the matches of the winner's run up to the root
+    for (size_t n = (k_ + winner) / 2; n > 0; n /= 2) {
+      if (Beats(losers_[n], winner)) {
+        std::swap(losers_[n], winner);
+      }
+    }
+    losers_[0] = winner;
+    return v;
+  }
+
+ private:
+  // whether the head of run 'a' comes before the head of run 'b'. A run that
+  // is done loses every match
+  bool Beats(size_t a, size_t b) const {
+    if (runs_[a].Done()) return false;
+    if (runs_[b].Done()) return true;
+    return comp_(runs_[a].Peek(), runs_[b].Peek());
+  }
+
+  std::vector<RunReader<ValueT>> &runs_;
+  Compare comp_;
+  size_t k_;
+  std::vector<size_t> losers_;
+};
+
+//
+// The number of elements of the sorted run 'range' that come before 'value'
+// (a lower bound), found by a binary search of the file.
+//
+template <typename ValueT, class Compare>
+uint64_t RunLowerBound(std::istream &file, FileRange range,
+                       const ValueT &value, Compare comp) {
+  uint64_t lo = range.first, hi = range.second;
+  while (lo < hi) {
+    const uint64_t mid = lo + (hi - lo) / 2;
+    ValueT v;
+    ReadElements(file, mid, &v, 1);
+    if (comp(v, value)) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+//
+// Merge the sorted 'runs' of the file 'runs_path' into the file 'out_path'
+// using 'threads' threads. The output is split into one slice per thread by
+// splitter values sampled from the runs; every run is split at the splitters
+// by a binary search, and each thread merges its part of every run with a
+// loser tree into its own range of the output file. Returns false if a file
+// could not be read or written.
+//
+template <typename ValueT, class Compare>
+bool MergeRuns(const std::string &runs_path, const std::vector<FileRange> &runs,
+               const std::string &out_path, unsigned threads, Compare comp,
+               size_t block_count = 1 << 16) {
+  constexpr size_t kSamplesPerRun = 64;
+  const size_t k = runs.size();
+  threads = std::max(1u, threads);
+
+  uint64_t total = 0;
+  for (auto &r : runs) {
+    total += r.second - r.first;
+  }
+
+  // create the output file with its final size, so that the threads can
+  // write their slices in place
+  {
+    std::ofstream out(out_path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+      std::cerr << "ERROR: could not create '" << out_path << "'\n";
+      return false;
+    }
+    if (total > 0) {
+      const ValueT last{};
+      if (!WriteElements(out, total - 1, &last, 1)) {
+        std::cerr << "ERROR: could not write '" << out_path << "'\n";
+        return false;
+      }
+    }
+  }
+
+  std::ifstream runs_file(runs_path, std::ios::binary);
+  if (!runs_file) {
+    std::cerr << "ERROR: could not open '" << runs_path << "'\n";
+    return false;
+  }
+
+  // pick the splitters of the slices from evenly spaced samples of the runs
+  std::vector<ValueT> samples;
+  for (auto &r : runs) {
+    const uint64_t size = r.second - r.first;
+    const uint64_t n = std::min<uint64_t>(kSamplesPerRun, size);
+    for (uint64_t i = 0; i < n; i++) {
+      ValueT v;
+      ReadElements(runs_file, r.first + i * size / n, &v, 1);
+      samples.push_back(v);
+    }
+  }
+  std::sort(samples.begin(), samples.end(), comp);
+  if (samples.size() < threads) {
+    threads = 1;
+  }
+
+  // bounds[t][r] is the first element of run 'r' in slice 't'
+  std::vector<std::vector<uint64_t>> bounds(threads + 1,
+                                            std::vector<uint64_t>(k));
+  for (size_t r = 0; r < k; r++) {
+    bounds[0][r] = runs[r].first;
+    bounds[threads][r] = runs[r].second;
+  }
+  for (unsigned t = 1; t < threads; t++) {
+    const ValueT splitter = samples[t * samples.size() / threads];
+    for (size_t r = 0; r < k; r++) {
+      bounds[t][r] = RunLowerBound(runs_file, runs[r], splitter, comp);
+    }
+  }
+  if (!runs_file) {
+    std::cerr << "ERROR: could not read '" << runs_path << "'\n";
+    return false;
+  }
+
+  // merge the slices in parallel
+  std::vector<char> ok(threads, true);
+  std::vector<std::thread> workers;
+  uint64_t out_offset = 0;
+  for (unsigned t = 0; t < threads; t++) {
+    std::vector<FileRange> slice(k);
+    uint64_t slice_count = 0;
+    for (size_t r = 0; r < k; r++) {
+      slice[r] = {bounds[t][r], bounds[t + 1][r]};
+      slice_count += slice[r].second - slice[r].first;
+    }
+
+    workers.emplace_back([&, t, slice, out_offset] {
+      std::ifstream in(runs_path, std::ios::binary);
+      std::fstream out(out_path,
+                       std::ios::binary | std::ios::in | std::ios::out);
+      if (!in || !out) {
+        ok[t] = false;
+        return;
+      }
+
+      std::vector<RunReader<ValueT>> readers;
+      readers.reserve(k);
+      for (auto &range : slice) {
+        readers.emplace_back(in, range, block_count);
+      }
+      LoserTree<ValueT, Compare> tree(readers, comp);
+
+      // merge through a buffer of 'block_count' elements
+      std::vector<ValueT> buffer;
+      buffer.reserve(block_count);
+      uint64_t offset = out_offset;
+      while (!tree.Empty()) {
+        buffer.push_back(tree.Pop());
+        if (buffer.size() == block_count || tree.Empty()) {
+          ok[t] &= WriteElements(out, offset, buffer.data(), buffer.size());
+          offset += buffer.size();
+          buffer.clear();
+        }
+      }
+
+      for (auto &reader : readers) {
+        ok[t] &= !reader.Failed();
+      }
+    });
+
+    out_offset += slice_count;
+  }
+
+  for (auto &w : workers) {
+    w.join();
+  }
+
+  if (std::find(ok.begin(), ok.end(), false) != ok.end()) {
+    std::cerr << "ERROR: could not merge the runs of '" << runs_path
+              << "' into '" << out_path << "'\n";
+    return false;
+  }
+  return true;
+}
+
+#endif /* __EXTERNALSORT_HPP__ */
@@ -1,8 +1,13 @@
 #include <algorithm>
 #include <array>
 #include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <future>
 #include <limits>
 #include <numeric>
+#include <string>
+#include <thread>
 #include <type_traits>
 #include <utility>
 #include <vector>
@@ -12,7 +17,9 @@
 
 #include "exception_handler.hpp"
 
+#include "external_sort.hpp"
 #include "merge_sort.hpp"
+#include "sorter.hpp"
 
 // Included from include/
 #include "constexpr_math.hpp"
@@ -64,25 +71,112 @@ constexpr size_t kSortWidth = SORT_WIDTH;
 static_assert(kSortWidth >= 1);
 static_assert(fpga_tools::IsPow2(kSortWidth));
 
+// The size of the records to sort, in bytes.
+// This can be set by defining the preprocessor macro 'RECORD_BYTES'
+// otherwise 'int' values are sorted.
+//    8: an argsort of 32-bit keys. The sorter sorts {key, index} records and
+//       outputs the indices of the keys in sorted order.
+//   16: a key/value sort of {64-bit key, 64-bit payload} records
+//   32: a key/value sort of {64-bit key, 24-byte payload} records
+#ifndef RECORD_BYTES
+#define RECORD_BYTES 0
+#endif
+constexpr size_t kRecordBytes = RECORD_BYTES;
+static_assert(kRecordBytes == 0 || kRecordBytes == 8 || kRecordBytes == 16 ||
+              kRecordBytes == 32);
+
+// the type used to index in the sorter
+// below we do a runtime check to make sure this type has enough bits to
+// count all the elements to be sorted.
+using IndexT = unsigned int;
+
+////////////////////////////////////////////////////////////////////////////////
+// The types of the sort:
+//    InT: the type of the input elements
+//    ValueT: the type to sort, needs a compare function (SortCompare)!
+//    OutT: the type of the output elements
+// and the functions that convert the input elements to the values to sort
+// (ToValue), and the sorted values to the output elements (FromValue).
+#if RECORD_BYTES == 8
+using KeyT = unsigned int;
+using InT = KeyT;
+using ValueT = KeyValue<KeyT, IndexT>;
+using OutT = IndexT;
+
+struct ToValue {
+  ValueT operator()(const InT &key, IndexT i) const { return {key, i}; }
+};
+struct FromValue {
+  OutT operator()(const ValueT &v) const { return v.value; }
+};
+#elif RECORD_BYTES == 16 || RECORD_BYTES == 32
+// the payload of a record, which holds the index of the record in the input
+// (to validate the sort) followed by some padding
+struct Payload {
+  uint64_t index;
+  uint64_t data[(kRecordBytes - 16) / sizeof(uint64_t)];
+};
+
+using KeyT = uint64_t;
+using InT = KeyValue<KeyT, std::conditional_t<kRecordBytes == 16, uint64_t,
+                                              Payload>>;
+using ValueT = InT;
+using OutT = InT;
+
+struct ToValue {
+  ValueT operator()(const InT &in, IndexT) const { return in; }
+};
+struct FromValue {
+  OutT operator()(const ValueT &v) const { return v; }
+};
+#else
+using InT = int;
+using ValueT = InT;
+using OutT = InT;
+
+struct ToValue {
+  ValueT operator()(const InT &in, IndexT) const { return in; }
+};
+struct FromValue {
+  OutT operator()(const ValueT &v) const { return v; }
+};
+#endif
+static_assert(kRecordBytes == 0 || sizeof(ValueT) == kRecordBytes);
+
+// records are sorted by their key
+using SortCompare = std::conditional_t<kRecordBytes == 0, LessThan,
+                                       KeyLessThan<KeyOfKeyValue>>;
+
+// the sorter, which streams data from USM host or device allocations
+using FPGASorter = Sorter<ValueT, IndexT, kSortWidth, kMergeUnits,
+                          kUseUSMHostAllocation, SortCompare>;
 ////////////////////////////////////////////////////////////////////////////////
-// Forward declare functions used in this file by main()
-template <typename ValueT, typename IndexT, typename KernelPtrType>
-double FPGASort(queue &q, ValueT *in_vec, ValueT *out_vec, IndexT count);
 
-template <typename T>
-bool Validate(T *val, T *ref, unsigned int count);
 ////////////////////////////////////////////////////////////////////////////////
+// Forward declare functions used in this file by main()
+template <typename ValueT>
+ValueT PaddingElement();
 
+template <typename InT>
+void GenerateInput(std::vector<InT> &in_vec);
 
-int main(int argc, char *argv[]) {
-  // the type to sort, needs a compare function!
-  using ValueT = int;
+template <typename InT, typename OutT>
+bool Validate(const std::vector<InT> &in_vec, const std::vector<OutT> &out_vec,
+              IndexT count);
+
+bool SorterCanSort(uint64_t count);
 
-  // the type used to index in the sorter
-  // below we do a runtime check to make sure this type has enough bits to
-  // count all the elements to be sorted.
-  using IndexT = unsigned int;
+template <typename ValueT, typename Compare>
+bool ExternalSort(queue &q, const std::string &in_path,
+                  const std::string &out_path, IndexT run_count,
+                  unsigned threads, Compare comp);
+
+template <typename InT>
+bool GenerateInputFile(const std::string &path, uint64_t count);
+////////////////////////////////////////////////////////////////////////////////
 
+
+int main(int argc, char *argv[]) {
   /////////////////////////////////////////////////////////////
   // reading and validating the command line arguments
   // defaults
@@ -99,38 +193,93 @@ int main(int argc, char *argv[]) {
 #endif
   int seed = 777;
 
-  // get the size of the input as the first command line argument
-  if (argc > 1) {
-    count = atoi(argv[1]);
-  }
-
-  // get the number of runs as the second command line argument
-  if (argc > 2) {
-    runs = atoi(argv[2]);
+  // the external sort options (see ExternalSort)
+  std::string in_path, out_path;
+  uint64_t generate_count = 0;
+#if defined(FPGA_EMULATOR)
+  IndexT run_count = 1 << 10;
+#elif defined(FPGA_SIMULATOR)
+  IndexT run_count = 16;
+#else
+  IndexT run_count = 1 << 24;
+#endif
+  unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+
+  // the benchmark options: sort a batch of 'num_arrays' arrays of 'count'
+  // elements in one launch, or sweep the size of the sort up to 'count'
+  size_t num_arrays = 1;
+  bool sweep = false;
+
+  // The positional arguments are the size of the input, the number of runs
+  // and the random number generator seed. The '--' options select the
+  // external sort of a file, and the batch and sweep benchmarks.
+  int positional = 0;
+  for (int i = 1; i < argc; i++) {
+    std::string arg(argv[i]);
+    std::string str_after_equals = arg.substr(arg.find("=") + 1);
+
+    if (arg.rfind("--in=", 0) == 0) {
+      in_path = str_after_equals;
+    } else if (arg.rfind("--out=", 0) == 0) {
+      out_path = str_after_equals;
+    } else if (arg.rfind("--generate=", 0) == 0) {
+      generate_count = atoll(str_after_equals.c_str());
+    } else if (arg.rfind("--run-count=", 0) == 0) {
+      run_count = atoi(str_after_equals.c_str());
+    } else if (arg.rfind("--threads=", 0) == 0) {
+      threads = std::max(1, atoi(str_after_equals.c_str()));
+    } else if (arg.rfind("--batch=", 0) == 0) {
+      num_arrays = std::max(1, atoi(str_after_equals.c_str()));
+    } else if (arg == "--sweep") {
+      sweep = true;
+    } else if (arg.rfind("--", 0) == 0) {
+      std::cerr << "WARNING: ignoring unknown argument '" << arg << "'\n";
+    } else if (positional == 0) {
+      count = atoi(argv[i]);
+      positional++;
+    } else if (positional == 1) {
+      runs = atoi(argv[i]);
+      positional++;
+    } else if (positional == 2) {
+      seed = atoi(argv[i]);
+      positional++;
+    }
   }
+  const bool external_sort = !in_path.empty();
 
-  // get the random number generator seed as the third command line argument
-  if (argc > 3) {
-    seed = atoi(argv[3]);
+  // check the external sort args
+  if (external_sort) {
+    if (out_path.empty()) {
+      std::cerr << "ERROR: the external sort needs an output file (--out)\n";
+      std::terminate();
+    } else if (kRecordBytes == 8) {
+      std::cerr << "ERROR: the external sort does not support argsorts\n";
+      std::terminate();
+    } else if (!SorterCanSort(run_count)) {
+      std::cerr << "ERROR: the run count must be greater than the sorter "
+                << "width times the number of merge units\n";
+      std::terminate();
+    }
   }
 
   // enforce at least two runs
-  if (runs < 2) {
+  if (runs < 2 && !external_sort) {
     std::cerr << "ERROR: 'runs' must be 2 or more\n";
     std::terminate();
   }
 
   // check args
-  if (count <= kMergeUnits) {
-    std::cerr << "ERROR: 'count' must be greater than number of merge units\n";
+  if (external_sort) {
+    // the external sort is not limited by 'count'
+  } else if (count == 0 || (num_arrays == 1 && !SorterCanSort(count))) {
+    std::cerr << "ERROR: 'count' must be greater than the sorter width times "
+              << "the number of merge units, unless sorting a batch\n";
     std::terminate();
-  } else if (count > std::numeric_limits<IndexT>::max()) {
+  } else if (fpga_tools::RoundUpToMultiple(size_t(count), kSortWidth) *
+                 num_arrays > std::numeric_limits<IndexT>::max()) {
     std::cerr << "ERROR: the index type (IndexT) does not have enough bits to "
               << "count to 'count'\n";
     std::terminate();
-  } else if ((count % kSortWidth) != 0) {
-    std::cerr << "ERROR: 'count' must be a multiple of the sorter width\n";
-    std::terminate();
   }
   /////////////////////////////////////////////////////////////
 
@@ -169,88 +318,158 @@ int main(int argc, char *argv[]) {
             << device.get_info<sycl::info::device::name>().c_str() 
             << std::endl;
 
-  // the input, output, and reference data
-  std::vector<ValueT> in_vec(count), out_vec(count), ref(count);
+  // sort a file with the external sort
+  if (external_sort) {
+    if constexpr (kRecordBytes != 8) {
+      srand(seed);
+      if (generate_count > 0 &&
+          !GenerateInputFile<InT>(in_path, generate_count)) {
+        std::cout << "FAILED\n";
+        return 1;
+      }
+
+      try {
+        passed = ExternalSort<ValueT>(q, in_path, out_path, run_count,
+                                      threads, SortCompare());
+      } catch (exception const &e) {
+        std::cout << "Caught a synchronous SYCL exception: " << e.what()
+                  << "\n";
+        std::terminate();
+      }
+    }
+
+    std::cout << (passed ? "PASSED\n" : "FAILED\n");
+    return passed ? 0 : 1;
+  }
 
-  // generate some random input data
-  srand(seed);
-  std::generate(in_vec.begin(), in_vec.end(), [] { return rand() % 100; });
+  // the sizes of the arrays to sort: 'count', or a sweep of sizes up to
+  // 'count' that are not powers of 2
+  std::vector<IndexT> sizes;
+  if (sweep) {
+    // the smallest size is at least 1, so that the sweep ends for small counts
+    const IndexT min_size = std::max(count / 16, IndexT(1));
+    for (IndexT size = count; size >= min_size; size = size * 2 / 3) {
+      if (num_arrays == 1 && !SorterCanSort(size)) {
+        break;
+      }
+      sizes.insert(sizes.begin(), size);
+    }
+  } else {
+    sizes.push_back(count);
+  }
 
-  // copy the input to the output reference and compute the expected result
-  std::copy(in_vec.begin(), in_vec.end(), ref.begin());
-  std::sort(ref.begin(), ref.end());
+  // the input and output data
+  const size_t max_total_count = size_t(count) * num_arrays;
+  std::vector<InT> in_vec;
+  std::vector<OutT> out_vec(max_total_count);
 
   // allocate the input and output data either in USM host or device allocations
-  ValueT *in, *out;
+  InT *in;
+  OutT *out;
   if constexpr (kUseUSMHostAllocation) {
     // using USM host allocations
-    if ((in = malloc_host<ValueT>(count, q)) == nullptr) {
+    if ((in = malloc_host<InT>(max_total_count, q)) == nullptr) {
       std::cerr << "ERROR: could not allocate space for 'in' using "
                 << "malloc_host\n";
       std::terminate();
     }
-    if ((out = malloc_host<ValueT>(count, q)) == nullptr) {
+    if ((out = malloc_host<OutT>(max_total_count, q)) == nullptr) {
       std::cerr << "ERROR: could not allocate space for 'out' using "
                 << "malloc_host\n";
       std::terminate();
     }
-
-    // Copy the input to USM memory and reset the output.
-    // This is NOT efficient since, in the case of USM host allocations,
-    // we could have simply generated the input data into the host allocation
-    // and avoided this copy. However, it makes the code cleaner to assume the
-    // input is always in 'in_vec' and this portion of the code is not part of
-    // the performance timing.
-    std::copy(in_vec.begin(), in_vec.end(), in);
-    std::fill(out, out + count, ValueT(0));
   } else {
     // using device allocations
-    if ((in = malloc_device<ValueT>(count, q)) == nullptr) {
+    if ((in = malloc_device<InT>(max_total_count, q)) == nullptr) {
       std::cerr << "ERROR: could not allocate space for 'in' using "
                 << "malloc_device\n";
       std::terminate();
     }
-    if ((out = malloc_device<ValueT>(count, q)) == nullptr) {
+    if ((out = malloc_device<OutT>(max_total_count, q)) == nullptr) {
       std::cerr << "ERROR: could not allocate space for 'out' using "
                 << "malloc_device\n";
       std::terminate();
     }
-
-    // copy the input to the device memory and wait for the copy to finish
-    q.memcpy(in, in_vec.data(), count * sizeof(ValueT)).wait();
   }
 
   // track timing information, in ms
   std::vector<double> time(runs);
+  double avg_time_ms = 0;
 
   try {
+    // the sorter allocates its temporary buffers once, for the largest sort
+    const size_t capacity =
+        fpga_tools::RoundUpToMultiple(size_t(count), kSortWidth) * num_arrays;
+    FPGASorter sorter(q, capacity, PaddingElement<ValueT>());
+
     std::cout << "Running sort " << runs << " times for an "
               << "input size of " << count << " using " << kMergeUnits
               << " " << kSortWidth << "-way merge units\n";
+    if (num_arrays > 1) {
+      std::cout << "Sorting a batch of " << num_arrays << " arrays\n";
+    }
+    if constexpr (kRecordBytes == 8) {
+      std::cout << "Argsorting 32-bit keys as " << sizeof(ValueT)
+                << " byte {key, index} records\n";
+    } else if constexpr (kRecordBytes != 0) {
+      std::cout << "Sorting " << sizeof(ValueT)
+                << " byte {64-bit key, payload} records\n";
+    }
     std::cout << "Streaming data from "
               << (kUseUSMHostAllocation ? "host" : "device") << " memory\n";
 
-    // the pointer type for the kernel depends on whether data is coming from
-    // USM host or device allocations
-    using KernelPtrType =
-        typename std::conditional_t<kUseUSMHostAllocation, 
-                                    sycl::ext::intel::host_ptr<ValueT>,
-                                    sycl::ext::intel::device_ptr<ValueT>>;
-
-    // run the sort multiple times to increase the accuracy of the timing
-    for (int i = 0; i < runs; i++) {
-      // run the sort
-      time[i] = FPGASort<ValueT, IndexT, KernelPtrType>(q, in, out, count);
-
-      // Copy the output to 'out_vec'. In the case where we are using USM host
-      // allocations this is unnecessary since we could simply deference
-      // 'out'. However, it makes the following code cleaner since the output
-      // is always in 'out_vec' and this copy is not part of the performance
-      // timing.
-      q.memcpy(out_vec.data(), out, count * sizeof(ValueT)).wait();
-
-      // validate the output
-      passed &= Validate(out_vec.data(), ref.data(), count);
+    for (IndexT size : sizes) {
+      const size_t total_count = size_t(size) * num_arrays;
+
+      // generate some random input data for each array
+      srand(seed);
+      in_vec.clear();
+      for (IndexT b = 0; b < num_arrays; b++) {
+        std::vector<InT> array_vec(size);
+        GenerateInput(array_vec);
+        in_vec.insert(in_vec.end(), array_vec.begin(), array_vec.end());
+      }
+
+      // Copy the input to the USM allocation, and wait for the copy to
+      // finish. In the case of USM host allocations, we could have simply
+      // generated the input data into the host allocation and avoided this
+      // copy. However, it makes the code cleaner to assume the input is
+      // always in 'in_vec' and this portion of the code is not part of the
+      // performance timing.
+      q.memcpy(in, in_vec.data(), total_count * sizeof(InT)).wait();
+
+      // run the sort multiple times to increase the accuracy of the timing
+      for (int i = 0; i < runs; i++) {
+        // run the sort
+        time[i] = sorter.SortBatch(in, out, size, IndexT(num_arrays),
+                                   ToValue(), FromValue());
+
+        // Copy the output to 'out_vec'. In the case where we are using USM
+        // host allocations this is unnecessary since we could simply
+        // deference 'out'. However, it makes the following code cleaner since
+        // the output is always in 'out_vec' and this copy is not part of the
+        // performance timing.
+        q.memcpy(out_vec.data(), out, total_count * sizeof(OutT)).wait();
+
+        // validate the output of each array
+        for (IndexT b = 0; b < num_arrays; b++) {
+          std::vector<InT> array_in(in_vec.begin() + size_t(b) * size,
+                                    in_vec.begin() + size_t(b + 1) * size);
+          std::vector<OutT> array_out(out_vec.begin() + size_t(b) * size,
+                                      out_vec.begin() + size_t(b + 1) * size);
+          passed &= Validate(array_in, array_out, size);
+        }
+      }
+
+      // NOTE: when run in emulation, these results do not accurately
+      // represent the performance of the kernels in actual FPGA hardware
+      avg_time_ms =
+        std::accumulate(time.begin() + 1, time.end(), 0.0) / (runs - 1);
+      if (sweep) {
+        std::cout << "Size " << size << ": " << avg_time_ms << " ms, "
+                  << (total_count * 1e-6 / (avg_time_ms * 1e-3))
+                  << " Melements/s\n";
+      }
     }
   } catch (exception const &e) {
     std::cout << "Caught a synchronous SYCL exception: " << e.what() << "\n";
@@ -263,16 +482,16 @@ int main(int argc, char *argv[]) {
 
   // print the performance results
   if (passed) {
-    // NOTE: when run in emulation, these results do not accurately represent
-    // the performance of the kernels in actual FPGA hardware
-    double avg_time_ms =
-      std::accumulate(time.begin() + 1, time.end(), 0.0) / (runs - 1);
-
-    IndexT input_count_mega = count * 1e-6;
+    // the results of the sort of 'count' elements (the last size of a sweep)
+    const size_t total_count = size_t(count) * num_arrays;
+    double input_count_mega = total_count * 1e-6;
 
     std::cout << "Execution time: " << avg_time_ms << " ms\n";
     std::cout << "Throughput: " << (input_count_mega / (avg_time_ms * 1e-3))
               << " Melements/s\n";
+    std::cout << "Throughput: "
+              << (total_count * sizeof(ValueT) * 1e-6 / (avg_time_ms * 1e-3))
+              << " MB/s (" << sizeof(ValueT) << " byte elements)\n";
 
     std::cout << "PASSED\n";
     return 0;
@@ -282,146 +501,348 @@ int main(int argc, char *argv[]) {
   }
 }
 
-// forward declare the kernel and pipe IDs to reduce name mangling
-class InputKernelID;
-class OutputKernelID;
-class SortInPipeID;
-class SortOutPipeID;
+//
+// This is the element we will pad the input with. In the case of this design,
+// we are sorting from smallest to largest and we want the last elements out
+// to be this element, so pad with MAX. If you are sorting from largest to
+// smallest, make this the MIN element. Records are padded with the MAX key.
+//
+template <typename ValueT>
+ValueT PaddingElement() {
+  if constexpr (kRecordBytes == 0) {
+    return std::numeric_limits<ValueT>::max();
+  } else {
+    ValueT padding_element{};
+    padding_element.key =
+        std::numeric_limits<decltype(padding_element.key)>::max();
+    return padding_element;
+  }
+}
 
 //
-// perform the actual sort on the FPGA.
+// generate some random input data. The keys of the records use both halves of
+// their 64 bits, and their payloads hold the index of the record in the input
 //
-template <typename ValueT, typename IndexT, typename KernelPtrType>
-double FPGASort(queue &q, ValueT *in_ptr, ValueT *out_ptr, IndexT count) {
-  // the input and output pipe for the sorter
-  using SortInPipe =
-      sycl::ext::intel::pipe<SortInPipeID, sycl::vec<ValueT, kSortWidth>>;
-  using SortOutPipe =
-      sycl::ext::intel::pipe<SortOutPipeID, sycl::vec<ValueT, kSortWidth>>;
-
-  // the sorter must sort a power of 2, so round up the requested count
-  // to the nearest power of 2; we will pad the input to make sure the
-  // output is still correct
-  const IndexT sorter_count = fpga_tools::RoundUpPow2(count);
-
-  // allocate some memory for the merge sort to use as temporary storage
-  ValueT *buf_0, *buf_1;
-#if defined (IS_BSP)
-  if ((buf_0 = malloc_device<ValueT>(sorter_count, q)) == nullptr) {
-    std::cerr << "ERROR: could not allocate memory for 'buf_0'\n";
-    std::terminate();
+template <typename InT>
+void GenerateInput(std::vector<InT> &in_vec) {
+  for (size_t i = 0; i < in_vec.size(); i++) {
+    if constexpr (kRecordBytes == 0 || kRecordBytes == 8) {
+      in_vec[i] = rand() % 100;
+    } else {
+      in_vec[i].key = (uint64_t(rand() % 100) << 32) | uint64_t(rand() % 4);
+      if constexpr (kRecordBytes == 16) {
+        in_vec[i].value = i;
+      } else {
+        in_vec[i].value.index = i;
+        std::fill(std::begin(in_vec[i].value.data),
+                  std::end(in_vec[i].value.data), ~uint64_t(i));
+      }
+    }
   }
-  if ((buf_1 = malloc_device<ValueT>(sorter_count, q)) == nullptr) {
-    std::cerr << "ERROR: could not allocate memory for 'buf_1'\n";
-    std::terminate();
+}
+
+//
+// check the output of the sort. Since the sort is not stable, the records
+// with equal keys can be in any order, so for records (and argsorts) this
+// checks that the output is a permutation of the input in key order.
+//
+template <typename InT, typename OutT>
+bool Validate(const std::vector<InT> &in_vec, const std::vector<OutT> &out_vec,
+              IndexT count) {
+  if constexpr (kRecordBytes == 0) {
+    // compute the expected result
+    std::vector<ValueT> ref(in_vec.begin(), in_vec.begin() + count);
+    std::sort(ref.begin(), ref.end());
+
+    for (IndexT i = 0; i < count; i++) {
+      if (out_vec[i] != ref[i]) {
+        std::cout << "ERROR: mismatch at entry " << i << "\n";
+        std::cout << "\t" << out_vec[i] << " != " << ref[i]
+                  << " (val[i] != ref[i])\n";
+        return false;
+      }
+    }
+  } else {
+    std::vector<bool> seen(count, false);
+    uint64_t prev_key = 0;
+    for (IndexT i = 0; i < count; i++) {
+      // the index of the output element in the input
+      uint64_t idx;
+      if constexpr (kRecordBytes == 8) {
+        idx = out_vec[i];
+      } else if constexpr (kRecordBytes == 16) {
+        idx = out_vec[i].value;
+      } else {
+        idx = out_vec[i].value.index;
+      }
+
+      if (idx >= count || seen[idx]) {
+        std::cout << "ERROR: entry " << i << " is not a permutation of the "
+                  << "input (index " << idx << ")\n";
+        return false;
+      }
+      seen[idx] = true;
+
+      // the record must be the input record, with its payload
+      if constexpr (kRecordBytes > 8) {
+        if (std::memcmp(&out_vec[i], &in_vec[idx], sizeof(ValueT)) != 0) {
+          std::cout << "ERROR: the record at entry " << i << " does not match "
+                    << "the input record " << idx << "\n";
+          return false;
+        }
+      }
+
+      // the keys must be in order
+      const uint64_t key = KeyOfKeyValue()(ToValue()(in_vec[idx], idx));
+      if (i > 0 && key < prev_key) {
+        std::cout << "ERROR: the keys at entries " << i - 1 << " and " << i
+                  << " are out of order (" << prev_key << " > " << key
+                  << ")\n";
+        return false;
+      }
+      prev_key = key;
+    }
   }
-#else
-  if ((buf_0 = malloc_shared<ValueT>(sorter_count, q)) == nullptr) {
-    std::cerr << "ERROR: could not allocate memory for 'buf_0'\n";
-    std::terminate();
+
+  return true;
+}
+
+//
+// whether the FPGA can sort 'count' elements in a single array: each merge
+// unit needs more than 'kSortWidth' elements (see SubmitMergeSort)
+//
+bool SorterCanSort(uint64_t count) {
+  return count > kSortWidth * kMergeUnits;
+}
+
+//
+// An order independent checksum of some elements: the sum of a hash (FNV-1a)
+// of the bytes of each element. The external sort compares the checksums of
+// its input and output, since the input may be too large to keep around for
+// a full validation.
+//
+template <typename ValueT>
+uint64_t Checksum(const ValueT *data, size_t count) {
+  uint64_t sum = 0;
+  for (size_t i = 0; i < count; i++) {
+    const unsigned char *bytes =
+        reinterpret_cast<const unsigned char *>(&data[i]);
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t j = 0; j < sizeof(ValueT); j++) {
+      hash = (hash ^ bytes[j]) * 1099511628211ull;
+    }
+    sum += hash;
   }
-  if ((buf_1 = malloc_shared<ValueT>(sorter_count, q)) == nullptr) {
-    std::cerr << "ERROR: could not allocate memory for 'buf_1'\n";
+  return sum;
+}
+
+//
+// The external sort: sorts the file 'in_path', which can be larger than the
+// device memory, into the file 'out_path'.
+//  1. The input is sorted in runs of 'run_count' elements by the FPGA, and the
+//     sorted runs are written to a runs file. The transfers are double
+//     buffered: the next run is read from the input file, and the previous
+//     run is written to the runs file, while the FPGA sorts the current run.
+//  2. The sorted runs are merged into the output file on the host by
+//     'threads' threads, with a loser tree (see MergeRuns).
+// The 32-bit IndexT only has to count the elements of a run, so the size of
+// the input is only limited by the disk.
+//
+template <typename ValueT, typename Compare>
+bool ExternalSort(queue &q, const std::string &in_path,
+                  const std::string &out_path, IndexT run_count,
+                  unsigned threads, Compare comp) {
+  const std::string runs_path = out_path + ".runs";
+
+  std::error_code ec;
+  const uint64_t bytes = std::filesystem::file_size(in_path, ec);
+  if (ec || (bytes % sizeof(ValueT)) != 0) {
+    std::cerr << "ERROR: '" << in_path << "' is not a file of "
+              << sizeof(ValueT) << " byte elements\n";
+    return false;
+  }
+  const uint64_t total = bytes / sizeof(ValueT);
+  const uint64_t num_runs = (total + run_count - 1) / run_count;
+
+  std::ifstream in_file(in_path, std::ios::binary);
+  std::ofstream runs_file(runs_path, std::ios::binary | std::ios::trunc);
+  if (!in_file || !runs_file) {
+    std::cerr << "ERROR: could not open '" << in_path << "' or create '"
+              << runs_path << "'\n";
+    return false;
+  }
+
+  std::cout << "Sorting " << total << " elements of '" << in_path
+            << "' in " << num_runs << " runs of " << run_count
+            << " elements using " << kMergeUnits << " " << kSortWidth
+            << "-way merge units, and merging them using " << threads
+            << " threads\n";
+
+  // the sorter, and the device buffers of a run, which are allocated once
+  Sorter<ValueT, IndexT, kSortWidth, kMergeUnits, kUseUSMHostAllocation,
+         Compare>
+      sorter(q, run_count, PaddingElement<ValueT>(), comp);
+  ValueT *in, *out;
+  if constexpr (kUseUSMHostAllocation) {
+    in = malloc_host<ValueT>(run_count, q);
+    out = malloc_host<ValueT>(run_count, q);
+  } else {
+    in = malloc_device<ValueT>(run_count, q);
+    out = malloc_device<ValueT>(run_count, q);
+  }
+  if (in == nullptr || out == nullptr) {
+    std::cerr << "ERROR: could not allocate space for the runs\n";
     std::terminate();
   }
-#endif
 
-  // This is the element we will pad the input with. In the case of this design,
-  // we are sorting from smallest to largest and we want the last elements out
-  // to be this element, so pad with MAX. If you are sorting from largest to
-  // smallest, make this the MIN element. If you are sorting custom types
-  // which are not supported by std::numeric_limits, then you will have to set
-  // this padding element differently.
-  const auto padding_element = std::numeric_limits<ValueT>::max();
-
-  // We are sorting kSortWidth elements per cycle, so we will have 
-  // sorter_count/kSortWidth pipe reads/writes from/to the sorter
-  const IndexT total_pipe_accesses = sorter_count / kSortWidth;
-
-  // launch the kernel that provides data into the sorter
-  auto input_kernel_event =
-    q.single_task<InputKernelID>([=]() [[intel::kernel_args_restrict]] {
-      // read from the input pointer and write it to the sorter's input pipe
-      KernelPtrType in(in_ptr);
-
-      for (IndexT i = 0; i < total_pipe_accesses; i++) {
-        // read data from device memory
-        bool in_range = i * kSortWidth < count;
-
-        // build the input pipe data
-        sycl::vec<ValueT, kSortWidth> data;
-        #pragma unroll
-        for (unsigned char j = 0; j < kSortWidth; j++) {
-          data[j] = in_range ? in[i * kSortWidth + j] : padding_element;
-        }
+  // the double buffered runs on the host
+  std::vector<ValueT> in_buf[2], out_buf[2];
+  for (int b = 0; b < 2; b++) {
+    in_buf[b].resize(run_count);
+    out_buf[b].resize(run_count);
+  }
+  auto run_size = [&](uint64_t r) {
+    return std::min<uint64_t>(run_count, total - r * run_count);
+  };
 
-        // write it into the sorter
-        SortInPipe::write(data);
-      }
-    });
+  bool passed = true;
+  uint64_t in_checksum = 0;
+  std::vector<FileRange> runs;
+  double fpga_time = 0;
+  auto start = high_resolution_clock::now();
 
-  // launch the kernel that reads out data from the sorter
-  auto output_kernel_event =
-    q.single_task<OutputKernelID>([=]() [[intel::kernel_args_restrict]] {
-      // read from the sorter's output pipe and write to the output pointer
-      KernelPtrType out(out_ptr);
-      
-      for (IndexT i = 0; i < total_pipe_accesses; i++) {
-        // read data from the sorter
-        auto data = SortOutPipe::read();
-
-        // sorter_count is a multiple of kSortWidth
-        bool in_range = i * kSortWidth < count;
-
-        // only write out to device memory if the index is in range
-        if (in_range) {
-          // write output to device memory
-          #pragma unroll
-          for (unsigned char j = 0; j < kSortWidth; j++) {
-            out[i * kSortWidth + j] = data[j];
-          }
-        }
-      }
+  // 1. sort the runs
+  std::future<bool> read_future, write_future;
+  if (num_runs > 0) {
+    passed &= ReadElements(in_file, 0, in_buf[0].data(), run_size(0));
+  }
+  for (uint64_t r = 0; r < num_runs && passed; r++) {
+    const int b = r % 2;
+    const uint64_t begin = r * run_count;
+    const uint64_t count = run_size(r);
+
+    // wait for this run, then start reading the next one
+    if (read_future.valid()) {
+      passed &= read_future.get();
+    }
+    if (r + 1 < num_runs) {
+      read_future = std::async(std::launch::async, [&, r] {
+        return ReadElements(in_file, (r + 1) * run_count,
+                            in_buf[(r + 1) % 2].data(), run_size(r + 1));
+      });
+    }
+
+    // sort the run on the FPGA. A last run that is too short for the merge
+    // units (see SorterCanSort) is sorted on the host
+    if (SorterCanSort(count)) {
+      q.memcpy(in, in_buf[b].data(), count * sizeof(ValueT)).wait();
+      fpga_time += sorter.Sort(in, out, IndexT(count), ToValue(), FromValue());
+      q.memcpy(out_buf[b].data(), out, count * sizeof(ValueT)).wait();
+    } else {
+      std::copy(in_buf[b].begin(), in_buf[b].begin() + count,
+                out_buf[b].begin());
+      std::sort(out_buf[b].begin(), out_buf[b].begin() + count, comp);
+    }
+    runs.push_back({begin, begin + count});
+    in_checksum += Checksum(in_buf[b].data(), count);
+
+    // wait for the previous run to be written, then start writing this one
+    if (write_future.valid()) {
+      passed &= write_future.get();
+    }
+    write_future = std::async(std::launch::async, [&, b, begin, count] {
+      return WriteElements(runs_file, begin, out_buf[b].data(), count);
     });
+  }
+  if (read_future.valid()) {
+    passed &= read_future.get();
+  }
+  if (write_future.valid()) {
+    passed &= write_future.get();
+  }
+  runs_file.close();
+  passed &= !runs_file.fail();
+  auto runs_end = high_resolution_clock::now();
+
+  sycl::free(in, q);
+  sycl::free(out, q);
 
-  // launch the merge sort kernels
-  auto merge_sort_events =
-      SubmitMergeSort<ValueT, IndexT, SortInPipe, SortOutPipe, kSortWidth,
-                      kMergeUnits>(q, sorter_count, buf_0, buf_1);
+  if (!passed) {
+    std::cerr << "ERROR: could not read '" << in_path << "' or write '"
+              << runs_path << "'\n";
+    std::remove(runs_path.c_str());
+    return false;
+  }
 
-  // wait for the input and output kernels to finish
-  auto start = high_resolution_clock::now();
-  input_kernel_event.wait();
-  output_kernel_event.wait();
+  // 2. merge the sorted runs. A single run is already the output
+  if (runs.size() <= 1) {
+    std::filesystem::rename(runs_path, out_path, ec);
+    passed = !ec;
+  } else {
+    passed = MergeRuns<ValueT>(runs_path, runs, out_path, threads, comp);
+    std::remove(runs_path.c_str());
+  }
   auto end = high_resolution_clock::now();
-
-  // wait for the merge sort kernels to finish
-  for (auto &e : merge_sort_events) {
-    e.wait();
+  if (!passed) {
+    std::cerr << "ERROR: could not write '" << out_path << "'\n";
+    return false;
   }
 
-  // free the memory allocated for the merge sort temporary buffers
-  sycl::free(buf_0, q);
-  sycl::free(buf_1, q);
+  duration<double, std::milli> runs_time = runs_end - start;
+  duration<double, std::milli> merge_time = end - runs_end;
+  duration<double, std::milli> total_time = end - start;
+  std::cout << "Run formation time: " << runs_time.count() << " ms ("
+            << fpga_time << " ms sorting on the FPGA)\n";
+  std::cout << "Merge time: " << merge_time.count() << " ms\n";
+  std::cout << "Throughput: " << (bytes * 1e-6 / (total_time.count() * 1e-3))
+            << " MB/s (" << sizeof(ValueT) << " byte elements)\n";
+
+  // validate the output: the elements must be in order, and be the elements
+  // of the input
+  std::ifstream out_file(out_path, std::ios::binary);
+  std::vector<ValueT> block(run_count);
+  uint64_t out_checksum = 0;
+  ValueT prev{};
+  for (uint64_t i = 0; i < total; i += run_count) {
+    const uint64_t count = std::min<uint64_t>(run_count, total - i);
+    if (!ReadElements(out_file, i, block.data(), count)) {
+      std::cout << "ERROR: could not read '" << out_path << "'\n";
+      return false;
+    }
+    for (uint64_t j = 0; j < count; j++) {
+      if ((i + j) > 0 && comp(block[j], prev)) {
+        std::cout << "ERROR: the elements " << i + j - 1 << " and " << i + j
+                  << " of the output are out of order\n";
+        return false;
+      }
+      prev = block[j];
+    }
+    out_checksum += Checksum(block.data(), count);
+  }
+  if (out_checksum != in_checksum) {
+    std::cout << "ERROR: the output is not a permutation of the input\n";
+    return false;
+  }
 
-  // return the duration of the sort in milliseconds, excluding memory transfers
-  duration<double, std::milli> diff = end - start;
-  return diff.count();
+  return true;
 }
 
 //
-// simple function to check if two regions of memory contain the same values
+// write 'count' random elements (see GenerateInput) to the file 'path'
 //
-template <typename T>
-bool Validate(T *val, T *ref, unsigned int count) {
-  for (unsigned int i = 0; i < count; i++) {
-    if (val[i] != ref[i]) {
-      std::cout << "ERROR: mismatch at entry " << i << "\n";
-      std::cout << "\t" << val[i] << " != " << ref[i]
-                << " (val[i] != ref[i])\n";
-      return false;
-    }
+template <typename InT>
+bool GenerateInputFile(const std::string &path, uint64_t count) {
+  constexpr uint64_t kBlockCount = 1 << 20;
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  std::vector<InT> block;
+  for (uint64_t i = 0; i < count && file; i += kBlockCount) {
+    block.resize(std::min(kBlockCount, count - i));
+    GenerateInput(block);
+    WriteElements(file, i, block.data(), block.size());
+  }
+  if (!file) {
+    std::cerr << "ERROR: could not write '" << path << "'\n";
+    return false;
   }
-
   return true;
 }
@@ -12,29 +12,96 @@
 using namespace sycl;
 
 //
-// Streams in two sorted list of size 'in_count`, 'k_width' elements at a time,
-// from both InPipeA and InPipeB and merges them into a single sorted list of
-// size 'in_count*2' to OutPipe. This merges two sorted lists of size in_count
-// at a rate of 'k_width' elements per cycle.
+// Walks the pairs of sorted sublists that one iteration of the merge sort
+// merges. The 'total_count' elements are split into segments of
+// 'segment_count' elements (the last one can be shorter), which are sorted
+// independently, and each segment is split into consecutive pairs of sublists
+// of 'in_count' elements: 'a_count' elements from the A side followed by
+// 'b_count' elements from the B side. The last pair of a segment can have
+// shorter sublists, or no B sublist, so the counts do not have to be powers
+// of 2. All counts must be multiples of the width of the sort.
+//
+template <typename IndexT>
+struct MergePairs {
+  MergePairs(IndexT total_count, IndexT in_count, IndexT segment_count)
+      : total(total_count), in(in_count), segment(segment_count) {
+    segment_left = (segment < total) ? segment : total;
+    Set();
+  }
+
+  // move to the next pair
+  void Next() {
+    start += a_count + b_count;
+    if (segment_left == 0) {
+      const IndexT left = total - start;
+      segment_left = (segment < left) ? segment : left;
+    }
+    Set();
+  }
+
+  // the number of elements of the pair on one side
+  IndexT Count(bool b_side) const { return b_side ? b_count : a_count; }
+
+  IndexT total, in, segment;
+  IndexT segment_left;  // the elements of the segment after this pair
+  IndexT start = 0;     // the offset of this pair
+  IndexT a_count, b_count;
+
+ private:
+  void Set() {
+    a_count = (in < segment_left) ? in : segment_left;
+    const IndexT left = segment_left - a_count;
+    b_count = (in < left) ? in : left;
+    segment_left = left - b_count;
+  }
+};
+
+//
+// The total number of elements on one side ('b_side') of the pairs of an
+// iteration of the merge sort (see MergePairs), computed on the host
+//
+template <typename IndexT>
+IndexT MergePairsCount(IndexT total_count, IndexT in_count,
+                       IndexT segment_count, bool b_side) {
+  auto side_count = [&](IndexT count) {
+    const IndexT full_pairs = count / (2 * in_count);
+    const IndexT rem = count % (2 * in_count);
+    const IndexT a =
+        full_pairs * in_count + ((rem < in_count) ? rem : in_count);
+    return b_side ? count - a : a;
+  };
+  return (total_count / segment_count) * side_count(segment_count) +
+         side_count(total_count % segment_count);
+}
+
+//
+// Streams in pairs of sorted lists, 'k_width' elements at a time, from
+// InPipeA and InPipeB and merges each pair into a single sorted list to
+// OutPipe, at a rate of 'k_width' elements per cycle. The pairs are those of
+// a MergePairs: lists of up to 'in_count' elements, within segments of
+// 'segment_count' elements. A list without a B side is streamed through.
 //
 template <typename Id, typename ValueT, typename IndexT, typename InPipeA,
           typename InPipeB, typename OutPipe, unsigned char k_width,
           class CompareFunc>
 event Merge(queue& q, IndexT total_count, IndexT in_count,
-            CompareFunc compare) {
+            IndexT segment_count, CompareFunc compare) {
   // sanity check on k_width
   static_assert(k_width >= 1);
   static_assert(fpga_tools::IsPow2(k_width));
 
-  // merging two lists of size 'in_count' into a single output list of
-  // double the size
-  const IndexT out_count = in_count * 2;
-
   return q.single_task<Id>([=] {
+    // the pair of lists being merged
+    MergePairs<IndexT> pairs(total_count, in_count, segment_count);
+
+    // the number of elements of the merged list of the pair
+    IndexT out_count = pairs.a_count + pairs.b_count;
+
     // the two input and feedback buffers
-    sycl::vec<ValueT, k_width> a, b, network_feedback;
+    SortVec<ValueT, k_width> a, b, network_feedback;
 
-    bool drain_a = false;
+    // a list without a B side is drained from A
+    bool drain_a = (pairs.b_count == 0);
     bool drain_b = false;
     bool a_valid = false;
     bool b_valid = false;
@@ -48,8 +115,8 @@ event Merge(queue& q, IndexT total_count, IndexT in_count,
     // read the last inputs from the input pipes
     bool read_from_a_is_last = false; // (0 == in_count)
     bool read_from_b_is_last = false; // (0 == in_count)
-    bool next_read_from_a_is_last = (k_width == in_count);
-    bool next_read_from_b_is_last = (k_width == in_count);
+    bool next_read_from_a_is_last = (k_width == pairs.a_count);
+    bool next_read_from_b_is_last = (k_width == pairs.b_count);
 
     // track the number of elements we have written to the output pipe
     // for each sublist (counts up to 'out_count')
@@ -72,7 +139,7 @@ event Merge(queue& q, IndexT total_count, IndexT in_count,
         a = InPipeA::read();
         a_valid = true;
         read_from_a_is_last = next_read_from_a_is_last;
-        next_read_from_a_is_last = (read_from_a == in_count-2*k_width);
+        next_read_from_a_is_last = (read_from_a == pairs.a_count-2*k_width);
         read_from_a += k_width;
       }
 
@@ -81,7 +148,7 @@ event Merge(queue& q, IndexT total_count, IndexT in_count,
         b = InPipeB::read();
         b_valid = true;
         read_from_b_is_last = next_read_from_b_is_last;
-        next_read_from_b_is_last = (read_from_b == in_count-2*k_width);
+        next_read_from_b_is_last = (read_from_b == pairs.b_count-2*k_width);
         read_from_b += k_width;
       }
 
@@ -90,7 +157,7 @@ event Merge(queue& q, IndexT total_count, IndexT in_count,
       auto chosen_data_in = choose_a ? a : b;
 
       // create input for merge sort network sorter network
-      sycl::vec<ValueT, k_width * 2> merge_sort_network_data;
+      SortVec<ValueT, k_width * 2> merge_sort_network_data;
       #pragma unroll
       for (unsigned char i = 0; i < k_width; i++) {
         // populate the k_width*2 sized input for the merge sort network
@@ -115,7 +182,7 @@ event Merge(queue& q, IndexT total_count, IndexT in_count,
         b_valid = choose_a;
         first_in_buffer = false;
       } else {
-        sycl::vec<ValueT, k_width> out_data;
+        SortVec<ValueT, k_width> out_data;
         if (written_out_inner == out_count - k_width) {
           // on the last iteration for a set of sublists, the feedback
           // is the only data left that is valid, so it goes to the output
@@ -133,10 +200,12 @@ event Merge(queue& q, IndexT total_count, IndexT in_count,
         OutPipe::write(out_data);
         written_out += k_width;
 
-        // check if switching to a new set of 'in_count' sorted sublists
+        // check if switching to the next pair of sorted sublists
         if (written_out_inner == out_count - k_width) {
           // switching, so reset all internal counters and flags
-          drain_a = false;
+          pairs.Next();
+          out_count = pairs.a_count + pairs.b_count;
+          drain_a = (pairs.b_count == 0);
           drain_b = false;
           a_valid = false;
           b_valid = false;
@@ -144,8 +213,8 @@ event Merge(queue& q, IndexT total_count, IndexT in_count,
           read_from_b = 0;
           read_from_a_is_last = false; // (0 == in_count)
           read_from_b_is_last = false; // (0 == in_count)
-          next_read_from_a_is_last = (k_width == in_count);
-          next_read_from_b_is_last = (k_width == in_count);
+          next_read_from_a_is_last = (k_width == pairs.a_count);
+          next_read_from_b_is_last = (k_width == pairs.b_count);
           written_out_inner = 0;
           first_in_buffer = true;
         } else {
@@ -1,6 +1,7 @@
 #ifndef __MERGESORT_HPP__
 #define __MERGESORT_HPP__
 
+#include <algorithm>
 #include <array>
 #include <iostream>
 #include <limits>
@@ -37,6 +38,45 @@ struct GreaterThan {
     return a > b;
   }
 };
+
+// Comparators that sort records by a key. 'KeyOf' is a key extractor: a
+// functor that returns the key of a record. The key can be any type with
+// operator< (e.g., a 64-bit integer), so records can be sorted by several
+// columns with a key extractor that packs the columns into a single key.
+template <class KeyOf>
+struct KeyLessThan {
+  template <class T>
+  bool operator()(T const& a, T const& b) const {
+    return KeyOf()(a) < KeyOf()(b);
+  }
+};
+
+template <class KeyOf>
+struct KeyGreaterThan {
+  template <class T>
+  bool operator()(T const& a, T const& b) const {
+    return KeyOf()(b) < KeyOf()(a);
+  }
+};
+///////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////
+// A record of a key/value sort: the key and the payload that moves with it
+// through the sorter. For an argsort, the payload is the index of the key in
+// the input.
+template <typename KeyT, typename PayloadT>
+struct KeyValue {
+  KeyT key;
+  PayloadT value;
+};
+
+// The key extractor of a KeyValue, e.g. KeyLessThan<KeyOfKeyValue>
+struct KeyOfKeyValue {
+  template <typename KeyT, typename PayloadT>
+  KeyT operator()(KeyValue<KeyT, PayloadT> const& kv) const {
+    return kv.key;
+  }
+};
 ///////////////////////////////////////////////////////////////
 
 ///////////////////////////////////////////////////////////////
@@ -65,16 +105,54 @@ class MergeTreeMergeKernelID;
 class InternalMergeTreePipeID;
 ///////////////////////////////////////////////////////////////
 
+//
+// The number of elements each merge unit sorts. The elements are split evenly
+// across the merge units, in multiples of 'k_width', and the segments of a
+// batch (see SubmitMergeSort) are never split across merge units.
+//
+template <unsigned char k_width, size_t units>
+size_t MergeSortCountPerUnit(size_t count, size_t segment_count) {
+  if (segment_count < count) {
+    const size_t segments = (count + segment_count - 1) / segment_count;
+    return ((segments + units - 1) / units) * segment_count;
+  } else {
+    const size_t count_per_unit = (count + units - 1) / units;
+    return fpga_tools::RoundUpToMultiple(count_per_unit, size_t(k_width));
+  }
+}
+
+//
+// The number of iterations of the merge units to sort 'count' elements in
+// segments of 'segment_count' elements. The merge units write the output of
+// their last iteration to the temporary buffer with the index
+// (iterations % 2), unless it goes to the merge tree.
+//
+template <unsigned char k_width, size_t units>
+size_t MergeSortIterations(size_t count, size_t segment_count) {
+  const size_t count_per_unit =
+      MergeSortCountPerUnit<k_width, units>(count, segment_count);
+  const size_t sorted_count = std::min(count_per_unit, segment_count);
+  return fpga_tools::CeilLog2(sorted_count / k_width);
+}
+
 //
 // Submits all of the merge sort kernels necessary to sort 'count' elements.
 // Returns all of the events for the caller to wait on.
 // NOTE: there is no need to worry about returing a std::vector by value here;
 // C++ return-value-optimization (RVO) will take care of it!
 //
+// 'count' can be any multiple of 'k_width'; it does not have to be a power
+// of 2. If 'segment_count' is less than 'count', the input is a batch of
+// arrays of 'segment_count' elements (the last one can be shorter), which
+// are sorted independently in the same launch of the kernels. The sorted
+// arrays of a batch are written to one of the temporary buffers (see
+// MergeSortIterations), instead of streaming out of 'OutPipe'.
+//
 template <typename ValueT, typename IndexT, typename InPipe, typename OutPipe,
           unsigned char k_width, size_t units, typename Compare>
 std::vector<event> SubmitMergeSort(queue& q, size_t count, ValueT* buf_0,
-                                   ValueT* buf_1, Compare comp) {
+                                   ValueT* buf_1, Compare comp,
+                                   size_t segment_count = 0) {
   // sanity check the number of merge units and the width of the sorter
   static_assert(units >= 1);
   static_assert(fpga_tools::IsPow2(units));
@@ -95,7 +173,7 @@ std::vector<event> SubmitMergeSort(queue& q, size_t count, ValueT* buf_0,
   constexpr size_t kDefPipeDepth = 0;
 
   // the type that is passed around the pipes
-  using PipeType = sycl::vec<ValueT, k_width>;
+  using PipeType = SortVec<ValueT, k_width>;
 
   // the pipes connecting the different kernels of each merge unit
   // one set of pipes for each 'units' merge units
@@ -129,24 +207,27 @@ std::vector<event> SubmitMergeSort(queue& q, size_t count, ValueT* buf_0,
   // depth of the merge tree to reduce the sorted partitions of each merge unit
   constexpr size_t kReductionLevels = fpga_tools::Log2(units);
 
+  // a single sort is a batch of one array
+  const bool batch = (segment_count != 0 && segment_count < count);
+  if (!batch) {
+    segment_count = count;
+  }
+
   // validate 'count'
   if (count == 0) {
     std::cerr << "ERROR: 'count' must be greater than 0\n";
     std::terminate();
-  } else if (!fpga_tools::IsPow2(count)) {
-    std::cerr << "ERROR: 'count' must be a power of 2\n";
-    std::terminate();
-  } else if (count < 4 * units) {
-    std::cerr << "ERROR: 'count' must be at least 4x greater than "
-              << "the number of merge units (" << units << ")\n";
+  } else if ((count % k_width) != 0 || (segment_count % k_width) != 0) {
+    std::cerr << "ERROR: 'count' and 'segment_count' must be multiples of "
+              << "k_width\n";
     std::terminate();
   } else if (count > std::numeric_limits<IndexT>::max()) {
     std::cerr << "ERROR: the index type does not have enough bits to count to "
               << "'count'\n";
     std::terminate();
-  } else if ((count / units) <= k_width) {
-    std::cerr << "ERROR: 'count/units' (elements per merge unit) "
-              << "must be greater than k_width\n";
+  } else if (!batch && count <= units * k_width) {
+    std::cerr << "ERROR: 'count' must be greater than k_width times the "
+              << "number of merge units (" << units << ")\n";
     std::terminate();
   }
 
@@ -169,18 +250,25 @@ std::vector<event> SubmitMergeSort(queue& q, size_t count, ValueT* buf_0,
   unsigned buf_idx = 0;
   auto next_buf_idx = [](unsigned buf_idx) { return buf_idx ^ 0x1; };
 
-  // the number of elements each merge unit will sort
-  const IndexT count_per_unit = count / units;
-
-  // each producer will produce half of the data for each merge unit
-  const IndexT half_count_per_unit = count_per_unit / 2;
+  // the number of elements each merge unit will sort. The last merge units
+  // can have fewer elements, or none at all
+  const IndexT count_per_unit =
+      MergeSortCountPerUnit<k_width, units>(count, segment_count);
+  auto unit_count = [&](size_t first_unit, size_t num_units) {
+    const size_t begin = std::min(count, first_unit * count_per_unit);
+    const size_t end =
+        std::min(count, (first_unit + num_units) * count_per_unit);
+    return IndexT(end - begin);
+  };
 
   // the number of sorting iterations each merge unit will perform
-  // NOTE: we subtract log2(k_width) because the bitonic sorting network
-  // performs the first log2(k_width) iterations of the sort while streaming
-  // the input data from the input pipe into device memory.
+  // NOTE: this is log2(k_width) fewer iterations than for single elements
+  // because the bitonic sorting network performs the first log2(k_width)
+  // iterations of the sort while streaming the input data from the input
+  // pipe into device memory. A merge unit with fewer elements than the
+  // others streams its sorted list through its last iterations.
   const IndexT iterations =
-    fpga_tools::Log2(count_per_unit) - fpga_tools::Log2(k_width);
+      MergeSortIterations<k_width, units>(count, segment_count);
 
   // store the various merge unit and merge tree kernel events
   std::array<std::vector<event>, units> produce_a_events, produce_b_events,
@@ -209,8 +297,9 @@ std::vector<event> SubmitMergeSort(queue& q, size_t count, ValueT* buf_0,
 
   // perform the sort iterations for each merge unit
   for (size_t i = 0; i < iterations; i++) {
-    // The Consume kernels will write to a pipe on the last iteration
-    bool consumer_to_pipe = (i == (iterations - 1));
+    // The Consume kernels will write to a pipe on the last iteration, unless
+    // the sorted arrays of a batch go to device memory
+    bool consumer_to_pipe = (i == (iterations - 1)) && !batch;
 
     // launch the merge unit kernels for this iteration of the sort using
     // a front-end meta-programming unroller
@@ -244,6 +333,7 @@ std::vector<event> SubmitMergeSort(queue& q, size_t count, ValueT* buf_0,
       // the temporary device buffers reside in a single device allocation,
       // so compute the offset into the buffer for each merge unit.
       const size_t unit_buf_offset = count_per_unit * u;
+      const IndexT unit_total_count = unit_count(u, 1);
 
       // get device pointers for this merge unit's Produce and Consume kernels
       ValueT* in_buf = buf[buf_idx];
@@ -253,19 +343,20 @@ std::vector<event> SubmitMergeSort(queue& q, size_t count, ValueT* buf_0,
       // Enqueue the merge unit kernels
       // Produce A
       produce_a_events[u][i] =
-        SubmitProduceA(q, in_buf, half_count_per_unit, in_count,
-                       unit_buf_offset, wait_events);
+          SubmitProduceA(q, in_buf, unit_total_count, in_count,
+                         segment_count, unit_buf_offset, false, wait_events);
 
       // Produce B
       produce_b_events[u][i] =
-          SubmitProduceB(q, in_buf, half_count_per_unit, in_count,
-                         unit_buf_offset + half_count_per_unit, wait_events);
+          SubmitProduceB(q, in_buf, unit_total_count, in_count,
+                         segment_count, unit_buf_offset, true, wait_events);
 
       // Merge
-      merge_events[u][i] = SubmitMerge(q, count_per_unit, in_count, comp);
+      merge_events[u][i] =
+          SubmitMerge(q, unit_total_count, in_count, segment_count, comp);
 
       // Consume
-      consume_events[u][i] = SubmitConsume(q, out_buf, count_per_unit,
+      consume_events[u][i] = SubmitConsume(q, out_buf, unit_total_count,
                                            unit_buf_offset, consumer_to_pipe);
       ////////////////////////////////////////////////////////////////////////
     });
@@ -344,13 +435,20 @@ std::vector<event> SubmitMergeSort(queue& q, size_t count, ValueT* buf_0,
           typename std::conditional_t<(level == (kReductionLevels - 1)),
                                       OutPipe, MTOutPipeToMT>;
 
-      // Launch the merge kernel
-      const auto e = SubmitMTMerge(q, in_count * 2, in_count, comp);
+      // Launch the merge kernel, which merges the sorted lists of the merge
+      // units of its two inputs. The merge units are filled in order, so the
+      // A list is never shorter than the B list. The merge tree is idle for
+      // a batch, since its sorted arrays go to device memory.
+      constexpr size_t kInputUnits = size_t(1) << level;
+      const IndexT a_count =
+          batch ? 0 : unit_count(merge_unit * 2 * kInputUnits, kInputUnits);
+      const IndexT b_count =
+          batch ? 0
+                : unit_count((merge_unit * 2 + 1) * kInputUnits, kInputUnits);
+      const auto e = SubmitMTMerge(q, a_count + b_count, a_count,
+                                   a_count + b_count, comp);
       mt_merge_events[level].push_back(e);
     });
-
-    // increase the input size
-    in_count *= 2;
   });
   ////////////////////////////////////////////////////////////////////////////
 
@@ -388,9 +486,9 @@ std::vector<event> SubmitMergeSort(queue& q, size_t count, ValueT* buf_0,
 template <typename ValueT, typename IndexT, typename InPipe, typename OutPipe,
           unsigned char k_width, size_t units>
 std::vector<event> SubmitMergeSort(queue& q, IndexT count, ValueT* buf_0,
-                                   ValueT* buf_1) {
+                                   ValueT* buf_1, size_t segment_count = 0) {
   return SubmitMergeSort<ValueT, IndexT, InPipe, OutPipe, k_width, units>(
-      q, count, buf_0, buf_1, LessThan());
+      q, count, buf_0, buf_1, LessThan(), segment_count);
 }
 
 #endif /* __MERGESORT_HPP__ */
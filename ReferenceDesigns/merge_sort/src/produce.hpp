@@ -4,18 +4,24 @@
 #include <sycl/sycl.hpp>
 #include <sycl/ext/intel/fpga_extensions.hpp>
 
+#include "merge.hpp"
+
 using namespace sycl;
 
 //
 // Produces 'k_width' elements of data per cycle into the merge unit from
-// device memory
+// device memory: the sublists on one side ('b_side') of the pairs that an
+// iteration of the merge sort merges (see MergePairs), which are strided
+// through the 'count' elements at 'start_offset'
 //
 template<typename Id, typename ValueT, typename IndexT, typename OutPipe,
          unsigned char k_width>
 event Produce(queue& q, ValueT *in_ptr, IndexT count, IndexT in_block_count,
-              IndexT start_offset, std::vector<event>& depend_events) {
+              IndexT segment_count, IndexT start_offset, bool b_side,
+              std::vector<event>& depend_events) {
   // the number of loop iterations required to produce all of the data
-  const IndexT iterations = count / k_width;
+  const IndexT iterations =
+      MergePairsCount(count, in_block_count, segment_count, b_side) / k_width;
 
   return q.submit([&](handler& h) {
     h.depends_on(depend_events);
@@ -32,16 +38,35 @@ event Produce(queue& q, ValueT *in_ptr, IndexT count, IndexT in_block_count,
       ValueT* in(in_ptr);
 #endif
 
+      // the pair of sublists being read, and the position in its sublist
+      MergePairs<IndexT> pairs(count, in_block_count, segment_count);
+      IndexT pos = 0;
+
       for (IndexT i = 0; i < iterations; i++) {
+        const IndexT offset =
+            start_offset + pairs.start + (b_side ? pairs.a_count : 0) + pos;
+
         // read 'k_width' elements from device memory
-        sycl::vec<ValueT, k_width> pipe_data;
+        SortVec<ValueT, k_width> pipe_data;
         #pragma unroll
         for (unsigned char j = 0; j < k_width; j++) {
-          pipe_data[j] = in[start_offset + i*k_width + j];
+          pipe_data[j] = in[offset + j];
         }
 
         // write to the output pipe
         OutPipe::write(pipe_data);
+
+        // move to the next pair at the end of the sublist. Only the last pair
+        // of a segment can have no B side, and unless it is the last pair of
+        // all, the next one has a B side
+        pos += k_width;
+        if (pos == pairs.Count(b_side)) {
+          pairs.Next();
+          if (pairs.Count(b_side) == 0) {
+            pairs.Next();
+          }
+          pos = 0;
+        }
       }
     });
   });
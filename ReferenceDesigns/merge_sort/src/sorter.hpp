@@ -0,0 +1,251 @@
+#ifndef __SORTER_HPP__
+#define __SORTER_HPP__
+
+#include <chrono>
+#include <iostream>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+#include <sycl/sycl.hpp>
+#include <sycl/ext/intel/fpga_extensions.hpp>
+
+#include "merge_sort.hpp"
+
+// Included from include/
+#include "constexpr_math.hpp"
+
+using namespace sycl;
+
+// forward declare the kernel and pipe IDs to reduce name mangling
+class InputKernelID;
+class OutputKernelID;
+class SortInPipeID;
+class SortOutPipeID;
+
+//
+// A persistent merge sorter on the FPGA. The temporary buffers of the merge
+// sort are allocated once, for up to 'capacity' elements, and are reused by
+// every sort, so that repeated sorts do not pay for the allocations.
+//
+// The sorter streams the input elements from 'in' (converted to the values to
+// sort by 'to_value'), and the sorted values to 'out' (converted to the output
+// elements by 'from_value'). The elements are only padded up to a multiple of
+// 'k_width', with 'padding_element', which must come after every element in
+// the order of 'Compare'. The input and output pointers are USM host
+// allocations if 'host_ptrs' is true, and USM device allocations otherwise.
+//
+template <typename ValueT, typename IndexT, unsigned char k_width, size_t units,
+          bool host_ptrs, typename Compare>
+class Sorter {
+  // the pointer type for the kernels depends on whether data is coming from
+  // USM host or device allocations
+  template <typename T>
+  using KernelPtrType =
+      typename std::conditional_t<host_ptrs, sycl::ext::intel::host_ptr<T>,
+                                  sycl::ext::intel::device_ptr<T>>;
+
+  // the input and output pipe for the sorter
+  using SortInPipe =
+      sycl::ext::intel::pipe<SortInPipeID, SortVec<ValueT, k_width>>;
+  using SortOutPipe =
+      sycl::ext::intel::pipe<SortOutPipeID, SortVec<ValueT, k_width>>;
+
+ public:
+  Sorter(queue& q, size_t capacity, ValueT padding_element,
+         Compare comp = Compare())
+      : q_(q),
+        capacity_(fpga_tools::RoundUpToMultiple(capacity, size_t(k_width))),
+        padding_element_(padding_element),
+        comp_(comp) {
+    // allocate the memory for the merge sort to use as temporary storage
+    for (int b = 0; b < 2; b++) {
+#if defined (IS_BSP)
+      buf_[b] = malloc_device<ValueT>(capacity_, q_);
+#else
+      buf_[b] = malloc_shared<ValueT>(capacity_, q_);
+#endif
+      if (buf_[b] == nullptr) {
+        std::cerr << "ERROR: could not allocate memory for 'buf_" << b
+                  << "'\n";
+        std::terminate();
+      }
+    }
+  }
+
+  ~Sorter() {
+    sycl::free(buf_[0], q_);
+    sycl::free(buf_[1], q_);
+  }
+
+  Sorter(const Sorter&) = delete;
+  Sorter& operator=(const Sorter&) = delete;
+
+  size_t Capacity() const { return capacity_; }
+
+  //
+  // Sort the 'count' elements of 'in' into 'out'. Returns the duration of the
+  // sort in milliseconds, excluding memory transfers.
+  //
+  template <typename InT, typename OutT, typename ToValueT,
+            typename FromValueT>
+  double Sort(InT* in, OutT* out, IndexT count, ToValueT to_value,
+              FromValueT from_value) {
+    return SortBatch(in, out, count, 1, to_value, from_value);
+  }
+
+  //
+  // Sort a batch of 'num_arrays' arrays of 'array_count' elements, stored one
+  // after the other in 'in', into 'out', in a single launch of the kernels.
+  // Each array is padded to a multiple of 'k_width' and sorted on its own by
+  // the merge units, which write the sorted arrays back to device memory. The
+  // index passed to 'to_value' is the index of the element in its array.
+  // Returns the duration of the sort in milliseconds, excluding memory
+  // transfers.
+  //
+  template <typename InT, typename OutT, typename ToValueT,
+            typename FromValueT>
+  double SortBatch(InT* in_ptr, OutT* out_ptr, IndexT array_count,
+                   IndexT num_arrays, ToValueT to_value,
+                   FromValueT from_value) {
+    // the arrays are padded to a multiple of the width of the sorter
+    const IndexT sorter_array_count =
+        fpga_tools::RoundUpToMultiple(array_count, IndexT(k_width));
+    const size_t sorter_count = size_t(sorter_array_count) * num_arrays;
+    const bool batch = (num_arrays > 1);
+
+    if (array_count == 0 || num_arrays == 0) {
+      return 0;
+    } else if (sorter_count > capacity_) {
+      std::cerr << "ERROR: the sort of " << sorter_count << " elements "
+                << "exceeds the capacity of the sorter (" << capacity_
+                << ")\n";
+      std::terminate();
+    } else if (sorter_count > std::numeric_limits<IndexT>::max()) {
+      std::cerr << "ERROR: the index type (IndexT) does not have enough bits "
+                << "to count to " << sorter_count << "\n";
+      std::terminate();
+    }
+
+    // We are sorting k_width elements per cycle, so we will have
+    // sorter_count/k_width pipe reads/writes from/to the sorter
+    const IndexT total_pipe_accesses = sorter_count / k_width;
+
+    // a batch is written to one of the temporary buffers
+    ValueT* sorted_ptr =
+        buf_[MergeSortIterations<k_width, units>(sorter_count,
+                                                 sorter_array_count) % 2];
+    const ValueT padding_element = padding_element_;
+
+    // launch the kernel that provides data into the sorter
+    auto input_kernel_event =
+      q_.single_task<InputKernelID>([=]() [[intel::kernel_args_restrict]] {
+        // read from the input pointer and write it to the sorter's input pipe
+        KernelPtrType<InT> in(in_ptr);
+
+        // the offset of the current array in the input, and the position in
+        // the array
+        IndexT array_offset = 0;
+        IndexT pos = 0;
+
+        for (IndexT i = 0; i < total_pipe_accesses; i++) {
+          // build the input pipe data, padding the end of the array
+          SortVec<ValueT, k_width> data;
+          #pragma unroll
+          for (unsigned char j = 0; j < k_width; j++) {
+            const IndexT idx = pos + j;
+            data[j] = (idx < array_count)
+                          ? to_value(in[array_offset + idx], idx)
+                          : padding_element;
+          }
+
+          // write it into the sorter
+          SortInPipe::write(data);
+
+          pos += k_width;
+          if (pos == sorter_array_count) {
+            pos = 0;
+            array_offset += array_count;
+          }
+        }
+      });
+
+    // launch the merge sort kernels
+    auto merge_sort_events =
+        SubmitMergeSort<ValueT, IndexT, SortInPipe, SortOutPipe, k_width,
+                        units>(q_, sorter_count, buf_[0], buf_[1], comp_,
+                               sorter_array_count);
+
+    // launch the kernel that reads out data from the sorter, or from device
+    // memory once a batch is sorted
+    auto output_kernel_event = q_.submit([&](handler& h) {
+      if (batch) {
+        h.depends_on(merge_sort_events);
+      }
+      h.single_task<OutputKernelID>([=]() [[intel::kernel_args_restrict]] {
+        // read from the sorter's output pipe and write to the output pointer
+        KernelPtrType<OutT> out(out_ptr);
+#if defined(IS_BSP)
+        sycl::ext::intel::device_ptr<ValueT> sorted(sorted_ptr);
+#else
+        ValueT* sorted(sorted_ptr);
+#endif
+
+        IndexT array_offset = 0;
+        IndexT pos = 0;
+
+        for (IndexT i = 0; i < total_pipe_accesses; i++) {
+          // read data from the sorter
+          SortVec<ValueT, k_width> data;
+          if (batch) {
+            #pragma unroll
+            for (unsigned char j = 0; j < k_width; j++) {
+              data[j] = sorted[i * k_width + j];
+            }
+          } else {
+            data = SortOutPipe::read();
+          }
+
+          // only write out the elements of the array, not the padding
+          #pragma unroll
+          for (unsigned char j = 0; j < k_width; j++) {
+            const IndexT idx = pos + j;
+            if (idx < array_count) {
+              out[array_offset + idx] = from_value(data[j]);
+            }
+          }
+
+          pos += k_width;
+          if (pos == sorter_array_count) {
+            pos = 0;
+            array_offset += array_count;
+          }
+        }
+      });
+    });
+
+    // wait for the input and output kernels to finish
+    auto start = std::chrono::high_resolution_clock::now();
+    input_kernel_event.wait();
+    output_kernel_event.wait();
+    auto end = std::chrono::high_resolution_clock::now();
+
+    // wait for the merge sort kernels to finish
+    for (auto& e : merge_sort_events) {
+      e.wait();
+    }
+
+    // return the duration of the sort in milliseconds
+    std::chrono::duration<double, std::milli> diff = end - start;
+    return diff.count();
+  }
+
+ private:
+  queue q_;
+  size_t capacity_;
+  ValueT padding_element_;
+  Compare comp_;
+  ValueT* buf_[2];
+};
+
+#endif /* __SORTER_HPP__ */
@@ -2,6 +2,8 @@
 #define __SORTINGNETWORKS_HPP__
 
 #include <algorithm>
+#include <array>
+#include <type_traits>
 
 #include <sycl/sycl.hpp>
 #include <sycl/ext/intel/fpga_extensions.hpp>
@@ -11,6 +13,17 @@
 
 using namespace sycl;
 
+//
+// The type that holds 'k_width' elements of the sort, which is passed between
+// the kernels through pipes. Arithmetic types are packed into a sycl::vec.
+// Other types, like the records of a key/value sort, which a sycl::vec cannot
+// hold, are packed into a std::array.
+//
+template <typename ValueT, int k_width>
+using SortVec = std::conditional_t<std::is_arithmetic_v<ValueT>,
+                                   sycl::vec<ValueT, k_width>,
+                                   std::array<ValueT, k_width>>;
+
 //
 // Creates a merge sort network.
 // Takes in two sorted lists ('a' and 'b') of size 'k_width' and merges them
@@ -21,7 +34,7 @@ using namespace sycl;
 //    b = {data[1], data[3], data[5], ...}
 //
 template <typename ValueT, unsigned char k_width, class CompareFunc>
-void MergeSortNetwork(sycl::vec<ValueT, k_width * 2>& data,
+void MergeSortNetwork(SortVec<ValueT, k_width * 2>& data,
                       CompareFunc compare) {
   if constexpr (k_width == 4) {
     // Special case for k_width==4 that has 1 less compare on the critical path
@@ -68,7 +81,7 @@ void MergeSortNetwork(sycl::vec<ValueT, k_width * 2>& data,
 // For more info see: https://en.wikipedia.org/wiki/Bitonic_sorter
 //
 template <typename ValueT, unsigned char k_width, class CompareFunc>
-void BitonicSortNetwork(sycl::vec<ValueT, k_width>& data, CompareFunc compare) {
+void BitonicSortNetwork(SortVec<ValueT, k_width>& data, CompareFunc compare) {
   #pragma unroll
   for (unsigned char k = 2; k <= k_width; k *= 2) {
     #pragma unroll
@@ -117,7 +130,7 @@ event SortNetworkKernel(queue& q, ValueT* out_ptr, IndexT total_count,
 
     for (IndexT i = 0; i < iterations; i++) {
       // read the input data from the pipe
-      sycl::vec<ValueT, k_width> data = InPipe::read();
+      SortVec<ValueT, k_width> data = InPipe::read();
 
       // bitonic sort network sorts the k_width elements of 'data' in-place
       // NOTE: there are no dependencies across loop iterations on 'data'
@@ -8,9 +8,12 @@
 
 #include <chrono>
 #include <cstring>
+#include <stdexcept>
+#include <string>
 #include <type_traits>
 #include <vector>
 
+#include "matrix_size.hpp"
 #include "memory_transfers.hpp"
 #include "streaming_qrd.hpp"
 #include "tuple.hpp"
@@ -27,6 +30,14 @@ class QRDLocalMemToDDRR;
 class APipe;
 class QPipe;
 class RPipe;
+class QRDMixedDDRToLocalMem;
+class QRDMixed;
+class QRDMixedLocalMemToDDRQ;
+class QRDMixedLocalMemToDDRR;
+class AMixedPipe;
+class QMixedPipe;
+class RMixedPipe;
+class SizeMixedPipe;
 
 /*
   Implementation of the QR decomposition using multiple streaming kernels
@@ -174,4 +185,184 @@ void QRDecompositionImpl(
   free(r_device, q);
 }
 
+/*
+  Implementation of the QR decomposition of a batch of matrices of different
+  sizes, up to rows x columns, using multiple streaming kernels.
+  The size of each matrix is read by the kernel that loads the matrices from
+  DDR, which streams it to the QRD kernel ahead of the matrix. The A and Q
+  matrices are stored one after the other, each with its own size, as are the
+  R matrices.
+*/
+template <unsigned columns,     // Maximum number of columns of the matrices
+          unsigned rows,        // Maximum number of rows of the matrices
+          unsigned raw_latency, // RAW latency for triangular loop optimization
+          bool is_complex,      // Selects between ac_complex<T> and T datatype
+          typename T,           // The datatype for the computation
+          typename TT = std::conditional_t<is_complex, ac_complex<T>, T>
+                        // TT will be ac_complex<T> or T depending on is_complex
+         >
+void QRDecompositionMixedImpl(
+  std::vector<TT> &a_matrix, // Input matrices to decompose
+  std::vector<TT> &q_matrix, // Output matrices Q
+  std::vector<TT> &r_matrix, // Output matrices R
+  std::vector<fpga_linalg::MatrixSize> &sizes, // Size of each matrix
+  sycl::queue &q,            // Device queue
+  int repetitions           // Number of repetitions, for performance evaluation
+) {
+
+  constexpr int kNumElementsPerDDRBurst = is_complex ? 4 : 8;
+
+  using PipeType = fpga_tools::NTuple<TT, kNumElementsPerDDRBurst>;
+
+  // Pipes to communicate the A, Q and R matrices between kernels, and the
+  // size of the A matrices to the QRD kernel
+  using AMatrixPipe = sycl::ext::intel::pipe<AMixedPipe, PipeType, 3>;
+  using QMatrixPipe = sycl::ext::intel::pipe<QMixedPipe, PipeType, 3>;
+  using RMatrixPipe = sycl::ext::intel::pipe<RMixedPipe, TT,
+                                                  kNumElementsPerDDRBurst * 4>;
+  using MatrixSizePipe =
+      sycl::ext::intel::pipe<SizeMixedPipe, fpga_linalg::MatrixSize, 4>;
+
+  int matrix_count = sizes.size();
+
+  // Total number of elements of the A (and Q) matrices and of the R matrices
+  int a_elements = 0;
+  int r_elements = 0;
+  for (int m = 0; m < matrix_count; m++) {
+    auto size = sizes[m];
+    if (!fpga_linalg::MatrixSizeSupported(size, rows, columns, false)) {
+      throw std::invalid_argument(
+          "matrix " + std::to_string(m) + " is " + std::to_string(size.rows) +
+          "x" + std::to_string(size.columns) + ", but the QRD kernel only " +
+          "supports matrices of at least 4x4, of up to " +
+          std::to_string(rows) + "x" + std::to_string(columns) +
+          ", with no more columns than rows");
+    }
+    a_elements += size.rows * size.columns;
+    r_elements += size.columns * (size.columns + 1) / 2;
+  }
+
+  // Allocate FPGA DDR memory.
+#if defined (IS_BSP)
+  TT *a_device = sycl::malloc_device<TT>(a_elements, q);
+  TT *q_device = sycl::malloc_device<TT>(a_elements, q);
+  TT *r_device = sycl::malloc_device<TT>(r_elements, q);
+  fpga_linalg::MatrixSize *sizes_device =
+      sycl::malloc_device<fpga_linalg::MatrixSize>(matrix_count, q);
+#else
+  // malloc_device are not supported when targetting an FPGA part/family
+  TT *a_device = sycl::malloc_shared<TT>(a_elements, q);
+  TT *r_device = sycl::malloc_shared<TT>(r_elements, q);
+  fpga_linalg::MatrixSize *sizes_device =
+      sycl::malloc_shared<fpga_linalg::MatrixSize>(matrix_count, q);
+
+  constexpr int BL0 = 0;
+  using PtrAnn = annotated_ptr<TT, decltype(properties{buffer_location<BL0>,
+                                                       dwidth<512>})>;
+  TT *q_device = sycl::malloc_shared<TT>(a_elements, q);
+  PtrAnn q_device_ptr(q_device);
+#endif
+
+  q.memcpy(a_device, a_matrix.data(), a_elements * sizeof(TT)).wait();
+  q.memcpy(sizes_device, sizes.data(),
+           matrix_count * sizeof(fpga_linalg::MatrixSize)).wait();
+
+  auto ddr_write_event =
+  q.submit([&](sycl::handler &h) {
+    h.single_task<QRDMixedDDRToLocalMem>([=
+                                    ]() [[intel::kernel_args_restrict]] {
+      MatrixReadFromDDRToPipeWithSize<TT, rows, columns,
+                                      kNumElementsPerDDRBurst, AMatrixPipe,
+                                      MatrixSizePipe>(
+          a_device, sizes_device, matrix_count, repetitions);
+    });
+  });
+
+  // Read the size of each matrix from the MatrixSizePipe pipe and the A
+  // matrix from the AMatrixPipe pipe, and compute the QR decomposition.
+  // Write the Q and R output matrices to the QMatrixPipe and RMatrixPipe
+  // pipes.
+  q.single_task<QRDMixed>(
+      fpga_linalg::StreamingQRD<T, is_complex, rows, columns, raw_latency,
+                   kNumElementsPerDDRBurst,
+                   AMatrixPipe, QMatrixPipe, RMatrixPipe, true,
+                   MatrixSizePipe>());
+
+  auto q_event = q.single_task<QRDMixedLocalMemToDDRQ>([=
+                                    ]() [[intel::kernel_args_restrict]] {
+    // Read the Q matrix from the QMatrixPipe pipe and copy it to the
+    // FPGA DDR
+    MatrixReadPipeToDDRWithSize<TT, rows, columns, kNumElementsPerDDRBurst,
+                                QMatrixPipe>(
+#if defined (IS_BSP)
+                          q_device,
+#else
+                          q_device_ptr,
+#endif
+                          sizes_device, matrix_count, repetitions);
+  });
+
+  auto r_event = q.single_task<QRDMixedLocalMemToDDRR>([=
+                                    ]() [[intel::kernel_args_restrict]] {
+    // Read the R matrix from the RMatrixPipe pipe and copy it to the
+    // FPGA DDR
+
+#if defined (IS_BSP)
+    // When targeting a BSP, we instruct the compiler that these pointers
+    // live on the device.
+    // Knowing this, the compiler won't generate hardware to
+    // potentially get data from the host.
+    sycl::ext::intel::device_ptr<TT> vector_ptr_located(r_device);
+    sycl::ext::intel::device_ptr<fpga_linalg::MatrixSize>
+        sizes_ptr_located(sizes_device);
+#else
+    // Device pointers are not supported when targeting an FPGA
+    // family/part
+    TT* vector_ptr_located(r_device);
+    fpga_linalg::MatrixSize* sizes_ptr_located(sizes_device);
+#endif
+
+    // Repeat matrix_count complete R matrix pipe reads
+    // for as many repetitions as needed
+    for (int repetition_index = 0; repetition_index < repetitions;
+         repetition_index++) {
+      int r_offset = 0;
+      for (int matrix_index = 0; matrix_index < matrix_count; matrix_index++) {
+        int r_columns = sizes_ptr_located[matrix_index].columns;
+        int r_matrix_size = r_columns * (r_columns + 1) / 2;
+        for (int r_idx = 0; r_idx < r_matrix_size; r_idx++) {
+          vector_ptr_located[r_offset + r_idx] = RMatrixPipe::read();
+        }  // end of r_idx
+        r_offset += r_matrix_size;
+      }    // end of matrix_index
+    }      // end of repetition_index
+  });
+
+  q_event.wait();
+  r_event.wait();
+
+  // Compute the total time the execution lasted
+  auto start_time = ddr_write_event.template
+              get_profiling_info<sycl::info::event_profiling::command_start>();
+  auto end_time = q_event.template
+                get_profiling_info<sycl::info::event_profiling::command_end>();
+  double diff = (end_time - start_time) / 1.0e9;
+  q.throw_asynchronous();
+
+  std::cout << "   Total duration:   " << diff << " s" << std::endl;
+  std::cout << "Throughput: "
+            << repetitions * matrix_count / diff * 1e-3
+            << "k matrices/s" << std::endl;
+
+  // Copy the Q and R matrices result from the FPGA DDR to the host memory
+  q.memcpy(q_matrix.data(), q_device, a_elements * sizeof(TT)).wait();
+  q.memcpy(r_matrix.data(), r_device, r_elements * sizeof(TT)).wait();
+
+  // Clean allocated FPGA memory
+  free(a_device, q);
+  free(q_device, q);
+  free(r_device, q);
+  free(sizes_device, q);
+}
+
 #endif /* __QRD_HPP__ */
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cmath>
 
 #include <sycl/sycl.hpp>
@@ -19,10 +20,13 @@
 #endif
 
 /*
-  COMPLEX, COLS_COMPONENT, ROWS_COMPONENT and FIXED_ITERATIONS are defined
-  by the build system.
+  COMPLEX, COLS_COMPONENT, ROWS_COMPONENT, FIXED_ITERATIONS and MIXED_SIZES
+  are defined by the build system.
   Depending on the value of COMPLEX, the real or complex QRDecomposition is
-  defined
+  defined.
+  If MIXED_SIZES is set, the kernels decompose matrices of any size up to
+  ROWS_COMPONENT x COLS_COMPONENT, and QRDecomposition streams the size of
+  each matrix along with it.
 
   Function arguments:
   - a_matrix:    The input matrix. Interpreted as a transposed matrix.
@@ -35,7 +39,35 @@
   - repetitions: The number of repetitions of the computation to execute.
                  (for performance evaluation)
 */
-#if COMPLEX == 0
+#if MIXED_SIZES
+// Select a type for this compile depending on the value of COMPLEX
+using QRDType = std::conditional_t<COMPLEX != 0, ac_complex<float>, float>;
+
+// Single precision floating-point QR Decomposition of matrices of mixed sizes
+void QRDecompositionMixed(std::vector<QRDType> &a_matrix,
+                          std::vector<QRDType> &q_matrix,
+                          std::vector<QRDType> &r_matrix,
+                          std::vector<fpga_linalg::MatrixSize> &sizes,
+                          sycl::queue &q, int repetitions) {
+  constexpr bool is_complex = COMPLEX != 0;
+  QRDecompositionMixedImpl<COLS_COMPONENT_V, ROWS_COMPONENT_V,
+                           FIXED_ITERATIONS, is_complex, float>(
+      a_matrix, q_matrix, r_matrix, sizes, q, repetitions);
+}
+
+// Single precision floating-point QR Decomposition of matrices of the maximum
+// size, on the same kernels
+void QRDecomposition(std::vector<QRDType> &a_matrix,
+                     std::vector<QRDType> &q_matrix,
+                     std::vector<QRDType> &r_matrix, sycl::queue &q,
+                     int matrix_count,
+                     int repetitions) {
+  std::vector<fpga_linalg::MatrixSize> sizes(
+      matrix_count,
+      fpga_linalg::MatrixSize{ROWS_COMPONENT_V, COLS_COMPONENT_V});
+  QRDecompositionMixed(a_matrix, q_matrix, r_matrix, sizes, q, repetitions);
+}
+#elif COMPLEX == 0
 // Real single precision floating-point QR Decomposition
 void QRDecomposition(std::vector<float> &a_matrix, std::vector<float> &q_matrix,
                      std::vector<float> &r_matrix, sycl::queue &q,
@@ -73,6 +105,140 @@ bool IsFinite(ac_complex<float> val) {
 */
 bool IsFinite(float val) { return std::isfinite(val); }
 
+#if MIXED_SIZES
+/*
+  returns the magnitude of the given value
+*/
+float Magnitude(ac_complex<float> val) {
+  return std::sqrt(val.r() * val.r() + val.i() * val.i());
+}
+float Magnitude(float val) { return std::abs(val); }
+
+/*
+  returns the conjugate of the given value
+*/
+ac_complex<float> Conjugate(ac_complex<float> val) { return val.conj(); }
+float Conjugate(float val) { return val; }
+
+/*
+  Decomposes a batch of random matrices of mixed sizes, up to
+  ROWS_COMPONENT x COLS_COMPONENT, in a single run of the kernels, and checks
+  that QR = A and that the columns of Q are orthonormal.
+  Returns true if all the decompositions are correct.
+*/
+bool TestMixedSizes(sycl::queue &q) {
+  using T = QRDType;
+  constexpr int kRows = ROWS_COMPONENT_V;
+  constexpr int kColumns = COLS_COMPONENT_V;
+  constexpr int kRandomMin = 1;
+  constexpr int kRandomMax = 10;
+  constexpr float kErrorThreshold = 1e-4;
+  float q_ortho_error_threshold = pow(2.0, -9);
+
+  // Square and rectangular matrices, from the maximum size down to 4x4
+  const std::pair<int, int> kShapes[] = {
+      {kRows, kColumns},         {kRows / 2, kColumns / 2},
+      {4, 4},                    {kRows - 1, kColumns - 1},
+      {kRows, kColumns / 2},     {kRows / 4, kColumns / 4},
+      {kRows, kColumns}};
+  std::vector<fpga_linalg::MatrixSize> sizes;
+  for (auto [rows, columns] : kShapes) {
+    int matrix_columns = std::max(columns, 4);
+    int matrix_rows = std::max(std::min(rows, kRows), matrix_columns);
+    sizes.push_back({(short)matrix_rows, (short)matrix_columns});
+  }
+
+  int a_elements = 0;
+  int r_elements = 0;
+  for (auto size : sizes) {
+    a_elements += size.rows * size.columns;
+    r_elements += size.columns * (size.columns + 1) / 2;
+  }
+
+  std::vector<T> a_matrix(a_elements);
+  std::vector<T> q_matrix(a_elements);
+  std::vector<T> r_matrix(r_elements);
+  for (auto &element : a_matrix) {
+    float random_real = rand() % (kRandomMax - kRandomMin) + kRandomMin;
+#if COMPLEX == 0
+    element = random_real;
+#else
+    float random_imag = rand() % (kRandomMax - kRandomMin) + kRandomMin;
+    element = ac_complex<float>{random_real, random_imag};
+#endif
+  }
+
+  std::cout << std::endl
+            << "Running QR decomposition of a batch of " << sizes.size()
+            << " matrices of mixed sizes:";
+  for (auto size : sizes) {
+    std::cout << " " << size.rows << "x" << size.columns;
+  }
+  std::cout << std::endl;
+
+  QRDecompositionMixed(a_matrix, q_matrix, r_matrix, sizes, q, 1);
+
+  std::cout << "Verifying results...";
+  int a_offset = 0;
+  int r_offset = 0;
+  for (auto size : sizes) {
+    int rows = size.rows;
+    int columns = size.columns;
+    // Element i,j of the matrices, stored column by column for A and Q, and
+    // as the upper triangular elements of R row by row
+    auto a = [&](int i, int j) { return a_matrix[a_offset + j * rows + i]; };
+    auto qm = [&](int i, int j) { return q_matrix[a_offset + j * rows + i]; };
+    auto r = [&](int i, int j) {
+      return i > j ? T{0}
+                   : r_matrix[r_offset + i * columns - i * (i - 1) / 2 +
+                              (j - i)];
+    };
+
+    float qr_error = 0;
+    float ortho_error = 0;
+    for (int i = 0; i < rows; i++) {
+      for (int j = 0; j < columns; j++) {
+        T q_r_ij{0};
+        for (int k = 0; k < columns; k++) {
+          q_r_ij += qm(i, k) * r(k, j);
+        }
+        qr_error = std::max(qr_error, Magnitude(q_r_ij - a(i, j)));
+        if (!IsFinite(q_r_ij)) {
+          qr_error = INFINITY;
+        }
+      }
+    }
+    for (int i = 0; i < columns; i++) {
+      for (int j = 0; j < columns; j++) {
+        T qt_q_ij{0};
+        for (int k = 0; k < rows; k++) {
+          qt_q_ij += Conjugate(qm(k, i)) * qm(k, j);
+        }
+        ortho_error = std::max(
+            ortho_error, Magnitude(qt_q_ij - (i == j ? T{1} : T{0})));
+        if (!IsFinite(qt_q_ij)) {
+          ortho_error = INFINITY;
+        }
+      }
+    }
+
+    if (!(qr_error < kErrorThreshold) ||
+        !(ortho_error < q_ortho_error_threshold)) {
+      std::cout << std::endl
+                << "Error in the decomposition of the " << rows << "x"
+                << columns << " matrix: max |QR - A| = " << qr_error
+                << ", max |transpose(Q) * Q - Id| = " << ortho_error
+                << std::endl;
+      return false;
+    }
+
+    a_offset += rows * columns;
+    r_offset += columns * (columns + 1) / 2;
+  }
+  return true;
+}
+#endif
+
 int main(int argc, char *argv[]) {
   constexpr size_t kRandomSeed = 1138;
   constexpr size_t kRandomMin = 1;
@@ -426,6 +592,12 @@ int main(int argc, char *argv[]) {
       }
     } // end of matrix_index
 
+#if MIXED_SIZES
+    if (!TestMixedSizes(q)) {
+      std::cout << std::endl << "FAILED" << std::endl;
+      return 1;
+    }
+#endif
 
     std::cout << std::endl << "PASSED" << std::endl;
     return 0;
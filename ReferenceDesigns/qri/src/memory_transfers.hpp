@@ -3,6 +3,7 @@
 
 #include "tuple.hpp"
 #include "constexpr_math.hpp"
+#include "matrix_size.hpp"
 #include "unrolled_loop.hpp"
 
 using namespace sycl::ext::intel::experimental;
@@ -213,4 +214,200 @@ void MatrixReadPipeToDDR(
   } // end of repetition
 }
 
+/*
+  Read matrix_count matrices of type TT of any size up to rows x columns from
+  DDR, and write their sizes to the "SizePipe" pipe and the matrices to the
+  "MatrixPipe" pipe num_elem_per_bank by num_elem_per_bank elements.
+  The sizes of the matrices are read from size_ptr, and the matrices are
+  stored one after the other in DDR, each with its own size.
+  Repeat this operations "repetitions" times.
+*/
+template <typename TT,           // Datatype of the elements of the matrix
+          int rows,              // Maximum number of rows of the matrix
+          int columns,           // Maximum number of columns of the matrix
+          int num_elem_per_bank, // Number of TT elements per DDR burst access
+          typename MatrixPipe,   // Output matrix pipe
+          typename SizePipe      // Output matrix size pipe
+          >
+void MatrixReadFromDDRToPipeWithSize(
+    TT* matrix_ptr,  // Input matrix pointer
+    fpga_linalg::MatrixSize* size_ptr, // Input matrix sizes pointer
+    int matrix_count,// Number of matrix to read from DDR
+    int repetitions  // Number of time to write the same matrix to the pipe
+    ) {
+
+  // Number of DDR burst reads of num_elem_per_bank elements required to read
+  // a full column of the largest matrix
+  constexpr int kLoopIterPerColumn =
+      (rows + num_elem_per_bank - 1) / num_elem_per_bank;
+  // Number of DDR burst reads of num_elem_per_bank to read the largest matrix
+  constexpr int kLoopIter = kLoopIterPerColumn * columns;
+  // Size in bits of the loop iterator over kLoopIter iterations
+  constexpr int kLoopIterBitSize = fpga_tools::BitsForMaxValue<kLoopIter + 1>();
+
+#if defined (IS_BSP)
+  // When targeting a BSP, we instruct the compiler that these pointers
+  // live on the device.
+  // Knowing this, the compiler won't generate hardware to
+  // potentially get data from the host.
+  sycl::ext::intel::device_ptr<TT> matrix_ptr_located(matrix_ptr);
+  sycl::ext::intel::device_ptr<fpga_linalg::MatrixSize>
+      size_ptr_located(size_ptr);
+#else
+  // Device pointers are not supported when targeting an FPGA
+  // family/part
+  TT* matrix_ptr_located(matrix_ptr);
+  fpga_linalg::MatrixSize* size_ptr_located(size_ptr);
+#endif
+
+  // Repeatedly read matrix_count matrices from DDR and sends them to the pipe
+  for (int repetition = 0; repetition < repetitions; repetition++){
+
+    // Index of the first element of the current matrix in DDR
+    int matrix_offset = 0;
+
+    for (int matrix_index = 0; matrix_index < matrix_count; matrix_index++){
+      fpga_linalg::MatrixSize size = size_ptr_located[matrix_index];
+      SizePipe::write(size);
+
+      int loop_iter_per_column =
+          (size.rows + num_elem_per_bank - 1) / num_elem_per_bank;
+      int loop_iter = loop_iter_per_column * size.columns;
+      // Number of elements of the last DDR burst of each column
+      int last_burst_size =
+          size.rows - (loop_iter_per_column - 1) * num_elem_per_bank;
+
+      // Keep track of the current element index in the matrix and of the
+      // current burst in the column
+      int load_index = 0;
+      int burst_index = 0;
+
+      [[intel::initiation_interval(1)]]  // NO-FORMAT: Attribute
+      for (ac_int<kLoopIterBitSize, false> li = 0; li < loop_iter; li++) {
+        // Check if we are reading the last DDR burst of the current column
+        bool last_burst_of_col = burst_index == loop_iter_per_column - 1;
+        int burst_size = last_burst_of_col ? last_burst_size
+                                           : num_elem_per_bank;
+
+        fpga_tools::NTuple<TT, num_elem_per_bank> ddr_read;
+
+        // Only perform the DDR reads that are within the current matrix
+        // column
+        fpga_tools::UnrolledLoop<num_elem_per_bank>([&](auto k) {
+          if (k < burst_size) {
+            ddr_read.template get<k>() =
+                matrix_ptr_located[matrix_offset + load_index + k];
+          }
+        });
+
+        load_index += burst_size;
+        burst_index = last_burst_of_col ? 0 : burst_index + 1;
+
+        MatrixPipe::write(ddr_read);
+      }  // end of li
+
+      matrix_offset += size.rows * size.columns;
+    } // end of matrix_index
+  } // end of repetition
+}
+
+/*
+  Read matrix_count matrices of type TT of any size up to rows x columns from
+  a pipe, num_elem_per_bank by num_elem_per_bank, and write them to DDR.
+  The sizes of the matrices are read from size_ptr, and the matrices are
+  stored one after the other in DDR, each with its own size.
+  Repeat this operations "repetitions" times.
+*/
+template <typename TT,           // Datatype of the elements of the matrix
+          int rows,              // Maximum number of rows of the matrix
+          int columns,           // Maximum number of columns of the matrix
+          int num_elem_per_bank, // Number of TT elements per DDR burst access
+          typename MatrixPipe    // Input matrix
+          >
+void MatrixReadPipeToDDRWithSize(
+#if defined (IS_BSP)
+    TT* matrix_ptr,  // Output matrix pointer
+# else
+    annotated_ptr<TT, decltype(properties{buffer_location<BL0>,
+                                          dwidth<512>})> matrix_ptr,
+#endif
+    fpga_linalg::MatrixSize* size_ptr, // Input matrix sizes pointer
+    int matrix_count,// Number of matrix to write to DDR
+    int repetitions  // Number of time to read the same matrix to the pipe
+    ) {
+
+  // Number of DDR burst of num_elem_per_bank required to write a full column
+  // of the largest matrix
+  constexpr int kLoopIterPerColumn =
+      (rows + num_elem_per_bank - 1) / num_elem_per_bank;
+  // Number of DDR burst of num_elem_per_bank to write the largest matrix
+  constexpr int kLoopIter = kLoopIterPerColumn * columns;
+  // Size in bits of the loop iterator over kLoopIter iterations
+  constexpr int kLoopIterBitSize = fpga_tools::BitsForMaxValue<kLoopIter + 1>();
+
+#if defined (IS_BSP)
+  // When targeting a BSP, we instruct the compiler that these pointers
+  // live on the device.
+  // Knowing this, the compiler won't generate hardware to
+  // potentially get data from the host.
+  sycl::ext::intel::device_ptr<TT> matrix_ptr_located(matrix_ptr);
+  sycl::ext::intel::device_ptr<fpga_linalg::MatrixSize>
+      size_ptr_located(size_ptr);
+#else
+  // Device pointers are not supported when targeting an FPGA
+  // family/part. We want to use the ptr_annotation that was definied in qri.hpp
+  auto matrix_ptr_located = matrix_ptr;
+  fpga_linalg::MatrixSize* size_ptr_located(size_ptr);
+#endif
+
+  // Repeatedly read matrix_count matrices from the pipe and write them to DDR
+  for (int repetition = 0; repetition < repetitions; repetition++){
+
+    // Index of the first element of the current matrix in DDR
+    int matrix_offset = 0;
+
+    for (int matrix_index = 0; matrix_index < matrix_count; matrix_index++){
+      fpga_linalg::MatrixSize size = size_ptr_located[matrix_index];
+
+      int loop_iter_per_column =
+          (size.rows + num_elem_per_bank - 1) / num_elem_per_bank;
+      int loop_iter = loop_iter_per_column * size.columns;
+      // Number of elements of the last DDR burst of each column
+      int last_burst_size =
+          size.rows - (loop_iter_per_column - 1) * num_elem_per_bank;
+
+      // Keep track of the current element index in the output matrix and of
+      // the current burst in the column
+      int write_idx = 0;
+      int burst_index = 0;
+
+      [[intel::initiation_interval(1)]]  // NO-FORMAT: Attribute
+      [[intel::ivdep]]  // NO-FORMAT: Attribute
+      for (ac_int<kLoopIterBitSize, false> li = 0; li < loop_iter; li++) {
+        fpga_tools::NTuple<TT, num_elem_per_bank> pipe_read =
+                                                            MatrixPipe::read();
+
+        // Check if we are writing the last DDR burst of the current column
+        bool last_burst_of_col = burst_index == loop_iter_per_column - 1;
+        int burst_size = last_burst_of_col ? last_burst_size
+                                           : num_elem_per_bank;
+
+        // Only perform the DDR writes that are within the current matrix
+        // column
+        fpga_tools::UnrolledLoop<num_elem_per_bank>([&](auto k) {
+          if (k < burst_size) {
+            matrix_ptr_located[matrix_offset + write_idx + k] =
+                                                    pipe_read.template get<k>();
+          }
+        });
+
+        write_idx += burst_size;
+        burst_index = last_burst_of_col ? 0 : burst_index + 1;
+      }  // end of li
+
+      matrix_offset += size.rows * size.columns;
+    } // end of matrix_index
+  } // end of repetition
+}
+
 #endif /* __MEMORY_TRANSFERS_HPP__ */
@@ -7,9 +7,12 @@
 
 #include <chrono>
 #include <cstring>
+#include <stdexcept>
+#include <string>
 #include <type_traits>
 #include <vector>
 
+#include "matrix_size.hpp"
 #include "memory_transfers.hpp"
 #include "streaming_qrd.hpp"
 #include "streaming_qri.hpp"
@@ -28,6 +31,17 @@ class APipe;
 class QPipe;
 class RPipe;
 class IPipe;
+class QRIMixedDDRToLocalMem;
+class QRIMixedSizes;
+class QRDMixed;
+class QRIMixedKernel;
+class QRIMixedLocalMemToDDRQ;
+class AMixedPipe;
+class QMixedPipe;
+class RMixedPipe;
+class IMixedPipe;
+class QRDSizeMixedPipe;
+class QRISizeMixedPipe;
 
 template <unsigned columns,         // Number of columns in the input matrix
           unsigned rows,            // Number of rows in the input matrix
@@ -153,3 +167,174 @@ void QRIImpl(
     free(a_device, q);
     free(i_device, q);
 }
+
+/*
+  Implementation of the QR based inversion of a batch of square matrices of
+  different sizes, up to rows x columns, using multiple streaming kernels.
+  The size of each matrix is read by the kernel that loads the matrices from
+  DDR, which streams it to the QRD kernel ahead of the matrix, and by a
+  separate kernel that streams it to the QRI kernel. The A and inverse
+  matrices are stored one after the other, each with its own size.
+*/
+template <unsigned columns,         // Maximum number of columns of the
+                                    // matrices
+          unsigned rows,            // Maximum number of rows of the matrices
+          unsigned raw_latency_qrd, // RAW latency for triangular loop
+                                    // optimization in the QRD kernel
+          unsigned raw_latency_qri, // RAW latency for triangular loop
+                                    // optimization in the QRI kernel
+          bool is_complex,          // Selects between ac_complex<T> and T
+                                    // datatype
+          typename T,               // The datatype for the computation
+          typename TT = std::conditional_t<is_complex, ac_complex<T>, T>
+                                    // TT will be ac_complex<T> or T depending
+                                    // on is_complex
+          >
+void QRIMixedImpl(
+    std::vector<TT> &a_matrix,       // Input matrices to inverse
+    std::vector<TT> &inverse_matrix, // Output inverse matrices
+    std::vector<fpga_linalg::MatrixSize> &sizes, // Size of each matrix
+    sycl::queue &q,                  // Device queue
+    int repetitions                  // Number of repetitions (for performance
+                                     // evaluation)
+) {
+
+  // Functional limitations
+  static_assert(rows == columns,
+                "only square matrices with rows==columns are supported");
+  static_assert(columns >= 4,
+                "only matrices of size 4x4 or over are supported");
+
+  constexpr int kNumElementsPerDDRBurst = is_complex ? 4 : 8;
+
+  using PipeType = fpga_tools::NTuple<TT, kNumElementsPerDDRBurst>;
+
+  using AMatrixPipe = sycl::ext::intel::pipe<AMixedPipe, PipeType, 3>;
+  using QMatrixPipe = sycl::ext::intel::pipe<QMixedPipe, PipeType, 3>;
+  using RMatrixPipe = sycl::ext::intel::pipe<RMixedPipe, TT, 3>;
+  using InverseMatrixPipe = sycl::ext::intel::pipe<IMixedPipe, PipeType, 3>;
+  using QRDSizePipe =
+      sycl::ext::intel::pipe<QRDSizeMixedPipe, fpga_linalg::MatrixSize, 4>;
+  using QRISizePipe =
+      sycl::ext::intel::pipe<QRISizeMixedPipe, fpga_linalg::MatrixSize, 4>;
+
+  int matrix_count = sizes.size();
+
+  // Total number of elements of the A (and inverse) matrices
+  int a_elements = 0;
+  for (int m = 0; m < matrix_count; m++) {
+    auto size = sizes[m];
+    if (!fpga_linalg::MatrixSizeSupported(size, rows, columns, true)) {
+      throw std::invalid_argument(
+          "matrix " + std::to_string(m) + " is " + std::to_string(size.rows) +
+          "x" + std::to_string(size.columns) + ", but the QRI kernels only " +
+          "support square matrices of at least 4x4 and of up to " +
+          std::to_string(rows) + "x" + std::to_string(columns));
+    }
+    a_elements += size.rows * size.columns;
+  }
+
+  // Create buffers and allocate space for them.
+#if defined (IS_BSP)
+  TT *a_device = sycl::malloc_device<TT>(a_elements, q);
+  TT *i_device = sycl::malloc_device<TT>(a_elements, q);
+  fpga_linalg::MatrixSize *sizes_device =
+      sycl::malloc_device<fpga_linalg::MatrixSize>(matrix_count, q);
+#else
+  // malloc_device are not supported when targetting an FPGA part/family
+  TT *a_device = sycl::malloc_shared<TT>(a_elements, q);
+  fpga_linalg::MatrixSize *sizes_device =
+      sycl::malloc_shared<fpga_linalg::MatrixSize>(matrix_count, q);
+
+  constexpr int BL0 = 0;
+  using PtrAnn = annotated_ptr<TT, decltype(properties{buffer_location<BL0>,
+                                                       dwidth<512>})>;
+  TT *i_device = sycl::malloc_shared<TT>(a_elements, q);
+  PtrAnn i_device_ptr(i_device);
+#endif
+
+  q.memcpy(a_device, a_matrix.data(), a_elements * sizeof(TT)).wait();
+  q.memcpy(sizes_device, sizes.data(),
+           matrix_count * sizeof(fpga_linalg::MatrixSize)).wait();
+
+  auto ddr_write_event = q.submit([&](sycl::handler &h) {
+    h.single_task<QRIMixedDDRToLocalMem>([=]() [[intel::kernel_args_restrict]] {
+      MatrixReadFromDDRToPipeWithSize<TT, rows, columns,
+                                      kNumElementsPerDDRBurst, AMatrixPipe,
+                                      QRDSizePipe>(
+          a_device, sizes_device, matrix_count, repetitions);
+    });
+  });
+
+  // Stream the size of each matrix to the QRI kernel
+  q.single_task<QRIMixedSizes>([=]() [[intel::kernel_args_restrict]] {
+#if defined (IS_BSP)
+    sycl::ext::intel::device_ptr<fpga_linalg::MatrixSize>
+        sizes_ptr_located(sizes_device);
+#else
+    fpga_linalg::MatrixSize* sizes_ptr_located(sizes_device);
+#endif
+    for (int repetition = 0; repetition < repetitions; repetition++) {
+      for (int matrix_index = 0; matrix_index < matrix_count; matrix_index++) {
+        QRISizePipe::write(sizes_ptr_located[matrix_index]);
+      }
+    }
+  });
+
+  // Read the size of each matrix from the QRDSizePipe pipe and the A matrix
+  // from the AMatrixPipe pipe, and compute the QR decomposition. Write the Q
+  // and R output matrices to the QMatrixPipe and RMatrixPipe pipes.
+  q.single_task<QRDMixed>(
+      fpga_linalg::StreamingQRD<T, is_complex, rows, columns, raw_latency_qrd,
+                   kNumElementsPerDDRBurst,
+                   AMatrixPipe, QMatrixPipe, RMatrixPipe, true,
+                   QRDSizePipe>());
+
+  q.single_task<QRIMixedKernel>(
+      // Read the size of each matrix from the QRISizePipe pipe and the Q and
+      // R matrices from pipes, and compute the inverse of A.
+      // Write the result to the InverseMatrixPipe pipe.
+      fpga_linalg::StreamingQRI<T, is_complex, rows, columns, raw_latency_qri,
+                   kNumElementsPerDDRBurst,
+                   QMatrixPipe, RMatrixPipe, InverseMatrixPipe, QRISizePipe>());
+
+  auto i_event = q.single_task<QRIMixedLocalMemToDDRQ>([=
+                                      ]() [[intel::kernel_args_restrict]] {
+      // Read the inverse matrix from the InverseMatrixPipe pipe and copy it
+      // to the FPGA DDR
+      MatrixReadPipeToDDRWithSize<TT, rows, columns, kNumElementsPerDDRBurst,
+              InverseMatrixPipe>(
+#if defined (IS_BSP)
+                i_device,
+#else
+                i_device_ptr,
+#endif
+                sizes_device, matrix_count, repetitions);
+  });
+
+  i_event.wait();
+
+  // Compute the total time the execution lasted
+  auto start_time = ddr_write_event.template
+              get_profiling_info<sycl::info::event_profiling::command_start>();
+  auto end_time = i_event.template
+                get_profiling_info<sycl::info::event_profiling::command_end>();
+  double diff = (end_time - start_time) / 1.0e9;
+
+  // Make sure we throw any asynchronous errors if they have occurred during
+  // the computation
+  q.throw_asynchronous();
+
+  std::cout << "   Total duration:   " << diff << " s" << std::endl;
+  std::cout << "Throughput: "
+            << repetitions * matrix_count / diff * 1e-3
+            << "k matrices/s" << std::endl;
+
+  // Copy the inverse matrices result from the FPGA DDR to the host memory
+  q.memcpy(inverse_matrix.data(), i_device, a_elements * sizeof(TT)).wait();
+
+  // Clean allocated FPGA memory
+  free(a_device, q);
+  free(i_device, q);
+  free(sizes_device, q);
+}
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cmath>
 #include <sycl/sycl.hpp>
 #include <chrono>
@@ -19,10 +20,13 @@
 #endif
 
 /*
-  COMPLEX, COLS_COMPONENT, ROWS_COMPONENT, FIXED_ITERATIONS_QRD and
-  FIXED_ITERATIONS_QRI are defined by the build system.
+  COMPLEX, COLS_COMPONENT, ROWS_COMPONENT, FIXED_ITERATIONS_QRD,
+  FIXED_ITERATIONS_QRI and MIXED_SIZES are defined by the build system.
   Depending on the value of COMPLEX, the real or complex QR based matrix
   inversion function (QRI) is defined.
+  If MIXED_SIZES is set, the kernels invert square matrices of any size up to
+  ROWS_COMPONENT x COLS_COMPONENT, and QRI streams the size of each matrix
+  along with it.
 
   Each matrix (input and output) are represented using vectors and are
   interpreted in a column fashion (transposed).
@@ -39,7 +43,31 @@
   - repetitions: The number of repetitions of the computation to execute.
                 (for performance evaluation)
 */
-#if COMPLEX == 0
+#if MIXED_SIZES
+// Select a type for this compile depending on the value of COMPLEX
+using QRIType = std::conditional_t<COMPLEX != 0, ac_complex<float>, float>;
+
+// Single precision floating-point QR based inversion of matrices of mixed
+// sizes
+void QRIMixed(std::vector<QRIType> &a_matrix,
+              std::vector<QRIType> &inv_matrix,
+              std::vector<fpga_linalg::MatrixSize> &sizes, sycl::queue &q,
+              size_t repetitions) {
+  constexpr bool is_complex = COMPLEX != 0;
+  QRIMixedImpl<COLS_COMPONENT_V, ROWS_COMPONENT_V, FIXED_ITERATIONS_QRD,
+               FIXED_ITERATIONS_QRI, is_complex, float>(a_matrix, inv_matrix,
+                                                       sizes, q, repetitions);
+}
+
+// Single precision floating-point QR based inversion of matrices of the
+// maximum size, on the same kernels
+void QRI(std::vector<QRIType> &a_matrix, std::vector<QRIType> &inv_matrix,
+         sycl::queue &q, size_t matrices, size_t repetitions) {
+  std::vector<fpga_linalg::MatrixSize> sizes(
+      matrices, fpga_linalg::MatrixSize{ROWS_COMPONENT_V, COLS_COMPONENT_V});
+  QRIMixed(a_matrix, inv_matrix, sizes, q, repetitions);
+}
+#elif COMPLEX == 0
 // Real single precision floating-point QR based inversion
 void QRI(std::vector<float> &a_matrix, std::vector<float> &inv_matrix,
          sycl::queue &q, size_t matrices, size_t repetitions) {
@@ -137,8 +165,8 @@ bool IsFinite(float val) { return std::isfinite(val); }
     % Do the diagonal scaling
     B=diag(diag(A))\A;
 */
-template <int size, typename T>
-void GenerateMatrixWithCondititionNumber(float epsilon,
+template <typename T>
+void GenerateMatrixWithCondititionNumber(int size, float epsilon,
                                          std::vector<T> &output) {
   // Random min and max values for the random floating-point value generation
   constexpr float kRandomMin = 0;
@@ -181,6 +209,103 @@ void GenerateMatrixWithCondititionNumber(float epsilon,
   }
 }
 
+#if MIXED_SIZES
+/*
+  returns the magnitude of the given value
+*/
+double Magnitude(ac_complex<double> val) {
+  return std::sqrt(val.r() * val.r() + val.i() * val.i());
+}
+double Magnitude(double val) { return std::abs(val); }
+
+/*
+  Inverts a batch of random matrices of mixed sizes, up to
+  ROWS_COMPONENT x COLS_COMPONENT, in a single run of the kernels, and checks
+  that A * inverse(A) = Id.
+  Returns true if all the inversions are correct.
+*/
+bool TestMixedSizes(sycl::queue &q) {
+  using T = QRIType;
+  // Select a type for the check, more precise than the kernel
+  using TD = std::conditional_t<COMPLEX != 0, ac_complex<double>, double>;
+  constexpr int kSize = ROWS_COMPONENT_V;
+  constexpr float kErrorThreshold = 1e-4;
+
+  // Square matrices, from the maximum size down to 4x4
+  const int kShapes[] = {kSize,     kSize / 2, 4,    kSize - 1,
+                         kSize / 4, kSize,     kSize / 2 + 1};
+  std::vector<fpga_linalg::MatrixSize> sizes;
+  for (int size : kShapes) {
+    short matrix_size = std::max(size, 4);
+    sizes.push_back({matrix_size, matrix_size});
+  }
+
+  int a_elements = 0;
+  for (auto size : sizes) {
+    a_elements += size.rows * size.columns;
+  }
+
+  // Generate well conditioned matrices, stored column by column
+  std::vector<T> a_matrix(a_elements);
+  std::vector<T> inv_matrix(a_elements);
+  int offset = 0;
+  for (auto size : sizes) {
+    int n = size.rows;
+    std::vector<T> random_matrix(n * n);
+    GenerateMatrixWithCondititionNumber(n, 0.5, random_matrix);
+    for (int row = 0; row < n; row++) {
+      for (int col = 0; col < n; col++) {
+        a_matrix[offset + col * n + row] = random_matrix[row * n + col];
+      }
+    }
+    offset += n * n;
+  }
+
+  std::cout << std::endl
+            << "Running QR inversion of a batch of " << sizes.size()
+            << " matrices of mixed sizes:";
+  for (auto size : sizes) {
+    std::cout << " " << size.rows << "x" << size.columns;
+  }
+  std::cout << std::endl;
+
+  QRIMixed(a_matrix, inv_matrix, sizes, q, 1);
+
+  std::cout << "Verifying results...";
+  offset = 0;
+  for (auto size : sizes) {
+    int n = size.rows;
+    // Element i,j of A, stored column by column, and of the inverse, stored
+    // row by row
+    auto a = [&](int i, int j) { return a_matrix[offset + j * n + i]; };
+    auto inv = [&](int i, int j) { return inv_matrix[offset + i * n + j]; };
+
+    double error = 0;
+    for (int i = 0; i < n; i++) {
+      for (int j = 0; j < n; j++) {
+        TD a_inv_ij{0};
+        for (int k = 0; k < n; k++) {
+          a_inv_ij += TD(a(i, k)) * TD(inv(k, j));
+        }
+        double diff = Magnitude(a_inv_ij - (i == j ? TD{1} : TD{0}));
+        error = std::isfinite(diff) ? std::max(error, diff) : INFINITY;
+      }
+    }
+
+    if (!(error < kErrorThreshold)) {
+      std::cout << std::endl
+                << "Error in the inversion of the " << n << "x" << n
+                << " matrix: max |A * inverse(A) - Id| = " << error
+                << std::endl;
+      return false;
+    }
+
+    offset += n * n;
+  }
+  return true;
+}
+#endif
+
 int main(int argc, char *argv[]) {
   constexpr size_t kRandomSeed = 1138;
   constexpr size_t kRows = ROWS_COMPONENT_V;
@@ -267,7 +392,7 @@ int main(int argc, char *argv[]) {
       // Setting an epsilon of 0.5 ensures that the inverse matrix will have
       // a condition number using the infinite norm lower than 1.5/0.5 = 3
       float epsilon = 0.5;
-      GenerateMatrixWithCondititionNumber<kRows>(epsilon, random_matrix);
+      GenerateMatrixWithCondititionNumber(kRows, epsilon, random_matrix);
 
       // Copy the generated matrix in the A vector
       for (size_t row = 0; row < kRows; row++) {
@@ -566,6 +691,13 @@ int main(int argc, char *argv[]) {
       return 1;
     }
 
+#if MIXED_SIZES
+    if (!TestMixedSizes(q)) {
+      std::cout << std::endl << "FAILED" << std::endl;
+      return 1;
+    }
+#endif
+
     std::cout << std::endl << "PASSED" << std::endl;
     return 0;
 
@@ -0,0 +1,67 @@
+#ifndef __MATRIX_SIZE_HPP__
+#define __MATRIX_SIZE_HPP__
+
+namespace fpga_linalg {
+
+/*
+  Size of a matrix streamed to a linear algebra kernel compiled for matrices of
+  up to a maximum size.
+
+  The streaming kernels that take a 'SizeIn' pipe read one MatrixSize from it
+  before each matrix, so that a single kernel processes a batch of matrices of
+  different sizes. The matrix itself is then streamed with its own size: the
+  number of pipe reads and writes follows the runtime size, not the maximum
+  size the kernel is compiled for.
+  The square matrix kernels only use the 'rows' field. The runtime sizes have
+  the same functional limitations as the sizes the kernels are compiled for
+  (for example, matrices of at least 4x4).
+*/
+struct MatrixSize {
+  short rows;
+  short columns;
+};
+
+/*
+  True if a kernel compiled for matrices of up to max_rows x max_columns
+  supports a matrix of the given runtime size: at least 4x4, within the
+  maximum size, with no more columns than rows, and square if 'square'.
+
+  A streaming kernel cannot report a size it does not support, so the host
+  checks each size with this function before launching the kernels.
+*/
+inline bool MatrixSizeSupported(MatrixSize size, int max_rows,
+                                int max_columns, bool square) {
+  return size.columns >= 4 && size.rows >= size.columns &&
+         size.rows <= max_rows && size.columns <= max_columns &&
+         (!square || size.rows == size.columns);
+}
+
+/*
+  Position of the pipe reads or writes of a matrix streamed with its runtime
+  size: the chunk of pipe_size elements in the column, and the column.
+  The streaming kernels find the position of a read from the loop index with
+  divisions by the compile-time size of the matrices; with runtime sizes they
+  advance this counter instead of dividing by the size of the matrix.
+*/
+struct MatrixChunkCounter {
+  int chunk = 0;
+  int column = 0;
+
+  // Move to the next read of a matrix streamed one column at a time
+  void NextInColumn(int chunks_per_column) {
+    bool column_done = chunk == chunks_per_column - 1;
+    chunk = column_done ? 0 : chunk + 1;
+    column += column_done ? 1 : 0;
+  }
+
+  // Move to the next read of a matrix streamed by sweeps of its rows
+  void NextInRow(int columns) {
+    bool sweep_done = column == columns - 1;
+    column = sweep_done ? 0 : column + 1;
+    chunk += sweep_done ? 1 : 0;
+  }
+};
+
+}  // namespace fpga_linalg
+
+#endif /* __MATRIX_SIZE_HPP__ */
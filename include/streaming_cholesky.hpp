@@ -1,7 +1,10 @@
 #ifndef __STREAMING_CHOLESKY_HPP__
 #define __STREAMING_CHOLESKY_HPP__
 
+#include <type_traits>
+
 #include "constexpr_math.hpp"
+#include "matrix_size.hpp"
 #include "tuple.hpp"
 #include "unrolled_loop.hpp"
 
@@ -32,6 +35,10 @@ namespace fpga_linalg {
   }
 
   The input and output matrices are consumed/produced from/to pipes.
+
+  When a SizeIn pipe is given, rows is the maximum size of the matrices: the
+  size of each matrix is read from SizeIn before the matrix, and the A and L
+  matrices are streamed with that size.
 */
 template <typename T,       // The datatype for the computation
           bool is_complex,  // True if T is ac_complex<X>
@@ -50,10 +57,13 @@ template <typename T,       // The datatype for the computation
                             // to read the input matrix
           typename AIn,     // A matrix input pipe, receive pipe_size
                             // elements from the pipe with each read
-          typename LOut     // L matrix output pipe, send one element to the
+          typename LOut,    // L matrix output pipe, send one element to the
                             // pipe with each write.
                             // Only lower-left elements of L are
                             // sent in row order, starting with row 0.
+          typename SizeIn = void  // Optional MatrixSize input pipe, one read
+                                  // per A matrix. void for matrices of
+                                  // exactly rows x rows.
           >
 struct StreamingCholesky {
   void operator()() const {
@@ -72,8 +82,18 @@ struct StreamingCholesky {
     // Number of lower-left elements in the L output matrix
     constexpr int kLMatrixSize = kColumns * (kColumns + 1) / 2;
 
+    // True if the size of each matrix is read from the SizeIn pipe
+    constexpr bool kRuntimeSize = !std::is_same_v<SizeIn, void>;
+
     // Compute Cholesky decompositions as long as matrices are given as inputs
     while (1) {
+      // Size of the current matrix
+      int matrix_rows = rows;
+      if constexpr (kRuntimeSize) {
+        matrix_rows = SizeIn::read().rows;
+      }
+      int matrix_columns = matrix_rows;
+
       // Break memories up to store pipe_size elements per bank
       constexpr short kBankwidth = pipe_size * sizeof(TT);
       constexpr unsigned short kNumBanks = rows / pipe_size;
@@ -110,17 +130,38 @@ struct StreamingCholesky {
       constexpr int kLoopIterBitSize =
           fpga_tools::BitsForMaxValue<kLoopIter + 1>();
 
+      // Number of pipe reads of pipe_size required to read a full column and
+      // all the matrix, for the size of the current matrix
+      int loop_iter_per_column = kLoopIterPerColumn;
+      int loop_iter = kLoopIter;
+      if constexpr (kRuntimeSize) {
+        loop_iter_per_column = (matrix_rows + pipe_size - 1) / pipe_size;
+        loop_iter = loop_iter_per_column * matrix_columns;
+      }
+
+      // Position of each pipe read in the matrix, with runtime sizes
+      MatrixChunkCounter counter;
+
       [[intel::initiation_interval(1)]]  // NO-FORMAT: Attribute
-      for (ac_int<kLoopIterBitSize, false> li = 0; li < kLoopIter; li++) {
+      for (ac_int<kLoopIterBitSize, false> li = 0; li < loop_iter; li++) {
         fpga_tools::NTuple<TT, pipe_size> pipe_read = AIn::read();
 
-        int write_idx = li % kLoopIterPerColumn;
+        int write_idx;
+        int a_col_index;
+        if constexpr (kRuntimeSize) {
+          write_idx = counter.chunk;
+          a_col_index = counter.column;
+          counter.NextInColumn(loop_iter_per_column);
+        } else {
+          write_idx = li % kLoopIterPerColumn;
+          a_col_index = li / kLoopIterPerColumn;
+        }
 
         fpga_tools::UnrolledLoop<kLoopIterPerColumn>([&](auto k) {
           fpga_tools::UnrolledLoop<pipe_size>([&](auto t) {
             if constexpr (k * pipe_size + t < kColumns) {
               if (write_idx == k) {
-                a_load[li / kLoopIterPerColumn][k * pipe_size + t] =
+                a_load[a_col_index][k * pipe_size + t] =
                     pipe_read.template get<t>();
               }
             }
@@ -138,21 +179,22 @@ struct StreamingCholesky {
       // Computation of the number of iterations required for the triangular
       // loop. Refer to the triangular_loop tutorial for details on how
       // to compute these.
-      constexpr int kRegularIterations = kColumns * (kColumns + 1) / 2;
+      int regular_iterations = matrix_columns * (matrix_columns + 1) / 2;
       constexpr int kExtraIterations = (raw_latency - 1) * raw_latency / 2;
-      constexpr int kExtraIterationsToRemove =
-          kColumns >= raw_latency
+      int extra_iterations_to_remove =
+          matrix_columns >= raw_latency
               ? 0
-              : (raw_latency - kColumns) * (raw_latency - kColumns + 1) / 2;
-      constexpr int kTotalIterations =
-          kRegularIterations + kExtraIterations - kExtraIterationsToRemove;
+              : (raw_latency - matrix_columns) *
+                    (raw_latency - matrix_columns + 1) / 2;
+      int total_iterations =
+          regular_iterations + kExtraIterations - extra_iterations_to_remove;
 
       // Compute the L matrix
       int column = 0;
       int row = 0;
       TT div_term{0};
       [[intel::ivdep(raw_latency)]] // NO-FORMAT: Attribute
-      for (int iteration = 0; iteration < kTotalIterations; iteration++) {
+      for (int iteration = 0; iteration < total_iterations; iteration++) {
         // Perform the dot product of the elements of the two rows indexed by
         // row and column from element 0 to column
 
@@ -171,7 +213,7 @@ struct StreamingCholesky {
           sum += to_add;
         });
 
-        TT a_loaded = (row < rows) ? a_load[row][column] : TT{0};
+        TT a_loaded = (row < matrix_rows) ? a_load[row][column] : TT{0};
         TT diff = a_loaded - sum;
 
         // Only do useful work for meaningful iterations
@@ -210,9 +252,9 @@ struct StreamingCholesky {
         }
 
         // Update loop indexes
-        if (row == (rows - 1)) {
+        if (row == (matrix_rows - 1)) {
           column = column + 1;
-          row = sycl::min(column, rows - raw_latency);
+          row = sycl::min(column, matrix_rows - raw_latency);
         } else {
           row = row + 1;
         }
@@ -222,7 +264,7 @@ struct StreamingCholesky {
       // Go over the L matrix and write each element to the pipe
       int l_idx = 0;
       [[intel::loop_coalesce(2)]] // NO-FORMAT: Attribute
-      for (int row = 0; row < rows; row++) {
+      for (int row = 0; row < matrix_rows; row++) {
         for (int column = 0; column <= row; column++) {
           TT to_write;
           TT current_l_value = l_result[l_idx];
@@ -1,7 +1,10 @@
 #ifndef __STREAMING_CHOLESKY_INVERSION_HPP__
 #define __STREAMING_CHOLESKY_INVERSION_HPP__
 
+#include <type_traits>
+
 #include "constexpr_math.hpp"
+#include "matrix_size.hpp"
 #include "tuple.hpp"
 #include "unrolled_loop.hpp"
 
@@ -32,6 +35,10 @@ namespace fpga_linalg {
   }
 
   The input and output matrices are consumed/produced from/to pipes.
+
+  When a SizeIn pipe is given, rows is the maximum size of the matrices: the
+  size of each matrix is read from SizeIn before its L matrix, and the L and
+  inverse matrices are streamed with that size.
 */
 template <typename T,       // The datatype for the computation
           bool is_complex,  // True if T is ac_complex<X>
@@ -50,10 +57,13 @@ template <typename T,       // The datatype for the computation
                             // to read the input matrix
           typename LIn,     // A matrix input pipe, receive pipe_size
                             // elements from the pipe with each read
-          typename IOut     // L matrix output pipe, send one elements to the
+          typename IOut,    // L matrix output pipe, send one elements to the
                             // pipe with each write.
                             // Only lower-left elements of L are
                             // sent in row order, starting with row 0.
+          typename SizeIn = void  // Optional MatrixSize input pipe, one read
+                                  // per L matrix. void for matrices of
+                                  // exactly rows x rows.
           >
 struct StreamingCholeskyInversion {
   void operator()() const {
@@ -69,8 +79,17 @@ struct StreamingCholeskyInversion {
 
     constexpr int kColumns = rows;
 
+    // True if the size of each matrix is read from the SizeIn pipe
+    constexpr bool kRuntimeSize = !std::is_same_v<SizeIn, void>;
+
     // Compute Cholesky-based inversions as long as L input matrices are given
     while (1) {
+      // Size of the current matrix
+      int matrix_rows = rows;
+      if constexpr (kRuntimeSize) {
+        matrix_rows = SizeIn::read().rows;
+      }
+      int matrix_columns = matrix_rows;
 
       // The compiler has difficulty automatically figuring out an optimal
       // configuration for these memories, so force all relevant parameters.
@@ -98,7 +117,7 @@ struct StreamingCholeskyInversion {
       [[intel::max_replicates(1)]]  // NO-FORMAT: Attribute
       TT i_matrix[kColumns * (kColumns + 1) / 2];
 
-      for (int row = 0; row < rows; row++) {
+      for (int row = 0; row < matrix_rows; row++) {
         for (int col = 0; col <= row; col++) {
           TT element = LIn::read();
 
@@ -129,12 +148,13 @@ struct StreamingCholeskyInversion {
 
       // Count the total number of loop iterations, using the triangular loop
       // optimization (refer to the Triangular Loop design pattern tutorial)
-      constexpr int kNormalIterations = kColumns * (kColumns + 1) / 2;
-      constexpr int kExtraIterations =
-          (raw_latency > rows) ? ((rows - 1) * (raw_latency - rows)) +
-                                     ((rows - 2) * (rows - 1)) / 2
-                               : (raw_latency - 2) * (raw_latency - 2 + 1) / 2;
-      constexpr int kTotalIterations = kNormalIterations + kExtraIterations;
+      int normal_iterations = matrix_columns * (matrix_columns + 1) / 2;
+      int extra_iterations =
+          (raw_latency > matrix_rows)
+              ? ((matrix_rows - 1) * (raw_latency - matrix_rows)) +
+                    ((matrix_rows - 2) * (matrix_rows - 1)) / 2
+              : (raw_latency - 2) * (raw_latency - 2 + 1) / 2;
+      int total_iterations = normal_iterations + extra_iterations;
 
       constexpr int kInitIterations = 0;
 
@@ -161,14 +181,15 @@ struct StreamingCholeskyInversion {
 
       int diagonal_number = 0;
       int next_diagonal_number = 1;
-      int diagonal_size = (kColumns > raw_latency ? kColumns : raw_latency) - 1;
+      int diagonal_size =
+          (matrix_columns > raw_latency ? matrix_columns : raw_latency) - 1;
       int col = diagonal_number;
       int row = 0;
  
       [[intel::ivdep(raw_latency)]]  // NO-FORMAT: Attribute
-      for (int it = 0; it < kTotalIterations + kInitIterations; it++) {
+      for (int it = 0; it < total_iterations + kInitIterations; it++) {
         // Only perform work when in not dummy iterations
-        if ((row < rows) & (col < kColumns)) {
+        if ((row < matrix_rows) & (col < matrix_columns)) {
           TT current_sum = (row == col) ? TT{1} : TT{0};
           TT div_val;
 
@@ -210,7 +231,7 @@ struct StreamingCholeskyInversion {
         if (row == diagonal_size) {
           diagonal_number = next_diagonal_number;
           diagonal_size =
-              std::max(kColumns - next_diagonal_number, raw_latency) - 1;
+              std::max(matrix_columns - next_diagonal_number, raw_latency) - 1;
           col = next_diagonal_number;
           row = 0;
           next_diagonal_number++;
@@ -222,11 +243,11 @@ struct StreamingCholeskyInversion {
 
       int inverse_matrix_write_idx = 0;
       // Compute inv(A) = inv(L)*trans(inv(L))
-      for (int col = 0; col < rows; col++) {
+      for (int col = 0; col < matrix_rows; col++) {
         TT col_of_transpose_matrix[rows];
         int row_index;
 
-        for (int row = col; row < rows; row++) {
+        for (int row = col; row < matrix_rows; row++) {
           if (row >= rows) {
             row_index = row - rows;
           } else {
@@ -242,8 +263,12 @@ struct StreamingCholeskyInversion {
               col_of_transpose_matrix[k] = li_load;
             }
 
-            auto lhs = (k < row_index) ? TT{0} : li_load;
-            auto rhs = (k < col) ? TT{0} : col_of_transpose_matrix[k];
+            // With runtime sizes, the columns of li_matrix past the matrix
+            // hold the data of previous matrices
+            bool outside = kRuntimeSize && k >= matrix_columns;
+            auto lhs = (k < row_index) || outside ? TT{0} : li_load;
+            auto rhs =
+                (k < col) || outside ? TT{0} : col_of_transpose_matrix[k];
             if constexpr (is_complex) {
               elem += lhs * rhs.conj();
             } else {
@@ -256,7 +281,7 @@ struct StreamingCholeskyInversion {
       }
 
       int inverse_matrix_read_idx = 0;
-      for (int loop_count = 0; loop_count < kNormalIterations; loop_count++) {
+      for (int loop_count = 0; loop_count < normal_iterations; loop_count++) {
         IOut::write(i_matrix[inverse_matrix_read_idx]);
         inverse_matrix_read_idx++;
       }
@@ -1,7 +1,10 @@
 #ifndef __STREAMING_QRD_HPP__
 #define __STREAMING_QRD_HPP__
 
+#include <type_traits>
+
 #include "constexpr_math.hpp"
+#include "matrix_size.hpp"
 #include "tuple.hpp"
 #include "unrolled_loop.hpp"
 
@@ -20,6 +23,10 @@ namespace fpga_linalg {
   Each matrix (input and output) are represented in a column wise (transposed).
 
   Then input and output matrices are consumed/produced from/to pipes.
+
+  When a SizeIn pipe is given, rows and columns are the maximum size of the
+  matrices: the size of each matrix is read from SizeIn before the matrix, and
+  the A, Q and R matrices are streamed with that size.
 */
 template <typename T,       // The datatype for the computation
           bool is_complex,  // True if T is ac_complex<X>
@@ -47,11 +54,14 @@ template <typename T,       // The datatype for the computation
                             // Only upper-right elements of R are
                             // sent in row order, starting with row 0.
           bool k_column_order =
-              true  // Default value is true for standard matrix input reads
-                    // (reads the matrix one column at a time). False if read
-                    // order by rows (sweeps the rows by pipe size). Each read
-                    // contains pipe_size samples from the same column, then the
-                    // next read contains samples from the next column.
+              true,  // Default value is true for standard matrix input reads
+                     // (reads the matrix one column at a time). False if read
+                     // order by rows (sweeps the rows by pipe size). Each read
+                     // contains pipe_size samples from the same column, then
+                     // the next read contains samples from the next column.
+          typename SizeIn = void  // Optional MatrixSize input pipe, one read
+                                  // per A matrix. void for matrices of
+                                  // exactly rows x columns.
           >
 struct StreamingQRD {
   void operator()() const {
@@ -61,6 +71,9 @@ struct StreamingQRD {
     static_assert(columns >= 4,
                   "only matrices of size 4x4 and over are supported");
 
+    // True if the size of each matrix is read from the SizeIn pipe
+    constexpr bool kRuntimeSize = !std::is_same_v<SizeIn, void>;
+
     /*
       This code implements a oneAPI optimized variation of the following
       algorithm
@@ -107,16 +120,8 @@ struct StreamingQRD {
                                         : rows / kFanoutReduction;
 
     // Number of iterations performed without any dummy work added for the
-    // triangular loop optimization
+    // triangular loop optimization, for matrices of the maximum size
     constexpr int kVariableIterations = columns - raw_latency;
-    // Total number of dummy iterations
-    static constexpr int kDummyIterations =
-        raw_latency > columns
-            ? (columns - 1) * columns / 2 + (raw_latency - columns) * columns
-            : raw_latency * (raw_latency - 1) / 2;
-    // Total number of iterations (including dummy iterations)
-    static constexpr int kIterations =
-        columns + columns * (columns + 1) / 2 + kDummyIterations;
 
     // Size in bits of the "i" loop variable in the triangular loop
     // i starts from -1 as we are doing a full copy of the matrix read from the
@@ -134,14 +139,39 @@ struct StreamingQRD {
     // -> enough bits to encode columns+1 for the positive iterations and
     //    the exit condition
     // -> enough bits to encode the maximum number of negative iterations
+    // which, with runtime sizes, is reached by the smallest matrices
     static constexpr int kJNegativeIterations =
-        kVariableIterations < 0 ? -kVariableIterations : 1;
+        kRuntimeSize ? raw_latency
+                     : (kVariableIterations < 0 ? -kVariableIterations : 1);
     static constexpr int kJBitSize =
         fpga_tools::BitsForMaxValue<columns + 1>() +
         fpga_tools::BitsForMaxValue<kJNegativeIterations>();
 
     // Compute QRDs as long as matrices are given as inputs
     while (1) {
+      // Size of the current matrix
+      int matrix_rows = rows;
+      int matrix_columns = columns;
+      if constexpr (kRuntimeSize) {
+        MatrixSize size = SizeIn::read();
+        matrix_rows = size.rows;
+        matrix_columns = size.columns;
+      }
+
+      // Number of iterations performed without any dummy work added for the
+      // triangular loop optimization
+      int variable_iterations = matrix_columns - raw_latency;
+      // Total number of dummy iterations
+      int dummy_iterations =
+          raw_latency > matrix_columns
+              ? (matrix_columns - 1) * matrix_columns / 2 +
+                    (raw_latency - matrix_columns) * matrix_columns
+              : raw_latency * (raw_latency - 1) / 2;
+      // Total number of iterations (including dummy iterations)
+      int iterations = matrix_columns +
+                       matrix_columns * (matrix_columns + 1) / 2 +
+                       dummy_iterations;
+
       // Three copies of the full matrix, so that each matrix has a single
       // load and a single store.
       // a_load is the initial matrix received from the pipe
@@ -179,25 +209,56 @@ struct StreamingQRD {
       constexpr int kLoopIterBitSize =
           fpga_tools::BitsForMaxValue<kLoopIter + 1>();
 
+      // Number of pipe reads of pipe_size required to read a full column and
+      // all the matrix, for the size of the current matrix
+      int loop_iter_per_column = kLoopIterPerColumn;
+      int loop_iter = kLoopIter;
+      if constexpr (kRuntimeSize) {
+        loop_iter_per_column = (matrix_rows + pipe_size - 1) / pipe_size;
+        loop_iter = loop_iter_per_column * matrix_columns;
+      }
+
+      // Position of each pipe read in the matrix, with runtime sizes
+      MatrixChunkCounter counter;
+
       [[intel::initiation_interval(1)]]  // NO-FORMAT: Attribute
-      for (ac_int<kLoopIterBitSize, false> li = 0; li < kLoopIter; li++) {
+      for (ac_int<kLoopIterBitSize, false> li = 0; li < loop_iter; li++) {
         fpga_tools::NTuple<TT, pipe_size> pipe_read = AIn::read();
 
         int write_idx;
         int a_col_index;
-        if constexpr (k_column_order) {
+        if constexpr (kRuntimeSize) {
+          write_idx = counter.chunk;
+          a_col_index = counter.column;
+          if constexpr (k_column_order) {
+            counter.NextInColumn(loop_iter_per_column);
+          } else {
+            counter.NextInRow(matrix_columns);
+          }
+        } else if constexpr (k_column_order) {
           write_idx = li % kLoopIterPerColumn;
           a_col_index = li / kLoopIterPerColumn;
         } else {
           write_idx = li / columns;
           a_col_index = li % columns;
         }
-        // int write_idx = li / columns;
+
+        // The rows below a matrix smaller than the maximum size take part in
+        // the dot products of the decomposition, so they are zeroed: the last
+        // read of a column also clears the chunks of the column below it.
+        bool last_read = write_idx == loop_iter_per_column - 1;
 
         fpga_tools::UnrolledLoop<kLoopIterPerColumn>([&](auto k) {
           fpga_tools::UnrolledLoop<pipe_size>([&](auto t) {
-            if (write_idx == k) {
-              if constexpr (k * pipe_size + t < rows) {
+            if constexpr (k * pipe_size + t < rows) {
+              if constexpr (kRuntimeSize) {
+                if (write_idx == k || (last_read && k > write_idx)) {
+                  a_load[a_col_index].template get<k * pipe_size + t>() =
+                      (write_idx == k && k * pipe_size + t < matrix_rows)
+                          ? pipe_read.template get<t>()
+                          : TT{0};
+                }
+              } else if (write_idx == k) {
                 a_load[a_col_index].template get<k * pipe_size + t>() =
                     pipe_read.template get<t>();
               }
@@ -210,6 +271,7 @@ struct StreamingQRD {
           });
 
           write_idx = sycl::ext::intel::fpga_reg(write_idx);
+          last_read = sycl::ext::intel::fpga_reg(last_read);
         });
       }
 
@@ -245,17 +307,17 @@ struct StreamingQRD {
 
       [[intel::initiation_interval(1)]]  // NO-FORMAT: Attribute
       [[intel::ivdep(raw_latency)]]      // NO-FORMAT: Attribute
-      for (int s = 0; s < kIterations; s++) {
+      for (int s = 0; s < iterations; s++) {
         // Pre-compute the next values of i and j
         ac_int<kIBitSize, true> next_i;
         ac_int<kJBitSize, true> next_j;
-        if (j == columns - 1) {
+        if (j == matrix_columns - 1) {
           // If i reached an index at which the j inner loop don't have
           // enough time to write its result for the next i iteration,
           // some "dummy" iterations are introduced
-          next_j = (kVariableIterations > i)
+          next_j = (variable_iterations > i)
                        ? ac_int<kJBitSize, true>{i + 1}
-                       : ac_int<kJBitSize, true>{kVariableIterations};
+                       : ac_int<kJBitSize, true>{variable_iterations};
           next_i = i + 1;
         } else {
           next_j = j + 1;
@@ -428,19 +490,19 @@ struct StreamingQRD {
         }
 
         // Write the computed R value when j is not a "dummy" iteration
-        if ((j >= i + 1) && (i + 1 < columns)) {
+        if ((j >= i + 1) && (i + 1 < matrix_columns)) {
           r_result[r_element_index] = r_ip1j;
           r_element_index++;
         }
 
         // Update loop indexes
-        if (j == (columns - 1)) {
+        if (j == (matrix_columns - 1)) {
           // If i reached an index at which the j inner loop doesn't have
           // enough time to write its result for the next i iteration,
           // some "dummy" iterations are introduced
-          j = (kVariableIterations > i)
+          j = (variable_iterations > i)
                   ? ac_int<kJBitSize, true>{i + 1}
-                  : ac_int<kJBitSize, true>{kVariableIterations};
+                  : ac_int<kJBitSize, true>{variable_iterations};
           i = i + 1;
         } else {
           j = j + 1;
@@ -449,16 +511,27 @@ struct StreamingQRD {
       }  // end of s
 
       // Number of upper-right elements in the R output matrix
-      constexpr int kRMatrixSize = columns * (columns + 1) / 2;
+      int r_matrix_size = matrix_columns * (matrix_columns + 1) / 2;
 
       [[intel::initiation_interval(1)]]  // NO-FORMAT: Attribute
-      for (int r_idx = 0; r_idx < kRMatrixSize; r_idx++) {
+      for (int r_idx = 0; r_idx < r_matrix_size; r_idx++) {
         ROut::write(r_result[r_idx]);
       }
 
+      counter = MatrixChunkCounter();
+
       [[intel::initiation_interval(1)]]  // NO-FORMAT: Attribute
-      for (ac_int<kLoopIterBitSize, false> li = 0; li < kLoopIter; li++) {
-        int column_iter = li % kLoopIterPerColumn;
+      for (ac_int<kLoopIterBitSize, false> li = 0; li < loop_iter; li++) {
+        int column_iter;
+        int q_col_index;
+        if constexpr (kRuntimeSize) {
+          column_iter = counter.chunk;
+          q_col_index = counter.column;
+          counter.NextInColumn(loop_iter_per_column);
+        } else {
+          column_iter = li % kLoopIterPerColumn;
+          q_col_index = li / kLoopIterPerColumn;
+        }
         bool get[kLoopIterPerColumn];
         fpga_tools::UnrolledLoop<kLoopIterPerColumn>([&](auto k) {
           get[k] = column_iter == k;
@@ -470,7 +543,7 @@ struct StreamingQRD {
           fpga_tools::UnrolledLoop<pipe_size>([&](auto k) {
             if constexpr (t * pipe_size + k < rows) {
               pipe_write.template get<k>() =
-                  get[t] ? q_result[li / kLoopIterPerColumn]
+                  get[t] ? q_result[q_col_index]
                                .template get<t * pipe_size + k>()
                          : sycl::ext::intel::fpga_reg(
                                pipe_write.template get<k>());
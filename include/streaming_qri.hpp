@@ -1,7 +1,10 @@
 #ifndef __STREAMING_QRI_HPP__
 #define __STREAMING_QRI_HPP__
 
+#include <type_traits>
+
 #include "constexpr_math.hpp"
+#include "matrix_size.hpp"
 #include "tuple.hpp"
 #include "unrolled_loop.hpp"
 
@@ -15,6 +18,10 @@ namespace fpga_linalg {
   - Output matrix I, the inverse of A such that A=QR
 
   Then input and output matrices are consumed/produced from/to pipes.
+
+  When a SizeIn pipe is given, rows and columns are the maximum size of the
+  matrices: the size of each matrix is read from SizeIn before its R matrix,
+  and the Q, R and inverse matrices are streamed with that size.
 */
 template <typename T,       // The datatype for the computation
           bool is_complex,  // True if T is ac_complex<T>
@@ -37,8 +44,11 @@ template <typename T,       // The datatype for the computation
           typename RIn,     // R input pipe. Receive one element per read.
                             // Only upper-right elements of R are sent.
                             // Sent in row order, starting with row 0.
-          typename IOut     // Inverse matrix output pipe.
+          typename IOut,    // Inverse matrix output pipe.
                             // The output is written column by column
+          typename SizeIn = void  // Optional MatrixSize input pipe, one read
+                                  // per matrix. void for matrices of exactly
+                                  // rows x columns.
           >
 struct StreamingQRI {
   void operator()() const {
@@ -52,8 +62,19 @@ struct StreamingQRI {
     // of is_complex
     using TT = std::conditional_t<is_complex, ac_complex<T>, T>;
 
+    // True if the size of each matrix is read from the SizeIn pipe
+    constexpr bool kRuntimeSize = !std::is_same_v<SizeIn, void>;
+
     // Continue to compute as long as matrices are given as inputs
     while (1) {
+      // Size of the current matrix
+      int matrix_rows = rows;
+      int matrix_columns = columns;
+      if constexpr (kRuntimeSize) {
+        matrix_rows = SizeIn::read().rows;
+        matrix_columns = matrix_rows;
+      }
+
       // Q matrix read from pipe
       [[intel::private_copies(4)]]  // NO-FORMAT: Attribute
       [[intel::max_replicates(1)]]  // NO-FORMAT: Attribute
@@ -85,8 +106,8 @@ struct StreamingQRI {
 
       // Transpose the R matrix
       [[intel::loop_coalesce(2)]]  // NO-FORMAT: Attribute
-      for (int row = 0; row < rows; row++) {
-        for (int col = 0; col < columns; col++) {
+      for (int row = 0; row < matrix_rows; row++) {
+        for (int col = 0; col < matrix_columns; col++) {
           rt_matrix[col][row] = col < row ? TT{0} : RIn::read();
         }
       }
@@ -102,17 +123,38 @@ struct StreamingQRI {
       constexpr int kLoopIterBitSize =
           fpga_tools::BitsForMaxValue<kLoopIter + 1>();
 
+      // Number of pipe reads of pipe_size required to read a full column and
+      // all the matrix, for the size of the current matrix
+      int loop_iter_per_column = kLoopIterPerColumn;
+      int loop_iter = kLoopIter;
+      if constexpr (kRuntimeSize) {
+        loop_iter_per_column = (matrix_rows + pipe_size - 1) / pipe_size;
+        loop_iter = loop_iter_per_column * matrix_columns;
+      }
+
+      // Position of each pipe read in the matrix, with runtime sizes
+      MatrixChunkCounter counter;
+
       [[intel::initiation_interval(1)]]  // NO-FORMAT: Attribute
-      for (ac_int<kLoopIterBitSize, false> li = 0; li < kLoopIter; li++) {
+      for (ac_int<kLoopIterBitSize, false> li = 0; li < loop_iter; li++) {
         fpga_tools::NTuple<TT, pipe_size> pipe_read = QIn::read();
 
-        int write_idx = li % kLoopIterPerColumn;
+        int write_idx;
+        int q_col_index;
+        if constexpr (kRuntimeSize) {
+          write_idx = counter.chunk;
+          q_col_index = counter.column;
+          counter.NextInColumn(loop_iter_per_column);
+        } else {
+          write_idx = li % kLoopIterPerColumn;
+          q_col_index = li / kLoopIterPerColumn;
+        }
 
         fpga_tools::UnrolledLoop<kLoopIterPerColumn>([&](auto k) {
           fpga_tools::UnrolledLoop<pipe_size>([&](auto t) {
             if (write_idx == k) {
               if constexpr (k * pipe_size + t < rows) {
-                q_matrix[li / kLoopIterPerColumn][k * pipe_size + t] =
+                q_matrix[q_col_index][k * pipe_size + t] =
                     pipe_read.template get<t>();
               }
             }
@@ -146,46 +188,52 @@ struct StreamingQRI {
 
       // Count the total number of loop iterations, using the triangular loop
       // optimization (refer to the triangular loop optimization tutorial)
-      constexpr int kNormalIterations = columns * (columns + 1) / 2;
-      constexpr int kExtraIterations =
-          raw_latency > rows
-              ? (rows - 1) * (raw_latency - rows) + (rows - 2) * (rows - 1) / 2
+      int normal_iterations = matrix_columns * (matrix_columns + 1) / 2;
+      int extra_iterations =
+          raw_latency > matrix_rows
+              ? (matrix_rows - 1) * (raw_latency - matrix_rows) +
+                    (matrix_rows - 2) * (matrix_rows - 1) / 2
               : (raw_latency - 2) * (raw_latency - 2 + 1) / 2;
-      constexpr int kTotalIterations = kNormalIterations + kExtraIterations;
-      constexpr bool kThereAreExtraInitIterations = rows - 1 < raw_latency - 1;
-      constexpr int kInitExtraIterations =
-          kThereAreExtraInitIterations ? raw_latency - 1 : rows - 1;
-      constexpr int kInitIterations =
-          (rows - 2) * (rows - 1) / 2 + kInitExtraIterations;
+      int total_iterations = normal_iterations + extra_iterations;
+      bool there_are_extra_init_iterations =
+          matrix_rows - 1 < raw_latency - 1;
+      int init_extra_iterations =
+          there_are_extra_init_iterations ? raw_latency - 1 : matrix_rows - 1;
+      int init_iterations =
+          (matrix_rows - 2) * (matrix_rows - 1) / 2 + init_extra_iterations;
 
       // All the loop control variables with all the requirements to apply
       // some shannonization (refer to the shannonization tutorial)
-      int row = rows - 1;
-      int row_plus_1 = rows;
+      int row = matrix_rows - 1;
+      int row_plus_1 = matrix_rows;
       int col = 0;
       int col_plus_1 = 1;
-      int row_limit = rows - 1;
+      int row_limit = matrix_rows - 1;
       int diag_size = 1;
       int next_diag_size = 2;
       int diag_iteration = 0;
       int diag_iteration_plus_1 = 1;
-      int start_row = rows - 2;
-      int start_row_plus_1 = rows - 1;
+      int start_row = matrix_rows - 2;
+      int start_row_plus_1 = matrix_rows - 1;
       int start_col = 0;
       int start_col_plus_1 = 1;
-      int next_row_limit = rows - 1;
+      int next_row_limit = matrix_rows - 1;
 
       [[intel::ivdep(raw_latency)]]  // NO-FORMAT: Attribute
-      for (int it = 0; it < kTotalIterations + kInitIterations; it++) {
+      for (int it = 0; it < total_iterations + init_iterations; it++) {
         // Only perform work when in not dummy iterations
-        if (row < rows & col < columns) {
+        if (row < matrix_rows & col < matrix_columns) {
           qt_matrix[row][col] = q_matrix[col][row];
 
           TT current_sum = row == col ? TT{1} : TT{0};
           TT div_val;
 
           fpga_tools::UnrolledLoop<columns>([&](auto k) {
-            auto lhs = rt_matrix[col][k];
+            // With runtime sizes, the columns of rt_matrix past the matrix
+            // hold the data of previous matrices
+            auto lhs = (kRuntimeSize && k >= matrix_columns)
+                           ? TT{0}
+                           : rt_matrix[col][k];
             auto rhs =
                 (k >= col) || (col < row) ? TT{0} : ri_matrix_compute[row][k];
             if (k == col) {
@@ -207,26 +255,26 @@ struct StreamingQRI {
         // Update loop indexes
         if (row == row_limit) {
           row_limit = next_row_limit;
-          if constexpr (kThereAreExtraInitIterations) {
-            next_row_limit = (diag_iteration + 2) >= (rows - 2)
+          if (there_are_extra_init_iterations) {
+            next_row_limit = (diag_iteration + 2) >= (matrix_rows - 2)
                                  ? sycl::max(next_diag_size, raw_latency - 1)
-                                 : rows - 1;
+                                 : matrix_rows - 1;
           } else {
             next_row_limit =
-                (diag_iteration + 2) >= rows
+                (diag_iteration + 2) >= matrix_rows
                     ? sycl::max(next_diag_size - 2, raw_latency - 1)
-                    : rows - 1;
+                    : matrix_rows - 1;
           }
 
           diag_size = next_diag_size;
-          int to_sum = diag_iteration >= rows - 2 ? -1 : 1;
+          int to_sum = diag_iteration >= matrix_rows - 2 ? -1 : 1;
           next_diag_size = diag_size + to_sum;
 
           row = start_row;
           row_plus_1 = start_row_plus_1;
           col = start_col;
           col_plus_1 = start_col_plus_1;
-          int start = diag_iteration + 1 - rows + 2;
+          int start = diag_iteration + 1 - matrix_rows + 2;
           start_col = start < 0 ? 0 : start;
           start_col_plus_1 = start_col + 1;
           start_row = start >= 0 ? 0 : -start;
@@ -244,14 +292,20 @@ struct StreamingQRI {
 
       // Multiply the inverse of R by the transposition of Q
       [[intel::loop_coalesce(2)]]  // NO-FORMAT: Attribute
-      for (int row = 0; row < rows; row++) {
-        for (int col = 0; col < columns; col++) {
+      for (int row = 0; row < matrix_rows; row++) {
+        for (int col = 0; col < matrix_columns; col++) {
           TT dot_product = {0.0};
           fpga_tools::UnrolledLoop<rows>([&](auto k) {
+            TT product;
             if constexpr (is_complex) {
-              dot_product += ri_matrix[row][k] * qt_matrix[col][k].conj();
+              product = ri_matrix[row][k] * qt_matrix[col][k].conj();
             } else {
-              dot_product += ri_matrix[row][k] * qt_matrix[col][k];
+              product = ri_matrix[row][k] * qt_matrix[col][k];
+            }
+            // With runtime sizes, the elements past the matrix hold the data
+            // of previous matrices
+            if (!kRuntimeSize || k < matrix_rows) {
+              dot_product += product;
             }
           });
           i_matrix[row][col] = dot_product;
@@ -259,9 +313,20 @@ struct StreamingQRI {
       }    // end of row
 
       // Copy the inverse matrix result to the output pipe
+      counter = MatrixChunkCounter();
+
       [[intel::initiation_interval(1)]]  // NO-FORMAT: Attribute
-      for (ac_int<kLoopIterBitSize, false> li = 0; li < kLoopIter; li++) {
-        int column_iter = li % kLoopIterPerColumn;
+      for (ac_int<kLoopIterBitSize, false> li = 0; li < loop_iter; li++) {
+        int column_iter;
+        int i_col_index;
+        if constexpr (kRuntimeSize) {
+          column_iter = counter.chunk;
+          i_col_index = counter.column;
+          counter.NextInColumn(loop_iter_per_column);
+        } else {
+          column_iter = li % kLoopIterPerColumn;
+          i_col_index = li / kLoopIterPerColumn;
+        }
         bool get[kLoopIterPerColumn];
         fpga_tools::UnrolledLoop<kLoopIterPerColumn>([&](auto k) {
           get[k] = column_iter == k;
@@ -273,7 +338,7 @@ struct StreamingQRI {
           fpga_tools::UnrolledLoop<pipe_size>([&](auto k) {
             if constexpr (t * pipe_size + k < rows) {
               pipe_write.template get<k>() =
-                  get[t] ? i_matrix[li / kLoopIterPerColumn][(t * pipe_size) + k]
+                  get[t] ? i_matrix[i_col_index][(t * pipe_size) + k]
                          : sycl::ext::intel::fpga_reg(
                                pipe_write.template get<k>());
             }